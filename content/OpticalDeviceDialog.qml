@@ -71,5 +71,12 @@ Dialog {
                 }
             }
         }
+
+        // Absorption of each layer
+        Component.onCompleted: {
+            for (let i = 0; i < device.num_layers; i++) {
+                device.fillLayerSeries(plotChartView.createSeries(ChartView.SeriesTypeLine, "A" + i, axisX, axisY), i)
+            }
+        }
     }
 }
\ No newline at end of file
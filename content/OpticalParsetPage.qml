@@ -78,10 +78,12 @@ OpticalParsetPageForm {
                 // }
                 Button {
                     id: dbImportButton
-                    text: "Import"
+                    text: model.db_model.loading ? "Cancel" : "Import"
                     enabled: model.checked
                     onClicked: {
-                        if (model.name === "GCL") {
+                        if (model.db_model.loading) {
+                            model.db_model.cancelLoading()
+                        } else if (model.name === "GCL") {
                             // For anyone wants something like WidgetItem:
                             // https://stackoverflow.com/questions/59127594/is-there-any-way-to-embed-a-qwidget-inside-a-qqmlapplicationengine-or-qquickview
                             // https://www.reddit.com/r/QtFramework/comments/u6rvvj/any_one_has_an_idea_how_to_use_a_qtwidget_in_qml/
@@ -183,16 +185,23 @@ OpticalParsetPageForm {
                     model.path = dbPath.toString()
                 }
                 // Even for the same path, we should allow re-importing because the same file may change.
-                let status
+                // The import runs in the background and reports its status by the loaded signal.
                 if (model.name === "Solcore") {
-                    status = model.db_model.readSolcoreDb(model.path)
+                    model.db_model.readSolcoreDb(model.path)
                 } else if (model.name === "Df") {
-                    status = model.db_model.readDfDb(model.path)
+                    model.db_model.readDfDb(model.path)
                 } else if (model.name === "Sopra") {
-                    status = model.db_model.readSopraDb(model.path)
+                    model.db_model.readSopraDb(model.path)
+                }
+            }
+
+            Connections {
+                target: model.db_model
+
+                function onLoaded(status) {
+                    statusText.text = statusInfo(status)
+                    showButton.enabled = status === 0
                 }
-                statusText.text = statusInfo(status)
-                showButton.enabled = status === 0
             }
         }
     }
@@ -205,6 +214,8 @@ OpticalParsetPageForm {
                 return "Cannot find the path"
             case 2:
                 return "Fail to load the n/k data"
+            case 3:
+                return "Import is cancelled"
             default:
                 return "Invalid status"
         }
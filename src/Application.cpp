@@ -2,12 +2,15 @@
 // Created by Yihua Liu on 2024/2/23.
 //
 
+#include <algorithm>
 #include <filesystem>
+#include <QList>
 
 #include "Application.h"
 #include "Preferences.h"
 #include "Profile.h"
 #include "SettingsStorage.h"
+#include "material/MaterialCache.h"
 
 using namespace std::string_literals;  // equivalent to std::literals::string_literals
 
@@ -24,4 +27,6 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv) {
     Profile::initInstance(profileDir, m_commandLineArgs.configName);
     SettingsStorage::initInstance();
     Preferences::initInstance();
+    MaterialCache<QList<double>>::instance().setBudget(
+            static_cast<std::size_t>(std::max(Preferences::instance()->getsMaterialCacheSize(), 0)) << 20);
 }
@@ -44,3 +44,28 @@ void Preferences::freeInstance() {
 std::filesystem::path Preferences::getsUnitSystemPath() const {
     return value<std::filesystem::path>(u"Preferences/Downloads/UnitsSystemPath"_s);
 }
+
+// Materials
+bool Preferences::getsSinglePrecisionNk() const {
+    return value(u"Preferences/Materials/SinglePrecisionNk"_s, false);
+}
+
+void Preferences::setSinglePrecisionNk(const bool enabled) {
+    setValue(u"Preferences/Materials/SinglePrecisionNk"_s, enabled);
+}
+
+bool Preferences::getsPchipNk() const {
+    return value(u"Preferences/Materials/PchipNk"_s, false);
+}
+
+void Preferences::setPchipNk(const bool enabled) {
+    setValue(u"Preferences/Materials/PchipNk"_s, enabled);
+}
+
+int Preferences::getsMaterialCacheSize() const {
+    return value(u"Preferences/Materials/CacheSize"_s, 512);
+}
+
+void Preferences::setMaterialCacheSize(const int size) {
+    setValue(u"Preferences/Materials/CacheSize"_s, size);
+}
@@ -21,6 +21,16 @@ public:
     // General options
     [[nodiscard]] std::filesystem::path getsUnitSystemPath() const;
 
+    // Materials
+    [[nodiscard]] bool getsSinglePrecisionNk() const;
+    void setSinglePrecisionNk(bool enabled);
+    // Monotone cubic rather than linear interpolation of n, k in wavelength
+    [[nodiscard]] bool getsPchipNk() const;
+    void setPchipNk(bool enabled);
+    // Memory budget for reloadable n, k data in MiB, see MaterialCache
+    [[nodiscard]] int getsMaterialCacheSize() const;
+    void setMaterialCacheSize(int size);
+
 private:
     static Preferences *m_instance;
 };
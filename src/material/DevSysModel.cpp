@@ -49,7 +49,8 @@ void DevSysModel::removeDevice(const int &row) {
         return;
     }
     beginRemoveRows(QModelIndex(), row, row);
-    m_list.erase(m_list.cbegin() + row);
+    // Also releases the pins of the device's materials in MaterialCache
+    m_list.takeAt(row)->deleteLater();
     endRemoveRows();
     // emit dataChanged(index(0), index(static_cast<int>(m_list.size() - 1)));
 }
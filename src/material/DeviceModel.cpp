@@ -4,15 +4,24 @@
 
 #include <numeric>
 #include <ranges>
+#include <sstream>
 #include <QDir>
+#include <QFile>
+#include <QXYSeries>
 #include <QtGui/QGuiApplication>
 
 #include "DbSysModel.h"
 #include "DeviceModel.h"
+#include "MaterialCache.h"
+#include "optics/AdaptiveGrid.h"
 #include "optics/TransferMatrix.h"
 
 DeviceModel::DeviceModel(QObject *parent) : QAbstractTableModel(parent) {}
 
+DeviceModel::~DeviceModel() {
+    pinMaterials({});
+}
+
 int DeviceModel::rowCount(const QModelIndex &parent) const {
     Q_UNUSED(parent)
     return ParameterClass<QList, double, QString>::size;
@@ -78,6 +87,39 @@ QList<double> DeviceModel::readT() const {
     return T;
 }
 
+qsizetype DeviceModel::readNumLayers() const {
+    // The first and last rows of A_per_layer are R and T.
+    return A_per_layer.shape(0) > 2 ? static_cast<qsizetype>(A_per_layer.shape(0)) - 2 : 0;
+}
+
+QList<double> DeviceModel::readJsc() const {
+    return Jsc;
+}
+
+void DeviceModel::fillLayerSeries(QAbstractSeries *series, const qsizetype layer) const {
+    if (A_per_layer.size() == 0) {
+        qWarning() << "fillLayerSeries called before calcRAT";
+        return;
+    }
+    auto *xy_series = qobject_cast<QXYSeries *>(series);
+    if (not xy_series or layer < 0 or layer >= readNumLayers()) {
+        qWarning() << "Invalid series or layer" << layer << "in fillLayerSeries";
+        return;
+    }
+    if (static_cast<std::size_t>(wavelengths.size()) not_eq A_per_layer.shape(1)) {
+        qWarning() << "Wavelengths mismatch the absorption spectra in fillLayerSeries";
+        return;
+    }
+    // Layer i is row i + 1 of the tensor, after R, and a contiguous row.
+    const std::valarray<double> A_layer = A_per_layer[layer + 1].flat();
+    QList<QPointF> points;
+    points.reserve(wavelengths.size());
+    for (qsizetype j = 0; j < wavelengths.size(); j++) {
+        points.emplace_back(wavelengths.at(j) * 1e9, A_layer[j]);
+    }
+    xy_series->replace(points);
+}
+
 qsizetype DeviceModel::readColSize() const {
     return par->col_size();
 }
@@ -158,50 +200,40 @@ Q_INVOKABLE void DeviceModel::calcRAT() {
         qWarning("QML singleton instance DbSysModel does not exist.");
         return;
     }
+    // The structure always runs from the front to the back electrode, and both sides are solved in one pass, so
+    // right-side illumination no longer needs a reversed structure.
+    if (opt_material.front().isEmpty()) {  // Default front surface
+        opt_material.front() = par->side ? "Ag" : "ITO";
+    }
+    if (opt_material.back().isEmpty()) {  // Default back surface
+        opt_material.back() = par->side ? "ITO2" : "Ag";  // ITO2 is Sopra's ITO
+    }
+    if (std::isnan(opt_d.front())) {  // Default front surface thickness
+        opt_d.front() = 5e-8;
+    }
+    if (std::isnan(opt_d.back())) {  // Default back surface thickness
+        opt_d.back() = 5e-8;
+    }
     std::vector<std::pair<OpticMaterial<QList<double>> *, double>> structure;
-    if (par->side) {  // right; need to reverse
-        if (opt_material.back().isEmpty()) {
-            opt_material.back() = "ITO2"; // Sopra's ITO
-        }
-        if (opt_material.front().isEmpty()) {
-            opt_material.front() = "Ag";
-        }
-        if (std::isnan(opt_d.back())) {
-            opt_d.back() = 5e-8;
-        }
-        structure.emplace_back(db_system->getMatByName(opt_material.back()), opt_d.back());
-        for (qsizetype i = par->layer_type.size() - 1; i >= 0; i--) {  // does not include the substrate
-            if (par->layer_type.at(i) not_eq "interface") {
-                structure.emplace_back(db_system->getMatByName(opt_material.at(i + 1)), opt_d.at(i + 1));  // skip electrodes
-                if (i not_eq par->layer_type.size() - 1 and par->layer_type.at(i + 1) == "interface" and par->layer_type.at(i) == "layer") {
-                    structure.back().second += opt_d.at(i + 2);
-                }
-            } else if (i not_eq 0 and par->layer_type.at(i + 1) == "layer") {  // is interface
-                structure.back().second += opt_d.at(i + 1);
+    structure.emplace_back(db_system->getMatByName(opt_material.front()), opt_d.front());
+    for (qsizetype i = 0; i < par->layer_type.size(); i++) {  // maxRow - 3
+        if (par->layer_type.at(i) not_eq "interface") {
+            structure.emplace_back(db_system->getMatByName(opt_material.at(i + 1)), opt_d.at(i + 1));
+            if (i not_eq 0 and par->layer_type.at(i - 1) == "interface" and par->layer_type.at(i) == "layer") {
+                structure.back().second += opt_d.at(i);
             }
+        } else if (i not_eq 0 and par->layer_type.at(i - 1) == "layer") {  // is interface
+            structure.back().second += opt_d.at(i + 1);
         }
-    } else {
-        if (opt_material.front().isEmpty()) {  // Default front surface
-            opt_material.front() = "ITO";
-        }
-        if (opt_material.back().isEmpty()) {  // Default back surface
-            opt_material.back() = "Ag";
-        }
-        if (std::isnan(opt_d.front())) {  // Default front surface thickness
-            opt_d.front() = 5e-8;
-        }  // opt_d.back() should be NaN; other values are meaningless
-        structure.emplace_back(db_system->getMatByName(opt_material.front()), opt_d.front());
-        for (qsizetype i = 0; i < par->layer_type.size(); i++) {  // maxRow - 3
-            if (par->layer_type.at(i) not_eq "interface") {
-                structure.emplace_back(db_system->getMatByName(opt_material.at(i + 1)), opt_d.at(i + 1));
-                if (i not_eq 0 and par->layer_type.at(i - 1) == "interface" and par->layer_type.at(i) == "layer") {
-                    structure.back().second += opt_d.at(i);
-                }
-            } else if (i not_eq 0 and par->layer_type.at(i - 1) == "layer") {  // is interface
-                structure.back().second += opt_d.at(i + 1);
-            }
+    }
+    structure.emplace_back(db_system->getMatByName(opt_material.back()), opt_d.back());
+    QList<OpticMaterial<QList<double>> *> materials;
+    for (OpticMaterial<QList<double>> *material : structure | std::views::keys) {
+        if (material and not materials.contains(material)) {
+            materials.append(material);
         }
     }
+    pinMaterials(materials);
     // For convenience, the wavelengths are expected to be sorted already, but still minmax here.
     // Since Ubuntu 24 has gcc libstdc++ 14, we are able to use std::ranges::to here for supported compilers.
     // https://en.cppreference.com/w/cpp/compiler_support
@@ -224,20 +256,88 @@ Q_INVOKABLE void DeviceModel::calcRAT() {
     const auto [min_minmax_wl, max_min_max_wl] = std::ranges::minmax_element(minmax_wls);
     const double min_wl = min_minmax_wl->first;
     const double max_wl = max_min_max_wl->second;
-    std::vector<double> wls_vec = Utils::Math::linspace(min_wl, max_wl, static_cast<std::size_t>((max_wl - min_wl) / 1e-9 + 1));
-    wavelengths = {wls_vec.cbegin(), wls_vec.cend()};
     try {
-        auto stack = par->side ? std::make_unique<OpticStack<QList<double>>>(std::move(structure), false, db_system->getMatByName(opt_material.back())) :
-                std::make_unique<OpticStack<QList<double>>>(std::move(structure), false, db_system->getMatByName(opt_material.front()));
-        // calculate_rat<QList<double>&>
-        const rat_dict<double> rat_out = calculate_rat(std::move(stack), wavelengths, 0, 's');
-        const std::valarray<double> R_va = std::get<std::valarray<double>>(rat_out.at("R"));
+        // Start at 10 nm and refine where the spectra bend, up to the 1 nm grid this used to evaluate in full.
+        const auto evaluate = [&structure](const std::valarray<double> &lam_vac) -> rat_dict<double> {
+            QList<double> wls(std::begin(lam_vac), std::end(lam_vac));
+            auto structure_copy = structure;
+            auto stack = std::make_unique<OpticStack<QList<double>>>(std::move(structure_copy));
+            // calculate_rat<QList<double>&>
+            return calculate_rat(std::move(stack), wls, 0, 's', true, {}, true);
+        };
+        const auto num_points = [min_wl, max_wl](const double step) -> std::size_t {
+            return std::max<std::size_t>(3, static_cast<std::size_t>((max_wl - min_wl) / step + 1));
+        };
+        const rat_dict<double> rat_out = adaptive_wavelength_grid<double>(evaluate, min_wl, max_wl, num_points(1e-8),
+                                                                          1e-3, num_points(1e-9));
+        const std::valarray<double> lam_va = std::get<std::valarray<double>>(rat_out.at("lam_vac"));
+        wavelengths = {std::begin(lam_va), std::end(lam_va)};
+        const std::string suffix = par->side ? "_rev" : "";
+        const std::valarray<double> R_va = std::get<std::valarray<double>>(rat_out.at("R" + suffix));
         R = {std::begin(R_va), std::end(R_va)};
-        const std::valarray<double> A_va = std::get<std::valarray<double>>(rat_out.at("A"));
+        const std::valarray<double> A_va = std::get<std::valarray<double>>(rat_out.at("A" + suffix));
         A = {std::begin(A_va), std::end(A_va)};
-        const std::valarray<double> T_va = std::get<std::valarray<double>>(rat_out.at("T"));
+        const std::valarray<double> T_va = std::get<std::valarray<double>>(rat_out.at("T" + suffix));
         T = {std::begin(T_va), std::end(T_va)};
+        A_per_layer = std::get<Utils::Tensor<double, 2>>(rat_out.at("A_per_layer" + suffix));
     } catch (std::runtime_error &e) {
         qWarning() << "Runtime error in calcRAT " << e.what();
+        return;
+    }
+    calcJsc();
+}
+
+/*
+ * Jsc,max of each inner layer under light source 1 from the absorption of the last calcRAT(). The reference spectra
+ * are read once from the ASTM G173 table bundled as the resource :/data/spectra/ASTMG173.csv, or else from
+ * data/spectra next to the application; without either, only "laser" and "blackbody" are available. A zero int1
+ * (dark) gives the current at 1 sun.
+ */
+void DeviceModel::calcJsc() {
+    Jsc.clear();
+    const std::string source_name = par->light_source1.toStdString();
+    if (not spectra.contains(source_name)) {
+        const QString g173 = QDir(QCoreApplication::applicationDirPath()).filePath("data/spectra/ASTMG173.csv");
+        try {
+            if (QFile resource(":/data/spectra/ASTMG173.csv"); resource.open(QIODevice::ReadOnly)) {
+                std::istringstream stream(resource.readAll().toStdString());
+                spectra.load_astm_g173(stream, resource.fileName().toStdString());
+            } else {
+                spectra.load_astm_g173(g173.toStdString());
+            }
+        } catch (std::runtime_error &e) {
+            qWarning() << "No ASTM G173 reference spectra (AM0, AM15, AM15D) bundled or found at" << g173 << ":"
+                       << e.what() << "- Jsc is only available for the laser and blackbody sources.";
+            return;
+        }
+    }
+    LightSource<double> source;
+    source.name = source_name;
+    source.intensity = par->int1 > 0 ? par->int1 : 1;
+    source.wavelength = par->laser_lambda1 * 1e-9;
+    source.power = par->pulsepow * 10;  // mW cm-2 -> W m-2
+    std::valarray<double> lam_vac(wavelengths.size());
+    std::ranges::copy(wavelengths, std::begin(lam_vac));
+    try {
+        // Trapezoid weights, since Simpson weights can turn negative on the non-uniform adaptive grid
+        const std::valarray<double> current = photocurrent(A_per_layer, spectra.weights(source, lam_vac));
+        Jsc = {std::begin(current), std::end(current)};
+    } catch (std::out_of_range &e) {
+        qWarning() << "Unknown light source in calcJsc" << e.what();
+    }
+}
+
+/*
+ * Pins the new materials before unpinning the old ones, so that materials kept by the device are never evictable in
+ * between.
+ */
+void DeviceModel::pinMaterials(const QList<OpticMaterial<QList<double>> *> &materials) {
+    MaterialCache<QList<double>> &cache = MaterialCache<QList<double>>::instance();
+    for (OpticMaterial<QList<double>> *material : materials) {
+        cache.pin(material);
+    }
+    for (OpticMaterial<QList<double>> *material : std::as_const(pinned)) {
+        cache.unpin(material);
     }
+    pinned = materials;
 }
@@ -6,9 +6,13 @@
 #define SUISAPP_DEVICEMODEL_H
 
 #include <QAbstractTableModel>
+#include <QAbstractSeries>
 #include <QQmlEngine>
 
+#include "OpticMaterial.h"
 #include "core/ParameterClass.h"
+#include "optics/Spectrum.h"
+#include "utils/Tensor.h"
 
 class DeviceModel : public QAbstractTableModel {
     Q_OBJECT
@@ -19,6 +23,8 @@ class DeviceModel : public QAbstractTableModel {
     Q_PROPERTY(QList<double> R READ readR CONSTANT)
     Q_PROPERTY(QList<double> A READ readA CONSTANT)
     Q_PROPERTY(QList<double> T READ readT CONSTANT)
+    Q_PROPERTY(qsizetype num_layers READ readNumLayers CONSTANT)
+    Q_PROPERTY(QList<double> Jsc READ readJsc CONSTANT)
     // QQmlExpression: Expression qrc:/qt/qml/content/BandDiagramDialog.qml: depends on non-NOTIFYable properties
     Q_PROPERTY(qsizetype col_size READ readColSize CONSTANT);
     Q_PROPERTY(QList<double> d READ readD CONSTANT)
@@ -27,6 +33,7 @@ class DeviceModel : public QAbstractTableModel {
 
 public:
     explicit DeviceModel(QObject *parent = nullptr);
+    ~DeviceModel() override;
 
     // Refer to qtdeclarative/src/labs/models/ qqmltablemodel_p.h and qqmltablemodel.cpp
     // qtdeclarative/src/quick/items/ qquicktableview_p.h and qquicktableview.cpp
@@ -43,6 +50,8 @@ public:
     [[nodiscard]] QList<double> readR() const;
     [[nodiscard]] QList<double> readA() const;
     [[nodiscard]] QList<double> readT() const;
+    [[nodiscard]] qsizetype readNumLayers() const;
+    [[nodiscard]] QList<double> readJsc() const;
     [[nodiscard]] qsizetype readColSize() const;
     [[nodiscard]] QList<double> readD() const;
     [[nodiscard]] QList<double> readCBM() const;
@@ -55,6 +64,9 @@ public:
 
     Q_INVOKABLE bool readDfDev(const QString &db_path);
     Q_INVOKABLE void calcRAT();
+    // Replaces the points of an XYSeries with the absorption spectrum of one layer in a single call, instead of
+    // appending point by point from QML.
+    Q_INVOKABLE void fillLayerSeries(QAbstractSeries *series, qsizetype layer) const;
 
 private:
     std::unique_ptr<ParameterClass<QList, double, QString>> par;  // by column
@@ -67,6 +79,14 @@ private:
     QList<double> R;
     QList<double> A;
     QList<double> T;
+    Utils::Tensor<double, 2> A_per_layer;  // (layer, wavelength)
+    QList<double> Jsc;  // Jsc,max [A m-2] of each layer of A_per_layer under light_source1
+    SpectrumLibrary<double> spectra;
+    // Materials of the last calcRAT(), pinned in MaterialCache while the device is open
+    QList<OpticMaterial<QList<double>> *> pinned;
+
+    void calcJsc();
+    void pinMaterials(const QList<OpticMaterial<QList<double>> *> &materials);
 };
 
 #endif  // SUISAPP_DEVICEMODEL_H
@@ -0,0 +1,227 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include "DielectricModel.h"
+
+// h * c / e in eV * m
+template<std::floating_point T>
+constexpr T HC_EV_M = 1.23984198e-6;
+
+/*
+ * Principal-value Kramers-Kronig transform
+ * eps1(E) - eps_inf = 2 / pi * P int_0^E_max xi * eps2(xi) / (xi^2 - E^2) dxi.
+ * The pole is removed by subtracting E * eps2(E) from the numerator, whose principal value integral has a closed
+ * form; the smooth remainder is integrated by the midpoint rule on num_nodes nodes, evaluated once for all energies.
+ */
+template<std::floating_point T, typename F>
+auto kramers_kronig(const F &eps2, const std::valarray<T> &energy, const T E_max,
+                    const std::size_t num_nodes) -> std::valarray<T> {
+    const T h = E_max / static_cast<T>(num_nodes);
+    std::valarray<T> xi(num_nodes);
+    for (std::size_t k = 0; k < num_nodes; k++) {
+        xi[k] = (static_cast<T>(k) + T(0.5)) * h;
+    }
+    const std::valarray<T> xi_eps2 = xi * eps2(xi);
+    const std::valarray<T> xi_sq = xi * xi;
+    const std::valarray<T> E_eps2 = energy * eps2(energy);
+    std::valarray<T> eps1(energy.size());
+    for (std::size_t j = 0; j < energy.size(); j++) {
+        const T E = energy[j];
+        if (E >= E_max) {
+            throw std::invalid_argument("Photon energy exceeds the Kramers-Kronig integration range.");
+        }
+        T sum = 0;
+        for (std::size_t k = 0; k < num_nodes; k++) {
+            // The remainder is bounded at the pole, so dropping a node that hits it exactly costs O(h).
+            if (const T denom = xi_sq[k] - E * E; denom not_eq 0) {
+                sum += (xi_eps2[k] - E_eps2[j]) / denom;
+            }
+        }
+        sum *= h;
+        if (E > 0) {
+            sum += E_eps2[j] / (2 * E) * std::log((E_max - E) / (E_max + E));
+        }
+        eps1[j] = 2 / std::numbers::pi_v<T> * sum;
+    }
+    return eps1;
+}
+
+template<std::floating_point T>
+auto DielectricModel<T>::energy_from_wl(const std::valarray<T> &wavelength) -> std::valarray<T> {
+    return HC_EV_M<T> / wavelength;
+}
+
+template<std::floating_point T>
+auto DielectricModel<T>::nk(const std::valarray<T> &wavelength) const -> std::valarray<std::complex<T>> {
+    // The principal square root gives k >= 0 for eps2 >= 0.
+    return std::sqrt(epsilon(energy_from_wl(wavelength)));
+}
+
+template<std::floating_point T>
+auto Cauchy<T>::nk(const std::valarray<T> &wavelength) const -> std::valarray<std::complex<T>> {
+    const std::valarray<T> wl_um_sq = wavelength * wavelength * T(1e12);
+    const std::valarray<T> n = A + B / wl_um_sq + C / (wl_um_sq * wl_um_sq);
+    std::valarray<std::complex<T>> nk_data(wavelength.size());
+    if (k_amp == 0) {
+        std::ranges::transform(n, std::begin(nk_data), [](const T n_v) -> std::complex<T> {
+            return n_v;
+        });
+    } else {
+        const std::valarray<T> k = k_amp * std::exp(k_exp * (DielectricModel<T>::energy_from_wl(wavelength) - E_b));
+        std::ranges::transform(n, k, std::begin(nk_data), [](const T n_v, const T k_v) -> std::complex<T> {
+            return {n_v, k_v};
+        });
+    }
+    return nk_data;
+}
+
+template<std::floating_point T>
+auto Cauchy<T>::epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> {
+    const std::valarray<std::complex<T>> nk_data = nk(HC_EV_M<T> / energy);
+    return nk_data * nk_data;
+}
+
+template<std::floating_point T>
+Sellmeier<T>::Sellmeier(const T A, std::vector<T> B, std::vector<T> C) : A(A), B(std::move(B)), C(std::move(C)) {
+    if (this->B.size() not_eq this->C.size()) {
+        throw std::invalid_argument("Sellmeier B and C coefficients must have the same length.");
+    }
+}
+
+template<std::floating_point T>
+auto Sellmeier<T>::nk(const std::valarray<T> &wavelength) const -> std::valarray<std::complex<T>> {
+    const std::valarray<T> wl_um_sq = wavelength * wavelength * T(1e12);
+    std::valarray<T> n_sq(A, wavelength.size());
+    for (std::size_t i = 0; i < B.size(); i++) {
+        n_sq += B.at(i) * wl_um_sq / (wl_um_sq - C.at(i));
+    }
+    std::valarray<std::complex<T>> nk_data(wavelength.size());
+    // Below a resonance n^2 < 0, which the complex square root turns into k.
+    std::ranges::transform(n_sq, std::begin(nk_data), [](const T n_sq_v) -> std::complex<T> {
+        return std::sqrt(std::complex<T>(n_sq_v));
+    });
+    return nk_data;
+}
+
+template<std::floating_point T>
+auto Sellmeier<T>::epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> {
+    const std::valarray<std::complex<T>> nk_data = nk(HC_EV_M<T> / energy);
+    return nk_data * nk_data;
+}
+
+template<std::floating_point T>
+TaucLorentz<T>::TaucLorentz(const T A, const T E0, const T C, const T Eg, const T eps_inf) : A(A), E0(E0), C(C),
+                                                                                            Eg(Eg),
+                                                                                            eps_inf(eps_inf) {
+    if (C <= 0 or 2 * E0 <= C) {
+        throw std::invalid_argument("Tauc-Lorentz requires 0 < C < 2 * E0.");
+    }
+    if (Eg < 0) {
+        throw std::invalid_argument("Tauc-Lorentz requires Eg >= 0.");
+    }
+}
+
+template<std::floating_point T>
+auto TaucLorentz<T>::epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> {
+    constexpr T pi = std::numbers::pi_v<T>;
+    const T alpha = std::sqrt(4 * E0 * E0 - C * C);
+    const T gamma_sq = E0 * E0 - C * C / 2;
+    const T E0_sq = E0 * E0;
+    const T Eg_sq = Eg * Eg;
+    // Energy-independent parts of the closed form
+    const T ln_alpha = std::log((E0_sq + Eg_sq + alpha * Eg) / (E0_sq + Eg_sq - alpha * Eg));
+    const T atan_sum = std::atan((alpha + 2 * Eg) / C) + std::atan((alpha - 2 * Eg) / C);
+    const T atan_diff = pi - std::atan((2 * Eg + alpha) / C) + std::atan((alpha - 2 * Eg) / C);
+    const T ln_norm = std::sqrt((E0_sq - Eg_sq) * (E0_sq - Eg_sq) + Eg_sq * C * C);
+    std::valarray<std::complex<T>> eps(energy.size());
+    std::ranges::transform(energy, std::begin(eps), [&](const T E) -> std::complex<T> {
+        const T E_sq = E * E;
+        const T zeta4 = (E_sq - gamma_sq) * (E_sq - gamma_sq) + alpha * alpha * C * C / 4;
+        const T a_ln = (Eg_sq - E0_sq) * E_sq + Eg_sq * C * C - E0_sq * (E0_sq + 3 * Eg_sq);
+        const T a_atan = (E_sq - E0_sq) * (E0_sq + Eg_sq) + Eg_sq * C * C;
+        T eps1 = eps_inf
+                 + A * C * a_ln / (2 * pi * zeta4 * alpha * E0) * ln_alpha
+                 - A * a_atan / (pi * zeta4 * E0) * atan_diff
+                 + 4 * A * E0 * Eg * (E_sq - gamma_sq) / (pi * zeta4 * alpha) * atan_sum;
+        // The logarithms of |E - Eg| cancel at E = Eg, leaving only those of E + Eg.
+        if (E not_eq Eg) {
+            const T abs_diff = std::abs(E - Eg);
+            if (E > 0) {
+                eps1 -= A * E0 * C * (E_sq + Eg_sq) / (pi * zeta4 * E) * std::log(abs_diff / (E + Eg));
+            } else {
+                // (E^2 + Eg^2) / E * ln(|E - Eg| / (E + Eg)) tends to -2 Eg as E tends to 0.
+                eps1 += 2 * A * E0 * C * Eg / (pi * zeta4);
+            }
+            eps1 += 2 * A * E0 * C * Eg / (pi * zeta4) * std::log(abs_diff * (E + Eg) / ln_norm);
+        } else if (Eg > 0) {
+            eps1 += 2 * A * E0 * C * Eg / (pi * zeta4) * (std::log(2 * Eg) + std::log(2 * Eg / ln_norm));
+        }
+        const T eps2 = E > Eg ? A * E0 * C * (E - Eg) * (E - Eg) / ((E_sq - E0_sq) * (E_sq - E0_sq) + C * C * E_sq) / E : 0;
+        return {eps1, eps2};
+    });
+    return eps;
+}
+
+template<std::floating_point T>
+CodyLorentz<T>::CodyLorentz(const T A, const T E0, const T Gamma, const T Eg, const T Ep, const T Et, const T Eu,
+                            const T eps_inf) : A(A), E0(E0), Gamma(Gamma), Eg(Eg), Ep(Ep), Et(Et), Eu(Eu),
+                                               eps_inf(eps_inf) {
+    if (Gamma <= 0 or E0 <= 0) {
+        throw std::invalid_argument("Cody-Lorentz requires E0 > 0 and Gamma > 0.");
+    }
+    if (Et < Eg or Eu <= 0) {
+        throw std::invalid_argument("Cody-Lorentz requires Et >= Eg and Eu > 0.");
+    }
+}
+
+template<std::floating_point T>
+auto CodyLorentz<T>::epsilon2(const std::valarray<T> &energy) const -> std::valarray<T> {
+    const auto G = [this](const T E) -> T {
+        return (E - Eg) * (E - Eg) / ((E - Eg) * (E - Eg) + Ep * Ep);
+    };
+    const auto L = [this](const T E) -> T {
+        return A * E0 * Gamma * E / ((E * E - E0 * E0) * (E * E - E0 * E0) + Gamma * Gamma * E * E);
+    };
+    const T E1 = Et * G(Et) * L(Et);
+    std::valarray<T> eps2(energy.size());
+    std::ranges::transform(energy, std::begin(eps2), [&](const T E) -> T {
+        if (E > Et) {
+            return G(E) * L(E);
+        }
+        return E > 0 ? E1 / E * std::exp((E - Et) / Eu) : 0;
+    });
+    return eps2;
+}
+
+template<std::floating_point T>
+auto CodyLorentz<T>::epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> {
+    // eps2 decays as E^-3 beyond the oscillator, so the truncation error of the transform decays as E_max^-3.
+    const T E_max = std::max(40 * (E0 + Gamma), 2 * energy.max());
+    const std::valarray<T> eps1 = eps_inf + kramers_kronig([this](const std::valarray<T> &E) -> std::valarray<T> {
+        return epsilon2(E);
+    }, energy, E_max, 40000);
+    const std::valarray<T> eps2 = epsilon2(energy);
+    std::valarray<std::complex<T>> eps(energy.size());
+    std::ranges::transform(eps1, eps2, std::begin(eps), [](const T eps1_v, const T eps2_v) -> std::complex<T> {
+        return {eps1_v, eps2_v};
+    });
+    return eps;
+}
+
+template<std::floating_point T>
+auto Mixing<T>::weight(const std::valarray<T> &wavelength) const -> std::valarray<T> {
+    const std::valarray<T> sigmoid = T(1) / (T(1) + std::exp(-(wavelength - point) / width));
+    return decreasing ? std::valarray<T>(T(1) - sigmoid) : sigmoid;
+}
+
+template class DielectricModel<double>;
+template class Cauchy<double>;
+template class Sellmeier<double>;
+template class TaucLorentz<double>;
+template class CodyLorentz<double>;
+template struct Mixing<double>;
@@ -0,0 +1,117 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_DIELECTRIC_MODEL_H
+#define SUISAPP_DIELECTRIC_MODEL_H
+
+#include <complex>
+#include <concepts>
+#include <valarray>
+#include <vector>
+
+/*
+ * Analytic dispersion model of a material. Models are evaluated directly on any wavelength grid, without file I/O
+ * or interpolation. Photon energies are in eV and wavelengths in m, as everywhere else in the optics code.
+ */
+template<std::floating_point T>
+class DielectricModel {
+public:
+    virtual ~DielectricModel() = default;
+
+    /*
+     * Complex dielectric function eps1 + 1j * eps2 at the photon energies given in eV.
+     */
+    virtual auto epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> = 0;
+    /*
+     * Complex refractive index n + 1j * k at the wavelengths given in m.
+     */
+    virtual auto nk(const std::valarray<T> &wavelength) const -> std::valarray<std::complex<T>>;
+
+    static auto energy_from_wl(const std::valarray<T> &wavelength) -> std::valarray<T>;
+};
+
+/*
+ * n = A + B / wl^2 + C / wl^4, with wl in um,
+ * and an optional Urbach absorption tail k = k_amp * exp(k_exp * (E - E_b)), with E in eV.
+ */
+template<std::floating_point T>
+class Cauchy : public DielectricModel<T> {
+public:
+    explicit Cauchy(const T A, const T B = 0, const T C = 0, const T k_amp = 0, const T k_exp = 0,
+                    const T E_b = 0) : A(A), B(B), C(C), k_amp(k_amp), k_exp(k_exp), E_b(E_b) {}
+
+    auto epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> override;
+    auto nk(const std::valarray<T> &wavelength) const -> std::valarray<std::complex<T>> override;
+private:
+    T A, B, C, k_amp, k_exp, E_b;
+};
+
+/*
+ * n^2 = A + sum_i B_i * wl^2 / (wl^2 - C_i), with wl in um and C_i in um^2. The material is transparent.
+ */
+template<std::floating_point T>
+class Sellmeier : public DielectricModel<T> {
+public:
+    Sellmeier(const T A, std::vector<T> B, std::vector<T> C);
+
+    auto epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> override;
+    auto nk(const std::valarray<T> &wavelength) const -> std::valarray<std::complex<T>> override;
+private:
+    T A;
+    std::vector<T> B, C;
+};
+
+/*
+ * Tauc-Lorentz oscillator (Jellison and Modine, Appl. Phys. Lett. 69, 371 (1996)).
+ * eps2 = A * E0 * C * (E - Eg)^2 / ((E^2 - E0^2)^2 + C^2 * E^2) / E for E > Eg, and 0 otherwise.
+ * eps1 is the closed-form Kramers-Kronig transform of eps2 plus eps_inf.
+ */
+template<std::floating_point T>
+class TaucLorentz : public DielectricModel<T> {
+public:
+    TaucLorentz(T A, T E0, T C, T Eg, T eps_inf = 1);
+
+    auto epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> override;
+private:
+    T A, E0, C, Eg, eps_inf;
+};
+
+/*
+ * Cody-Lorentz oscillator (Ferlauto et al., J. Appl. Phys. 92, 2424 (2002)).
+ * eps2 = G(E) * L(E) for E > Et, with the Cody variable band edge G(E) = (E - Eg)^2 / ((E - Eg)^2 + Ep^2) and the
+ * Lorentz oscillator L(E) = A * E0 * Gamma * E / ((E^2 - E0^2)^2 + Gamma^2 * E^2),
+ * and the Urbach tail eps2 = Et * G(Et) * L(Et) / E * exp((E - Et) / Eu) for 0 < E <= Et, where Et >= Eg
+ * (Et = Eg switches the tail off).
+ * eps1 has no closed form and is obtained by a numerical Kramers-Kronig transform plus eps_inf.
+ */
+template<std::floating_point T>
+class CodyLorentz : public DielectricModel<T> {
+public:
+    CodyLorentz(T A, T E0, T Gamma, T Eg, T Ep, T Et, T Eu, T eps_inf = 1);
+
+    auto epsilon(const std::valarray<T> &energy) const -> std::valarray<std::complex<T>> override;
+    auto epsilon2(const std::valarray<T> &energy) const -> std::valarray<T>;
+private:
+    T A, E0, Gamma, Eg, Ep, Et, Eu, eps_inf;
+};
+
+/*
+ * Mixing of experimental n, k data with a DielectricModel within the same layer in distinct spectral regions,
+ * i.e., the [mixing point, mixing width, zero or one] list of OpticStack's documentation, here in m.
+ * If increasing (decreasing = false), the model is used at long wavelengths and the experimental data at short
+ * wavelengths; if decreasing, the opposite. The point and the width control how smooth the sigmoid transition is.
+ */
+template<std::floating_point T>
+struct Mixing {
+    T point;
+    T width;
+    bool decreasing = false;
+
+    /*
+     * Weight of the model at each wavelength; the experimental data get 1 - weight.
+     */
+    auto weight(const std::valarray<T> &wavelength) const -> std::valarray<T>;
+};
+
+#endif  // SUISAPP_DIELECTRIC_MODEL_H
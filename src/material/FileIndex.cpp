@@ -0,0 +1,148 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <utility>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "FileIndex.h"
+#include "Profile.h"
+
+namespace {
+    // Bump when the layout of the cache file changes
+    constexpr quint32 cache_version = 2;
+
+    qint64 modificationTime(const QFileInfo &info) {
+        return info.lastModified().toMSecsSinceEpoch();
+    }
+
+    /*
+     * QDirIterator's order depends on the file system, so duplicate file names are resolved deterministically: the
+     * shorter path (i.e. the shallower one, as all paths share the root) wins, then the lexicographically smaller one.
+     */
+    bool isPreferred(const QString &path, const QString &other) {
+        return path.size() < other.size() or (path.size() == other.size() and path < other);
+    }
+}
+
+FileIndex::FileIndex(QString root, QStringList name_filters) : root(std::move(root)),
+                                                               name_filters(std::move(name_filters)) {}
+
+std::shared_ptr<const FileIndex> FileIndex::load(const QString &root, const QStringList &name_filters) {
+    // std::make_shared cannot access the private constructor
+    std::shared_ptr<FileIndex> index(new FileIndex(QDir(root).absolutePath(), name_filters));
+    if (not index->readCache() or not index->isUpToDate()) {
+        index->build();
+        index->writeCache();
+    }
+    return index;
+}
+
+std::optional<QString> FileIndex::find(const QString &file_name) const {
+    if (const auto it = paths.constFind(file_name); it not_eq paths.cend()) {
+        return it.value();
+    }
+    return std::nullopt;
+}
+
+qsizetype FileIndex::size() const {
+    return paths.size();
+}
+
+void FileIndex::build() {
+    paths.clear();
+    dir_mtimes.clear();
+    const QFileInfo root_info(root);
+    if (not root_info.isDir()) {
+        return;
+    }
+    dir_mtimes.insert(root, modificationTime(root_info));
+    // One walk over files and directories; QDirIterator::fileInfo() reuses the stat() of the listing.
+    QDirIterator dit(root, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (dit.hasNext()) {
+        dit.next();
+        const QFileInfo info = dit.fileInfo();
+        if (info.isDir()) {
+            dir_mtimes.insert(info.absoluteFilePath(), modificationTime(info));
+        } else if (QDir::match(name_filters, info.fileName())) {
+            const QString path = info.absoluteFilePath();
+            if (const auto it = paths.constFind(info.fileName()); it == paths.cend() or isPreferred(path, it.value())) {
+                paths.insert(info.fileName(), path);
+            }
+        }
+    }
+}
+
+bool FileIndex::isUpToDate() const {
+    if (dir_mtimes.isEmpty()) {
+        return false;
+    }
+    for (auto it = dir_mtimes.cbegin(); it not_eq dir_mtimes.cend(); ++it) {
+        if (const QFileInfo info(it.key()); not info.isDir() or modificationTime(info) not_eq it.value()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString FileIndex::cacheFile() const {
+    if (not Profile::instance()) {
+        return {};
+    }
+    const QByteArray key = QCryptographicHash::hash((root + '\n' + name_filters.join('\n')).toUtf8(),
+                                                    QCryptographicHash::Sha1).toHex();
+    const QDir cache_dir(specialFolderLocation(SpecialFolder::Cache) / "file-index");
+    return cache_dir.filePath(QString::fromLatin1(key) + ".idx");
+}
+
+bool FileIndex::readCache() {
+    const QString cache_file = cacheFile();
+    if (cache_file.isEmpty()) {
+        return false;
+    }
+    QFile file(cache_file);
+    if (not file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    quint32 version = 0;
+    QString cached_root;
+    QStringList cached_filters;
+    stream >> version;
+    if (version not_eq cache_version) {
+        return false;
+    }
+    stream >> cached_root >> cached_filters >> paths >> dir_mtimes;
+    // The key is a hash of root and filters; make sure it is not a collision.
+    return stream.status() == QDataStream::Ok and cached_root == root and cached_filters == name_filters;
+}
+
+void FileIndex::writeCache() const {
+    const QString cache_file = cacheFile();
+    if (cache_file.isEmpty() or dir_mtimes.isEmpty()) {
+        return;
+    }
+    if (not QDir().mkpath(QFileInfo(cache_file).absolutePath())) {
+        qWarning() << "Cannot create the cache folder of" << cache_file;
+        return;
+    }
+    // QSaveFile replaces the old index atomically, so a concurrent reader never sees a truncated one.
+    QSaveFile file(cache_file);
+    if (not file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write file index" << cache_file;
+        return;
+    }
+    QDataStream stream(&file);
+    stream << cache_version << root << name_filters << paths << dir_mtimes;
+    if (stream.status() not_eq QDataStream::Ok or not file.commit()) {
+        qWarning() << "Cannot write file index" << cache_file;
+    }
+}
@@ -0,0 +1,49 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_FILEINDEX_H
+#define SUISAPP_FILEINDEX_H
+
+#include <memory>
+#include <optional>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/*
+ * File name -> path index of a database directory tree, so that resolving a material file, e.g. mat_name + ".MAT",
+ * is a hash lookup instead of a recursive directory walk per material.
+
+ * The index is persisted in the profile cache folder. A persisted index is reused as long as none of the directories
+ * of the tree has been modified (added or removed entries change the modification time of their directory), which
+ * costs one stat() per directory rather than a listing of every file.
+ */
+class FileIndex {
+public:
+    /*
+     * Loads the persisted index of root for the file name filters (e.g. {"*.MAT"}), or walks the tree and persists it
+     * if there is none or it is outdated. If a file name occurs in several directories, the one with the shortest path
+     * relative to root wins, and among equally long paths the lexicographically smallest one.
+     */
+    static std::shared_ptr<const FileIndex> load(const QString &root, const QStringList &name_filters);
+
+    [[nodiscard]] std::optional<QString> find(const QString &file_name) const;
+    [[nodiscard]] qsizetype size() const;
+
+private:
+    QString root;
+    QStringList name_filters;
+    QHash<QString, QString> paths;
+    // Modification time of every directory of the tree in ms since epoch
+    QHash<QString, qint64> dir_mtimes;
+
+    FileIndex(QString root, QStringList name_filters);
+    void build();
+    [[nodiscard]] bool isUpToDate() const;
+    [[nodiscard]] QString cacheFile() const;
+    bool readCache();
+    void writeCache() const;
+};
+
+#endif  // SUISAPP_FILEINDEX_H
@@ -0,0 +1,63 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <QHashFunctions>
+#include <QList>
+
+#include "GridRegistry.h"
+
+template<FloatingList T>
+GridRegistry<T> &GridRegistry<T>::instance() {
+    static GridRegistry registry;
+    return registry;
+}
+
+template<FloatingList T>
+GridRegistry<T>::GridRegistry(const Hash hash) : hash(hash) {}
+
+template<FloatingList T>
+std::size_t GridRegistry<T>::hashRange(const T &grid) {
+    return qHashRange(grid.cbegin(), grid.cend());
+}
+
+template<FloatingList T>
+T GridRegistry<T>::intern(const T &grid) {
+    const std::size_t key = hash(grid);
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto [first, last] = grids.equal_range(key);
+    if (const auto it = std::find_if(first, last, [&grid](const auto &entry) -> bool {
+        return entry.second == grid;
+    }); it not_eq last) {
+        return it->second;
+    }
+    return grids.emplace(key, grid)->second;
+}
+
+/*
+ * Interned grids are found by identity rather than by value, so a list equal to but not shared with a registered grid
+ * is only cleared. The registry's own copy is the last owner when it is detached; no other reference can appear
+ * concurrently, as new ones are only handed out by intern() under the lock.
+ */
+template<FloatingList T>
+void GridRegistry<T>::release(T &grid) {
+    const std::size_t key = hash(grid);
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto [first, last] = grids.equal_range(key);
+    const auto it = std::find_if(first, last, [&grid](const auto &entry) -> bool {
+        return entry.second.isSharedWith(grid);
+    });
+    grid = T();
+    if (it not_eq last and it->second.isDetached()) {
+        grids.erase(it);
+    }
+}
+
+template<FloatingList T>
+std::size_t GridRegistry<T>::size() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return grids.size();
+}
+
+template class GridRegistry<QList<double>>;
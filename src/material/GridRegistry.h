@@ -0,0 +1,50 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_GRIDREGISTRY_H
+#define SUISAPP_GRIDREGISTRY_H
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+#include "Global.h"
+
+/*
+ * Interns wavelength grids: materials and composition fractions tabulated on the same wavelengths get the same
+ * implicitly shared QList, i.e. one array in memory, instead of one copy each. Solcore composition materials use one
+ * grid for all fractions, and many Sopra files share their grids, too.
+
+ * The interned lists must only be read (asConst(), const references), since any non-const access detaches a copy.
+ * Holders give their grids back with release(), which drops a grid once the registry is its only owner, so grids of
+ * unloaded materials do not pile up.
+ */
+template<FloatingList T>
+class GridRegistry {
+public:
+    using Hash = std::size_t (*)(const T &);
+
+    static GridRegistry &instance();
+
+    // The hash only buckets the grids, equal grids are found by comparing the values.
+    explicit GridRegistry(Hash hash = &GridRegistry::hashRange);
+    GridRegistry(const GridRegistry &) = delete;
+    GridRegistry &operator=(const GridRegistry &) = delete;
+
+    // Returns the registered grid equal to grid, registering grid if there is none.
+    T intern(const T &grid);
+    // Clears grid, and unregisters the grid it referred to if no other list shares it any more.
+    void release(T &grid);
+    // Number of distinct grids
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    static std::size_t hashRange(const T &grid);
+
+    Hash hash;
+    std::unordered_multimap<std::size_t, T> grids;
+    mutable std::mutex mutex;
+};
+
+#endif  // SUISAPP_GRIDREGISTRY_H
@@ -0,0 +1,30 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_LISTCOLUMNS_H
+#define SUISAPP_LISTCOLUMNS_H
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include <QList>
+
+#include "utils/NumericParser.h"
+
+/*
+ * Utils::NumericParser::read_columns() as the QList<double> the materials hold their n/k data in.
+ */
+inline auto read_list_columns(Utils::NumericParser &parser, const std::vector<std::size_t> &columns,
+                              const std::size_t num_fields = 0, const char separator = ' ',
+                              const std::size_t max_rows = std::numeric_limits<std::size_t>::max()) -> std::vector<QList<double>> {
+    const std::vector<std::vector<double>> data = parser.read_columns(columns, num_fields, separator, max_rows);
+    std::vector<QList<double>> lists;
+    lists.reserve(data.size());
+    for (const std::vector<double> &column : data) {
+        lists.emplace_back(column.begin(), column.end());
+    }
+    return lists;
+}
+
+#endif  // SUISAPP_LISTCOLUMNS_H
@@ -0,0 +1,119 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <QList>
+
+#include "MaterialCache.h"
+#include "OpticMaterial.h"
+
+template<FloatingList T>
+MaterialCache<T> &MaterialCache<T>::instance() {
+    static MaterialCache cache;
+    return cache;
+}
+
+template<FloatingList T>
+void MaterialCache<T>::setBudget(const std::size_t budget) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    limit = budget;
+    evict(nullptr);
+}
+
+template<FloatingList T>
+std::size_t MaterialCache<T>::budget() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return limit;
+}
+
+template<FloatingList T>
+std::size_t MaterialCache<T>::usage() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return used;
+}
+
+template<FloatingList T>
+void MaterialCache<T>::touch(OpticMaterial<T> *material) {
+    const std::size_t bytes = material->memory_usage();
+    const std::lock_guard<std::mutex> lock(mutex);
+    Entry &entry = entries[material];
+    if (entry.loaded) {
+        lru.splice(lru.begin(), lru, entry.position);
+        used -= entry.bytes;
+    } else {
+        entry.position = lru.insert(lru.begin(), material);
+        entry.loaded = true;
+    }
+    entry.bytes = bytes;
+    used += bytes;
+    evict(material);
+}
+
+template<FloatingList T>
+void MaterialCache<T>::pin(OpticMaterial<T> *material) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    entries[material].pins++;
+}
+
+template<FloatingList T>
+void MaterialCache<T>::unpin(OpticMaterial<T> *material) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = entries.find(material);
+    if (it == entries.end() or it->second.pins == 0) {
+        return;
+    }
+    if (--it->second.pins == 0 and not it->second.loaded) {
+        entries.erase(it);
+    }
+    evict(nullptr);
+}
+
+template<FloatingList T>
+void MaterialCache<T>::remove(OpticMaterial<T> *material) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = entries.find(material);
+    if (it == entries.end()) {
+        return;
+    }
+    if (it->second.loaded) {
+        lru.erase(it->second.position);
+        used -= it->second.bytes;
+    }
+    entries.erase(it);
+}
+
+template<FloatingList T>
+void MaterialCache<T>::forget(OpticMaterial<T> *material) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = entries.find(material);
+    if (it == entries.end()) {
+        return;
+    }
+    if (it->second.loaded) {
+        lru.erase(it->second.position);
+        used -= it->second.bytes;
+        it->second.loaded = false;
+        it->second.bytes = 0;
+    }
+    if (it->second.pins == 0) {
+        entries.erase(it);
+    }
+}
+
+template<FloatingList T>
+void MaterialCache<T>::evict(const OpticMaterial<T> *keep) {
+    for (auto it = lru.end(); used > limit and it not_eq lru.begin();) {
+        --it;
+        OpticMaterial<T> *material = *it;
+        const auto entry = entries.find(material);
+        if (material == keep or entry->second.pins not_eq 0) {
+            continue;
+        }
+        material->unload_nk();
+        used -= entry->second.bytes;
+        it = lru.erase(it);
+        entries.erase(entry);
+    }
+}
+
+template class MaterialCache<QList<double>>;
@@ -0,0 +1,67 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_MATERIALCACHE_H
+#define SUISAPP_MATERIALCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "Global.h"
+
+template<FloatingList T>
+class OpticMaterial;
+
+/*
+ * Memory budget for the n, k data of materials that can reload it from their database file (Sopra, DriftFusion).
+ * Such a material loads its data on first access and reports every access here; when the loaded data exceed the
+ * budget, the least recently used materials are unloaded until they fit again. The material being accessed and pinned
+ * materials are never unloaded, so a material may keep the cache above its budget.
+
+ * Unloading is not synchronized with readers of other materials: a calculation that may run concurrently with other
+ * accesses, e.g. of a device, should pin its materials for as long as it uses them.
+ */
+template<FloatingList T>
+class MaterialCache {
+public:
+    static MaterialCache &instance();
+
+    // Budget in bytes
+    void setBudget(std::size_t budget);
+    [[nodiscard]] std::size_t budget() const;
+    // Bytes of n, k data currently loaded
+    [[nodiscard]] std::size_t usage() const;
+
+    // Marks material as most recently used and evicts others beyond the budget.
+    void touch(OpticMaterial<T> *material);
+    // Pins are counted; every pin() needs an unpin().
+    void pin(OpticMaterial<T> *material);
+    void unpin(OpticMaterial<T> *material);
+    // Forgets a material that is being destroyed.
+    void remove(OpticMaterial<T> *material);
+    // Forgets the loaded data of a material whose data have been replaced, but keeps its pins.
+    void forget(OpticMaterial<T> *material);
+
+private:
+    struct Entry {
+        std::size_t bytes = 0;
+        unsigned pins = 0;
+        bool loaded = false;
+        typename std::list<OpticMaterial<T> *>::iterator position;
+    };
+
+    // Most recently used first
+    std::list<OpticMaterial<T> *> lru;
+    std::unordered_map<OpticMaterial<T> *, Entry> entries;
+    std::size_t used = 0;
+    std::size_t limit = std::size_t(512) << 20;
+    mutable std::mutex mutex;
+
+    MaterialCache() = default;
+    void evict(const OpticMaterial<T> *keep);
+};
+
+#endif  // SUISAPP_MATERIALCACHE_H
@@ -2,6 +2,7 @@
 // Created by Yihua Liu on 2024/6/4.
 //
 
+#include <chrono>
 #include <map>
 #include <stdexcept>
 #include <unordered_set>
@@ -9,7 +10,6 @@
 #include <QDir>
 #include <QFile>
 #include <QProcessEnvironment>
-#include <QRegularExpression>
 #include <QStandardPaths>
 #include <QString>
 #include "xlsxabstractsheet.h"
@@ -17,13 +17,44 @@
 #include "xlsxworkbook.h"
 
 #include "IniConfigParser.h"
+#include "ListColumns.h"
 #include "MaterialDbModel.h"
 
 #include "DbSysModel.h"
 #include "ParameterSystem.h"
+#include "Preferences.h"
+#include "utils/NumericParser.h"
+
+namespace {
+    // Progress of a background import reaches QML at most this often.
+    constexpr std::chrono::milliseconds progress_interval(100);
+    // Editors save in several steps (truncate, write, rename); changes are collected this long before reloading.
+    constexpr std::chrono::milliseconds reindex_delay(500);
+    // Share of the progress of a Solcore import with the embedded Sopra database: Solcore reads every n, k file up
+    // front, Sopra only its index and the file names.
+    constexpr double solcore_progress = 0.8;
+}
 
 MaterialDbModel::MaterialDbModel(QObject *parent, QString name) : QAbstractListModel(parent), m_progress(0),
-                                                                  m_name(std::move(name)), m_checked(false) {}
+                                                                  m_name(std::move(name)), m_checked(false) {
+    m_poll.setInterval(progress_interval);
+    connect(&m_poll, &QTimer::timeout, this, &MaterialDbModel::poll);
+    m_reindex.setSingleShot(true);
+    m_reindex.setInterval(reindex_delay);
+    connect(&m_reindex, &QTimer::timeout, this, &MaterialDbModel::reindex);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &MaterialDbModel::onSourceChanged);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &MaterialDbModel::onSourceChanged);
+}
+
+MaterialDbModel::~MaterialDbModel() {
+    // Wait for the running job and the discarded ones: on exit, they could outlive the caches their materials use.
+    m_poll.stop();
+    if (m_job.valid()) {
+        m_stop.request_stop();
+        qDeleteAll(m_job.get().materials);
+    }
+    reapDiscarded(true);
+}
 
 int MaterialDbModel::rowCount(const QModelIndex& parent) const {
     Q_UNUSED(parent)
@@ -38,7 +69,7 @@ QVariant MaterialDbModel::data(const QModelIndex& index, int role) const {
         case NameRole:
             return it.key();
         case NWlRole:
-            return QVariant::fromValue(it.value()->nWl());
+            return QVariant::fromValue(it.value()->wl());
         case NDataRole:
             return QVariant::fromValue(it.value()->nData());
         case KWlRole:
@@ -87,6 +118,10 @@ void MaterialDbModel::setPath(const QString &path) {
     }
 }
 
+bool MaterialDbModel::loading() const {
+    return m_job.valid();
+}
+
 QHash<int, QByteArray> MaterialDbModel::roleNames() const {
     QHash<int, QByteArray> roles;
     roles[NameRole] = "name";
@@ -141,8 +176,93 @@ QString findSolcoreUserConfig() {
     return user_path.filePath("solcore_config.txt");
 }
 
-int MaterialDbModel::readSolcoreDb(const QString& db_path) {
-    using namespace Qt::Literals::StringLiterals;
+namespace {
+    /*
+     * Reads the wavelength and the n or k column of a Solcore n/k file in one pass over the whole file.
+     */
+    auto read_solcore_nk(const QString& path) -> std::pair<QList<double>, QList<double>> {
+        QFile file(path);
+        if (not file.open(QIODevice::ReadOnly)) {
+            throw std::runtime_error("Cannot open file " + path.toStdString());
+        }
+        const QByteArray bytes = file.readAll();
+        Utils::NumericParser parser({bytes.constData(), static_cast<std::size_t>(bytes.size())}, path.toStdString());
+        std::vector<QList<double>> columns = read_list_columns(parser, {0, 1}, 2);
+        return {std::move(columns.front()), std::move(columns.back())};
+    }
+
+    // n and k of a Solcore material and the paths they were read from
+    struct SolcoreNk {
+        QList<std::pair<double, QList<double>>> n_wl;
+        QList<std::pair<double, QList<double>>> n_data;
+        QList<std::pair<double, QList<double>>> k_wl;
+        QList<std::pair<double, QList<double>>> k_data;
+        // The n and k files, and the folders of per-fraction files
+        QStringList sources;
+    };
+
+    /*
+     * Reads the n and k files of the Solcore material in mat_dir. A composition material has one file per fraction in
+     * its n and k folders.
+     */
+    SolcoreNk read_solcore_material(const QDir& mat_dir, const bool composition) {
+        SolcoreNk nk;
+        // Note that same Solcore material has the same n_wl and k_wl even for different compositions, so there is
+        // no need to store many n_wl and k_wl for one material.
+        if (composition) {
+            const QDir n_dir = mat_dir.filePath("n");
+            const QDir k_dir = mat_dir.filePath("k");
+            if (not n_dir.exists() or not k_dir.exists()) {
+                throw std::runtime_error("Cannot find n and k folder for composition material " + mat_dir.path().toStdString());
+            }
+            nk.sources << n_dir.path() << k_dir.path();
+            const QFileInfoList n_flist = n_dir.entryInfoList(QDir::Files);
+            const QFileInfoList k_flist = k_dir.entryInfoList(QDir::Files);
+            for (const QFileInfo& n_info : n_flist) {
+                if (n_info.fileName() not_eq "critical_points.txt") {
+                    // Warning: use completeBaseName() instead of baseName() to leave out all before the last dot!
+                    const QString main_fraction_str = n_info.completeBaseName().split('_').front();
+                    // use filePath() rather than fileName()!
+                    auto [frac_n_wl, frac_n_data] = read_solcore_nk(n_info.filePath());
+                    nk.sources.append(n_info.filePath());
+                    nk.n_wl.emplace_back(main_fraction_str.toDouble(), std::move(frac_n_wl));
+                    nk.n_data.emplace_back(main_fraction_str.toDouble(), std::move(frac_n_data));
+                }
+            }
+            for (const QFileInfo& k_info : k_flist) {
+                if (k_info.fileName() not_eq "critical_points.txt") {
+                    const QString main_fraction_str = k_info.completeBaseName().split('_').front();
+                    auto [frac_k_wl, frac_k_data] = read_solcore_nk(k_info.filePath());
+                    nk.sources.append(k_info.filePath());
+                    nk.k_wl.emplace_back(main_fraction_str.toDouble(), std::move(frac_k_wl));
+                    nk.k_data.emplace_back(main_fraction_str.toDouble(), std::move(frac_k_data));
+                }
+            }
+        } else {
+            auto [frac_n_wl, frac_n_data] = read_solcore_nk(mat_dir.filePath("n.txt"));
+            auto [frac_k_wl, frac_k_data] = read_solcore_nk(mat_dir.filePath("k.txt"));
+            nk.sources << mat_dir.filePath("n.txt") << mat_dir.filePath("k.txt");
+            nk.n_wl.emplace_back(1, std::move(frac_n_wl));
+            nk.n_data.emplace_back(1, std::move(frac_n_data));
+            nk.k_wl.emplace_back(1, std::move(frac_k_wl));
+            nk.k_data.emplace_back(1, std::move(frac_k_data));
+        }
+        return nk;
+    }
+
+    bool singlePrecisionNk() {
+        return Preferences::instance() and Preferences::instance()->getsSinglePrecisionNk();
+    }
+
+    Interpolation nkInterpolation() {
+        return Preferences::instance() and Preferences::instance()->getsPchipNk() ? Interpolation::PCHIP :
+                                                                                   Interpolation::LINEAR;
+    }
+}
+
+MaterialDbModel::Table MaterialDbModel::loadSolcoreDb(const QString& db_path, const bool sopra_checked,
+                                                      const bool single_precision, const std::stop_token& stop,
+                                                      std::atomic<double>& progress) {
     const QUrl url(db_path);
     QString db_path_imported = db_path;
     if (url.isLocalFile()) {
@@ -159,11 +279,11 @@ int MaterialDbModel::readSolcoreDb(const QString& db_path) {
     const QFileInfo ini_finfo(db_path_imported);  // for later get the parent directory as the root path
     if (not ini_finfo.exists() or not ini_finfo.isFile()) {
         qWarning("Database path is not an existing file!");
-        return 1;
+        return {PathNotFound};
     }
     if (not ini_file.open(QIODevice::ReadOnly)) {
         qWarning("Cannot open the configuration ini file %s.", qUtf8Printable(db_path));
-        return 1;
+        return {PathNotFound};
     }
     // db_dir.setFilter(QDir::Dirs);
     // QStringList name_filters;
@@ -177,186 +297,116 @@ int MaterialDbModel::readSolcoreDb(const QString& db_path) {
     const ParameterSystem par_sys(solcore_config.loadGroup("Parameters"), ini_finfo.absolutePath());
     const QMap<QString, QString> mat_map = solcore_config.loadGroup("Materials");
     const QMap<QString, QString> others_map = solcore_config.loadGroup("Others");
+    const bool read_sopra = others_map.contains("sopra") and sopra_checked;
+    const double progress_end = read_sopra ? solcore_progress : 1;
+    Table table;
     for (QMap<QString, QString>::const_iterator it = mat_map.cbegin(); it not_eq mat_map.cend(); ++it) {
+        if (stop.stop_requested()) {
+            table.status = Cancelled;
+            return table;
+        }
         try {
             const QString& mat_name = it.key();
             QString mat_path = it.value();
             mat_path.replace("SOLCORE_ROOT", ini_finfo.absolutePath());
             const QDir mat_dir(mat_path);
-            QList<std::pair<double, QList<double>>> n_wl;
-            QList<std::pair<double, QList<double>>> n_data;
-            QList<std::pair<double, QList<double>>> k_wl;
-            QList<std::pair<double, QList<double>>> k_data;
-            static const QRegularExpression ws_regexp("\\s+");
-            QString line;
-            QStringList ln_data;
-            // Note that same Solcore material has the same n_wl and k_wl even for different compositions, so there is
-            // no need to store many n_wl and k_wl for one material.
-            if (par_sys.isComposition(mat_name, "x")) {
-                const QDir n_dir = mat_dir.filePath("n");
-                const QDir k_dir = mat_dir.filePath("k");
-                if (not n_dir.exists() or not k_dir.exists()) {
-                    throw std::runtime_error("Cannot find n and k folder for composition material " + mat_name.toStdString());
-                }
-                const QFileInfoList n_flist = n_dir.entryInfoList(QDir::Files);
-                const QFileInfoList k_flist = k_dir.entryInfoList(QDir::Files);
-                for (const QFileInfo& n_info : n_flist) {
-                    if (n_info.fileName() not_eq "critical_points.txt") {
-                        // Warning: use completeBaseName() instead of baseName() to leave out all before the last dot!
-                        const QString main_fraction_str = n_info.completeBaseName().split('_').front();
-                        QFile n_file(n_info.filePath());  // use filePath() rather than fileName()!
-                        if (not n_file.open(QIODevice::ReadOnly)) {
-                            throw std::runtime_error("Cannot open file " + n_info.filePath().toStdString());
-                        }
-                        QTextStream n_stream(&n_file);
-                        QList<double> frac_n_wl;
-                        QList<double> frac_n_data;
-                        while (not n_stream.atEnd()) {
-                            line = n_stream.readLine();
-                            // Clazy: Don't create temporary QRegularExpression objects.
-                            // Use a static QRegularExpression object instead
-                            ln_data = line.split(ws_regexp);
-                            if (ln_data.length() not_eq 2) {
-                                throw std::runtime_error("Error parsing file " + n_info.filePath().toStdString());
-                            }
-                            frac_n_wl.emplace_back(ln_data.front().toDouble());
-                            frac_n_data.emplace_back(ln_data.back().toDouble());
-                        }
-                        n_file.close();
-                        n_wl.emplace_back(main_fraction_str.toDouble(), frac_n_wl);
-                        n_data.emplace_back(main_fraction_str.toDouble(), frac_n_data);
-                    }
-                }
-                for (const QFileInfo& k_info : k_flist) {
-                    if (k_info.fileName() not_eq "critical_points.txt") {
-                        const QString main_fraction_str = k_info.completeBaseName().split('_').front();
-                        QFile k_file(k_info.filePath());
-                        if (not k_file.open(QIODevice::ReadOnly)) {
-                            throw std::runtime_error("Cannot open file " + k_info.filePath().toStdString());
-                        }
-                        QTextStream k_stream(&k_file);
-                        QList<double> frac_k_wl;
-                        QList<double> frac_k_data;
-                        while (not k_stream.atEnd()) {
-                            line = k_stream.readLine();
-                            ln_data = line.split(ws_regexp);
-                            if (ln_data.length() not_eq 2) {
-                                throw std::runtime_error("Error parsing file " + k_info.filePath().toStdString());
-                            }
-                            frac_k_wl.emplace_back(ln_data.front().toDouble());
-                            frac_k_data.emplace_back(ln_data.back().toDouble());
-                        }
-                        k_file.close();
-                        k_wl.emplace_back(main_fraction_str.toDouble(), frac_k_wl);
-                        k_data.emplace_back(main_fraction_str.toDouble(), frac_k_data);
-                    }
-                }
-            } else {
-                QFile n_file = mat_dir.filePath("n.txt");
-                QFile k_file = mat_dir.filePath("k.txt");
-                if (not n_file.open(QIODevice::ReadOnly)) {
-                    throw std::runtime_error("Cannot open file " + n_file.fileName().toStdString());
-                }
-                if (not k_file.open(QIODevice::ReadOnly)) {
-                    throw std::runtime_error("Cannot open file " + k_file.fileName().toStdString());
-                }
-                QTextStream n_stream(&n_file);
-                QTextStream k_stream(&k_file);
-                QList<double> frac_n_wl;
-                QList<double> frac_n_data;
-                QList<double> frac_k_wl;
-                QList<double> frac_k_data;
-                while (not n_stream.atEnd()) {
-                    line = n_stream.readLine();
-                    ln_data = line.split(ws_regexp);
-                    if (ln_data.length() not_eq 2) {
-                        throw std::runtime_error("Error parsing file " + n_file.fileName().toStdString());
-                    }
-                    frac_n_wl.emplace_back(ln_data.front().toDouble());
-                    frac_n_data.emplace_back(ln_data.back().toDouble());
-                }
-                while (not k_stream.atEnd()) {
-                    line = k_stream.readLine();
-                    ln_data = line.split(ws_regexp);
-                    if (ln_data.length() not_eq 2) {
-                        throw std::runtime_error("Error parsing file " + k_file.fileName().toStdString());
-                    }
-                    frac_k_wl.emplace_back(ln_data.front().toDouble());
-                    frac_k_data.emplace_back(ln_data.back().toDouble());
-                }
-                n_file.close();
-                k_file.close();
-                n_wl.emplace_back(1, frac_n_wl);
-                n_data.emplace_back(1, frac_n_data);
-                k_wl.emplace_back(1, frac_k_wl);
-                k_data.emplace_back(1, frac_k_data);
-            }
-            auto *opt_mat = new OpticMaterial<QList<double>>(mat_name, n_wl, n_data, k_wl, k_data);
-            beginInsertRows(QModelIndex(), static_cast<int>(m_list.size()), static_cast<int>(m_list.size()));
-            m_list.insert(mat_name, opt_mat);
-            endInsertRows();
-            // emit dataChanged(index(0), index(static_cast<int>(m_list.size()) - 1));
-            setProgress(static_cast<double>(std::distance(mat_map.cbegin(), it) + 1) / static_cast<double>(mat_map.size()));
+            const bool composition = par_sys.isComposition(mat_name, "x");
+            SolcoreNk nk = read_solcore_material(mat_dir, composition);
+            auto *opt_mat = new OpticMaterial<QList<double>>(mat_name, nk.n_wl, nk.n_data, nk.k_wl, nk.k_data);
+            opt_mat->set_single_precision(single_precision);
+            table.materials.insert(mat_name, opt_mat);
+            table.sources.insert(mat_name, std::move(nk.sources));
+            table.solcore_dirs.insert(mat_name, {mat_path, composition});
+            progress.store(progress_end * static_cast<double>(std::distance(mat_map.cbegin(), it) + 1) /
+                           static_cast<double>(mat_map.size()), std::memory_order_relaxed);
         } catch (std::runtime_error& e) {
             qWarning() << e.what();
-            return 2;
+            table.status = DataFailed;
+            return table;
         }
     }
     // read SOPRA db embedded in solcore
-    if (others_map.contains("sopra")) {
-        for (const MaterialDbModel *db : DbSysModel::instance()) {
-            if (db->name() == u"Sopra"_s and db->checked()) {
-                QString sopra_path = others_map["sopra"];
-                sopra_path.replace("SOLCORE_ROOT", ini_finfo.absolutePath());
-                setPath(sopra_path);  // signal emitted
-                return readSopraDb(sopra_path);
+    if (read_sopra) {
+        QString sopra_path = others_map["sopra"];
+        sopra_path.replace("SOLCORE_ROOT", ini_finfo.absolutePath());
+        Table sopra = loadSopraDb(sopra_path, single_precision, stop, progress, solcore_progress);
+        // Sopra's data win where both databases have a material.
+        for (auto it = table.materials.cbegin(); it not_eq table.materials.cend(); ++it) {
+            if (sopra.materials.contains(it.key())) {
+                delete it.value();
+                continue;
             }
+            sopra.materials.insert(it.key(), it.value());
+            sopra.sources.insert(it.key(), table.sources.value(it.key()));
+            sopra.solcore_dirs.insert(it.key(), table.solcore_dirs.value(it.key()));
         }
+        sopra.path = sopra_path;
+        return sopra;
     }
-    return 0;
+    return table;
 }
 
 // Optical Data from Sopra SA http://www.sspectra.com/sopra.html
-int MaterialDbModel::readSopraDb(const QString& db_path) {
+MaterialDbModel::Table MaterialDbModel::loadSopraDb(const QString& db_path, const bool single_precision,
+                                                    const std::stop_token& stop, std::atomic<double>& progress,
+                                                    const double progress_begin) {
+    using namespace Qt::Literals::StringLiterals;
     const QDir sopra_dir(db_path);
     QFile sopra_db = sopra_dir.filePath("SOPRA_DB_Updated.csv");
+    Table table;
     try {
         if (not sopra_db.open(QIODevice::ReadOnly)) {
             throw std::runtime_error("Cannot open file " + QFileInfo(sopra_db).filePath().toStdString());
         }
+        // Sopra files may be anywhere below the database folder, e.g. in site-packages
+        const std::shared_ptr<const FileIndex> file_index = FileIndex::load(db_path, {u"*.MAT"_s});
         QTextStream sopra_stream(&sopra_db);
         // std::array<std::vector<QString>, 4> info;
         sopra_stream.readLine();  // skip header
         while (not sopra_stream.atEnd()) {
+            if (stop.stop_requested()) {
+                table.status = Cancelled;
+                return table;
+            }
             QString line = sopra_stream.readLine();
             QStringList ln_data = line.split(',');
             if (ln_data.length() not_eq 4 or ln_data.front() == "Filename") {
                 continue;
             }
             const QString& mat_name = ln_data.front();
-            const QString path = sopra_dir.filePath(mat_name + ".MAT");
+            // A file directly in the database folder takes precedence over copies deeper in the tree.
+            const QString top_path = sopra_dir.filePath(mat_name + ".MAT");
+            const QString path = QFileInfo::exists(top_path) ? top_path
+                                                              : file_index->find(mat_name + ".MAT").value_or(top_path);
             // info.front().emplace_back(ln_data.at(2));  // Material
             // info.at(2).emplace_back(ln_data.at(3));  // Wavelength (nm)
             // info.at(3).emplace_back(ln_data.back());  // File Info
             // info.back().emplace_back(path);  // File Path
             try {
-                auto *opt_mat = new OpticMaterial<QList<double>>(mat_name, DbType::SOPRA, path);
-                beginInsertRows(QModelIndex(), static_cast<int>(m_list.size()), static_cast<int>(m_list.size()));
-                m_list.insert(mat_name, opt_mat);
-                endInsertRows();
+                auto *opt_mat = new OpticMaterial<QList<double>>(mat_name, DbType::SOPRA, path, file_index);
+                opt_mat->set_single_precision(single_precision);
+                table.materials.insert(mat_name, opt_mat);
+                table.sources.insert(mat_name, {path});
             } catch (std::runtime_error &e) {
                 qWarning() << e.what();
-                return 2;
+                table.status = DataFailed;
+                return table;
             }
+            // The stream reads ahead in blocks, so this is coarse but monotonic.
+            progress.store(progress_begin + (1 - progress_begin) * static_cast<double>(sopra_db.pos()) /
+                           static_cast<double>(sopra_db.size()), std::memory_order_relaxed);
         }
     } catch (std::runtime_error& e) {
         qWarning() << e.what();
-        return 1;
+        table.status = PathNotFound;
+        return table;
     }
-    return 0;
+    progress.store(1, std::memory_order_relaxed);
+    return table;
 }
 
-int MaterialDbModel::readDfDb(const QString& db_path) {
+MaterialDbModel::Table MaterialDbModel::loadDfDb(const QString& db_path, const bool single_precision,
+                                                 const std::stop_token& stop, std::atomic<double>& progress) {
     const QUrl url(db_path);
     QString db_path_imported = db_path;
     if (url.isLocalFile()) {
@@ -365,26 +415,31 @@ int MaterialDbModel::readDfDb(const QString& db_path) {
     QXlsx::Document doc(db_path_imported);
     if (not doc.load()) {
         qWarning("Cannot load DriftFusion's material data file %s ", qUtf8Printable(db_path));
-        return 1;
+        return {PathNotFound};
     }
     doc.selectSheet("data");
     // QXlsx::AbstractSheet is not a derived class of QObject
     const QXlsx::AbstractSheet *data_sheet = doc.sheet("data");
     if (data_sheet == nullptr) {
         qWarning("Data sheet in data file %s does not exist!", qUtf8Printable(db_path));
-        return 2;
+        return {DataFailed};
     }
     data_sheet->workbook()->setActiveSheet(0);
     const auto *wsheet = dynamic_cast<QXlsx::Worksheet*>(data_sheet->workbook()->activeSheet());
     if (not wsheet) {
         qWarning("Data sheet not found");
-        return 2;
+        return {DataFailed};
     }
     const int maxRow = wsheet->dimension().rowCount();  // qsizetype is long long (different from std::size_t)
     const int maxCol = wsheet->dimension().columnCount();
     std::unordered_set<QString> mat_name_set;
+    Table table;
     // Scan the header first.
     for (int cc = 2; cc < maxCol; cc += 2) {
+        if (stop.stop_requested()) {
+            table.status = Cancelled;
+            return table;
+        }
         // const QString mat_name = clList.at(cc).cell->readValue().toString();
         const QStringList mat_name_list = wsheet->cellAt(1, cc)->readValue().toString().split('_');
         const QStringList mat_name_list2 = wsheet->cellAt(1, cc + 1)->readValue().toString().split('_');
@@ -413,11 +468,11 @@ int MaterialDbModel::readDfDb(const QString& db_path) {
             // Otherwise, qlist.h inline T& last() { Q_ASSERT(!isEmpty()); return *(end()-1); } assertion will fail.
             // auto *opt_mat = new OpticMaterial<QList<double>>(it.key(), wls, std::move(n_series), wls, std::move(k_series));
             auto *opt_mat = new OpticMaterial<QList<double>>(mat_name, DbType::DF, db_path_imported);
-            beginInsertRows(QModelIndex(), static_cast<int>(m_list.size()), static_cast<int>(m_list.size()));
-            m_list.insert(mat_name, opt_mat);
-            endInsertRows();
+            opt_mat->set_single_precision(single_precision);
+            table.materials.insert(mat_name, opt_mat);
+            table.sources.insert(mat_name, {db_path_imported});
         }
-        setProgress(static_cast<double>(cc + 2) / static_cast<double>(maxCol));
+        progress.store(static_cast<double>(cc + 2) / static_cast<double>(maxCol), std::memory_order_relaxed);
     }
     for (QMap<QString, QList<std::pair<int, double>>>::const_iterator it = mat_name_indices.cbegin();
          it not_eq mat_name_indices.cend(); ++it) {
@@ -442,7 +497,213 @@ int MaterialDbModel::readDfDb(const QString& db_path) {
             break;
         }
     }
-    return 0;
+    return table;
+}
+
+void MaterialDbModel::readSolcoreDb(const QString& db_path) {
+    using namespace Qt::Literals::StringLiterals;
+    // Models are only read on this thread.
+    bool sopra_checked = false;
+    const DbSysModel *db_sys = DbSysModel::instance();
+    for (int row = 0; row < db_sys->rowCount(QModelIndex()); row++) {
+        const QModelIndex db_index = db_sys->index(row);
+        if (db_index.data(DbSysModel::NameRole).toString() == u"Sopra"_s and db_index.data(DbSysModel::CheckedRole).toBool()) {
+            sopra_checked = true;
+        }
+    }
+    startLoading([db_path, sopra_checked, single_precision = singlePrecisionNk()](
+            const std::stop_token& stop, std::atomic<double>& progress) -> Table {
+        return loadSolcoreDb(db_path, sopra_checked, single_precision, stop, progress);
+    });
+}
+
+void MaterialDbModel::readSopraDb(const QString& db_path) {
+    startLoading([db_path, single_precision = singlePrecisionNk()](const std::stop_token& stop,
+                                                                   std::atomic<double>& progress) -> Table {
+        return loadSopraDb(db_path, single_precision, stop, progress);
+    });
+}
+
+void MaterialDbModel::readDfDb(const QString& db_path) {
+    startLoading([db_path, single_precision = singlePrecisionNk()](const std::stop_token& stop,
+                                                                   std::atomic<double>& progress) -> Table {
+        return loadDfDb(db_path, single_precision, stop, progress);
+    });
+}
+
+void MaterialDbModel::cancelLoading() {
+    m_stop.request_stop();
+}
+
+void MaterialDbModel::startLoading(Job job) {
+    // Even for the same path, re-importing is allowed because the same file may change.
+    const bool was_loading = loading();
+    discardJob();
+    m_stop = std::stop_source();
+    // A discarded job may still be running and writing its progress, so every job gets its own.
+    m_job_progress = std::make_shared<std::atomic<double>>(0);
+    setProgress(0);
+    m_job = std::async(std::launch::async, [job = std::move(job), stop = m_stop.get_token(),
+                                            progress = m_job_progress]() -> Table {
+        return job(stop, *progress);
+    });
+    m_poll.start();
+    if (not was_loading) {
+        emit loadingChanged();
+    }
+}
+
+/*
+ * Cancels the running import, if any. Its materials are never published. Some steps cannot be interrupted (walking a
+ * directory tree, loading a workbook), so rather than blocking the GUI, the job is left to finish in m_discarded. Its
+ * materials are deleted by the next poll() or discardJob() after it has finished, or by the destructor.
+ */
+void MaterialDbModel::discardJob() {
+    m_poll.stop();
+    if (m_job.valid()) {
+        m_stop.request_stop();
+        m_discarded.push_back(std::move(m_job));
+    }
+    reapDiscarded(false);
+}
+
+/*
+ * Deletes the materials of the discarded jobs that have finished, or of all of them after waiting for them if wait.
+ */
+void MaterialDbModel::reapDiscarded(const bool wait) {
+    for (auto it = m_discarded.begin(); it not_eq m_discarded.end();) {
+        if (wait or it->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            qDeleteAll(it->get().materials);
+            it = m_discarded.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void MaterialDbModel::poll() {
+    reapDiscarded(false);
+    setProgress(m_job_progress->load(std::memory_order_relaxed));
+    if (m_job.wait_for(std::chrono::seconds(0)) not_eq std::future_status::ready) {
+        return;
+    }
+    m_poll.stop();
+    Table table = m_job.get();
+    if (table.status == Cancelled) {
+        qDeleteAll(table.materials);
+    } else if (not table.materials.empty()) {
+        const Interpolation interpolation = nkInterpolation();
+        for (OpticMaterial<QList<double>> *material : std::as_const(table.materials)) {
+            material->set_interpolation(interpolation);
+        }
+        // Materials of the same name are updated in place, since devices may still refer to the old objects.
+        beginResetModel();
+        for (auto it = table.materials.cbegin(); it not_eq table.materials.cend(); ++it) {
+            if (OpticMaterial<QList<double>> *&material = m_list[it.key()]) {
+                material->replace(std::move(*it.value()));
+                delete it.value();
+            } else {
+                material = it.value();
+            }
+        }
+        endResetModel();
+        unwatch(table.materials.keys());
+        m_solcore_dirs.insert(table.solcore_dirs);
+        watch(table.sources);
+    }
+    if (not table.path.isEmpty()) {
+        setPath(table.path);
+    }
+    emit loadingChanged();
+    emit loaded(table.status);
+}
+
+void MaterialDbModel::watch(const QHash<QString, QStringList> &sources) {
+    QStringList new_paths;
+    for (auto it = sources.cbegin(); it not_eq sources.cend(); ++it) {
+        for (const QString &path : it.value()) {
+            QStringList &materials = m_sources[path];
+            if (materials.isEmpty()) {
+                new_paths.append(path);
+            }
+            if (not materials.contains(it.key())) {
+                materials.append(it.key());
+            }
+        }
+    }
+    if (not new_paths.isEmpty()) {
+        m_watcher.addPaths(new_paths);
+    }
+}
+
+void MaterialDbModel::unwatch(const QStringList &mat_names) {
+    QStringList stale_paths;
+    for (auto it = m_sources.begin(); it not_eq m_sources.end();) {
+        for (const QString &mat_name : mat_names) {
+            it.value().removeAll(mat_name);
+        }
+        if (it.value().isEmpty()) {
+            stale_paths.append(it.key());
+            it = m_sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const QString &mat_name : mat_names) {
+        m_solcore_dirs.remove(mat_name);
+    }
+    if (not stale_paths.isEmpty()) {
+        m_watcher.removePaths(stale_paths);
+    }
+}
+
+void MaterialDbModel::onSourceChanged(const QString &path) {
+    m_changed.insert(path);
+    m_reindex.start();
+}
+
+void MaterialDbModel::reindex() {
+    // Saving by renaming replaces a file, which drops it from the watcher. The new file may only appear some time after
+    // the signal, so every known source is checked here, after the delay.
+    const QStringList files = m_watcher.files();
+    const QStringList directories = m_watcher.directories();
+    const QSet<QString> watched(files.cbegin(), files.cend());
+    QStringList unwatched;
+    for (auto it = m_sources.cbegin(); it not_eq m_sources.cend(); ++it) {
+        if (not watched.contains(it.key()) and not directories.contains(it.key()) and QFileInfo::exists(it.key())) {
+            unwatched.append(it.key());
+        }
+    }
+    if (not unwatched.isEmpty()) {
+        m_watcher.addPaths(unwatched);
+    }
+    QSet<QString> materials;
+    for (const QString &path : std::exchange(m_changed, {})) {
+        for (const QString &mat_name : m_sources.value(path)) {
+            materials.insert(mat_name);
+        }
+    }
+    for (const QString &mat_name : materials) {
+        const auto it = m_list.constFind(mat_name);
+        if (it == m_list.cend()) {
+            continue;
+        }
+        try {
+            if (const auto dir = m_solcore_dirs.constFind(mat_name); dir not_eq m_solcore_dirs.cend()) {
+                SolcoreNk nk = read_solcore_material(dir->first, dir->second);
+                it.value()->set_nk(std::move(nk.n_wl), std::move(nk.n_data), std::move(nk.k_wl), std::move(nk.k_data));
+                // New fraction files
+                watch({{mat_name, nk.sources}});
+            } else {
+                it.value()->reload_nk();
+            }
+        } catch (std::runtime_error &e) {
+            qWarning() << "Cannot reload" << mat_name << e.what();
+            continue;
+        }
+        const QModelIndex row = index(static_cast<int>(std::distance(m_list.cbegin(), it)));
+        emit dataChanged(row, row);
+    }
 }
 
 OpticMaterial<QList<double>> *MaterialDbModel::getMatByName(const QString &mat_name) const {
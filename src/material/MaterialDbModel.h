@@ -5,7 +5,16 @@
 #ifndef SUISAPP_MATERIALDBMODEL_H
 #define SUISAPP_MATERIALDBMODEL_H
 
+#include <atomic>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <stop_token>
 #include <QAbstractListModel>
+#include <QFileSystemWatcher>
+#include <QSet>
+#include <QTimer>
 
 #include "OpticMaterial.h"
 
@@ -16,6 +25,7 @@ class MaterialDbModel : public QAbstractListModel {
     Q_PROPERTY(QString name READ name)
     Q_PROPERTY(bool checked READ checked WRITE setChecked NOTIFY checkedChanged)
     Q_PROPERTY(QString path READ path WRITE setPath NOTIFY pathChanged)
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
 
 public:
     enum ModelRoles {
@@ -26,7 +36,17 @@ public:
         KDataRole
     };
 
+    // Status of an import
+    enum LoadStatus {
+        Loaded = 0,
+        PathNotFound,
+        DataFailed,
+        Cancelled
+    };
+    Q_ENUM(LoadStatus)
+
     explicit MaterialDbModel(QObject *parent = nullptr, QString name = "");
+    ~MaterialDbModel() override;
 
     // Default arguments on virtual or override methods are prohibited
     [[nodiscard]] int rowCount(const QModelIndex& parent) const override;  // parent = QModelIndex()
@@ -39,10 +59,20 @@ public:
     void setChecked(bool checked);
     [[nodiscard]] QString path() const;
     void setPath(const QString &path);
+    [[nodiscard]] bool loading() const;
 
-    Q_INVOKABLE int readSolcoreDb(const QString& db_path);
-    Q_INVOKABLE int readSopraDb(const QString& db_path);
-    Q_INVOKABLE int readDfDb(const QString& db_path);
+    /*
+     * The databases are imported in the background; loaded(status) is emitted when the import has finished. A new
+     * import cancels the running one. The imported materials are published with a single model reset, and progress
+     * is updated at a fixed rate rather than per material. Materials that are listed already are updated in place.
+
+     * The files the materials were read from are watched afterward. When some change, only the materials read from
+     * them are reloaded, in place, and their rows are updated; materials added to a database need a new import.
+     */
+    Q_INVOKABLE void readSolcoreDb(const QString& db_path);
+    Q_INVOKABLE void readSopraDb(const QString& db_path);
+    Q_INVOKABLE void readDfDb(const QString& db_path);
+    Q_INVOKABLE void cancelLoading();
 
     [[nodiscard]] OpticMaterial<QList<double>> *getMatByName(const QString &mat_name) const;
 
@@ -50,11 +80,26 @@ signals:
     void progressChanged();
     void checkedChanged();
     void pathChanged();
+    void loadingChanged();
+    void loaded(int status);
 
 protected:
     [[nodiscard]] QHash<int, QByteArray> roleNames() const override;
 
 private:
+    // Materials imported by a background job
+    struct Table {
+        LoadStatus status = Loaded;
+        QMap<QString, OpticMaterial<QList<double>> *> materials;
+        // Set if the import went on in another database folder (Sopra embedded in Solcore)
+        QString path;
+        // Files each material was read from, and folders of per-fraction files
+        QHash<QString, QStringList> sources;
+        // Folder of each Solcore material and whether it is composition-resolved
+        QHash<QString, std::pair<QString, bool>> solcore_dirs;
+    };
+    using Job = std::function<Table(const std::stop_token &, std::atomic<double> &)>;
+
     // If using QObject, the values should be a pointer
     QMap<QString, OpticMaterial<QList<double>> *> m_list;
 
@@ -62,6 +107,38 @@ private:
     QString m_name;
     bool m_checked{};
     QString m_path;
+
+    std::future<Table> m_job;
+    std::stop_source m_stop;
+    // Cancelled jobs that may still be running, see discardJob()
+    std::list<std::future<Table>> m_discarded;
+    std::shared_ptr<std::atomic<double>> m_job_progress = std::make_shared<std::atomic<double>>(0);
+    QTimer m_poll;
+
+    QFileSystemWatcher m_watcher;
+    // Watched path -> materials read from it
+    QHash<QString, QStringList> m_sources;
+    QHash<QString, std::pair<QString, bool>> m_solcore_dirs;
+    // Paths changed since the last reindex()
+    QSet<QString> m_changed;
+    QTimer m_reindex;
+
+    static Table loadSolcoreDb(const QString &db_path, bool sopra_checked, bool single_precision,
+                               const std::stop_token &stop, std::atomic<double> &progress);
+    // progress_begin is the progress already reported by a Solcore import reading the embedded Sopra database.
+    static Table loadSopraDb(const QString &db_path, bool single_precision, const std::stop_token &stop,
+                             std::atomic<double> &progress, double progress_begin = 0);
+    static Table loadDfDb(const QString &db_path, bool single_precision, const std::stop_token &stop,
+                          std::atomic<double> &progress);
+    void startLoading(Job job);
+    void discardJob();
+    void reapDiscarded(bool wait);
+    void poll();
+    void watch(const QHash<QString, QStringList> &sources);
+    // Stops tracking the sources of materials about to be re-imported, which may now come from other files.
+    void unwatch(const QStringList &mat_names);
+    void onSourceChanged(const QString &path);
+    void reindex();
 };
 
 #endif  // SUISAPP_MATERIALDBMODEL_H
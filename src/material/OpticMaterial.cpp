@@ -2,13 +2,65 @@
 // Created by Yihua Liu on 2024/3/31.
 //
 
-#include <QDirIterator>
+#include <utility>
 #include <QFile>
+#include <QFileInfo>
 #include "xlsxabstractsheet.h"
 #include "xlsxdocument.h"
 #include "xlsxworkbook.h"
 
+#include "ListColumns.h"
+#include "MaterialCache.h"
 #include "OpticMaterial.h"
+#include "utils/NumericParser.h"
+
+template<FloatingList T>
+OpticMaterial<T>::OpticMaterial(QString mat_name, QList<std::pair<double, T>> n_wl, QList<std::pair<double, T>> n_data,
+                                QList<std::pair<double, T>> k_wl,
+                                QList<std::pair<double, T>> k_data) : mat_name(std::move(mat_name)),
+                                                                      db_type(DbType::SOLCORE) {
+    set_nk(std::move(n_wl), std::move(n_data), std::move(k_wl), std::move(k_data));
+}
+
+template<FloatingList T>
+void OpticMaterial<T>::set_nk(QList<std::pair<double, T>> n_wl, QList<std::pair<double, T>> n_data,
+                              QList<std::pair<double, T>> k_wl, QList<std::pair<double, T>> k_data) {
+    // Directory listings are ordered by file name, not by fraction; composition interpolation needs sorted fractions.
+    // n_wl and n_data (k_wl and k_data) are built in the same order, so the same stable sort keeps them paired.
+    constexpr auto frac = &std::pair<double, T>::first;
+    std::ranges::stable_sort(n_wl, {}, frac);
+    std::ranges::stable_sort(n_data, {}, frac);
+    std::ranges::stable_sort(k_wl, {}, frac);
+    std::ranges::stable_sort(k_data, {}, frac);
+    // Every fraction of a Solcore material has the same grid, and n and k mostly do, too.
+    for (T &grid : n_wl | std::views::values) {
+        grid = intern(grid);
+    }
+    for (T &grid : k_wl | std::views::values) {
+        grid = intern(grid);
+    }
+    release_grids();
+    wavelengths = std::move(n_wl);
+    k_wavelengths = std::move(k_wl);
+    this->n_data.clear();
+    this->k_data.clear();
+    for (auto &[fraction, values] : n_data) {
+        this->n_data.emplace_back(fraction, store(std::move(values)));
+    }
+    for (auto &[fraction, values] : k_data) {
+        this->k_data.emplace_back(fraction, store(std::move(values)));
+    }
+    n_pchip.reset();
+    k_pchip.reset();
+    SpectralCache<T>::instance().remove(this);
+}
+
+template<FloatingList T>
+OpticMaterial<T>::~OpticMaterial() {
+    release_grids();
+    MaterialCache<T>::instance().remove(this);
+    SpectralCache<T>::instance().remove(this);
+}
 
 template<FloatingList T>
 QString OpticMaterial<T>::name() const {
@@ -16,42 +68,35 @@ QString OpticMaterial<T>::name() const {
 }
 
 template<FloatingList T>
-T OpticMaterial<T>::wl() const {
-    if (wl.empty()) {
-        try {
-            load_n();
-        } catch (std::runtime_error& e) {
-            qWarning() << "Material" << mat_name << "does not have wl defined." << e.what();
-            return {};
-        }
+T OpticMaterial<T>::wl() {
+    if (not loaded("wl defined.")) {
+        return {};
     }
     return wavelengths.back().second;
 }
 
 template<FloatingList T>
-T OpticMaterial<T>::nData() const {
-    if (n_data.empty()) {
-        try {
-            load_n();
-        } catch (std::runtime_error& e) {
-            qWarning() << "Material" << mat_name << "does not have n-data defined." << e.what();
-            return {};
-        }
+T OpticMaterial<T>::kWl() {
+    if (not loaded("wl defined.")) {
+        return {};
     }
-    return n_data.back().second;
+    return k_grid(k_data.size() - 1);
 }
 
 template<FloatingList T>
-T OpticMaterial<T>::kData() const {
-    if (k_data.empty()) {
-        try {
-            load_k();
-        } catch (std::runtime_error& e) {
-            qWarning() << "Material" << mat_name << "does not have k-data defined." << e.what();
-            return {};
-        }
+T OpticMaterial<T>::nData() {
+    if (not loaded("n-data defined.")) {
+        return {};
     }
-    return k_data.back().second;
+    return to_list(n_data.back().second);
+}
+
+template<FloatingList T>
+T OpticMaterial<T>::kData() {
+    if (not loaded("k-data defined.")) {
+        return {};
+    }
+    return to_list(k_data.back().second);
 }
 
 /*
@@ -61,58 +106,35 @@ T OpticMaterial<T>::kData() const {
  */
 template <FloatingList T>
 void OpticMaterial<T>::load_nk() {
-    QString line;
-    QStringList ln_data;
     if (db_type == DbType::SOPRA) {
         // Load Sopra's n data
         QFile mat_file(path);
         if (not mat_file.open(QIODevice::ReadOnly)) {
             // Use site-packages db instead of source repo db to skip this high cost file I/O
-            bool f_submat = false;
-            QDirIterator dit(path, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-            while (dit.hasNext()) {
-                QString subDirPath = dit.next();
-                QDir subDir(subDirPath);
-                QStringList filters;
-                filters << mat_name + ".MAT";
-                subDir.setNameFilters(filters);
-
-                if (QFileInfoList files = subDir.entryInfoList(QDir::Files); not files.isEmpty()) {
-                    f_submat = true;
-                    mat_file.setFileName(files.front().absolutePath());
-                    break;
-                }
-            }
-            if (not f_submat) {
+            const std::optional<QString> found = file_index ? file_index->find(mat_name + ".MAT") : std::nullopt;
+            if (not found) {
                 throw std::runtime_error("Cannot open file " + QFileInfo(mat_file).filePath().toStdString());
             }
-        }
-        QTextStream mat_stream(&mat_file);
-        QList<double> frac_wl;
-        QList<double> frac_n_data;
-        QList<double> frac_k_data;
-        mat_stream.readLine();  // VERSION
-        mat_stream.readLine();  // FORMAT
-        const QString points = mat_stream.readLine();  // POINTS
-        const QStringList points_data = points.split('*', Qt::SkipEmptyParts);  // skip trailing asterisk
-        if (points_data.length() not_eq 2) {  // if Qt::KeepEmptyParts, length should equal 3
-            throw std::runtime_error("Error parsing file " + QFileInfo(mat_file).filePath().toStdString());
-        }
-        const std::size_t n_points = points_data.back().toULong();
-        for (std::size_t i = 0; i < n_points; i++) {
-            line = mat_stream.readLine();
-            ln_data = line.split('*', Qt::SkipEmptyParts);
-            if (ln_data.length() not_eq 5) {
-                throw std::runtime_error("Error parsing file " + QFileInfo(mat_file).filePath().toStdString());
+            mat_file.setFileName(*found);
+            if (not mat_file.open(QIODevice::ReadOnly)) {
+                throw std::runtime_error("Cannot open file " + found->toStdString());
             }
-            frac_wl.emplace_back(ln_data.at(3).toDouble());
-            frac_n_data.emplace_back(ln_data.at(4).toDouble());
-            frac_k_data.emplace_back(ln_data.back().toDouble());
         }
+        const std::string file_path = QFileInfo(mat_file).filePath().toStdString();
+        const QByteArray bytes = mat_file.readAll();
         mat_file.close();
-        wavelengths.emplace_back(1, frac_wl);
-        n_data.emplace_back(1, frac_n_data);
-        k_data.emplace_back(1, frac_k_data);
+        Utils::NumericParser parser({bytes.constData(), static_cast<std::size_t>(bytes.size())}, file_path);
+        parser.skip_lines(2);  // VERSION, FORMAT
+        const std::vector<std::string_view> points_data = parser.read_fields('*');  // POINTS*  n*
+        if (points_data.size() not_eq 2) {
+            throw std::runtime_error(std::format("{}:{}: expected POINTS*n*", file_path, parser.line_number()));
+        }
+        const std::size_t n_points = parser.parse<std::size_t>(points_data.back());
+        // DATA1*unit*wavelength*n*k*
+        std::vector<QList<double>> columns = read_list_columns(parser, {2, 3, 4}, 5, '*', n_points);
+        wavelengths.emplace_back(1, intern(columns.front()));
+        n_data.emplace_back(1, store(std::move(columns.at(1))));
+        k_data.emplace_back(1, store(std::move(columns.back())));
     } else if (db_type == DbType::SOLCORE) {
         // Load Solcore's n data
     } else if (db_type == DbType::DF) {
@@ -146,6 +168,7 @@ void OpticMaterial<T>::load_nk() {
                 wls.front().second[rc - 2] = cell->value().toDouble() * 1e-9;
             }  // qDebug() << "Empty cell at Row " << rc << " Column " << 0;
         }
+        wavelengths.emplace_back(1, intern(wls.front().second));
         // Table format has been checked in readDfDb()
         for (int cc = 2; cc < maxCol; cc += 2) {
             const QStringList mat_name_list = wsheet->cellAt(1, cc)->readValue().toString().split('_');
@@ -166,8 +189,8 @@ void OpticMaterial<T>::load_nk() {
                         k_list[rc - 2] = cell->readValue().toDouble();
                     }
                 }
-                n_data.emplace_back(fraction, n_list);
-                k_data.emplace_back(fraction, k_list);
+                n_data.emplace_back(fraction, store(std::move(n_list)));
+                k_data.emplace_back(fraction, store(std::move(k_list)));
             }
         }
     } else {
@@ -175,5 +198,89 @@ void OpticMaterial<T>::load_nk() {
     }
 }
 
+template<FloatingList T>
+void OpticMaterial<T>::set_single_precision(const bool single_precision) {
+    this->single_precision = single_precision;
+    for (QList<std::pair<double, Values>> *data : {&n_data, &k_data}) {
+        for (Values &values : *data | std::views::values) {
+            values = store(to_list(values));
+        }
+    }
+    n_pchip.reset();
+    k_pchip.reset();
+    SpectralCache<T>::instance().remove(this);
+}
+
+template<FloatingList T>
+void OpticMaterial<T>::replace(OpticMaterial &&other) {
+    release_grids();
+    db_type = other.db_type;
+    path = std::move(other.path);
+    file_index = std::move(other.file_index);
+    wavelengths = std::exchange(other.wavelengths, {});
+    n_data = std::exchange(other.n_data, {});
+    k_data = std::exchange(other.k_data, {});
+    k_wavelengths = std::exchange(other.k_wavelengths, {});
+    single_precision = other.single_precision;
+    interpolation = other.interpolation;
+    n_pchip = std::exchange(other.n_pchip, std::nullopt);
+    k_pchip = std::exchange(other.k_pchip, std::nullopt);
+    model = std::move(other.model);
+    mixing = std::exchange(other.mixing, std::nullopt);
+    // The pins of this object stay, its bytes and interpolated spectra are outdated.
+    MaterialCache<T>::instance().forget(this);
+    SpectralCache<T>::instance().remove(this);
+}
+
+template<FloatingList T>
+void OpticMaterial<T>::set_interpolation(const Interpolation interpolation) {
+    if (this->interpolation not_eq interpolation) {
+        this->interpolation = interpolation;
+        SpectralCache<T>::instance().remove(this);
+    }
+}
+
+template<FloatingList T>
+void OpticMaterial<T>::unload_nk() {
+    if (not reloadable()) {
+        return;
+    }
+    release_grids();
+    n_data.clear();
+    k_data.clear();
+    n_pchip.reset();
+    k_pchip.reset();
+}
+
+template<FloatingList T>
+void OpticMaterial<T>::reload_nk() {
+    unload_nk();
+    SpectralCache<T>::instance().remove(this);
+}
+
+template<FloatingList T>
+std::size_t OpticMaterial<T>::memory_usage() const {
+    std::size_t bytes = 0;
+    for (const QList<std::pair<double, Values>> *data : {&n_data, &k_data}) {
+        for (const Values &values : *data | std::views::values) {
+            bytes += std::visit([](const auto &list) -> std::size_t {
+                return list.size() * sizeof(typename std::remove_cvref_t<decltype(list)>::value_type);
+            }, values);
+        }
+    }
+    for (const std::optional<Utils::Math::Pchip<typename T::value_type>> *pchip : {&n_pchip, &k_pchip}) {
+        if (*pchip) {
+            bytes += (*pchip)->memory_usage();
+        }
+    }
+    return bytes;
+}
+
+template<FloatingList T>
+void OpticMaterial<T>::accessed() {
+    if (reloadable()) {
+        MaterialCache<T>::instance().touch(this);
+    }
+}
 
 template class OpticMaterial<QList<double>>;
@@ -5,10 +5,20 @@
 #ifndef SUISAPP_OPTIC_MATERIAL_H
 #define SUISAPP_OPTIC_MATERIAL_H
 
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <unordered_map>
+#include <variant>
 #include <QDebug>
 #include <QList>
 #include <QString>
 
+#include "DielectricModel.h"
+#include "FileIndex.h"
+#include "GridRegistry.h"
+#include "SpectralCache.h"
 #include "Global.h"
 #include "utils/Math.h"
 
@@ -17,7 +27,14 @@ enum class DbType {
     SOLCORE,
     SOPRA,
     DF,
-    GCL
+    GCL,
+    MODEL  // analytic DielectricModel, no data file
+};
+
+// Interpolation of n and k in wavelength, see OpticMaterial::set_interpolation
+enum class Interpolation {
+    LINEAR,
+    PCHIP  // monotone cubic, see Utils::Math::Pchip
 };
 
 template<typename T1, typename T2>
@@ -38,59 +55,334 @@ concept PairVector = requires(T1 a) {
 template<FloatingList T>
 class OpticMaterial {
 public:
-    OpticMaterial(QString mat_name, const DbType db_type, QString path) : mat_name(std::move(mat_name)),
-                                                                          db_type(db_type),
-                                                                          path(std::move(path)) {}
+    // file_index resolves the data file by name if path cannot be opened
+    OpticMaterial(QString mat_name, const DbType db_type, QString path,
+                  std::shared_ptr<const FileIndex> file_index = nullptr) : mat_name(std::move(mat_name)),
+                                                                           db_type(db_type),
+                                                                           path(std::move(path)),
+                                                                           file_index(std::move(file_index)) {}
+    OpticMaterial(QString mat_name,
+                  std::shared_ptr<const DielectricModel<typename T::value_type>> model) : mat_name(std::move(mat_name)),
+                                                                                        db_type(DbType::MODEL),
+                                                                                        model(std::move(model)) {}
+    // Composition-resolved data, e.g. Solcore's per-fraction n and k files; sorted by fraction here.
+    OpticMaterial(QString mat_name, QList<std::pair<double, T>> n_wl, QList<std::pair<double, T>> n_data,
+                  QList<std::pair<double, T>> k_wl, QList<std::pair<double, T>> k_data);
+    ~OpticMaterial();
 
     [[nodiscard]] QString name() const;
-    [[nodiscard]] T wl() const;
-    [[nodiscard]] T nData() const;
-    [[nodiscard]] T kData() const;
+    // The tabulated data, loaded on demand as by n_interpolated()
+    [[nodiscard]] T wl();
+    // The wavelengths of kData(), which differ from wl() if k is tabulated on its own grid (Solcore)
+    [[nodiscard]] T kWl();
+    [[nodiscard]] T nData();
+    [[nodiscard]] T kData();
 
     // The original Python implementation does really late evaluations. When executing calculate_rat, it evaluates
     // the get_indices() function, which evaluates the interpolation methods depending on wavelengths n_interpolated
     // and k_interpolated of the material class. In the interpolation methods, it loads n_data (a vstack of wl and n)
     // and k_data (a vstack of wl and k) from the TXT files and then does interpolation.
     void load_nk();
+    /*
+     * Frees the n, k data of a reloadable material (one read from a database file); the next access loads them again.
+     * MaterialCache calls it to keep the loaded data within its budget.
+     */
+    void unload_nk();
+    /*
+     * Discards the n, k data and everything interpolated from them after the database file has changed: a reloadable
+     * material reads the file again on the next access.
+     */
+    void reload_nk();
+    // Replaces the data of a composition-resolved material in place, as the constructor sets them.
+    void set_nk(QList<std::pair<double, T>> n_wl, QList<std::pair<double, T>> n_data,
+                QList<std::pair<double, T>> k_wl, QList<std::pair<double, T>> k_data);
+    /*
+     * Takes over the data source, n, k data and settings of other, a newer import of the same material, so that
+     * everything referring to this object (e.g. devices that pin it) sees the new data. other is left empty.
+     */
+    void replace(OpticMaterial &&other);
+    [[nodiscard]] bool reloadable() const {
+        return (db_type == DbType::SOPRA or db_type == DbType::DF) and not path.isEmpty();
+    }
+    // Bytes of the n, k data and their PCHIP coefficients, without the shared wavelength grids
+    [[nodiscard]] std::size_t memory_usage() const;
+
+    /*
+     * Stores n and k (loaded or to be loaded) in single precision, halving their memory. They are still interpolated
+     * and returned in the precision of T; tabulated data rarely have more than 6 significant digits.
+     */
+    void set_single_precision(bool single_precision);
+
+    /*
+     * Interpolation of n_interpolated() and k_interpolated() in wavelength. Integrated over wavelength, PCHIP on a
+     * smooth spectrum tabulated at a quarter of the points is more accurate than linear interpolation. Composition
+     * blends (nk_composition) stay bilinear.
+     */
+    void set_interpolation(Interpolation interpolation);
+
+    /*
+     * Mixes the tabulated n, k data with a DielectricModel in distinct spectral regions, see Mixing.
+     */
+    void set_model(std::shared_ptr<const DielectricModel<typename T::value_type>> dielectric_model,
+                   const Mixing<typename T::value_type> &model_mixing) {
+        model = std::move(dielectric_model);
+        mixing = model_mixing;
+        SpectralCache<T>::instance().remove(this);
+    }
 
     template<FloatingList U>
     T n_interpolated(U &&x) {
-        if (wavelengths.empty() or n_data.empty()) {
-            try {
-                load_nk();
-            } catch (std::runtime_error& e) {
-                qWarning() << "Material" << mat_name << "does not have n-data defined. Returning \"ones\": " << e.what();
-                T ret(x.size(), 1);
-                return ret;
-            }
+        if (db_type == DbType::MODEL) {
+            return model_data(x, false);
+        }
+        if (not loaded("n-data defined. Returning \"ones\":")) {
+            T ret(x.size(), 1);
+            return ret;
+        }
+        if (model) {
+            return model_data(x, false, interpolate_nk(false, x));
         }
-        return Utils::Math::interp1_linear(wavelengths.back().second, n_data.back().second, std::forward<U>(x));
+        return interpolate_nk(false, x);
     }
 
     template<FloatingList U>
     T k_interpolated(U &&x) {
-        if (wavelengths.empty() or k_data.empty()) {
-            try {
-                load_nk();
-            } catch (std::runtime_error& e) {
-                qWarning() << "Material" << mat_name << "does not have k-data defined. Returning \"zeros\": " << e.what();
-                T ret(x.size(), 0);
-                return ret;
+        if (db_type == DbType::MODEL) {
+            return model_data(x, true);
+        }
+        if (not loaded("k-data defined. Returning \"zeros\":")) {
+            T ret(x.size(), 0);
+            return ret;
+        }
+        if (model) {
+            return model_data(x, true, interpolate_nk(true, x));
+        }
+        return interpolate_nk(true, x);
+    }
+
+    /*
+     * n and k at each composition fraction in fractions (e.g. a composition sweep or the slices of a graded layer) and
+     * each wavelength, interpolated bilinearly in composition and wavelength between the tabulated data, e.g. Solcore's
+     * per-fraction files. The bracketing fractions and wavelengths and their weights are found once per call (the
+     * wavelengths once per distinct grid of the data), so each point costs four multiply-adds. Compositions outside
+     * the tabulated range are clamped.
+     */
+    template<FloatingList U>
+    std::pair<std::vector<T>, std::vector<T>> nk_composition(const std::valarray<double> &fractions,
+                                                             const U &wavelength) {
+        if (db_type == DbType::MODEL) {
+            return {std::vector<T>(fractions.size(), model_data(wavelength, false)),
+                    std::vector<T>(fractions.size(), model_data(wavelength, true))};
+        }
+        if (n_data.empty() or k_data.empty()) {
+            load_nk();
+        }
+        accessed();
+        std::pair<std::vector<T>, std::vector<T>> nk{bilinear(false, fractions, wavelength),
+                                                     bilinear(true, fractions, wavelength)};
+        if (model) {
+            using V = typename T::value_type;
+            std::valarray<V> wl(wavelength.size());
+            std::ranges::copy(wavelength, std::begin(wl));
+            const std::valarray<std::complex<V>> model_nk = model->nk(wl);
+            const std::valarray<V> weight = mixing ? mixing->weight(wl) : std::valarray<V>(1, wl.size());
+            for (std::size_t s = 0; s < fractions.size(); s++) {
+                for (std::size_t j = 0; j < wl.size(); j++) {
+                    nk.first.at(s)[j] = (1 - weight[j]) * nk.first.at(s)[j] + weight[j] * model_nk[j].real();
+                    nk.second.at(s)[j] = (1 - weight[j]) * nk.second.at(s)[j] + weight[j] * model_nk[j].imag();
+                }
+            }
+        }
+        return nk;
+    }
+
+    // n and k at a single composition fraction, see above
+    template<FloatingList U>
+    std::pair<T, T> nk_composition(const double fraction, const U &wavelength) {
+        auto [n, k] = nk_composition(std::valarray<double>{fraction}, wavelength);
+        return {std::move(n.front()), std::move(k.front())};
+    }
+
+    /*
+     * Complex refractive index n + 1j * k at each composition fraction in fractions (e.g. the slices of a graded
+     * layer) and each wavelength, see nk_composition.
+     */
+    template<FloatingList U>
+    std::vector<std::valarray<std::complex<typename T::value_type>>> nk_graded(const std::valarray<double> &fractions,
+                                                                               const U &wavelength) {
+        const auto [n, k] = nk_composition(fractions, wavelength);
+        std::vector<std::valarray<std::complex<typename T::value_type>>> nk(fractions.size());
+        for (std::size_t s = 0; s < fractions.size(); s++) {
+            nk.at(s).resize(wavelength.size());
+            for (std::size_t j = 0; j < wavelength.size(); j++) {
+                nk.at(s)[j] = {n.at(s)[j], k.at(s)[j]};
             }
         }
-        return Utils::Math::interp1_linear(wavelengths.back().second, k_data.back().second, std::forward<U>(x));
+        return nk;
     }
 
 private:
+    // n or k at one fraction; QList<float> with single-precision storage
+    using Values = std::variant<T, QList<float>>;
+
     QString mat_name;
     DbType db_type;
     QString path;
+    std::shared_ptr<const FileIndex> file_index;
     // Design tradeoff: one-time file I/O and no searching time cost but higher memory space cost
     // Alternative design: lazy loading n/k data when interpolation needed
     // No matter using the raw data or the interpolated data, we have to store the raw data.
+    // The wavelength grids are interned by GridRegistry and must only be read.
     QList<std::pair<double, T>> wavelengths;
-    QList<std::pair<double, T>> n_data;
-    QList<std::pair<double, T>> k_data;
+    QList<std::pair<double, Values>> n_data;
+    QList<std::pair<double, Values>> k_data;
+    // Only set when k is tabulated on other wavelengths than n (Solcore)
+    QList<std::pair<double, T>> k_wavelengths;
+    bool single_precision = false;
+    Interpolation interpolation = Interpolation::LINEAR;
+    // PCHIP coefficients of the last tabulated n and k, built on first use
+    std::optional<Utils::Math::Pchip<typename T::value_type>> n_pchip;
+    std::optional<Utils::Math::Pchip<typename T::value_type>> k_pchip;
+    // Either the only source of n, k (DbType::MODEL), or mixed with the tabulated data
+    std::shared_ptr<const DielectricModel<typename T::value_type>> model;
+    std::optional<Mixing<typename T::value_type>> mixing;
+
+    // Reports an access of the n, k data to MaterialCache.
+    void accessed();
+
+    /*
+     * Loads the n, k data unless they are loaded and reports the access, as every reader of the data must. If they
+     * cannot be loaded, warns that the material does not have what defined and returns false.
+     */
+    bool loaded(const char *what) {
+        if (wavelengths.empty() or n_data.empty() or k_data.empty()) {
+            try {
+                load_nk();
+            } catch (std::runtime_error& e) {
+                qWarning() << "Material" << mat_name << "does not have" << what << e.what();
+                return false;
+            }
+        }
+        accessed();
+        return true;
+    }
+
+    const T &n_grid(const qsizetype i) const {
+        return wavelengths.size() == n_data.size() ? wavelengths[i].second : wavelengths.front().second;
+    }
+
+    const T &k_grid(const qsizetype i) const {
+        const QList<std::pair<double, T>> &k_wl = k_wavelengths.empty() ? wavelengths : k_wavelengths;
+        return k_wl.size() == k_data.size() ? k_wl[i].second : k_wl.front().second;
+    }
+
+    static T intern(const T &grid) {
+        return GridRegistry<T>::instance().intern(grid);
+    }
+
+    // Gives the wavelength grids back to GridRegistry and clears them.
+    void release_grids() {
+        for (QList<std::pair<double, T>> *grids : {&wavelengths, &k_wavelengths}) {
+            for (T &grid : *grids | std::views::values) {
+                GridRegistry<T>::instance().release(grid);
+            }
+            grids->clear();
+        }
+    }
+
+    Values store(T values) const {
+        if (single_precision) {
+            return QList<float>(values.cbegin(), values.cend());
+        }
+        return values;
+    }
+
+    static T to_list(const Values &values) {
+        return std::visit([](const auto &list) -> T {
+            return T(list.cbegin(), list.cend());
+        }, values);
+    }
+
+    // Linear interpolation of y on the grid x at xi, in the precision of T
+    template<FloatingList U>
+    static T interpolate(const T &x, const Values &y, const U &xi) {
+        return std::visit([&x, &xi](const auto &y_list) -> T {
+            return Utils::Math::interp1_linear(x, y_list, xi);
+        }, y);
+    }
+
+    // The last tabulated n (imag_part = false) or k (imag_part = true) at x
+    template<FloatingList U>
+    T interpolate_nk(const bool imag_part, const U &x) {
+        const T &grid = imag_part ? k_grid(k_data.size() - 1) : n_grid(n_data.size() - 1);
+        const Values &values = imag_part ? k_data.back().second : n_data.back().second;
+        if (interpolation == Interpolation::PCHIP) {
+            std::optional<Utils::Math::Pchip<typename T::value_type>> &pchip = imag_part ? k_pchip : n_pchip;
+            if (not pchip) {
+                pchip = std::visit([&grid](const auto &y) -> Utils::Math::Pchip<typename T::value_type> {
+                    return {grid, y};
+                }, values);
+            }
+            return pchip->template evaluate<T>(x);
+        }
+        return interpolate(grid, values, x);
+    }
+
+    // n (imag_part = false) or k (imag_part = true) of the tabulated fractions, interpolated bilinearly at fractions and
+    // wavelength
+    template<FloatingList U>
+    std::vector<T> bilinear(const bool imag_part, const std::valarray<double> &fractions, const U &wavelength) const {
+        using V = typename T::value_type;
+        const QList<std::pair<double, Values>> &data = imag_part ? k_data : n_data;
+        std::vector<double> tabulated(data.size());
+        std::ranges::copy(data | std::views::keys, tabulated.begin());
+        const Utils::Math::LinearStencil<V> composition = Utils::Math::linear_stencil<V>(tabulated, fractions);
+        // Interned grids share their storage, so its address identifies a grid.
+        std::unordered_map<const V *, Utils::Math::LinearStencil<V>> on_grid;
+        const auto stencil = [this, imag_part, &wavelength, &on_grid](const std::size_t i) -> const auto & {
+            const T &grid = imag_part ? k_grid(i) : n_grid(i);
+            auto it = on_grid.find(std::ranges::data(grid));
+            if (it == on_grid.end()) {
+                it = on_grid.emplace(std::ranges::data(grid), Utils::Math::linear_stencil<V>(grid, wavelength)).first;
+            }
+            return it->second;
+        };
+        std::vector<T> ret(fractions.size(), T(wavelength.size()));
+        for (std::size_t s = 0; s < fractions.size(); s++) {
+            const std::size_t lo = composition.lower.at(s);
+            const std::size_t hi = composition.upper.at(s);
+            const V t = composition.weight.at(s);
+            const Utils::Math::LinearStencil<V> &lo_wl = stencil(lo);
+            const Utils::Math::LinearStencil<V> &hi_wl = stencil(hi);
+            T &values = ret.at(s);
+            std::visit([&](const auto &lo_y, const auto &hi_y) -> void {
+                for (std::size_t j = 0; j < values.size(); j++) {
+                    const V lo_v = (1 - lo_wl.weight[j]) * static_cast<V>(lo_y[lo_wl.lower[j]]) +
+                                   lo_wl.weight[j] * static_cast<V>(lo_y[lo_wl.upper[j]]);
+                    const V hi_v = (1 - hi_wl.weight[j]) * static_cast<V>(hi_y[hi_wl.lower[j]]) +
+                                   hi_wl.weight[j] * static_cast<V>(hi_y[hi_wl.upper[j]]);
+                    values[j] = (1 - t) * lo_v + t * hi_v;
+                }
+            }, data[lo].second, data[hi].second);
+        }
+        return ret;
+    }
+
+    // n (imag_part = false) or k (imag_part = true) of the model, blended with tab if given.
+    template<FloatingList U>
+    T model_data(const U &x, const bool imag_part, const T &tab = {}) const {
+        using V = typename T::value_type;
+        std::valarray<V> wl(x.size());
+        std::ranges::copy(x, std::begin(wl));
+        const std::valarray<std::complex<V>> nk = model->nk(wl);
+        const std::valarray<V> weight = mixing ? mixing->weight(wl) : std::valarray<V>(1, wl.size());
+        T ret(x.size());
+        for (std::size_t i = 0; i < wl.size(); i++) {
+            const V model_v = imag_part ? nk[i].imag() : nk[i].real();
+            ret[i] = tab.empty() ? model_v : (1 - weight[i]) * tab[i] + weight[i] * model_v;
+        }
+        return ret;
+    }
 };
 
 #endif  // SUISAPP_OPTIC_MATERIAL_H
@@ -2,43 +2,413 @@
 // Created by Yihua Liu on 2024/6/11.
 //
 
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
 #include <boost/property_tree/ini_parser.hpp>
+#include <QDebug>
 #include <QFileInfo>
 
 #include "ParameterSystem.h"
 
+namespace {
+    constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+    // Alloys of alloys and formulas of formulas nest only a few levels; anything deeper is a cycle.
+    constexpr int max_depth = 32;
+
+    /*
+     * Reads the sections (materials) of a Solcore INI file as (section, key, value) triples.
+     */
+    auto read_ini_entries(const QString& path) -> std::vector<std::tuple<QString, QString, QString>> {
+        std::vector<std::tuple<QString, QString, QString>> entries;
+        // Warning: Although backslash is a special character in INI files,  most Windows applications don't escape
+        // backslashes (\) in file paths. Solcore config files on Windows must not contain backslashes.
+        if (not QFileInfo::exists(path)) {
+            qWarning() << "File not found: " << path;
+            return entries;
+        }
+        boost::property_tree::ptree mat_par_ptree;
+        try {
+            boost::property_tree::ini_parser::read_ini(path.toStdString(), mat_par_ptree);
+        } catch (const boost::property_tree::ini_parser_error& e) {
+            qWarning() << "Error reading INI file << " << path << ": " << e.what();
+            return entries;
+        }
+        for (const std::pair<const std::string, boost::property_tree::basic_ptree<std::string, std::string>>& section : mat_par_ptree) {
+            const QString group = QString::fromStdString(section.first);
+            for (const std::pair<const std::string, boost::property_tree::basic_ptree<std::string, std::string>>& elem : section.second) {
+                entries.emplace_back(group, QString::fromStdString(elem.first), QString::fromStdString(elem.second.data()));
+            }
+        }
+        return entries;
+    }
+}
+
 ParameterSystem::ParameterSystem(const QMap<QString, QString>& par_map, const QString& root_path) {
+    std::vector<std::tuple<qsizetype, qsizetype, QString>> values;
     for (const std::pair<QString, QString>& par_pair : par_map.asKeyValueRange()) {
-        const QString& par_key = par_pair.first;
-        if (par_key not_eq "calculables") {
-            QString par_path = par_pair.second;
-            par_path.replace("SOLCORE_ROOT", root_path);
-            // Warning: Although backslash is a special character in INI files,  most Windows applications don't escape
-            // backslashes (\) in file paths. QSettings always treats backslash as a special character and provides no
-            // API for reading or writing such entries.
-            // You have to replace all backslashes in your solcore config file on Windows!
-            if (not QFileInfo::exists(par_path)) {
-                qWarning() << "File not found: " << par_path;
+        if (par_pair.first == "calculables") {
+            continue;
+        }
+        QString par_path = par_pair.second;
+        par_path.replace("SOLCORE_ROOT", root_path);
+        for (const auto& [group, key, value] : read_ini_entries(par_path)) {
+            qsizetype material;
+            if (const auto it = material_index.constFind(group); it not_eq material_index.cend()) {
+                material = it.value();
             } else {
-                boost::property_tree::ptree mat_par_ptree;
-                try {
-                    boost::property_tree::ini_parser::read_ini(par_path.toStdString(), mat_par_ptree);
-                    for (const std::pair<const std::string, boost::property_tree::basic_ptree<std::string, std::string>>& section : mat_par_ptree) {
-                        const QString group = QString::fromStdString(section.first);
-                        par_settings.beginGroup(group);
-                        for (const std::pair<const std::string, boost::property_tree::basic_ptree<std::string, std::string>>& elem : section.second) {
-                            par_settings.setValue(QString::fromStdString(elem.first), QString::fromStdString(elem.second.data()));
-                        }
-                        par_settings.endGroup();
-                    }
-                } catch (const boost::property_tree::ini_parser_error& e) {
-                    qWarning() << "Error reading INI file << " << par_path << ": " << e.what();
-                }
+                material = material_names.size();
+                material_index.insert(group, material);
+                material_names.append(group);
             }
+            values.emplace_back(material, internKey(key), value);
         }
     }
+    x_key = internKey("x");
+    parent_keys[0] = internKey("parent0");
+    parent_keys[1] = internKey("parent1");
+    // Compiling interns the keys the formulas refer to, so it must precede the allocation of the table.
+    std::vector<std::pair<qsizetype, Program>> programs;
+    if (par_map.contains("calculables")) {
+        QString calc_path = par_map.value("calculables");
+        calc_path.replace("SOLCORE_ROOT", root_path);
+        for (const auto& [group, key, formula] : read_ini_entries(calc_path)) {
+            try {
+                programs.emplace_back(internKey(key), compile(formula));
+            } catch (const std::runtime_error& e) {
+                qWarning() << "Calculable" << key << "in section" << group << "ignored:" << e.what();
+            }
+        }
+    }
+    const std::size_t num_keys = key_names.size();
+    numbers.assign(material_names.size() * num_keys, NaN);
+    texts.assign(material_names.size() * num_keys, {});
+    for (auto& [material, key, value] : values) {
+        const std::size_t cell = material * num_keys + key;
+        const QByteArray utf8 = value.trimmed().toUtf8();
+        const char *last = utf8.constData() + utf8.size();
+        double number;
+        // A number, optionally followed by its unit
+        if (const auto [ptr, ec] = std::from_chars(utf8.constData(), last, number);
+                ec == std::errc() and (ptr == last or *ptr == ' ' or *ptr == '\t')) {
+            numbers.at(cell) = number;
+            texts.at(cell) = QString::fromUtf8(ptr, last - ptr).trimmed();
+        } else {
+            texts.at(cell) = std::move(value);
+        }
+    }
+    calculables.resize(num_keys);
+    for (auto& [key, program] : programs) {
+        calculables.at(key) = std::move(program);
+    }
 }
 
 bool ParameterSystem::isComposition(const QString &mat_name, const QString& key) const {
-    return par_settings.contains(mat_name + "/" + key);
+    const std::optional<qsizetype> material = materialIndex(mat_name);
+    const std::optional<qsizetype> key_id = keyIndex(key);
+    return material and key_id and (not std::isnan(number(*material, *key_id)) or
+                                    not text(*material, *key_id).isEmpty());
+}
+
+std::optional<qsizetype> ParameterSystem::materialIndex(const QString& mat_name) const {
+    if (const auto it = material_index.constFind(mat_name); it not_eq material_index.cend()) {
+        return it.value();
+    }
+    return std::nullopt;
+}
+
+std::optional<qsizetype> ParameterSystem::keyIndex(const QString& key) const {
+    if (const auto it = key_index.constFind(key); it not_eq key_index.cend()) {
+        return it.value();
+    }
+    return std::nullopt;
+}
+
+QString ParameterSystem::materialName(const qsizetype material) const {
+    return material_names.at(material);
+}
+
+QString ParameterSystem::keyName(const qsizetype key) const {
+    return key_names.at(key);
+}
+
+double ParameterSystem::number(const qsizetype material, const qsizetype key) const {
+    return numbers.at(material * key_names.size() + key);
+}
+
+QString ParameterSystem::text(const qsizetype material, const qsizetype key) const {
+    return texts.at(material * key_names.size() + key);
+}
+
+std::valarray<double> ParameterSystem::evaluate(const qsizetype material, const qsizetype key,
+                                                const QHash<QString, std::valarray<double>>& composition,
+                                                const double T) const {
+    std::size_t size = 1;
+    for (const std::valarray<double>& fractions : composition) {
+        if (size not_eq 1 and fractions.size() not_eq size) {
+            throw std::invalid_argument("All compositions must have the same number of values.");
+        }
+        size = fractions.size();
+    }
+    if (material < 0 or material >= material_names.size() or key < 0 or key >= key_names.size()) {
+        throw std::out_of_range("Material or parameter index out of range.");
+    }
+    return evaluate(material, key, composition, T, size, 0);
+}
+
+qsizetype ParameterSystem::internKey(const QString& key) {
+    if (const auto it = key_index.constFind(key); it not_eq key_index.cend()) {
+        return it.value();
+    }
+    const qsizetype index = key_names.size();
+    key_index.insert(key, index);
+    key_names.append(key);
+    return index;
+}
+
+/*
+ * Shunting-yard compilation of a formula into a postfix program.
+ */
+ParameterSystem::Program ParameterSystem::compile(const QString& formula) {
+    struct Pending {
+        OpCode op;
+        int precedence;  // 0 for "(" and functions
+        bool function;
+    };
+    const std::string source = formula.toStdString();
+    Program program;
+    std::vector<Pending> pending;
+    const auto flush = [&program, &pending](const int precedence, const bool right_assoc) -> void {
+        while (not pending.empty() and pending.back().precedence > 0 and
+               (pending.back().precedence > precedence or (pending.back().precedence == precedence and not right_assoc))) {
+            program.push_back({pending.back().op});
+            pending.pop_back();
+        }
+    };
+    const auto close = [&program, &pending, &formula]() -> void {
+        while (not pending.empty() and pending.back().precedence > 0) {
+            program.push_back({pending.back().op});
+            pending.pop_back();
+        }
+        if (pending.empty()) {
+            throw std::runtime_error("unbalanced parentheses in " + formula.toStdString());
+        }
+    };
+    bool operand_expected = true;
+    for (std::size_t pos = 0; pos < source.size();) {
+        const char c = source.at(pos);
+        if (c == ' ' or c == '\t') {
+            pos++;
+        } else if (std::isdigit(static_cast<unsigned char>(c)) or c == '.') {
+            double value;
+            const auto [ptr, ec] = std::from_chars(source.data() + pos, source.data() + source.size(), value);
+            if (ec not_eq std::errc() or not operand_expected) {
+                throw std::runtime_error("unexpected number in " + source);
+            }
+            program.push_back({OpCode::NUMBER, value});
+            pos = ptr - source.data();
+            operand_expected = false;
+        } else if (std::isalpha(static_cast<unsigned char>(c)) or c == '_') {
+            std::size_t end = pos;
+            while (end < source.size() and (std::isalnum(static_cast<unsigned char>(source.at(end))) or source.at(end) == '_')) {
+                end++;
+            }
+            const std::string name = source.substr(pos, end - pos);
+            pos = end;
+            if (not operand_expected) {
+                throw std::runtime_error("unexpected name " + name + " in " + source);
+            }
+            static const std::unordered_map<std::string, OpCode> functions = {
+                {"min", OpCode::MIN}, {"max", OpCode::MAX}, {"sqrt", OpCode::SQRT}, {"exp", OpCode::EXP},
+                {"log", OpCode::LOG}};
+            if (const auto it = functions.find(name); it not_eq functions.end()) {
+                while (pos < source.size() and source.at(pos) == ' ') {
+                    pos++;
+                }
+                if (pos == source.size() or source.at(pos) not_eq '(') {
+                    throw std::runtime_error("expected ( after " + name + " in " + source);
+                }
+                pending.push_back({it->second, 0, true});
+                pending.push_back({OpCode::ADD, 0, false});  // its "("
+                pos++;
+            } else if (name == "T") {
+                program.push_back({OpCode::TEMPERATURE});
+                operand_expected = false;
+            } else {
+                program.push_back({OpCode::PARAMETER, 0, internKey(QString::fromStdString(name))});
+                operand_expected = false;
+            }
+        } else if (c == '(') {
+            if (not operand_expected) {
+                throw std::runtime_error("unexpected ( in " + source);
+            }
+            pending.push_back({OpCode::ADD, 0, false});
+            pos++;
+        } else if (c == ')' or c == ',') {
+            if (operand_expected) {
+                throw std::runtime_error(std::string("unexpected ") + c + " in " + source);
+            }
+            close();
+            if (c == ')') {
+                pending.pop_back();  // "("
+                if (not pending.empty() and pending.back().function) {
+                    program.push_back({pending.back().op});
+                    pending.pop_back();
+                }
+            } else {
+                operand_expected = true;
+            }
+            pos++;
+        } else if (c == '-' and operand_expected) {
+            // A prefix operator has no left operand to reduce yet.
+            pending.push_back({OpCode::NEGATE, 3, false});
+            pos++;
+        } else if (not operand_expected and (c == '+' or c == '-' or c == '*' or c == '/' or c == '^')) {
+            const int precedence = c == '+' or c == '-' ? 1 : c == '^' ? 4 : 2;
+            flush(precedence, c == '^');
+            pending.push_back({c == '+' ? OpCode::ADD : c == '-' ? OpCode::SUBTRACT : c == '*' ? OpCode::MULTIPLY :
+                               c == '/' ? OpCode::DIVIDE : OpCode::POWER, precedence, false});
+            operand_expected = true;
+            pos++;
+        } else {
+            throw std::runtime_error(std::string("unexpected ") + c + " in " + source);
+        }
+    }
+    if (operand_expected) {
+        throw std::runtime_error("incomplete formula " + source);
+    }
+    flush(0, false);
+    if (not pending.empty()) {
+        throw std::runtime_error("unbalanced parentheses in " + source);
+    }
+    // Checks the arity of every instruction, including the commas of min and max.
+    std::ptrdiff_t depth = 0;
+    for (const Instruction& instruction : program) {
+        switch (instruction.op) {
+            case OpCode::NUMBER:
+            case OpCode::PARAMETER:
+            case OpCode::TEMPERATURE:
+                depth++;
+                break;
+            case OpCode::NEGATE:
+            case OpCode::SQRT:
+            case OpCode::EXP:
+            case OpCode::LOG:
+                break;
+            default:
+                depth--;
+        }
+        if (depth < 1) {
+            throw std::runtime_error("missing operand in " + source);
+        }
+    }
+    if (depth not_eq 1) {
+        throw std::runtime_error("wrong number of arguments in " + source);
+    }
+    return program;
+}
+
+std::valarray<double> ParameterSystem::evaluate(const qsizetype material, const qsizetype key,
+                                                const QHash<QString, std::valarray<double>>& composition,
+                                                const double T, const std::size_t size, const int depth) const {
+    if (depth > max_depth) {
+        qWarning() << "Parameter" << key_names.at(key) << "of" << material_names.at(material) << "is cyclic.";
+        return std::valarray<double>(NaN, size);
+    }
+    const std::size_t row = material * key_names.size();
+    const Program& program = calculables.at(key);
+    if (const QString& element = texts.at(row + x_key); not element.isEmpty()) {
+        // Like Solcore, a calculable the alloy does not tabulate is evaluated for the alloy itself, i.e. from the
+        // interpolated inputs; interpolating the parents' results instead would smear out e.g. a min() crossover.
+        if (std::isnan(numbers.at(row + key)) and not program.empty()) {
+            return run(program, material, composition, T, size, depth);
+        }
+        const std::optional<qsizetype> parent0 = materialIndex(texts.at(row + parent_keys[0]));
+        const std::optional<qsizetype> parent1 = materialIndex(texts.at(row + parent_keys[1]));
+        if (not parent0 or not parent1) {
+            return std::valarray<double>(NaN, size);
+        }
+        const std::valarray<double> x = composition.contains(element) ? composition.value(element) :
+                std::valarray<double>(0., size);
+        const double bowing = std::isnan(numbers.at(row + key)) ? 0 : numbers.at(row + key);
+        return (1. - x) * evaluate(*parent0, key, composition, T, size, depth + 1) +
+               x * evaluate(*parent1, key, composition, T, size, depth + 1) - x * (1. - x) * bowing;
+    }
+    if (not std::isnan(numbers.at(row + key))) {
+        return std::valarray<double>(numbers.at(row + key), size);
+    }
+    if (program.empty()) {
+        return std::valarray<double>(NaN, size);
+    }
+    return run(program, material, composition, T, size, depth);
+}
+
+std::valarray<double> ParameterSystem::run(const Program& program, const qsizetype material,
+                                           const QHash<QString, std::valarray<double>>& composition, const double T,
+                                           const std::size_t size, const int depth) const {
+    std::vector<std::valarray<double>> stack;
+    for (const Instruction& instruction : program) {
+        std::valarray<double> rhs;
+        switch (instruction.op) {
+            case OpCode::NUMBER:
+                stack.emplace_back(instruction.number, size);
+                continue;
+            case OpCode::PARAMETER:
+                stack.push_back(evaluate(material, instruction.key, composition, T, size, depth + 1));
+                continue;
+            case OpCode::TEMPERATURE:
+                stack.emplace_back(T, size);
+                continue;
+            case OpCode::NEGATE:
+                stack.back() = -stack.back();
+                continue;
+            case OpCode::SQRT:
+                stack.back() = std::sqrt(stack.back());
+                continue;
+            case OpCode::EXP:
+                stack.back() = std::exp(stack.back());
+                continue;
+            case OpCode::LOG:
+                stack.back() = std::log(stack.back());
+                continue;
+            default:
+                rhs = std::move(stack.back());
+                stack.pop_back();
+        }
+        std::valarray<double>& lhs = stack.back();
+        switch (instruction.op) {
+            case OpCode::ADD:
+                lhs += rhs;
+                break;
+            case OpCode::SUBTRACT:
+                lhs -= rhs;
+                break;
+            case OpCode::MULTIPLY:
+                lhs *= rhs;
+                break;
+            case OpCode::DIVIDE:
+                lhs /= rhs;
+                break;
+            case OpCode::POWER:
+                lhs = std::pow(lhs, rhs);
+                break;
+            case OpCode::MIN:
+                for (std::size_t i = 0; i < size; i++) {
+                    lhs[i] = std::fmin(lhs[i], rhs[i]);
+                }
+                break;
+            case OpCode::MAX:
+                for (std::size_t i = 0; i < size; i++) {
+                    lhs[i] = std::fmax(lhs[i], rhs[i]);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return stack.back();
 }
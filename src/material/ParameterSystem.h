@@ -5,15 +5,85 @@
 #ifndef SUISAPP_PARAMETERSYSTEM_H
 #define SUISAPP_PARAMETERSYSTEM_H
 
-#include <QSettings>
+#include <optional>
+#include <valarray>
+#include <vector>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
 
+/*
+ * Solcore's material parameters, compiled into one table when the parameter files are read. Material names and
+ * parameter keys are interned into indices, so a query is an array access rather than a string lookup; numbers are
+ * parsed once ("1.424 eV" is 1.424 with unit "eV"), everything else ("parent0 = GaAs") is kept as text.
+
+ * The file under the "calculables" key holds formulas for parameters that are derived from others, one INI entry per
+ * parameter in any section, e.g. "band_gap = min(Eg0_Gamma - alpha_Gamma * T ^ 2 / (T + beta_Gamma), Eg0_X)". A
+ * formula is made of numbers, parameter keys, the temperature T in K, + - * / ^, parentheses and the functions
+ * min, max, sqrt, exp and log. Formulas are compiled to postfix programs once, so evaluating them for many
+ * compositions costs no parsing or string lookups either.
+ */
 class ParameterSystem {
 public:
     ParameterSystem(const QMap<QString, QString>& par_map, const QString& root_path);
     [[nodiscard]] bool isComposition(const QString& mat_name, const QString& key) const;
 
+    [[nodiscard]] std::optional<qsizetype> materialIndex(const QString& mat_name) const;
+    [[nodiscard]] std::optional<qsizetype> keyIndex(const QString& key) const;
+    [[nodiscard]] QString materialName(qsizetype material) const;
+    [[nodiscard]] QString keyName(qsizetype key) const;
+    // Tabulated number, NaN if the material does not define it as a number
+    [[nodiscard]] double number(qsizetype material, qsizetype key) const;
+    // Unit of a number or the whole text of another value; empty if the material does not define key
+    [[nodiscard]] QString text(qsizetype material, qsizetype key) const;
+
+    /*
+     * Parameter key of material at every composition, given as element -> fractions (e.g. {"Al", x} for AlGaAs,
+     * whose "x" names "Al"), and temperature T in K.
+     * - For an alloy (a material with an "x" key), (1 - x) * parent0 + x * parent1 - x * (1 - x) * bowing, with the
+     *   parents evaluated in the same way and the bowing parameter tabulated for the alloy (0 if it is not). If the
+     *   alloy does not tabulate key but there is a calculable formula for it, the formula is evaluated for the alloy
+     *   instead, so its inputs are the interpolated ones.
+     * - Otherwise the tabulated number, or else the calculable formula evaluated for the material.
+     * Compositions of elements that are not given are 0. NaN where the parameter is not defined.
+     */
+    [[nodiscard]] std::valarray<double> evaluate(qsizetype material, qsizetype key,
+                                                 const QHash<QString, std::valarray<double>>& composition,
+                                                 double T = 300) const;
+
 private:
-    QSettings par_settings;
+    enum class OpCode { NUMBER, PARAMETER, TEMPERATURE, ADD, SUBTRACT, MULTIPLY, DIVIDE, POWER, NEGATE, MIN, MAX,
+                        SQRT, EXP, LOG };
+    struct Instruction {
+        OpCode op;
+        double number = 0;  // NUMBER
+        qsizetype key = 0;  // PARAMETER
+    };
+    using Program = std::vector<Instruction>;
+
+    QHash<QString, qsizetype> material_index;
+    QHash<QString, qsizetype> key_index;
+    QStringList material_names;
+    QStringList key_names;
+    // numbers[material * key_names.size() + key], NaN where not a number
+    std::vector<double> numbers;
+    // Same layout as numbers
+    std::vector<QString> texts;
+    // Calculable formula of each key; empty if there is none
+    std::vector<Program> calculables;
+    // Interned indices of the keys that make up alloys
+    qsizetype x_key = -1;
+    qsizetype parent_keys[2] = {-1, -1};
+
+    qsizetype internKey(const QString& key);
+    [[nodiscard]] Program compile(const QString& formula);
+    [[nodiscard]] std::valarray<double> evaluate(qsizetype material, qsizetype key,
+                                                 const QHash<QString, std::valarray<double>>& composition, double T,
+                                                 std::size_t size, int depth) const;
+    [[nodiscard]] std::valarray<double> run(const Program& program, qsizetype material,
+                                            const QHash<QString, std::valarray<double>>& composition, double T,
+                                            std::size_t size, int depth) const;
 };
 
 
@@ -0,0 +1,106 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <array>
+#include <numbers>
+#include <QHashFunctions>
+#include <QList>
+
+#include "OpticMaterial.h"
+#include "SpectralCache.h"
+
+template<FloatingList T>
+SpectralCache<T> &SpectralCache<T>::instance() {
+    static SpectralCache cache;
+    return cache;
+}
+
+template<FloatingList T>
+SpectralData<typename T::value_type> SpectralCache<T>::query(const std::vector<OpticMaterial<T> *> &materials,
+                                                             const std::valarray<V> &wavelength) {
+    const std::array<std::size_t, 2> shape{materials.size(), wavelength.size()};
+    SpectralData<V> data{wavelength, Utils::Tensor<V, 2>(shape, 1), Utils::Tensor<V, 2>(shape, 0),
+                         Utils::Tensor<V, 2>(shape, 0)};
+    for (std::size_t i = 0; i < materials.size(); i++) {
+        if (materials.at(i)) {
+            const std::shared_ptr<const Row> row = spectrum(materials.at(i), wavelength);
+            data.n[i].assign(row->n);
+            data.k[i].assign(row->k);
+            data.alpha[i].assign(row->alpha);
+        }
+    }
+    return data;
+}
+
+template<FloatingList T>
+void SpectralCache<T>::remove(const OpticMaterial<T> *material) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    lru.remove_if([material](const Entry &entry) -> bool {
+        return entry.material == material;
+    });
+    if (in_flight) {
+        ++generations[material];
+    }
+}
+
+// Both below are called with the lock held.
+template<FloatingList T>
+std::size_t SpectralCache<T>::generation(const OpticMaterial<T> *material) const {
+    const auto it = generations.find(material);
+    return it == generations.end() ? 0 : it->second;
+}
+
+template<FloatingList T>
+void SpectralCache<T>::finished() {
+    if (--in_flight == 0) {
+        generations.clear();
+    }
+}
+
+template<FloatingList T>
+std::shared_ptr<const typename SpectralCache<T>::Row> SpectralCache<T>::spectrum(OpticMaterial<T> *material,
+                                                                                 const std::valarray<V> &wavelength) {
+    const std::size_t key = qHashRange(std::begin(wavelength), std::end(wavelength));
+    std::size_t old_generation;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (const auto it = std::ranges::find_if(lru, [material, key, &wavelength](const Entry &entry) -> bool {
+            return entry.material == material and entry.key == key and
+                   std::ranges::equal(entry.row->wavelength, wavelength);
+        }); it not_eq lru.end()) {
+            lru.splice(lru.begin(), lru, it);
+            return it->row;
+        }
+        ++in_flight;
+        old_generation = generation(material);
+    }
+    // Interpolated without the lock, as loading the data may unload other materials through MaterialCache.
+    std::shared_ptr<Row> row;
+    try {
+        const T wl(std::begin(wavelength), std::end(wavelength));
+        const T n = material->n_interpolated(wl);
+        const T k = material->k_interpolated(wl);
+        row = std::make_shared<Row>(wavelength, std::valarray<V>(n.data(), n.size()),
+                                    std::valarray<V>(k.data(), k.size()), std::valarray<V>());
+        row->alpha = 4 * std::numbers::pi_v<V> * row->k / wavelength;
+    } catch (...) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        finished();
+        throw;
+    }
+    const std::lock_guard<std::mutex> lock(mutex);
+    // Removed meanwhile: the row is of the old data, return it to this caller only.
+    const bool current = generation(material) == old_generation;
+    finished();
+    if (current) {
+        lru.push_front({material, key, row});
+        if (lru.size() > capacity) {
+            lru.pop_back();
+        }
+    }
+    return row;
+}
+
+template class SpectralCache<QList<double>>;
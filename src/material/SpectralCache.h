@@ -0,0 +1,79 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_SPECTRALCACHE_H
+#define SUISAPP_SPECTRALCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <valarray>
+#include <vector>
+
+#include "Global.h"
+#include "utils/Tensor.h"
+
+template<FloatingList T>
+class OpticMaterial;
+
+/*
+ * n, k and the absorption coefficient alpha = 4 pi k / lambda of materials on one wavelength grid, as contiguous
+ * (material, wavelength) matrices. alpha is in the inverse units of the wavelengths.
+ */
+template<std::floating_point V>
+struct SpectralData {
+    std::valarray<V> wavelength;
+    Utils::Tensor<V, 2> n;
+    Utils::Tensor<V, 2> k;
+    Utils::Tensor<V, 2> alpha;
+};
+
+/*
+ * The interpolated n, k and alpha of the most recently queried materials and wavelength grids. OpticStack reads
+ * materials through it, so a material is interpolated once per grid however many stacks and absorption profiles use
+ * it. A material drops its entries when its data change.
+ */
+template<FloatingList T>
+class SpectralCache {
+public:
+    using V = typename T::value_type;
+
+    static SpectralCache &instance();
+
+    // Rows of null materials are those of vacuum: n = 1, k = alpha = 0.
+    SpectralData<V> query(const std::vector<OpticMaterial<T> *> &materials, const std::valarray<V> &wavelength);
+    void remove(const OpticMaterial<T> *material);
+
+private:
+    struct Row {
+        std::valarray<V> wavelength;
+        std::valarray<V> n;
+        std::valarray<V> k;
+        std::valarray<V> alpha;
+    };
+    struct Entry {
+        const OpticMaterial<T> *material;
+        std::size_t key;  // hash of wavelength
+        std::shared_ptr<const Row> row;
+    };
+
+    // Enough for the materials of a few devices on a few grids
+    static constexpr std::size_t capacity = 64;
+    // Most recently used first
+    std::list<Entry> lru;
+    // Spectra are interpolated without the lock. remove() bumps the generation of a material while any are, so that
+    // a spectrum of the old data is not cached after the removal. Cleared when none are in flight.
+    std::size_t in_flight = 0;
+    std::unordered_map<const OpticMaterial<T> *, std::size_t> generations;
+    mutable std::mutex mutex;
+
+    SpectralCache() = default;
+    std::shared_ptr<const Row> spectrum(OpticMaterial<T> *material, const std::valarray<V> &wavelength);
+    std::size_t generation(const OpticMaterial<T> *material) const;
+    void finished();
+};
+
+#endif  // SUISAPP_SPECTRALCACHE_H
@@ -0,0 +1,151 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_ADAPTIVEGRID_H
+#define SUISAPP_ADAPTIVEGRID_H
+
+#include <algorithm>
+#include <concepts>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <valarray>
+#include <variant>
+#include <vector>
+
+#include "RatDict.h"
+#include "utils/Math.h"
+#include "utils/Tensor.h"
+
+/*
+ * Adaptive wavelength grid for any of the calculations of TransferMatrix.h: evaluate(lam_vac) returns their rat_dict on a batch of
+    increasing wavelengths, e.g. a lambda calling calculate_rat() on a fresh stack.
+
+    The grid starts with num_initial equidistant points in [lam_min, lam_max], and every round bisects, in a single
+    evaluate() call, the intervals where linear interpolation of any of the curves (R, T, A, ... and every layer of
+    A_per_layer) may be off by more than tol. The error of an interval of width h is estimated as
+    |y''| * h^2 / 8 from the second divided differences at its ends, multiplied by weight at its midpoint if given,
+    e.g. the photon flux normalized to its maximum, so that only the error of the photocurrent integrand counts.
+    Rounds stop when no interval exceeds tol or the grid reaches max_points; the intervals with the largest errors
+    are bisected first. num_initial must resolve the fringe period lam^2 / (2 * n * d) of the thickest coherent layer
+    at least roughly, since a fringe that falls between two points leaves no curvature to detect.
+
+    :return: The rat_dict of all points in increasing order of wavelength, with lam_vac, the trapezoidal weights of
+        the grid (weights) and the number of evaluate() calls (num_rounds) added.
+ */
+template<std::floating_point T, std::invocable<const std::valarray<T> &> F>
+rat_dict<T> adaptive_wavelength_grid(F &&evaluate, const T lam_min, const T lam_max, const std::size_t num_initial = 33,
+                                     const T tol = 1e-3, const std::size_t max_points = 4096,
+                                     const std::function<T(T)> &weight = {}) {
+    if (num_initial < 3 or not (lam_min < lam_max)) {
+        throw std::invalid_argument("The adaptive grid needs lam_min < lam_max and at least three initial points.");
+    }
+    // Appends the results of b to those of a along the wavelength axis.
+    const auto concat = [](rat_dict<T> &a, const rat_dict<T> &b) -> void {
+        for (const auto &[key, value] : b) {
+            if (not a.contains(key)) {
+                a.emplace(key, value);
+            } else if (std::holds_alternative<std::valarray<T>>(value)) {
+                const std::valarray<T> &head = std::get<std::valarray<T>>(a.at(key));
+                const std::valarray<T> &tail = std::get<std::valarray<T>>(value);
+                std::valarray<T> joined(head.size() + tail.size());
+                joined[std::slice(0, head.size(), 1)] = head;
+                joined[std::slice(head.size(), tail.size(), 1)] = tail;
+                a.at(key) = std::move(joined);
+            } else {
+                const Utils::Tensor<T, 2> &head = std::get<Utils::Tensor<T, 2>>(a.at(key));
+                const Utils::Tensor<T, 2> &tail = std::get<Utils::Tensor<T, 2>>(value);
+                const std::size_t num_rows = head.shape(0);
+                const std::size_t n_head = head.shape(1);
+                const std::size_t n_tail = tail.shape(1);
+                std::valarray<T> joined(num_rows * (n_head + n_tail));
+                for (std::size_t i = 0; i < num_rows; i++) {
+                    joined[std::slice(i * (n_head + n_tail), n_head, 1)] = head[i].flat();
+                    joined[std::slice(i * (n_head + n_tail) + n_head, n_tail, 1)] = tail[i].flat();
+                }
+                a.at(key) = Utils::Tensor<T, 2>({num_rows, n_head + n_tail}, std::move(joined));
+            }
+        }
+    };
+    std::valarray<T> lam_vac = Utils::Math::linspace_va(lam_min, lam_max, num_initial);
+    rat_dict<T> rat_out = evaluate(lam_vac);
+    std::size_t num_rounds = 1;
+    while (true) {
+        const std::size_t num_points = lam_vac.size();
+        // Curves to watch, each a row of num_points values
+        std::vector<std::valarray<T>> curves;
+        for (const auto &[key, value] : rat_out) {
+            if (std::holds_alternative<std::valarray<T>>(value)) {
+                curves.push_back(std::get<std::valarray<T>>(value));
+            } else {
+                const Utils::Tensor<T, 2> &tensor = std::get<Utils::Tensor<T, 2>>(value);
+                for (std::size_t i = 0; i < tensor.shape(0); i++) {
+                    curves.push_back(tensor[i].flat());
+                }
+            }
+        }
+        const std::valarray<T> h = std::valarray<T>(lam_vac[std::slice(1, num_points - 1, 1)]) -
+                std::valarray<T>(lam_vac[std::slice(0, num_points - 1, 1)]);
+        std::valarray<T> curvature(T(0), num_points);
+        for (const std::valarray<T> &y : curves) {
+            for (std::size_t j = 1; j < num_points - 1; j++) {
+                const T d2 = 2 * ((y[j + 1] - y[j]) / h[j] - (y[j] - y[j - 1]) / h[j - 1]) / (h[j - 1] + h[j]);
+                curvature[j] = std::max(curvature[j], std::abs(d2));
+            }
+        }
+        std::vector<std::pair<T, std::size_t>> errors;
+        for (std::size_t j = 0; j < num_points - 1; j++) {
+            const T lam_mid = (lam_vac[j] + lam_vac[j + 1]) / 2;
+            const T error = std::max(curvature[j], curvature[j + 1]) * h[j] * h[j] / 8 * (weight ? weight(lam_mid) : T(1));
+            // Stop at the resolution of the wavelengths themselves.
+            if (error > tol and lam_mid > lam_vac[j] and lam_mid < lam_vac[j + 1]) {
+                errors.emplace_back(error, j);
+            }
+        }
+        if (errors.empty() or num_points >= max_points) {
+            break;
+        }
+        const std::size_t num_new = std::min(errors.size(), max_points - num_points);
+        std::ranges::partial_sort(errors, errors.begin() + static_cast<std::ptrdiff_t>(num_new), std::greater<>());
+        std::valarray<T> lam_new(num_new);
+        for (std::size_t k = 0; k < num_new; k++) {
+            const std::size_t j = errors.at(k).second;
+            lam_new[k] = (lam_vac[j] + lam_vac[j + 1]) / 2;
+        }
+        std::ranges::sort(lam_new);
+        concat(rat_out, evaluate(lam_new));
+        num_rounds++;
+        std::valarray<T> lam_all(num_points + num_new);
+        lam_all[std::slice(0, num_points, 1)] = lam_vac;
+        lam_all[std::slice(num_points, num_new, 1)] = lam_new;
+        // Sort all results by wavelength.
+        std::valarray<std::size_t> order(lam_all.size());
+        std::iota(std::begin(order), std::end(order), 0);
+        std::ranges::sort(order, [&lam_all](const std::size_t a, const std::size_t b) -> bool {
+            return lam_all[a] < lam_all[b];
+        });
+        lam_vac = std::valarray<T>(lam_all[order]);
+        for (auto &[key, value] : rat_out) {
+            if (std::holds_alternative<std::valarray<T>>(value)) {
+                value = std::valarray<T>(std::get<std::valarray<T>>(value)[order]);
+            } else {
+                const Utils::Tensor<T, 2> &tensor = std::get<Utils::Tensor<T, 2>>(value);
+                const std::size_t num_rows = tensor.shape(0);
+                std::valarray<T> sorted(num_rows * order.size());
+                for (std::size_t i = 0; i < num_rows; i++) {
+                    sorted[std::slice(i * order.size(), order.size(), 1)] = std::valarray<T>(tensor[i].flat()[order]);
+                }
+                value = Utils::Tensor<T, 2>({num_rows, order.size()}, std::move(sorted));
+            }
+        }
+    }
+    rat_out.emplace("weights", Utils::Math::trapezoid_weights(lam_vac));
+    rat_out.emplace("num_rounds", std::valarray<T>(static_cast<T>(num_rounds), 1));
+    rat_out.emplace("lam_vac", std::move(lam_vac));
+    return rat_out;
+}
+
+#endif  // SUISAPP_ADAPTIVEGRID_H
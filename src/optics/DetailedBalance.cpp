@@ -0,0 +1,102 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <numbers>
+#include <stdexcept>
+#include <thread>
+#include "DetailedBalance.h"
+#include "Spectrum.h"
+#include "utils/Math.h"
+
+namespace {
+    constexpr double h = 6.62607015e-34;  // Planck constant [J s]
+    constexpr double c = 299792458;  // Speed of light [m s-1]
+    constexpr double k_B = 1.380649e-23;  // Boltzmann constant [J K-1]
+    constexpr double q = 1.602176634e-19;  // Elementary charge [C]
+
+    /*
+     * Principal branch of the Lambert W function for x >= 0, by Halley's method.
+     */
+    template<std::floating_point T>
+    auto lambert_w(const T x) -> T {
+        T w = x < 1 ? x : std::log(x) - std::log(std::log(x) + 1);
+        for (int iter = 0; iter < 50; iter++) {
+            const T e_w = std::exp(w);
+            const T f = w * e_w - x;
+            const T step = f / (e_w * (w + 1) - (w + 2) * f / (2 * w + 2));
+            w -= step;
+            if (std::abs(step) <= Utils::Math::EPSILON<T> * std::max(T(1), std::abs(w))) {
+                break;
+            }
+        }
+        return w;
+    }
+}
+
+template<std::floating_point T>
+DetailedBalance<T>::DetailedBalance(const std::valarray<T> &lam_vac, const std::valarray<T> &sun_weights,
+                                    const T temperature) : sun_weights(sun_weights),
+                                                           thermal_voltage(T(k_B / q) * temperature) {
+    if (lam_vac.size() not_eq sun_weights.size()) {
+        throw std::invalid_argument("lam_vac and sun_weights must have the same size.");
+    }
+    if (not (temperature > 0)) {
+        throw std::invalid_argument("The cell temperature must be positive.");
+    }
+    bb_weights = T(q) * blackbody_photon_flux(lam_vac, temperature) * Utils::Math::trapezoid_weights(lam_vac);
+    // Photons to energy
+    power_in = (sun_weights * T(h * c) / lam_vac).sum();
+}
+
+template<std::floating_point T>
+auto DetailedBalance<T>::operator()(const std::valarray<T> &absorptance) const -> detailed_balance_dict<T> {
+    if (absorptance.size() not_eq sun_weights.size()) {
+        throw std::invalid_argument("The absorptance must be given on the wavelength grid of the constructor.");
+    }
+    const T Jsc = T(q) * (sun_weights * absorptance).sum();
+    const T J0 = (bb_weights * absorptance).sum();
+    if (not (J0 > 0) or not (Jsc > 0)) {
+        return {{"Jsc", Jsc}, {"J0", J0}, {"Voc", 0}, {"Vmp", 0}, {"Jmp", 0}, {"FF", 0}, {"PCE", 0}};
+    }
+    const T ratio = Jsc / J0;
+    // log1p keeps Voc accurate for weak illumination.
+    const T Voc = thermal_voltage * std::log1p(ratio);
+    // d(V * J) / dV = 0 <=> (1 + v) * exp(v) = 1 + Jsc / J0 with v = V / V_T
+    const T v_mp = lambert_w(std::numbers::e_v<T> * (1 + ratio)) - 1;
+    const T Vmp = thermal_voltage * v_mp;
+    const T Jmp = Jsc - J0 * std::expm1(v_mp);
+    const T Pmp = Vmp * Jmp;
+    return {{"Jsc", Jsc},
+            {"J0", J0},
+            {"Voc", Voc},
+            {"Vmp", Vmp},
+            {"Jmp", Jmp},
+            {"FF", Pmp / (Voc * Jsc)},
+            {"PCE", power_in > 0 ? Pmp / power_in : T(0)}};
+}
+
+template<std::floating_point T>
+auto DetailedBalance<T>::operator()(const std::vector<std::valarray<T>> &absorptance) const -> std::vector<detailed_balance_dict<T>> {
+    const std::size_t num_stacks = absorptance.size();
+    std::vector<detailed_balance_dict<T>> results(num_stacks);
+    const std::size_t num_tasks = std::min<std::size_t>(num_stacks, std::max(1U, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(num_tasks);
+    for (std::size_t task = 0; task < num_tasks; task++) {
+        tasks.push_back(std::async(std::launch::async, [this, &absorptance, &results, task, num_tasks, num_stacks]() -> void {
+            for (std::size_t s = task; s < num_stacks; s += num_tasks) {
+                results.at(s) = (*this)(absorptance.at(s));
+            }
+        }));
+    }
+    for (std::future<void> &task : tasks) {
+        task.get();
+    }
+    return results;
+}
+
+template class DetailedBalance<double>;
@@ -0,0 +1,57 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_DETAILEDBALANCE_H
+#define SUISAPP_DETAILEDBALANCE_H
+
+#include <concepts>
+#include <string>
+#include <unordered_map>
+#include <valarray>
+#include <vector>
+
+/*
+ * Jsc, J0, Jmp: T [A m-2]
+ * Voc, Vmp: T [V]
+ * FF, PCE: T
+ */
+template<typename T>
+using detailed_balance_dict = std::unordered_map<std::string, T>;
+
+/*
+ * Radiative-limit (detailed-balance) performance of a cell from the absorptance a(lambda) of its active layer,
+ * preferably angle-integrated, e.g. from calculate_rat_hemispherical(). By reciprocity, the cell emits in the dark
+ * J0 = q * int a(lambda) * phi_bb(lambda, T_cell) d lambda with the hemispherical black-body photon flux phi_bb, so
+ * J(V) = Jsc - J0 * (exp(q * V / (k * T_cell)) - 1), Voc = k * T_cell / q * ln(Jsc / J0 + 1), and the maximum power
+ * point follows from the Lambert W function.
+
+ * Everything that depends only on the wavelength grid (the black-body weights, the incident power) is computed once
+ * by the constructor, so an evaluation is two dot products. a must vanish beyond the grid, i.e. the grid must extend
+ * past the absorption edge.
+ */
+template<std::floating_point T>
+class DetailedBalance {
+public:
+    /*
+     * lam_vac: wavelengths in m, increasing.
+     * sun_weights: photon flux weights of the illumination on lam_vac, quadrature included, e.g. from
+     *     SpectrumLibrary::weights().
+     * temperature: cell temperature in K, e.g. ParameterClass::T.
+     */
+    DetailedBalance(const std::valarray<T> &lam_vac, const std::valarray<T> &sun_weights, T temperature);
+
+    auto operator()(const std::valarray<T> &absorptance) const -> detailed_balance_dict<T>;
+    /*
+     * Evaluates the absorptance spectra of many stacks concurrently.
+     */
+    auto operator()(const std::vector<std::valarray<T>> &absorptance) const -> std::vector<detailed_balance_dict<T>>;
+private:
+    std::valarray<T> sun_weights;
+    // q * phi_bb * quadrature weight
+    std::valarray<T> bb_weights;
+    T thermal_voltage;
+    T power_in;
+};
+
+#endif  // SUISAPP_DETAILEDBALANCE_H
@@ -0,0 +1,198 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include "EllipsFit.h"
+#include "tmm.h"
+
+template<std::floating_point T>
+EllipsFit<T>::EllipsFit(StackModel model, const std::valarray<T> &th_0, const std::valarray<T> &lam_vac,
+                        const std::vector<std::valarray<T>> &psi,
+                        const std::vector<std::valarray<T>> &Delta) : model(std::move(model)), th_0(th_0),
+                                                                      lam_vac(lam_vac), psi_meas(psi),
+                                                                      Delta_meas(Delta) {
+    if (psi.size() not_eq th_0.size() or Delta.size() not_eq th_0.size()) {
+        throw std::invalid_argument("psi and Delta must have one spectrum per angle of incidence.");
+    }
+    for (std::size_t a = 0; a < th_0.size(); a++) {
+        if (psi.at(a).size() not_eq lam_vac.size() or Delta.at(a).size() not_eq lam_vac.size()) {
+            throw std::invalid_argument("psi and Delta spectra mismatch lam_vac's size.");
+        }
+    }
+}
+
+template<std::floating_point T>
+auto EllipsFit<T>::residuals(const std::valarray<T> &params) const -> std::valarray<T> {
+    const std::size_t num_angles = th_0.size();
+    const std::size_t num_wl = lam_vac.size();
+    const auto [n_list, d_list] = model(params);
+    const std::unordered_map<std::string, std::vector<std::valarray<T>>> ellips_data = ellips(n_list, d_list, th_0,
+                                                                                                lam_vac);
+    const std::vector<std::valarray<T>> &psi = ellips_data.at("psi");
+    const std::vector<std::valarray<T>> &Delta = ellips_data.at("Delta");
+    std::valarray<T> res(2 * num_angles * num_wl);
+    for (std::size_t a = 0; a < num_angles; a++) {
+        res[std::slice(a * num_wl, num_wl, 1)] = psi.at(a) - psi_meas.at(a);
+        for (std::size_t j = 0; j < num_wl; j++) {
+            // Delta is only defined modulo 2 pi.
+            res[(num_angles + a) * num_wl + j] = std::remainder(Delta.at(a)[j] - Delta_meas.at(a)[j],
+                                                                2 * std::numbers::pi_v<T>);
+        }
+    }
+    return res;
+}
+
+/*
+ * Forward differences, stepping backwards where a forward step would leave the bounds. If the interval is narrower
+ * than the step, the step is shortened to the wider side; a parameter with lower == upper gets a zero column.
+ * Returns the Jacobian column-wise: jac[k] = d res / d params[k].
+ */
+template<std::floating_point T>
+auto EllipsFit<T>::jacobian(const std::valarray<T> &params, const std::valarray<T> &res, const std::valarray<T> &lower,
+                            const std::valarray<T> &upper) const -> std::vector<std::valarray<T>> {
+    const std::size_t num_params = params.size();
+    std::vector<T> steps(num_params);
+    std::vector<std::future<std::valarray<T>>> columns(num_params);
+    for (std::size_t k = 0; k < num_params; k++) {
+        T h = std::sqrt(std::numeric_limits<T>::epsilon()) * std::max(std::abs(params[k]), T(1));
+        const T room_up = upper[k] - params[k];
+        const T room_down = params[k] - lower[k];
+        if (h > room_up) {
+            if (h <= room_down) {
+                h = -h;
+            } else {
+                h = room_up >= room_down ? room_up : -room_down;
+            }
+        }
+        steps.at(k) = h;
+        if (h == 0) {
+            continue;
+        }
+        std::valarray<T> shifted = params;
+        shifted[k] += h;
+        columns.at(k) = std::async(std::launch::async, [this, shifted = std::move(shifted)]() -> std::valarray<T> {
+            return residuals(shifted);
+        });
+    }
+    std::vector<std::valarray<T>> jac(num_params);
+    for (std::size_t k = 0; k < num_params; k++) {
+        if (steps.at(k) == 0) {
+            jac.at(k) = std::valarray<T>(res.size());
+        } else {
+            jac.at(k) = (columns.at(k).get() - res) / steps.at(k);
+        }
+    }
+    return jac;
+}
+
+template<std::floating_point T>
+auto EllipsFit<T>::fit(std::valarray<T> params, const std::valarray<T> &lower, const std::valarray<T> &upper,
+                       const std::size_t max_iter, const T tol) const -> ellips_fit_dict<T> {
+    const std::size_t num_params = params.size();
+    if (lower.size() not_eq num_params or upper.size() not_eq num_params) {
+        throw std::invalid_argument("lower and upper must have the same size as params.");
+    }
+    for (std::size_t k = 0; k < num_params; k++) {
+        if (lower[k] > upper[k]) {
+            throw std::invalid_argument("lower bound exceeds upper bound.");
+        }
+        params[k] = std::clamp(params[k], lower[k], upper[k]);
+    }
+    std::valarray<T> res = residuals(params);
+    T chi2 = (res * res).sum();
+    T lambda = 1e-3;
+    std::size_t iter = 0;
+    while (iter < max_iter) {
+        ++iter;
+        const std::vector<std::valarray<T>> jac = jacobian(params, res, lower, upper);
+        // Normal equations: JtJ * step = -Jt * res
+        std::vector<std::valarray<T>> JtJ(num_params, std::valarray<T>(num_params));
+        std::valarray<T> grad(num_params);
+        for (std::size_t k = 0; k < num_params; k++) {
+            for (std::size_t l = 0; l <= k; l++) {
+                JtJ.at(k)[l] = JtJ.at(l)[k] = (jac.at(k) * jac.at(l)).sum();
+            }
+            grad[k] = (jac.at(k) * res).sum();
+        }
+        bool accepted = false;
+        T chi2_new = chi2;
+        while (not accepted and lambda < 1e10) {
+            // Solve (JtJ + lambda * diag(JtJ)) * step = -grad by Gaussian elimination with partial pivoting.
+            std::vector<std::valarray<T>> A = JtJ;
+            std::valarray<T> b = -grad;
+            for (std::size_t k = 0; k < num_params; k++) {
+                A.at(k)[k] += lambda * std::max(JtJ.at(k)[k], std::numeric_limits<T>::min());
+            }
+            bool singular = false;
+            for (std::size_t k = 0; k < num_params; k++) {
+                std::size_t pivot = k;
+                for (std::size_t l = k + 1; l < num_params; l++) {
+                    if (std::abs(A.at(l)[k]) > std::abs(A.at(pivot)[k])) {
+                        pivot = l;
+                    }
+                }
+                if (A.at(pivot)[k] == 0) {
+                    singular = true;
+                    break;
+                }
+                std::swap(A.at(k), A.at(pivot));
+                std::swap(b[k], b[pivot]);
+                for (std::size_t l = k + 1; l < num_params; l++) {
+                    const T factor = A.at(l)[k] / A.at(k)[k];
+                    A.at(l) -= factor * A.at(k);
+                    b[l] -= factor * b[k];
+                }
+            }
+            if (singular) {
+                lambda *= 10;
+                continue;
+            }
+            std::valarray<T> step(num_params);
+            for (std::size_t k = num_params; k-- > 0;) {
+                T sum = b[k];
+                for (std::size_t l = k + 1; l < num_params; l++) {
+                    sum -= A.at(k)[l] * step[l];
+                }
+                step[k] = sum / A.at(k)[k];
+            }
+            std::valarray<T> trial = params + step;
+            for (std::size_t k = 0; k < num_params; k++) {
+                trial[k] = std::clamp(trial[k], lower[k], upper[k]);
+            }
+            const std::valarray<T> trial_res = residuals(trial);
+            chi2_new = (trial_res * trial_res).sum();
+            if (chi2_new < chi2) {
+                accepted = true;
+                params = trial;
+                res = trial_res;
+                lambda = std::max(lambda / 10, T(1e-12));
+            } else {
+                lambda *= 10;
+            }
+        }
+        if (not accepted) {
+            break;
+        }
+        const T decrease = chi2 - chi2_new;
+        chi2 = chi2_new;
+        if (decrease <= tol * chi2) {
+            break;
+        }
+    }
+    const auto [n_list, d_list] = model(params);
+    const std::unordered_map<std::string, std::vector<std::valarray<T>>> ellips_data = ellips(n_list, d_list, th_0,
+                                                                                                lam_vac);
+    return {{"params", params},
+            {"chi2", chi2},
+            {"iterations", iter},
+            {"psi", ellips_data.at("psi")},
+            {"Delta", ellips_data.at("Delta")}};
+}
+
+template class EllipsFit<double>;
@@ -0,0 +1,68 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_ELLIPSFIT_H
+#define SUISAPP_ELLIPSFIT_H
+
+#include <complex>
+#include <concepts>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <valarray>
+#include <variant>
+#include <vector>
+
+/*
+ * params: std::valarray<T>
+ * chi2: T
+ * iterations: std::size_t
+ * psi: std::vector<std::valarray<T>>
+ * Delta: std::vector<std::valarray<T>>
+ */
+template<typename T>
+using ellips_fit_dict = std::unordered_map<std::string, std::variant<T, std::size_t, std::valarray<T>,
+        std::vector<std::valarray<T>>>>;
+
+/*
+ * Fits a layer model to variable-angle spectroscopic ellipsometry data (psi and Delta measured at several angles of
+ * incidence) with the Levenberg-Marquardt method.
+
+ * The model maps a parameter vector (layer thicknesses, oscillator parameters, ...) to the n_list and d_list of the
+ * stack, in the layout accepted by the batched ellips(). All angles are evaluated in one ellips() call, and the
+ * columns of the finite-difference Jacobian are evaluated concurrently, so the model must be safe to call from
+ * several threads at once.
+ */
+template<std::floating_point T>
+class EllipsFit {
+public:
+    using StackModel = std::function<std::pair<std::vector<std::valarray<std::complex<T>>>, std::vector<T>>(
+            const std::valarray<T> &)>;
+
+    EllipsFit(StackModel model, const std::valarray<T> &th_0, const std::valarray<T> &lam_vac,
+              const std::vector<std::valarray<T>> &psi, const std::vector<std::valarray<T>> &Delta);
+
+    /*
+     * psi residuals of all angles followed by Delta residuals of all angles, the latter wrapped into (-pi, pi].
+     */
+    auto residuals(const std::valarray<T> &params) const -> std::valarray<T>;
+    /*
+     * Starting from params, minimizes the sum of squared residuals with every parameter kept within
+     * [lower, upper]. Stops when the relative decrease of chi2 falls below tol or after max_iter iterations.
+     */
+    auto fit(std::valarray<T> params, const std::valarray<T> &lower, const std::valarray<T> &upper,
+             std::size_t max_iter = 100, T tol = 1e-10) const -> ellips_fit_dict<T>;
+private:
+    StackModel model;
+    std::valarray<T> th_0;
+    std::valarray<T> lam_vac;
+    std::vector<std::valarray<T>> psi_meas;
+    std::vector<std::valarray<T>> Delta_meas;
+
+    auto jacobian(const std::valarray<T> &params, const std::valarray<T> &res, const std::valarray<T> &lower,
+                  const std::valarray<T> &upper) const -> std::vector<std::valarray<T>>;
+};
+
+#endif  // SUISAPP_ELLIPSFIT_H
@@ -0,0 +1,218 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <future>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include "GuidedModes.h"
+
+using namespace std::complex_literals;
+
+/*
+ * Mode condition of one polarization at one wavelength.
+ */
+template<std::floating_point T>
+struct ModeCondition {
+    std::vector<std::complex<T>> n_sq;
+    std::vector<T> d;
+    T k0;
+    char pol;
+    bool leaky_front;
+    bool leaky_back;
+
+    auto operator()(const std::complex<T> n_eff) const -> std::complex<T> {
+        const std::size_t num_layers = n_sq.size();
+        const std::complex<T> n_eff_sq = n_eff * n_eff;
+        // Admittance q of the outer media, on the branch selected by leaky_front and leaky_back
+        const auto q_outer = [&](const std::size_t i, const bool leaky) -> std::complex<T> {
+            const std::complex<T> proper = 1i * std::sqrt(n_eff_sq - n_sq.at(i));
+            const std::complex<T> kz_n = leaky ? -proper : proper;
+            return pol == 's' ? kz_n : kz_n / n_sq.at(i);
+        };
+        const std::complex<T> q_0 = q_outer(0, leaky_front);
+        const std::complex<T> q_N = q_outer(num_layers - 1, leaky_back);
+        // Running product of the characteristic matrices [[cos(delta), -1j * sin(delta) / q],
+        // [-1j * q * sin(delta), cos(delta)]] of the inner layers. With u = (kz / k0)^2 = n^2 - n_eff^2,
+        // sin(delta) / q and q * sin(delta) only involve u and sinc(delta), so all entries are even in kz and the
+        // product is entire in n_eff.
+        std::complex<T> m00 = 1;
+        std::complex<T> m01 = 0;
+        std::complex<T> m10 = 0;
+        std::complex<T> m11 = 1;
+        for (std::size_t i = 1; i + 1 < num_layers; i++) {
+            const std::complex<T> u = n_sq.at(i) - n_eff_sq;
+            const T k0d = k0 * d.at(i);
+            const std::complex<T> delta = k0d * std::sqrt(u);
+            const std::complex<T> cos_delta = std::cos(delta);
+            const std::complex<T> sinc_delta = std::abs(delta) < T(1e-4) ? T(1) - delta * delta / T(6) :
+                                               std::sin(delta) / delta;
+            // pol == 's': q = kz / k0; pol == 'p': q = kz / (k0 * n^2)
+            const std::complex<T> scale = pol == 's' ? std::complex<T>(1) : n_sq.at(i);
+            const std::complex<T> a01 = -1i * k0d * scale * sinc_delta;
+            const std::complex<T> a10 = -1i * k0d * u / scale * sinc_delta;
+            const std::complex<T> n00 = m00 * cos_delta + m01 * a10;
+            const std::complex<T> n01 = m00 * a01 + m01 * cos_delta;
+            const std::complex<T> n10 = m10 * cos_delta + m11 * a10;
+            const std::complex<T> n11 = m10 * a01 + m11 * cos_delta;
+            m00 = n00;
+            m01 = n01;
+            m10 = n10;
+            m11 = n11;
+        }
+        // Denominator of the reflection coefficient
+        return (m00 + m01 * q_N) * q_0 + m10 + m11 * q_N;
+    }
+};
+
+/*
+ * Change of arg(f) from z0 to z1, bisecting until every step turns by less than pi / 4.
+ */
+template<std::floating_point T>
+auto arg_change(const ModeCondition<T> &f, const std::complex<T> z0, const std::complex<T> z1,
+                const std::complex<T> f0, const std::complex<T> f1, const std::size_t depth) -> T {
+    const T turn = std::arg(f1 / f0);
+    if (std::abs(turn) < std::numbers::pi_v<T> / 4 or depth >= 20) {
+        return turn;
+    }
+    const std::complex<T> zm = (z0 + z1) / T(2);
+    const std::complex<T> fm = f(zm);
+    return arg_change(f, z0, zm, f0, fm, depth + 1) + arg_change(f, zm, z1, fm, f1, depth + 1);
+}
+
+/*
+ * Number of zeros of f in the box with corners lo and hi (argument principle).
+ */
+template<std::floating_point T>
+auto count_zeros(const ModeCondition<T> &f, const std::complex<T> lo, const std::complex<T> hi) -> long {
+    const std::array<std::complex<T>, 4> corners = {lo, {hi.real(), lo.imag()}, hi, {lo.real(), hi.imag()}};
+    constexpr std::size_t num_steps = 8;
+    T total = 0;
+    for (std::size_t c = 0; c < 4; c++) {
+        const std::complex<T> start = corners.at(c);
+        const std::complex<T> end = corners.at((c + 1) % 4);
+        std::complex<T> z0 = start;
+        std::complex<T> f0 = f(z0);
+        for (std::size_t k = 1; k <= num_steps; k++) {
+            const std::complex<T> z1 = start + (end - start) * (static_cast<T>(k) / num_steps);
+            const std::complex<T> f1 = f(z1);
+            total += arg_change(f, z0, z1, f0, f1, 0);
+            z0 = z1;
+            f0 = f1;
+        }
+    }
+    return std::lround(total / (2 * std::numbers::pi_v<T>));
+}
+
+template<std::floating_point T>
+auto newton(const ModeCondition<T> &f, std::complex<T> z) -> std::optional<std::complex<T>> {
+    for (std::size_t iter = 0; iter < 100; iter++) {
+        const T h = T(1e-7) * std::max(T(1), std::abs(z));
+        const std::complex<T> df = (f(z + h) - f(z - h)) / (2 * h);
+        if (df == T(0)) {
+            return std::nullopt;
+        }
+        const std::complex<T> step = f(z) / df;
+        z -= step;
+        if (std::abs(step) <= T(1e-12) * std::max(T(1), std::abs(z))) {
+            return z;
+        }
+    }
+    return std::nullopt;
+}
+
+template<std::floating_point T>
+void search_box(const ModeCondition<T> &f, const std::complex<T> lo, const std::complex<T> hi,
+                const std::size_t depth, std::vector<std::complex<T>> &zeros) {
+    const long num_zeros = count_zeros(f, lo, hi);
+    if (num_zeros <= 0) {
+        return;
+    }
+    if (num_zeros == 1) {
+        if (const std::optional<std::complex<T>> z = newton(f, (lo + hi) / T(2));
+                z and z->real() >= lo.real() and z->real() <= hi.real() and z->imag() >= lo.imag() and
+                z->imag() <= hi.imag()) {
+            zeros.emplace_back(*z);
+            return;
+        }
+    }
+    if (depth >= 12) {
+        return;
+    }
+    // Split slightly off-centre, so that a zero at the centre of a symmetric box does not land on an edge.
+    const std::complex<T> mid = lo + (hi - lo) * T(0.5137);
+    search_box(f, lo, mid, depth + 1, zeros);
+    search_box(f, {mid.real(), lo.imag()}, {hi.real(), mid.imag()}, depth + 1, zeros);
+    search_box(f, mid, hi, depth + 1, zeros);
+    search_box(f, {lo.real(), mid.imag()}, {mid.real(), hi.imag()}, depth + 1, zeros);
+}
+
+template<std::floating_point T>
+auto find_guided_modes(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+                       const std::valarray<T> &lam_vac, const std::complex<T> n_eff_min,
+                       const std::complex<T> n_eff_max, const bool leaky_front,
+                       const bool leaky_back) -> guided_mode_dict<T> {
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_wl = lam_vac.size();
+    if (num_layers < 3 or num_layers not_eq d_list.size()) {
+        throw std::invalid_argument("n_list and d_list must have the same length of at least 3.");
+    }
+    if (n_eff_min.real() >= n_eff_max.real() or n_eff_min.imag() >= n_eff_max.imag()) {
+        throw std::invalid_argument("n_eff_min must lie below and to the left of n_eff_max.");
+    }
+    std::vector<std::valarray<std::complex<T>>> n_eff_s(num_wl);
+    std::vector<std::valarray<std::complex<T>>> n_eff_p(num_wl);
+    std::vector<std::valarray<T>> alpha_s(num_wl);
+    std::vector<std::valarray<T>> alpha_p(num_wl);
+    const auto solve = [&](const std::size_t j) -> void {
+        const T k0 = 2 * std::numbers::pi_v<T> / lam_vac[j];
+        std::vector<std::complex<T>> n_sq(num_layers);
+        for (std::size_t i = 0; i < num_layers; i++) {
+            n_sq.at(i) = n_list.at(i)[j] * n_list.at(i)[j];
+        }
+        for (const char pol : {'s', 'p'}) {
+            const ModeCondition<T> f{n_sq, d_list, k0, pol, leaky_front, leaky_back};
+            std::vector<std::complex<T>> zeros;
+            search_box(f, n_eff_min, n_eff_max, 0, zeros);
+            // Fundamental mode first
+            std::ranges::sort(zeros, [](const std::complex<T> a, const std::complex<T> b) -> bool {
+                return a.real() > b.real();
+            });
+            const auto last = std::ranges::unique(zeros, [](const std::complex<T> a, const std::complex<T> b) -> bool {
+                return std::abs(a - b) <= T(1e-9) * std::abs(a);
+            }).begin();
+            zeros.erase(last, zeros.end());
+            std::valarray<std::complex<T>> n_eff(zeros.data(), zeros.size());
+            std::valarray<T> alpha(zeros.size());
+            for (std::size_t m = 0; m < zeros.size(); m++) {
+                alpha[m] = 2 * k0 * zeros.at(m).imag();
+            }
+            (pol == 's' ? n_eff_s : n_eff_p).at(j) = std::move(n_eff);
+            (pol == 's' ? alpha_s : alpha_p).at(j) = std::move(alpha);
+        }
+    };
+    const std::size_t num_tasks = std::min<std::size_t>(num_wl, std::max(1U, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(num_tasks);
+    for (std::size_t task = 0; task < num_tasks; task++) {
+        tasks.push_back(std::async(std::launch::async, [&solve, task, num_tasks, num_wl]() -> void {
+            for (std::size_t j = task; j < num_wl; j += num_tasks) {
+                solve(j);
+            }
+        }));
+    }
+    for (std::future<void> &task : tasks) {
+        task.get();
+    }
+    return {{"n_eff_s", n_eff_s}, {"n_eff_p", n_eff_p}, {"alpha_s", alpha_s}, {"alpha_p", alpha_p}};
+}
+
+template auto find_guided_modes(const std::vector<std::valarray<std::complex<double>>> &n_list,
+                                const std::vector<double> &d_list, const std::valarray<double> &lam_vac,
+                                std::complex<double> n_eff_min, std::complex<double> n_eff_max, bool leaky_front,
+                                bool leaky_back) -> guided_mode_dict<double>;
@@ -0,0 +1,51 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_GUIDEDMODES_H
+#define SUISAPP_GUIDEDMODES_H
+
+#include <complex>
+#include <concepts>
+#include <string>
+#include <unordered_map>
+#include <valarray>
+#include <variant>
+#include <vector>
+
+/*
+ * n_eff_s: std::vector<std::valarray<std::complex<T>>>
+ * n_eff_p: std::vector<std::valarray<std::complex<T>>>
+ * alpha_s: std::vector<std::valarray<T>>
+ * alpha_p: std::vector<std::valarray<T>>
+ * The j'th element belongs to lam_vac[j] and holds all modes found at that wavelength.
+ */
+template<typename T>
+using guided_mode_dict = std::unordered_map<std::string, std::variant<std::vector<std::valarray<std::complex<T>>>,
+        std::vector<std::valarray<T>>>>;
+
+/*
+ * Finds the TE (s) and TM (p) modes of a planar stack as the poles of its reflection coefficient in the complex
+ * plane of the effective index n_eff = kx / k0 = n_0 * sin(th_0).
+
+ * The poles are the zeros of the denominator (m00 + m01 * q_N) * q_0 + m10 + m11 * q_N of the reflection coefficient,
+ * where m is the product of the characteristic matrices [[cos(delta), -1j * sin(delta) / q],
+ * [-1j * q * sin(delta), cos(delta)]] of the inner layers, with q = kz / k0 for s and kz / (k0 * n^2) for p. Its entries
+ * only depend on kz^2, so the denominator is an entire function of n_eff except for the branch points of the outer
+ * media. The zeros in the box
+ * [n_eff_min, n_eff_max] are counted by the argument principle on the box boundary; boxes with several zeros are
+ * quartered, and single zeros are refined with Newton's method. Wavelengths are solved concurrently.
+
+ * In the outer media, kz = 1j * k0 * sqrt(n_eff^2 - n^2) (decaying away from the stack) unless leaky_front or
+ * leaky_back selects the opposite (improper) branch for quasi-guided modes leaking into that medium. The box must not
+ * contain the branch cuts n_eff in (-n, n) of the real axis, i.e., guided modes need Re(n_eff_min) > n of the outer
+ * media, and leaky modes Im(n_eff_min) > 0.
+
+ * alpha = 2 * k0 * Im(n_eff) is the intensity attenuation along the stack, in the inverse units of lam_vac.
+ */
+template<std::floating_point T>
+auto find_guided_modes(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+                       const std::valarray<T> &lam_vac, std::complex<T> n_eff_min, std::complex<T> n_eff_max,
+                       bool leaky_front = false, bool leaky_back = false) -> guided_mode_dict<T>;
+
+#endif  // SUISAPP_GUIDEDMODES_H
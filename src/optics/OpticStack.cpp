@@ -16,26 +16,28 @@ template<FloatingList T>
 template<FloatingList U>
 requires std::same_as<typename U::value_type, typename T::value_type>
 U OpticStack<T>::get_widths() {
-    std::size_t sz_struct = structure.size();
-    if (no_back_reflection) {
-        // std::valarray and std::vector have different constructors for (val, count)
-        U widths(sz_struct + 3);
-        widths[0] = INFINITY;
-        for (std::size_t i = 1; i <= sz_struct; i++) {
-            widths[i] = structure.at(i - 1).second;
-        }
-        widths[sz_struct + 1] = 1e-3;
-        widths[sz_struct + 2] = INFINITY;
-        return widths;
-    } else {
-        U widths(sz_struct + 2);
-        widths[0] = INFINITY;
-        for (std::size_t i = 1; i <= sz_struct; i++) {
-            widths[i] = structure.at(i - 1).second;
+    std::size_t sz_struct = 0;  // graded layers count as their slices
+    for (std::size_t i = 0; i < structure.size(); i++) {
+        sz_struct += grades.contains(i) ? grades.at(i).num_slices : 1;
+    }
+    // std::valarray and std::vector have different constructors for (val, count)
+    U widths(sz_struct + (no_back_reflection ? 3 : 2));
+    widths[0] = INFINITY;
+    std::size_t row = 1;
+    for (std::size_t i = 0; i < structure.size(); i++) {
+        if (const auto grade = grades.find(i); grade not_eq grades.end()) {
+            for (std::size_t s = 0; s < grade->second.num_slices; s++) {
+                widths[row++] = structure.at(i).second / static_cast<double>(grade->second.num_slices);
+            }
+        } else {
+            widths[row++] = structure.at(i).second;
         }
-        widths[sz_struct + 1] = INFINITY;
-        return widths;
     }
+    if (no_back_reflection) {
+        widths[row++] = 1e-3;
+    }
+    widths[row] = INFINITY;
+    return widths;
 }
 
 /*
@@ -44,14 +46,17 @@ U OpticStack<T>::get_widths() {
         within the absorbing layer thickness.
 
         :param wl: Wavelength of the light in m.
+        :param bottom: The refractive index of the bottom layer of the stack at wl.
         :return: The k value at each wavelength.
  */
 template<FloatingList T>
-T OpticStack<T>::k_absorbing(T &&wavelength) {
-    T k_absorbing(wavelength.size());
-    std::ranges::transform(wavelength, structure.back().first->kData(), std::begin(k_absorbing), [](T::value_type wl, T::value_type k) -> T::value_type {
-        return std::max(k * 1e3, k);
-    });
+std::valarray<typename T::value_type> OpticStack<T>::k_absorbing(const std::valarray<typename T::value_type> &wl,
+                                                                 const std::valarray<std::complex<typename T::value_type>> &bottom) {
+    std::valarray<typename T::value_type> k_absorbing(wl.size());
+    for (std::size_t j = 0; j < wl.size(); j++) {
+        // alpha = 4 pi k / wl makes the 1 mm layer 4 pi absorption lengths thick.
+        k_absorbing[j] = std::max(wl[j] * 1e3, bottom[j].imag());
+    }
     return k_absorbing;
 }
 
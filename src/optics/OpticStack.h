@@ -6,11 +6,16 @@
 #define SUISAPP_OPTICSTACK_H
 
 #include <complex>
+#include <map>
+#include <numbers>
+#include <stdexcept>
 #include <valarray>
 #include <vector>
 
 #include "utils/Math.h"
+#include "utils/Tensor.h"
 #include "material/OpticMaterial.h"
+#include "material/SpectralCache.h"
 
 /*
  * Class that contains an optical structure: a sequence of layers with a thickness
@@ -56,6 +61,11 @@ wavelengths and the experimental data at short wavelengths. If decreasing (one)
 the opposite is done. The mixing point and mixing width control how smooth is the
 transition between one and the other type of data.
 
+Here, both kinds of layers are OpticMaterial objects: a [thickness, DielectricModel]
+layer is an OpticMaterial constructed from a DielectricModel (Cauchy, Sellmeier,
+TaucLorentz, CodyLorentz), and a mixed layer is a tabulated OpticMaterial on which
+set_model() was called with a Mixing of the mixing point and width in m.
+
 Extra layers such as he semi-infinite, air-like first and last medium, and a back
 highly absorbing layer are included at runtime to fulfill the requirements of the
 TMM solver or to solve some of its limitations.
@@ -71,14 +81,15 @@ public:
                         const bool no_back_reflection = false,
                         OpticMaterial<T> *substrate = nullptr,
                         OpticMaterial<T> *incidence = nullptr) : no_back_reflection(no_back_reflection),
-                                                                 num_mat_layers(structure.size() + (substrate not_eq nullptr) +
-                                                                     (incidence not_eq nullptr)),
+                                                                 num_mat_layers(structure.size()),
                                                                  structure(std::move(structure)),
                                                                  substrate(substrate),
                                                                  incidence(incidence) {}
 
     bool no_back_reflection;
-    std::size_t num_mat_layers;  // include non-null substrate and incidence
+    // Layers of the structure, graded layers counted by their slices: the rows of get_indices() but the incidence
+    // medium, the back absorbing layer and the substrate
+    std::size_t num_mat_layers;
 
     /*
      * Returns the complex refractive index of the stack.
@@ -92,42 +103,10 @@ public:
     requires std::same_as<U, std::valarray<std::complex<typename T::value_type>>>
     U get_indices(T_WL &&wavelength) {
         const std::size_t sz_wl = wavelength.size();
-        U indices(1, sz_wl * (num_mat_layers + 1));
-        if (incidence) {
-            const QList<double> n_data = incidence->n_interpolated(wavelength);
-            const QList<double> k_data = incidence->k_interpolated(wavelength);
-            if (sz_wl not_eq n_data.size() or sz_wl not_eq k_data.size()) {
-                qWarning("n_data size does not match k_data size");
-                return {};
-            }
-            for (qsizetype i = 0; i < sz_wl; i++) {
-                indices[i] = {n_data.at(i), k_data.at(i)};
-            }
-        }
-        if (substrate) {
-            const QList<double> n_data = substrate->n_interpolated(wavelength);
-            const QList<double> k_data = substrate->k_interpolated(wavelength);
-            if (sz_wl not_eq n_data.size() or sz_wl not_eq k_data.size()) {
-                qWarning("n_data size does not match k_data size");
-                return {};
-            }
-            for (qsizetype i = 0; i < sz_wl; i++) {
-                indices[(num_mat_layers - 1) * sz_wl + i] = {n_data.at(i), k_data.at(i)};
-            }
-        }
-        for (std::size_t i = 0; i < structure.size(); i++) {
-            for (qsizetype j = 0; j < sz_wl; j++) {
-                const QList<double> n_data = structure.at(i).first->n_interpolated(wavelength);
-                const QList<double> k_data = structure.at(i).first->k_interpolated(wavelength);
-                indices[(i + 1) * sz_wl + j] = {n_data.at(j), k_data.at(j)};
-            }
-        }
-        // substrate irrelevant if no_back_reflection = True
-        if (no_back_reflection) {
-            for (qsizetype i = 0; i < sz_wl; i++) {
-                const T absorbing_k = k_absorbing(std::forward<T>(wavelength));
-                indices[(num_mat_layers - 1) * sz_wl + i] = absorbing_k[i];
-            }
+        const std::vector<std::valarray<std::complex<typename T::value_type>>> rows = layer_rows(std::forward<T_WL>(wavelength)).first;
+        U indices(rows.size() * sz_wl);
+        for (std::size_t i = 0; i < rows.size(); i++) {
+            indices[std::slice(i * sz_wl, sz_wl, 1)] = rows.at(i);
         }
         return indices;
     }
@@ -135,45 +114,40 @@ public:
     template<typename U, FloatingList T_WL>
     requires std::same_as<U, std::vector<std::valarray<std::complex<typename T::value_type>>>>
     U get_indices(T_WL &&wavelength) {
+        return layer_rows(std::forward<T_WL>(wavelength)).first;
+    }
+
+    /*
+     * Absorption coefficient alpha = 4 pi k / lambda of each row of get_indices(), as (layer, wavelength), e.g. the
+     * alphas of inc_position_resolved(). In the inverse units of the wavelengths.
+     */
+    template<FloatingList T_WL>
+    Utils::Tensor<typename T::value_type, 2> get_alphas(T_WL &&wavelength) {
         const std::size_t sz_wl = wavelength.size();
-        U indices(num_mat_layers, std::valarray<std::complex<typename T::value_type>>(1, sz_wl));
-        if (incidence) {
-            const QList<double> n_data = incidence->n_interpolated(wavelength);
-            const QList<double> k_data = incidence->k_interpolated(wavelength);
-            if (sz_wl not_eq n_data.size() or sz_wl not_eq k_data.size()) {
-                qWarning("n_data size does not match k_data size");
-                return {};
-            }
-            for (qsizetype i = 0; i < sz_wl; i++) {
-                indices.front()[i] = {n_data.at(i), k_data.at(i)};
-            }
+        const std::vector<std::valarray<typename T::value_type>> rows = layer_rows(std::forward<T_WL>(wavelength)).second;
+        Utils::Tensor<typename T::value_type, 2> alphas({rows.size(), sz_wl});
+        for (std::size_t i = 0; i < rows.size(); i++) {
+            alphas[i].assign(rows.at(i));
         }
-        if (substrate) {
-            const QList<double> n_data = substrate->n_interpolated(wavelength);
-            const QList<double> k_data = substrate->k_interpolated(wavelength);
-            if (sz_wl not_eq n_data.size() or sz_wl not_eq k_data.size()) {
-                qWarning("n_data size does not match k_data size");
-                return {};
-            }
-            for (qsizetype i = 0; i < sz_wl; i++) {
-                indices.back()[i] = {n_data.at(i), k_data.at(i)};
-            }
-        }
-        for (std::size_t i = 0; i < structure.size(); i++) {
-            for (qsizetype j = 0; j < sz_wl; j++) {
-                const QList<double> n_data = structure.at(i).first->n_interpolated(wavelength);
-                const QList<double> k_data = structure.at(i).first->k_interpolated(wavelength);
-                indices.at(i + 1)[j] = {n_data.at(j), k_data.at(j)};
-            }
+        return alphas;
+    }
+
+    /*
+     * Grades the composition of the structure layer with index layer linearly from x_front to x_back over num_slices
+     * sublayers of equal thickness. Each sublayer takes n and k at the composition of its middle, interpolated in
+     * composition and in wavelength (see OpticMaterial::nk_graded). Every sublayer counts as a layer of the stack,
+     * e.g. in the coherency list of calculate_rat().
+     */
+    void set_grade(const std::size_t layer, const double x_front, const double x_back, const std::size_t num_slices) {
+        if (layer >= structure.size()) {
+            throw std::out_of_range("Graded layer index is out of the structure.");
         }
-        // substrate irrelevant if no_back_reflection = True
-        if (no_back_reflection) {
-            for (qsizetype i = 0; i < sz_wl; i++) {
-                const T absorbing_k = k_absorbing(std::forward<T>(wavelength));
-                indices.back()[i] = absorbing_k[i];
-            }
+        if (num_slices == 0) {
+            throw std::invalid_argument("A graded layer needs at least one slice.");
         }
-        return indices;
+        const std::size_t old_slices = grades.contains(layer) ? grades.at(layer).num_slices : 1;
+        num_mat_layers = num_mat_layers + num_slices - old_slices;
+        grades.insert_or_assign(layer, Grade{x_front, x_back, num_slices});
     }
 
     template<FloatingList U>
@@ -186,7 +160,97 @@ private:
     OpticMaterial<T> *substrate;
     OpticMaterial<T> *incidence;
 
-    T k_absorbing(T &&wavelength);
+    struct Grade {
+        double x_front;
+        double x_back;
+        std::size_t num_slices;
+
+        [[nodiscard]] std::valarray<double> fractions() const {
+            std::valarray<double> x(num_slices);
+            for (std::size_t s = 0; s < num_slices; s++) {
+                x[s] = x_front + (x_back - x_front) * (static_cast<double>(s) + 0.5) / static_cast<double>(num_slices);
+            }
+            return x;
+        }
+    };
+    // structure index -> grade
+    std::map<std::size_t, Grade> grades;
+
+    /*
+     * The rows of get_indices() and get_alphas(), in the order of get_widths(): incidence (or 1), the structure with
+     * graded layers expanded into their slices, the back absorbing layer if no_back_reflection, and the substrate
+     * (or 1). The materials are queried from SpectralCache at once, so each is interpolated once per wavelength grid,
+     * also across stacks.
+     */
+    template<FloatingList T_WL>
+    std::pair<std::vector<std::valarray<std::complex<typename T::value_type>>>,
+              std::vector<std::valarray<typename T::value_type>>> layer_rows(T_WL &&wavelength) {
+        using V = typename T::value_type;
+        const std::size_t sz_wl = wavelength.size();
+        std::valarray<V> wl(sz_wl);
+        std::ranges::copy(wavelength, std::begin(wl));
+        std::vector<OpticMaterial<T> *> materials{incidence};
+        for (std::size_t i = 0; i < structure.size(); i++) {
+            if (not grades.contains(i)) {
+                materials.push_back(structure.at(i).first);
+            }
+        }
+        // substrate irrelevant if no_back_reflection = True
+        if (not no_back_reflection) {
+            materials.push_back(substrate);
+        }
+        const SpectralData<V> data = SpectralCache<T>::instance().query(materials, wl);
+        std::vector<std::valarray<std::complex<V>>> rows;
+        std::vector<std::valarray<V>> alphas;
+        rows.reserve(num_mat_layers + 3);
+        alphas.reserve(num_mat_layers + 3);
+        std::size_t next = 0;
+        const auto push_material = [&data, &rows, &alphas, &next, sz_wl]() -> void {
+            const std::valarray<V> n = data.n[next].flat();
+            const std::valarray<V> k = data.k[next].flat();
+            std::valarray<std::complex<V>> row(sz_wl);
+            for (std::size_t j = 0; j < sz_wl; j++) {
+                row[j] = {n[j], k[j]};
+            }
+            rows.push_back(std::move(row));
+            alphas.push_back(data.alpha[next].flat());
+            next++;
+        };
+        const auto push_row = [&rows, &alphas, &wl](std::valarray<std::complex<V>> &&row) -> void {
+            std::valarray<V> alpha(wl.size());
+            for (std::size_t j = 0; j < wl.size(); j++) {
+                alpha[j] = 4 * std::numbers::pi_v<V> * row[j].imag() / wl[j];
+            }
+            rows.push_back(std::move(row));
+            alphas.push_back(std::move(alpha));
+        };
+        push_material();  // incidence
+        for (std::size_t i = 0; i < structure.size(); i++) {
+            if (const auto grade = grades.find(i); grade not_eq grades.end()) {
+                for (std::valarray<std::complex<V>> &slice : structure.at(i).first->nk_graded(grade->second.fractions(), wavelength)) {
+                    push_row(std::move(slice));
+                }
+            } else {
+                push_material();
+            }
+        }
+        if (no_back_reflection) {
+            // Index-matched to the bottom layer of the stack, so that light enters it without reflection
+            const std::valarray<V> absorbing_k = k_absorbing(wl, rows.back());
+            std::valarray<std::complex<V>> absorbing(sz_wl);
+            for (std::size_t i = 0; i < sz_wl; i++) {
+                absorbing[i] = {rows.back()[i].real(), absorbing_k[i]};
+            }
+            push_row(std::move(absorbing));
+            push_row(std::valarray<std::complex<V>>(1, sz_wl));
+        } else {
+            push_material();  // substrate
+        }
+        return {std::move(rows), std::move(alphas)};
+    }
+
+    static std::valarray<typename T::value_type> k_absorbing(const std::valarray<typename T::value_type> &wl,
+                                                             const std::valarray<std::complex<typename T::value_type>> &bottom);
 };
 
 #endif  // SUISAPP_OPTICSTACK_H
@@ -0,0 +1,25 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_RATDICT_H
+#define SUISAPP_RATDICT_H
+
+#include <string>
+#include <unordered_map>
+#include <valarray>
+#include <variant>
+
+#include "utils/Tensor.h"
+
+/*
+ * R: std::valarray<T>
+ * A: std::valarray<T>
+ * T: std::valarray<T>
+ * A_per_layer: Utils::Tensor<T, 2> (layer, wavelength)
+ * R_rev, A_rev, T_rev, A_per_layer_rev: the same for rear illumination (bidirectional calculate_rat() only)
+ */
+template<typename T>
+using rat_dict = std::unordered_map<std::string, std::variant<std::valarray<T>, Utils::Tensor<T, 2>>>;
+
+#endif //SUISAPP_RATDICT_H
@@ -0,0 +1,213 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <numbers>
+#include <stdexcept>
+#include "Spectrum.h"
+#include "utils/CSV.h"
+#include "utils/Math.h"
+
+namespace {
+    constexpr double h = 6.62607015e-34;  // Planck constant [J s]
+    constexpr double c = 299792458;  // Speed of light [m s-1]
+    constexpr double k_B = 1.380649e-23;  // Boltzmann constant [J K-1]
+    constexpr double q = 1.602176634e-19;  // Elementary charge [C]
+
+    /*
+     * Numeric columns of the rows of CSV data that start with a number; source names the data in errors.
+     */
+    auto read_columns(const std::vector<std::vector<std::string>> &data, const std::string &source,
+                      const std::size_t num_columns) -> std::vector<std::vector<double>> {
+        if (data.empty()) {
+            throw std::runtime_error("Cannot read spectrum file " + source);
+        }
+        std::vector<std::vector<double>> columns(num_columns);
+        for (const std::vector<std::string> &row : data) {
+            if (row.size() < num_columns) {
+                continue;
+            }
+            std::vector<double> values(num_columns);
+            bool numeric = true;
+            for (std::size_t col = 0; col < num_columns and numeric; col++) {
+                const std::string &cell = row.at(col);
+                const char *first = cell.data();
+                const char *last = cell.data() + cell.size();
+                while (first not_eq last and *first == ' ') {
+                    ++first;
+                }
+                numeric = std::from_chars(first, last, values.at(col)).ec == std::errc();
+            }
+            if (numeric) {
+                for (std::size_t col = 0; col < num_columns; col++) {
+                    columns.at(col).push_back(values.at(col));
+                }
+            }
+        }
+        if (columns.front().size() < 2) {
+            throw std::runtime_error("Spectrum file " + source + " has less than two rows of data.");
+        }
+        return columns;
+    }
+}
+
+template<std::floating_point T>
+auto blackbody_photon_flux(const std::valarray<T> &lam_vac, const T temperature) -> std::valarray<T> {
+    std::valarray<T> flux(lam_vac.size());
+    for (std::size_t j = 0; j < lam_vac.size(); j++) {
+        const T lam = lam_vac[j];
+        flux[j] = 2 * std::numbers::pi_v<T> * T(c) / (lam * lam * lam * lam) / std::expm1(T(h * c / k_B) / (lam * temperature));
+    }
+    return flux;
+}
+
+template auto blackbody_photon_flux(const std::valarray<double> &lam_vac, double temperature) -> std::valarray<double>;
+
+template<std::floating_point T>
+void SpectrumLibrary<T>::add_table(const std::string &name, std::valarray<T> wavelength, std::valarray<T> irradiance) {
+    if (wavelength.size() not_eq irradiance.size() or wavelength.size() < 2) {
+        throw std::invalid_argument("A spectrum needs as many irradiance values as wavelengths, at least two.");
+    }
+    if (not std::ranges::is_sorted(wavelength)) {
+        throw std::invalid_argument("The wavelengths of a spectrum must be increasing.");
+    }
+    const std::lock_guard<std::mutex> lock(mutex);
+    tables.insert_or_assign(name, Table{std::move(wavelength), std::move(irradiance)});
+    std::erase_if(cache, [&name](const auto &entry) -> bool {
+        return entry.first.starts_with(name + '\n');
+    });
+}
+
+template<std::floating_point T>
+void SpectrumLibrary<T>::load_table(const std::string &name, const std::string &filename) {
+    const std::vector<std::vector<double>> columns = read_columns(Utils::CSV::readCSV(filename), filename, 2);
+    std::valarray<T> wavelength(columns.front().size());
+    std::valarray<T> irradiance(columns.front().size());
+    // nm -> m and W m-2 nm-1 -> W m-2 m-1
+    std::ranges::transform(columns.front(), std::begin(wavelength), [](const double wl) -> T {
+        return static_cast<T>(wl * 1e-9);
+    });
+    std::ranges::transform(columns.back(), std::begin(irradiance), [](const double e) -> T {
+        return static_cast<T>(e * 1e9);
+    });
+    add_table(name, std::move(wavelength), std::move(irradiance));
+}
+
+template<std::floating_point T>
+void SpectrumLibrary<T>::load_astm_g173(const std::string &filename) {
+    std::ifstream file(filename);
+    load_astm_g173(file, filename);
+}
+
+template<std::floating_point T>
+void SpectrumLibrary<T>::load_astm_g173(std::istream &stream, const std::string &source) {
+    const std::vector<std::vector<double>> columns = read_columns(Utils::CSV::readCSV(stream), source, 4);
+    const std::size_t num_rows = columns.front().size();
+    std::valarray<T> wavelength(num_rows);
+    std::ranges::transform(columns.front(), std::begin(wavelength), [](const double wl) -> T {
+        return static_cast<T>(wl * 1e-9);
+    });
+    for (const auto &[name, col] : {std::pair<std::string, std::size_t>{"AM0", 1}, {"AM15", 2}, {"AM15D", 3}}) {
+        std::valarray<T> irradiance(num_rows);
+        std::ranges::transform(columns.at(col), std::begin(irradiance), [](const double e) -> T {
+            return static_cast<T>(e * 1e9);
+        });
+        add_table(name, wavelength, std::move(irradiance));
+    }
+}
+
+template<std::floating_point T>
+auto SpectrumLibrary<T>::contains(const std::string &name) const -> bool {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return name == "laser" or name == "blackbody" or tables.contains(name);
+}
+
+template<std::floating_point T>
+auto SpectrumLibrary<T>::photon_flux(const LightSource<T> &source, const std::valarray<T> &lam_vac) const -> std::valarray<T> {
+    if (source.name == "blackbody") {
+        return source.dilution * blackbody_photon_flux(lam_vac, source.temperature);
+    }
+    const auto table = tables.find(source.name);
+    if (table == tables.end()) {
+        throw std::out_of_range("Unknown light source " + source.name);
+    }
+    const std::valarray<T> &wl = table->second.wavelength;
+    const std::valarray<T> &irradiance = table->second.irradiance;
+    std::valarray<T> flux(T(0), lam_vac.size());
+    for (std::size_t j = 0; j < lam_vac.size(); j++) {
+        if (lam_vac[j] < wl[0] or lam_vac[j] > wl[wl.size() - 1]) {
+            continue;
+        }
+        const std::size_t upper = std::distance(std::begin(wl), std::upper_bound(std::begin(wl), std::end(wl) - 1, lam_vac[j]));
+        const T frac = (lam_vac[j] - wl[upper - 1]) / (wl[upper] - wl[upper - 1]);
+        // Energy to photons
+        flux[j] = std::lerp(irradiance[upper - 1], irradiance[upper], frac) * lam_vac[j] / T(h * c);
+    }
+    return flux;
+}
+
+template<std::floating_point T>
+auto SpectrumLibrary<T>::weights(const LightSource<T> &source, const std::valarray<T> &lam_vac,
+                                 const Quadrature quadrature) -> std::valarray<T> {
+    if (lam_vac.size() == 0) {
+        return {};
+    }
+    if (not std::ranges::is_sorted(lam_vac)) {
+        throw std::invalid_argument("The wavelengths must be increasing.");
+    }
+    if (source.name == "laser") {
+        // Photon flux of the laser, put on the two grid points around its wavelength
+        std::valarray<T> w(T(0), lam_vac.size());
+        const T num_photons = source.intensity * source.power * source.wavelength / T(h * c);
+        if (source.wavelength < lam_vac[0] or source.wavelength > lam_vac[lam_vac.size() - 1]) {
+            return w;
+        }
+        if (lam_vac.size() == 1) {
+            w[0] = num_photons;
+            return w;
+        }
+        const std::size_t upper = std::distance(std::begin(lam_vac), std::upper_bound(std::begin(lam_vac) + 1, std::end(lam_vac) - 1, source.wavelength));
+        const T frac = (source.wavelength - lam_vac[upper - 1]) / (lam_vac[upper] - lam_vac[upper - 1]);
+        w[upper - 1] = (1 - frac) * num_photons;
+        w[upper] = frac * num_photons;
+        return w;
+    }
+    const std::string key = source.name + '\n' + std::to_string(source.temperature) + '\n' +
+            std::to_string(source.dilution) + '\n' + std::to_string(static_cast<int>(quadrature));
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (const auto cached = cache.find(key); cached not_eq cache.end() and
+            cached->second.lam_vac.size() == lam_vac.size() and
+            std::ranges::equal(cached->second.lam_vac, lam_vac)) {
+        return source.intensity * cached->second.weights;
+    }
+    const std::valarray<T> quad = quadrature == Quadrature::Simpson ? Utils::Math::simpson_weights(lam_vac) :
+            Utils::Math::trapezoid_weights(lam_vac);
+    std::valarray<T> w = photon_flux(source, lam_vac) * quad;
+    cache.insert_or_assign(key, CachedWeights{lam_vac, w});
+    return source.intensity * w;
+}
+
+template class SpectrumLibrary<double>;
+
+template<std::floating_point T>
+auto photocurrent(const Utils::Tensor<T, 2> &A_per_layer, const std::valarray<T> &weights) -> std::valarray<T> {
+    const std::size_t num_layers = A_per_layer.shape(0);
+    if (A_per_layer.shape(1) not_eq weights.size()) {
+        throw std::invalid_argument("A_per_layer and the weights have different numbers of wavelengths.");
+    }
+    if (num_layers < 2) {
+        throw std::invalid_argument("A_per_layer must have the R and T rows.");
+    }
+    std::valarray<T> current(num_layers - 2);
+    for (std::size_t i = 1; i + 1 < num_layers; i++) {
+        current[i - 1] = T(q) * (A_per_layer[i].flat() * weights).sum();
+    }
+    return current;
+}
+
+template auto photocurrent(const Utils::Tensor<double, 2> &A_per_layer,
+                           const std::valarray<double> &weights) -> std::valarray<double>;
@@ -0,0 +1,105 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_SPECTRUM_H
+#define SUISAPP_SPECTRUM_H
+
+#include <concepts>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <valarray>
+
+#include "utils/Tensor.h"
+
+enum class Quadrature { Trapezoid, Simpson };
+
+/*
+ * A light source as in ParameterClass: light_source1/2 names the spectrum, laser_lambda1/2 the laser wavelength and
+ * int1/2 the intensity in suns (or multiples of the laser power).
+ * - "laser": monochromatic light of wavelength (in m) and power (in W m-2), e.g. pulsepow * 10.
+ * - "blackbody": a black body of temperature (in K) seen under the solid angle of the sun from the earth by default.
+ * - Any other name is a tabulated spectrum of the SpectrumLibrary, e.g. "AM15" and "AM0" from ASTM G173.
+ */
+template<std::floating_point T>
+struct LightSource {
+    std::string name = "AM15";
+    T intensity = 1;
+    T wavelength = 0;
+    T power = 0;
+    T temperature = 5778;
+    // (R_sun / 1 au)^2
+    T dilution = 2.1646e-5;
+};
+
+/*
+ * Spectral photon flux in m-2 s-1 m-1 emitted by a black body of the given temperature (in K) into a hemisphere,
+ * 2 * pi * c / lambda^4 / (exp(h * c / (lambda * k * T)) - 1), at the wavelengths lam_vac (in m).
+ */
+template<std::floating_point T>
+auto blackbody_photon_flux(const std::valarray<T> &lam_vac, T temperature) -> std::valarray<T>;
+
+/*
+ * Reference spectra and the photon flux weights derived from them.
+
+ * A tabulated spectrum is the spectral irradiance in W m-2 m-1 at increasing wavelengths in m. It is resampled by
+ * linear interpolation (zero outside the table) onto the wavelength grid of a stack and converted to photon flux. The
+ * weights w of a grid, with the quadrature weights folded in, give the absorbed photon flux of a layer as
+ * (w * A).sum() for its row A of A_per_layer. They are cached per source and grid, since every optics run of a
+ * device uses the same grid.
+ */
+template<std::floating_point T>
+class SpectrumLibrary {
+public:
+    void add_table(const std::string &name, std::valarray<T> wavelength, std::valarray<T> irradiance);
+    /*
+     * Reads two columns, wavelength in nm and spectral irradiance in W m-2 nm-1, from a CSV file; rows that do not
+     * start with a number (headers) are skipped.
+     */
+    void load_table(const std::string &name, const std::string &filename);
+    /*
+     * Reads the ASTM G173-03 reference spectra CSV published by NREL (wavelength, extraterrestrial, global tilt and
+     * direct + circumsolar irradiance) as "AM0", "AM15" and "AM15D".
+     */
+    void load_astm_g173(const std::string &filename);
+    /*
+     * As above from a stream, e.g., the copy bundled as a resource; source names it in errors.
+     */
+    void load_astm_g173(std::istream &stream, const std::string &source);
+    [[nodiscard]] auto contains(const std::string &name) const -> bool;
+
+    /*
+     * Photon flux weights of the source on the grid lam_vac (in m, increasing). A laser puts its photon flux on the
+     * two grid points around its wavelength, so that (w * A).sum() is A interpolated linearly at the laser
+     * wavelength, whatever the quadrature.
+     */
+    auto weights(const LightSource<T> &source, const std::valarray<T> &lam_vac,
+                 Quadrature quadrature = Quadrature::Trapezoid) -> std::valarray<T>;
+
+private:
+    struct Table {
+        std::valarray<T> wavelength;
+        std::valarray<T> irradiance;
+    };
+    struct CachedWeights {
+        std::valarray<T> lam_vac;
+        std::valarray<T> weights;
+    };
+    std::unordered_map<std::string, Table> tables;
+    std::unordered_map<std::string, CachedWeights> cache;
+    mutable std::mutex mutex;
+
+    auto photon_flux(const LightSource<T> &source, const std::valarray<T> &lam_vac) const -> std::valarray<T>;
+};
+
+/*
+ * Photocurrent density in A m-2 generated in each layer if every absorbed photon is collected (Jsc,max), from
+ * A_per_layer (layer, wavelength) and the photon flux weights of SpectrumLibrary::weights(). The first and last rows
+ * of A_per_layer are R and T, so the result has one element per inner layer.
+ */
+template<std::floating_point T>
+auto photocurrent(const Utils::Tensor<T, 2> &A_per_layer, const std::valarray<T> &weights) -> std::valarray<T>;
+
+#endif  // SUISAPP_SPECTRUM_H
@@ -0,0 +1,264 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <boost/numeric/ublas/vector.hpp>
+#include "TexturedStack.h"
+#include "tmm.h"
+
+template<std::floating_point T>
+InterfaceTable<T>::InterfaceTable(const std::vector<std::valarray<std::complex<T>>> &n_list,
+                                  const std::vector<T> &d_list, const std::valarray<T> &lam_vac,
+                                  const std::size_t num_angles) : theta(num_angles + 1), num_wl(lam_vac.size()),
+                                                                  R(0.0, (num_angles + 1) * lam_vac.size()),
+                                                                  Tr(0.0, (num_angles + 1) * lam_vac.size()) {
+    if (num_angles < 2) {
+        throw std::invalid_argument("An interface table needs at least two angles.");
+    }
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_batch = num_angles * num_wl;
+    for (std::size_t a = 0; a <= num_angles; a++) {
+        theta[a] = std::numbers::pi_v<T> / 2 * static_cast<T>(a) / static_cast<T>(num_angles);
+    }
+    // Angle-major tiling: element a * num_wl + j belongs to theta[a] and lam_vac[j].
+    std::vector<std::valarray<std::complex<T>>> n_tiled(num_layers, std::valarray<std::complex<T>>(num_batch));
+    std::valarray<T> lam_tiled(num_batch);
+    std::valarray<std::complex<T>> th_tiled(num_batch);
+    for (std::size_t a = 0; a < num_angles; a++) {
+        const std::slice angle(a * num_wl, num_wl, 1);
+        lam_tiled[angle] = lam_vac;
+        th_tiled[angle] = theta[a];
+        for (std::size_t i = 0; i < num_layers; i++) {
+            n_tiled.at(i)[angle] = n_list.at(i);
+        }
+    }
+    const std::slice batch(0, num_batch, 1);
+    for (const char pol : {'s', 'p'}) {
+        const coh_tmm_vecn_dict<T> coh_tmm_data = coh_tmm(pol, n_tiled, d_list, th_tiled, lam_tiled);
+        R[batch] += std::valarray<T>(std::get<std::valarray<T>>(coh_tmm_data.at("R")) / T(2));
+        Tr[batch] += std::valarray<T>(std::get<std::valarray<T>>(coh_tmm_data.at("T")) / T(2));
+    }
+    R[std::slice(num_batch, num_wl, 1)] = 1;
+}
+
+template<std::floating_point T>
+auto InterfaceTable<T>::at(const T angle) const -> std::pair<std::valarray<T>, std::valarray<T>> {
+    const std::size_t num_angles = theta.size() - 1;
+    const T step = theta[1];
+    const T clamped = std::clamp(angle, T(0), theta[num_angles]);
+    const std::size_t a = std::min(static_cast<std::size_t>(clamped / step), num_angles - 1);
+    const T f = (clamped - theta[a]) / step;
+    const std::slice lo(a * num_wl, num_wl, 1);
+    const std::slice hi((a + 1) * num_wl, num_wl, 1);
+    return {(1 - f) * std::valarray<T>(R[lo]) + f * std::valarray<T>(R[hi]),
+            (1 - f) * std::valarray<T>(Tr[lo]) + f * std::valarray<T>(Tr[hi])};
+}
+
+template<std::floating_point T>
+TexturedStack<T>::TexturedStack(const std::vector<std::valarray<std::complex<T>>> &front_n,
+                                const std::vector<T> &front_d, const std::valarray<T> &lam_vac, const T base_angle,
+                                const std::size_t num_bins, const std::size_t num_rays, const std::size_t num_angles,
+                                const std::uint_fast32_t seed) : lam_vac(lam_vac), n_bulk(front_n.back()),
+                                                                 num_bins(num_bins), num_angles(num_angles) {
+    if (front_n.size() < 2 or front_n.size() not_eq front_d.size()) {
+        throw std::invalid_argument("front_n and front_d must have the same length of at least 2.");
+    }
+    if (num_bins == 0 or num_rays == 0) {
+        throw std::invalid_argument("num_bins and num_rays must be positive.");
+    }
+    if (base_angle <= 0 or base_angle >= std::numbers::pi_v<T> / 2) {
+        throw std::invalid_argument("The base angle must lie in (0, pi / 2).");
+    }
+    const std::size_t num_wl = lam_vac.size();
+    const InterfaceTable<T> front(front_n, front_d, lam_vac, num_angles);
+    // From inside, the bulk is the incidence medium, which the TMM needs transparent; the bulk absorption is
+    // accounted for along the paths between the front and the rear instead.
+    std::vector<std::valarray<std::complex<T>>> int_n(front_n.rbegin(), front_n.rend());
+    int_n.front() = std::valarray<std::complex<T>>(num_wl);
+    for (std::size_t j = 0; j < num_wl; j++) {
+        int_n.front()[j] = n_bulk[j].real();
+    }
+    const InterfaceTable<T> internal(int_n, std::vector<T>(front_d.rbegin(), front_d.rend()), lam_vac, num_angles);
+
+    const T sin_a = std::sin(base_angle);
+    const T cos_a = std::cos(base_angle);
+    // Outward (upward) facet normals of upright pyramids
+    const std::array<std::array<T, 3>, 4> normals = {{{sin_a, 0, cos_a}, {-sin_a, 0, cos_a},
+                                                      {0, sin_a, cos_a}, {0, -sin_a, cos_a}}};
+    const auto dot = [](const std::array<T, 3> &u, const std::array<T, 3> &v) -> T {
+        return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+    };
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<T> uni(0, 1);
+    // Picks a facet with a probability proportional to sign * dot(dir, normal) where positive.
+    const auto pick_facet = [&](const std::array<T, 3> &dir, const T sign) -> std::size_t {
+        std::array<T, 4> proj{};
+        for (std::size_t k = 0; k < 4; k++) {
+            proj[k] = std::max(sign * dot(dir, normals[k]), T(0));
+        }
+        T target = uni(gen) * (proj[0] + proj[1] + proj[2] + proj[3]);
+        std::size_t k = 0;
+        while (k < 3 and target >= proj[k]) {
+            target -= proj[k++];
+        }
+        return k;
+    };
+    const T bin_width = std::numbers::pi_v<T> / 2 / static_cast<T>(num_bins);
+    constexpr std::size_t max_bounces = 20;
+    const T ray_weight = T(1) / static_cast<T>(num_rays);
+
+    // Dense accumulators, column-major in the source bin: acc[j][target * num_bins + source]
+    std::vector<std::valarray<T>> T_acc(num_wl, std::valarray<T>(0.0, num_bins * num_bins));
+    std::vector<std::valarray<T>> R_acc(num_wl, std::valarray<T>(0.0, num_bins * num_bins));
+    R_front.assign(num_bins, std::valarray<T>(0.0, num_wl));
+    A_front.assign(num_bins, std::valarray<T>(0.0, num_wl));
+    T_int.assign(num_bins, std::valarray<T>(0.0, num_wl));
+    A_int.assign(num_bins, std::valarray<T>(0.0, num_wl));
+    for (std::size_t b = 0; b < num_bins; b++) {
+        for (std::size_t ray = 0; ray < num_rays; ray++) {
+            // From the incidence medium, going down
+            T th = (static_cast<T>(b) + uni(gen)) * bin_width;
+            T phi = 2 * std::numbers::pi_v<T> * uni(gen);
+            std::array<T, 3> d = {std::sin(th) * std::cos(phi), std::sin(th) * std::sin(phi), -std::cos(th)};
+            std::valarray<T> w(ray_weight, num_wl);
+            std::size_t bounce = 0;
+            for (; bounce < max_bounces and d[2] < 0; bounce++) {
+                const std::array<T, 3> &n = normals[pick_facet(d, -1)];
+                const T cos_i = -dot(d, n);
+                const auto [R_k, T_k] = front.at(std::acos(std::min(cos_i, T(1))));
+                for (std::size_t j = 0; j < num_wl; j++) {
+                    const T eta = front_n.front()[j].real() / n_bulk[j].real();
+                    const T cos_t = std::sqrt(std::max(1 - eta * eta * (1 - cos_i * cos_i), T(0)));
+                    // Refracted rays heading up inside a pyramid are binned by their polar angle as well.
+                    const T dz = std::abs(eta * d[2] + (eta * cos_i - cos_t) * n[2]);
+                    T_acc.at(j)[bin_of(std::acos(std::min(dz, T(1)))) * num_bins + b] += w[j] * T_k[j];
+                }
+                A_front.at(b) += w * (1 - R_k - T_k);
+                w *= R_k;
+                for (std::size_t c = 0; c < 3; c++) {
+                    d[c] += 2 * cos_i * n[c];
+                }
+            }
+            // Rays still bouncing after max_bounces carry a weight of at most R^max_bounces.
+            (bounce == max_bounces ? A_front : R_front).at(b) += w;
+
+            // From inside the bulk, going up
+            th = (static_cast<T>(b) + uni(gen)) * bin_width;
+            phi = 2 * std::numbers::pi_v<T> * uni(gen);
+            std::array<T, 3> u = {std::sin(th) * std::cos(phi), std::sin(th) * std::sin(phi), std::cos(th)};
+            w = ray_weight;
+            for (bounce = 0; bounce < max_bounces and u[2] > 0; bounce++) {
+                const std::array<T, 3> &n = normals[pick_facet(u, 1)];
+                const T cos_i = dot(u, n);
+                const auto [R_k, T_k] = internal.at(std::acos(std::min(cos_i, T(1))));
+                T_int.at(b) += w * T_k;
+                A_int.at(b) += w * (1 - R_k - T_k);
+                w *= R_k;
+                for (std::size_t c = 0; c < 3; c++) {
+                    u[c] -= 2 * cos_i * n[c];
+                }
+            }
+            if (bounce == max_bounces) {
+                A_int.at(b) += w;
+            } else {
+                const std::size_t target = bin_of(std::acos(std::min(-u[2], T(1))));
+                for (std::size_t j = 0; j < num_wl; j++) {
+                    R_acc.at(j)[target * num_bins + b] += w[j];
+                }
+            }
+        }
+    }
+    // Row-major push_back keeps the compressed matrices' insertion linear.
+    const auto compress = [num_bins](const std::valarray<T> &dense) -> boost::numeric::ublas::compressed_matrix<T> {
+        boost::numeric::ublas::compressed_matrix<T> sparse(num_bins, num_bins);
+        for (std::size_t r = 0; r < num_bins; r++) {
+            for (std::size_t c = 0; c < num_bins; c++) {
+                if (const T v = dense[r * num_bins + c]; v not_eq 0) {
+                    sparse.push_back(r, c, v);
+                }
+            }
+        }
+        return sparse;
+    };
+    T_front.reserve(num_wl);
+    R_int.reserve(num_wl);
+    for (std::size_t j = 0; j < num_wl; j++) {
+        T_front.emplace_back(compress(T_acc.at(j)));
+        R_int.emplace_back(compress(R_acc.at(j)));
+    }
+}
+
+template<std::floating_point T>
+auto TexturedStack<T>::calculate_rat(const T bulk_width, const T theta_0,
+                                     const std::vector<std::valarray<std::complex<T>>> &rear_n,
+                                     const std::vector<T> &rear_d,
+                                     const T tol) const -> std::unordered_map<std::string, std::valarray<T>> {
+    const std::size_t num_wl = lam_vac.size();
+    std::vector<std::valarray<std::complex<T>>> back_n = rear_n;
+    back_n.front() = std::valarray<std::complex<T>>(num_wl);
+    for (std::size_t j = 0; j < num_wl; j++) {
+        back_n.front()[j] = n_bulk[j].real();
+    }
+    const InterfaceTable<T> rear(back_n, rear_d, lam_vac, num_angles);
+    std::vector<std::valarray<T>> R_rear(num_bins);
+    std::vector<std::valarray<T>> T_rear(num_bins);
+    std::valarray<T> cos_bin(num_bins);
+    for (std::size_t b = 0; b < num_bins; b++) {
+        std::tie(R_rear.at(b), T_rear.at(b)) = rear.at(bin_centre(b));
+        cos_bin[b] = std::cos(bin_centre(b));
+    }
+    const std::size_t b_in = bin_of(theta_0);
+    std::valarray<T> R(num_wl);
+    std::valarray<T> Tr(0.0, num_wl);
+    std::valarray<T> A_coat(num_wl);
+    std::valarray<T> A_bulk(0.0, num_wl);
+    std::valarray<T> A_back(0.0, num_wl);
+    boost::numeric::ublas::vector<T> unit(num_bins, 0);
+    unit(b_in) = 1;
+    boost::numeric::ublas::vector<T> u(num_bins);
+    for (std::size_t j = 0; j < num_wl; j++) {
+        R[j] = R_front.at(b_in)[j];
+        A_coat[j] = A_front.at(b_in)[j];
+        const T alpha = 4 * std::numbers::pi_v<T> * n_bulk[j].imag() / lam_vac[j];
+        const std::valarray<T> att = std::exp(-alpha * bulk_width / cos_bin);
+        // Down-going power per bin just below the front
+        boost::numeric::ublas::vector<T> v = boost::numeric::ublas::prod(T_front.at(j), unit);
+        for (std::size_t pass = 0; pass < 1000 and boost::numeric::ublas::sum(v) > tol; pass++) {
+            for (std::size_t b = 0; b < num_bins; b++) {
+                const T down = v(b) * att[b];
+                const T up = down * R_rear.at(b)[j];
+                Tr[j] += down * T_rear.at(b)[j];
+                A_back[j] += down - up - down * T_rear.at(b)[j];
+                u(b) = up * att[b];
+                A_bulk[j] += v(b) - down + up - u(b);
+                R[j] += u(b) * T_int.at(b)[j];
+                A_coat[j] += u(b) * A_int.at(b)[j];
+            }
+            v = boost::numeric::ublas::prod(R_int.at(j), u);
+        }
+        // What is left below tol is eventually absorbed in the bulk.
+        A_bulk[j] += boost::numeric::ublas::sum(v);
+    }
+    return {{"R", R}, {"T", Tr}, {"A_front", A_coat}, {"A_bulk", A_bulk}, {"A_rear", A_back}};
+}
+
+template<std::floating_point T>
+auto TexturedStack<T>::bin_of(const T angle) const -> std::size_t {
+    return std::min(static_cast<std::size_t>(angle / (std::numbers::pi_v<T> / 2) * static_cast<T>(num_bins)),
+                    num_bins - 1);
+}
+
+template<std::floating_point T>
+auto TexturedStack<T>::bin_centre(const std::size_t bin) const -> T {
+    return (static_cast<T>(bin) + T(0.5)) * std::numbers::pi_v<T> / 2 / static_cast<T>(num_bins);
+}
+
+template struct InterfaceTable<double>;
+template class TexturedStack<double>;
@@ -0,0 +1,92 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_TEXTUREDSTACK_H
+#define SUISAPP_TEXTUREDSTACK_H
+
+#include <complex>
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <valarray>
+#include <vector>
+#include <boost/numeric/ublas/matrix_sparse.hpp>
+
+/*
+ * Unpolarized R and T of a planar thin-film interface as a function of the angle of incidence, tabulated on
+ * num_angles equidistant angles in [0, pi / 2) for every wavelength. R[a * num_wl + j] belongs to theta[a] and
+ * lam_vac[j]. Grazing incidence (pi / 2) is appended as R = 1, T = 0.
+ */
+template<std::floating_point T>
+struct InterfaceTable {
+    std::valarray<T> theta;
+    std::size_t num_wl;
+    std::valarray<T> R;
+    std::valarray<T> Tr;
+
+    /*
+     * The interface is n_list.front() | n_list[1 : -1] | n_list.back(), with the coating thicknesses d_list.
+     * All angles and wavelengths go through one angle-vectorized coh_tmm() call per polarization.
+     */
+    InterfaceTable(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+                   const std::valarray<T> &lam_vac, std::size_t num_angles);
+
+    /*
+     * R and T at all wavelengths for one angle of incidence, linearly interpolated in the angle.
+     */
+    auto at(T angle) const -> std::pair<std::valarray<T>, std::valarray<T>>;
+};
+
+/*
+ * Random upright pyramid texture on the front of a thick absorbing bulk (a wafer), with a thin-film coating on the
+ * facets and a planar rear.
+
+ * Rays are traced once through the front surface for every polar-angle bin, both from the incidence medium and from
+ * inside the bulk, using TMM lookup tables (InterfaceTable) for the facet R and T. Each ray carries the weights of
+ * all wavelengths and is split deterministically into reflected and transmitted parts, so the facet sequence is
+ * sampled once for the whole spectrum. The results are cached as angular redistribution matrices per wavelength
+ * (sparse, since a facet only maps a bin to a few bins), and calculate_rat() then only propagates the angular power
+ * distribution between the front and the rear with sparse matrix-vector products.
+
+ * Facets are picked with a probability proportional to their area projected on the ray, which is the usual
+ * statistical model of random pyramids; angles are binned in the polar angle, averaging over the azimuth.
+ */
+template<std::floating_point T>
+class TexturedStack {
+public:
+    /*
+     * front_n: incidence medium, coating layers and bulk; front_d: their thicknesses (inf for the outer two).
+     * base_angle: angle between the facets and the wafer plane, 54.74 degrees for KOH-etched (111) facets.
+     */
+    TexturedStack(const std::vector<std::valarray<std::complex<T>>> &front_n, const std::vector<T> &front_d,
+                  const std::valarray<T> &lam_vac, T base_angle = 0.9553166181245093, std::size_t num_bins = 45,
+                  std::size_t num_rays = 2000, std::size_t num_angles = 91, std::uint_fast32_t seed = 0);
+
+    /*
+     * R, T (out of the rear), A_front (coating), A_bulk and A_rear (rear coating) for light incident at theta_0 from
+     * the incidence medium. rear_n: bulk, rear layers and exit medium; rear_d: their thicknesses.
+     * Stops when the power left in the bulk falls below tol.
+     */
+    auto calculate_rat(T bulk_width, T theta_0, const std::vector<std::valarray<std::complex<T>>> &rear_n,
+                       const std::vector<T> &rear_d, T tol = 1e-6) const -> std::unordered_map<std::string, std::valarray<T>>;
+private:
+    std::valarray<T> lam_vac;
+    std::valarray<std::complex<T>> n_bulk;
+    std::size_t num_bins;
+    std::size_t num_angles;
+    // Incidence bin -> down-going bulk bin, per wavelength
+    std::vector<boost::numeric::ublas::compressed_matrix<T>> T_front;
+    // Up-going bulk bin -> down-going bulk bin, per wavelength
+    std::vector<boost::numeric::ublas::compressed_matrix<T>> R_int;
+    // [bin][wavelength]: total reflection and coating absorption of incident light
+    std::vector<std::valarray<T>> R_front, A_front;
+    // [bin][wavelength]: escape and coating absorption of light hitting the front from the bulk
+    std::vector<std::valarray<T>> T_int, A_int;
+
+    auto bin_of(T angle) const -> std::size_t;
+    auto bin_centre(std::size_t bin) const -> T;
+};
+
+#endif  // SUISAPP_TEXTUREDSTACK_H
@@ -0,0 +1,258 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include "ThicknessOptimizer.h"
+#include "tmm.h"
+
+using namespace std::complex_literals;
+
+template<std::floating_point T>
+ThicknessOptimizer<T>::ThicknessOptimizer(const std::vector<std::valarray<std::complex<T>>> &n_list,
+                                          const std::vector<T> &d_list, std::vector<std::size_t> variable_layers,
+                                          const std::size_t active_layer, const std::valarray<T> &lam_vac,
+                                          const std::valarray<T> &weight, const T th_0) : d_list(d_list),
+                                                                                          variable_layers(std::move(variable_layers)),
+                                                                                          active_layer(active_layer),
+                                                                                          weight(weight) {
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_wl = lam_vac.size();
+    if (weight.size() not_eq num_wl) {
+        throw std::invalid_argument("weight and lam_vac must have the same size.");
+    }
+    if (active_layer < 1 or active_layer + 1 >= num_layers) {
+        throw std::invalid_argument("The active layer must be a finite layer.");
+    }
+    if (std::ranges::any_of(this->variable_layers, [num_layers](const std::size_t i) -> bool {
+        return i < 1 or i + 1 >= num_layers;
+    })) {
+        throw std::invalid_argument("Variable layers must be finite layers.");
+    }
+    // Thickness-independent, so any d_list gives the same angles and wavevectors.
+    const coh_tmm_vecn_dict<T> coh_tmm_data = coh_tmm('s', n_list, d_list, std::complex<T>(th_0), lam_vac);
+    const std::vector<std::valarray<std::complex<T>>> th_list = std::get<std::vector<std::valarray<std::complex<T>>>>(coh_tmm_data.at("th_list"));
+    kz_list = std::get<std::vector<std::valarray<std::complex<T>>>>(coh_tmm_data.at("kz_list"));
+    std::vector<std::valarray<std::complex<T>>> cos_list(num_layers);
+    for (std::size_t i = 0; i < num_layers; i++) {
+        cos_list.at(i) = std::cos(th_list.at(i));
+    }
+    for (std::size_t p = 0; p < 2; p++) {
+        r_list.at(p).resize(num_layers - 1);
+        t_list.at(p).resize(num_layers - 1);
+        for (std::size_t i = 0; i < num_layers - 1; i++) {
+            const std::valarray<std::complex<T>> ni_ci = n_list.at(i) * cos_list.at(i);
+            const std::valarray<std::complex<T>> nf_cf = n_list.at(i + 1) * cos_list.at(i + 1);
+            const std::valarray<std::complex<T>> nf_ci = n_list.at(i + 1) * cos_list.at(i);
+            const std::valarray<std::complex<T>> ni_cf = n_list.at(i) * cos_list.at(i + 1);
+            if (p == 0) {
+                r_list.at(p).at(i) = (ni_ci - nf_cf) / (ni_ci + nf_cf);
+                t_list.at(p).at(i) = T(2) * ni_ci / (ni_ci + nf_cf);
+            } else {
+                r_list.at(p).at(i) = (nf_ci - ni_cf) / (nf_ci + ni_cf);
+                t_list.at(p).at(i) = T(2) * ni_ci / (nf_ci + ni_cf);
+            }
+        }
+        poyn_factor.at(p).resize(num_layers);
+        for (std::size_t i = 0; i < num_layers; i++) {
+            poyn_factor.at(p).at(i).resize(num_wl);
+            for (std::size_t j = 0; j < num_wl; j++) {
+                const std::complex<T> n_0 = n_list.front()[j];
+                const std::complex<T> cos_0 = cos_list.front()[j];
+                poyn_factor.at(p).at(i)[j] = p == 0 ? n_list.at(i)[j] * cos_list.at(i)[j] / (n_0 * cos_0).real() :
+                                             n_list.at(i)[j] * std::conj(cos_list.at(i)[j]) / (n_0 * std::conj(cos_0)).real();
+            }
+        }
+    }
+}
+
+template<std::floating_point T>
+auto ThicknessOptimizer<T>::objective(const std::valarray<T> &thickness) const -> std::pair<T, std::valarray<T>> {
+    const std::size_t num_vars = variable_layers.size();
+    if (thickness.size() not_eq num_vars) {
+        throw std::invalid_argument("One thickness per variable layer is required.");
+    }
+    const std::size_t num_layers = kz_list.size();
+    const std::size_t num_wl = weight.size();
+    std::vector<T> d = d_list;
+    // Variable index of each layer, or num_vars
+    std::vector<std::size_t> var_of(num_layers, num_vars);
+    for (std::size_t v = 0; v < num_vars; v++) {
+        d.at(variable_layers.at(v)) = thickness[v];
+        var_of.at(variable_layers.at(v)) = v;
+    }
+    using Vec = std::array<std::complex<T>, 2>;
+    T J = 0;
+    std::valarray<T> grad(0.0, num_vars);
+    std::vector<Vec> du(num_vars);
+    std::vector<Vec> du_a(num_vars);
+    std::vector<Vec> du_b(num_vars);
+    for (std::size_t p = 0; p < 2; p++) {
+        const std::vector<std::valarray<std::complex<T>>> &r = r_list.at(p);
+        const std::vector<std::valarray<std::complex<T>>> &t = t_list.at(p);
+        for (std::size_t j = 0; j < num_wl; j++) {
+            // u_i = M_i * u_(i + 1) with u = (1, 0) in the last medium; vw_i = t * u_i with t = 1 / Mtilde(0, 0).
+            Vec u = {1, 0};
+            std::ranges::fill(du, Vec{0, 0});
+            Vec u_a{};
+            Vec u_b = u;
+            du_b = du;
+            for (std::size_t i = num_layers - 2; i > 0; i--) {
+                std::complex<T> delta = kz_list.at(i)[j] * d.at(i);
+                // Same clipping of almost opaque layers as coh_tmm(); the clipped phase no longer depends on d.
+                const bool clipped = delta.imag() > 35;
+                if (clipped) {
+                    delta = {delta.real(), 35};
+                }
+                const std::complex<T> e_m = std::exp(-1i * delta) / t.at(i)[j];
+                const std::complex<T> e_p = std::exp(1i * delta) / t.at(i)[j];
+                const std::complex<T> r_i = r.at(i)[j];
+                const auto apply = [&](const Vec &x) -> Vec {
+                    return {e_m * (x[0] + r_i * x[1]), e_p * (r_i * x[0] + x[1])};
+                };
+                for (std::size_t v = 0; v < num_vars; v++) {
+                    du.at(v) = apply(du.at(v));
+                }
+                u = apply(u);
+                if (const std::size_t v = var_of.at(i); v < num_vars and not clipped) {
+                    // d M_i / d d_i = diag(-1j * kz, 1j * kz) * M_i
+                    du.at(v)[0] -= 1i * kz_list.at(i)[j] * u[0];
+                    du.at(v)[1] += 1i * kz_list.at(i)[j] * u[1];
+                }
+                if (i == active_layer + 1) {
+                    u_b = u;
+                    du_b = du;
+                } else if (i == active_layer) {
+                    u_a = u;
+                    du_a = du;
+                }
+            }
+            const std::complex<T> m00 = (u[0] + r.front()[j] * u[1]) / t.front()[j];
+            const std::complex<T> t_tot = T(1) / m00;
+            // P(vw) = Re(c * conj(v + w) * (v - w)) for s and Re(c * (v + w) * conj(v - w)) for p
+            const auto poyn = [p](const std::complex<T> c, const Vec &vw) -> T {
+                return p == 0 ? (c * std::conj(vw[0] + vw[1]) * (vw[0] - vw[1])).real() :
+                       (c * (vw[0] + vw[1]) * std::conj(vw[0] - vw[1])).real();
+            };
+            const auto poyn_diff = [p](const std::complex<T> c, const Vec &vw, const Vec &dvw) -> T {
+                return p == 0 ? (c * (std::conj(dvw[0] + dvw[1]) * (vw[0] - vw[1]) +
+                                      std::conj(vw[0] + vw[1]) * (dvw[0] - dvw[1]))).real() :
+                       (c * ((dvw[0] + dvw[1]) * std::conj(vw[0] - vw[1]) +
+                             (vw[0] + vw[1]) * std::conj(dvw[0] - dvw[1]))).real();
+            };
+            const Vec vw_a = {t_tot * u_a[0], t_tot * u_a[1]};
+            const Vec vw_b = {t_tot * u_b[0], t_tot * u_b[1]};
+            const std::complex<T> c_a = poyn_factor.at(p).at(active_layer)[j];
+            const std::complex<T> c_b = poyn_factor.at(p).at(active_layer + 1)[j];
+            // Unpolarized: the mean of s and p
+            const T w_j = weight[j] / 2;
+            J += w_j * (poyn(c_a, vw_a) - poyn(c_b, vw_b));
+            for (std::size_t v = 0; v < num_vars; v++) {
+                const std::complex<T> dt_tot = -t_tot * t_tot * (du.at(v)[0] + r.front()[j] * du.at(v)[1]) / t.front()[j];
+                const Vec dvw_a = {dt_tot * u_a[0] + t_tot * du_a.at(v)[0], dt_tot * u_a[1] + t_tot * du_a.at(v)[1]};
+                const Vec dvw_b = {dt_tot * u_b[0] + t_tot * du_b.at(v)[0], dt_tot * u_b[1] + t_tot * du_b.at(v)[1]};
+                grad[v] += w_j * (poyn_diff(c_a, vw_a, dvw_a) - poyn_diff(c_b, vw_b, dvw_b));
+            }
+        }
+    }
+    return {J, grad};
+}
+
+template<std::floating_point T>
+auto ThicknessOptimizer<T>::ascend(std::valarray<T> thickness, const std::valarray<T> &lower,
+                                   const std::valarray<T> &upper, const std::size_t max_iter,
+                                   const T tol) const -> thickness_opt_dict<T> {
+    const auto project = [&lower, &upper](std::valarray<T> x) -> std::valarray<T> {
+        for (std::size_t v = 0; v < x.size(); v++) {
+            x[v] = std::clamp(x[v], lower[v], upper[v]);
+        }
+        return x;
+    };
+    thickness = project(std::move(thickness));
+    auto [J, grad] = objective(thickness);
+    std::size_t evaluations = 1;
+    const T grad_max = std::abs(grad).max();
+    // First step: move the steepest variable by a tenth of its range.
+    T step = grad_max > 0 ? T(0.1) * (upper - lower).max() / grad_max : T(1);
+    std::size_t iter = 0;
+    while (iter < max_iter) {
+        ++iter;
+        bool accepted = false;
+        std::valarray<T> trial;
+        T J_trial = J;
+        std::valarray<T> grad_trial;
+        while (step > std::numeric_limits<T>::epsilon() * std::max(T(1), std::abs(thickness).max())) {
+            trial = project(thickness + step * grad);
+            std::tie(J_trial, grad_trial) = objective(trial);
+            ++evaluations;
+            // Armijo condition along the projected path
+            if (J_trial >= J + T(1e-4) * (grad * (trial - thickness)).sum()) {
+                accepted = true;
+                break;
+            }
+            step /= 2;
+        }
+        if (not accepted) {
+            break;
+        }
+        const std::valarray<T> s = trial - thickness;
+        const std::valarray<T> y = grad_trial - grad;
+        const T sy = (s * y).sum();
+        // Barzilai-Borwein step for ascent (the Hessian is negative definite near a maximum)
+        step = sy < 0 ? (s * s).sum() / -sy : 2 * step;
+        const T increase = J_trial - J;
+        thickness = trial;
+        J = J_trial;
+        grad = grad_trial;
+        if (increase <= tol * std::abs(J)) {
+            break;
+        }
+    }
+    return {{"thickness", thickness}, {"objective", J}, {"iterations", iter}, {"evaluations", evaluations}};
+}
+
+template<std::floating_point T>
+auto ThicknessOptimizer<T>::optimize(const std::valarray<T> &lower, const std::valarray<T> &upper,
+                                     const std::size_t num_starts, const std::size_t max_iter, const T tol,
+                                     const std::uint_fast32_t seed) const -> thickness_opt_dict<T> {
+    const std::size_t num_vars = variable_layers.size();
+    if (lower.size() not_eq num_vars or upper.size() not_eq num_vars) {
+        throw std::invalid_argument("lower and upper must have one entry per variable layer.");
+    }
+    for (std::size_t v = 0; v < num_vars; v++) {
+        if (lower[v] > upper[v] or lower[v] < 0) {
+            throw std::invalid_argument("Bounds must satisfy 0 <= lower <= upper.");
+        }
+    }
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<T> uni(0, 1);
+    std::vector<std::future<thickness_opt_dict<T>>> runs;
+    runs.reserve(num_starts);
+    for (std::size_t s = 0; s < num_starts; s++) {
+        std::valarray<T> start(num_vars);
+        for (std::size_t v = 0; v < num_vars; v++) {
+            start[v] = s == 0 ? d_list.at(variable_layers.at(v)) : lower[v] + uni(gen) * (upper[v] - lower[v]);
+        }
+        runs.push_back(std::async(std::launch::async, [=, this, start = std::move(start)]() -> thickness_opt_dict<T> {
+            return ascend(start, lower, upper, max_iter, tol);
+        }));
+    }
+    thickness_opt_dict<T> best;
+    std::size_t evaluations = 0;
+    for (std::future<thickness_opt_dict<T>> &run : runs) {
+        thickness_opt_dict<T> result = run.get();
+        evaluations += std::get<std::size_t>(result.at("evaluations"));
+        if (best.empty() or std::get<T>(result.at("objective")) > std::get<T>(best.at("objective"))) {
+            best = std::move(result);
+        }
+    }
+    best.insert_or_assign("evaluations", evaluations);
+    return best;
+}
+
+template class ThicknessOptimizer<double>;
@@ -0,0 +1,76 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef SUISAPP_THICKNESSOPTIMIZER_H
+#define SUISAPP_THICKNESSOPTIMIZER_H
+
+#include <array>
+#include <complex>
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <valarray>
+#include <variant>
+#include <vector>
+
+/*
+ * thickness: std::valarray<T>
+ * objective: T
+ * iterations: std::size_t
+ * evaluations: std::size_t
+ */
+template<typename T>
+using thickness_opt_dict = std::unordered_map<std::string, std::variant<T, std::size_t, std::valarray<T>>>;
+
+/*
+ * Maximizes the weighted absorption sum_j weight[j] * A_active(lam_vac[j]) of one layer of a coherent stack (the
+ * photocurrent of the active layer if weight is q * photon flux * d lambda) over the thicknesses of some of the
+ * other layers, e.g. an anti-reflection coating and transport layers, for unpolarized light.
+
+ * Everything that does not depend on the thicknesses (Snell angles, kz and the Fresnel coefficients of all
+ * interfaces) is computed once by the constructor, so an evaluation only multiplies the layer matrices. The
+ * objective comes with its exact gradient: the derivative of a layer matrix with respect to the layer thickness is
+ * diag(-1j * kz, 1j * kz) times the matrix, which is carried along the matrix products.
+ */
+template<std::floating_point T>
+class ThicknessOptimizer {
+public:
+    /*
+     * n_list and d_list: the whole stack, d_list in the units of lam_vac with inf for the outer media; the
+     * thicknesses of the variable layers in d_list are the first starting point of optimize().
+     */
+    ThicknessOptimizer(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+                       std::vector<std::size_t> variable_layers, std::size_t active_layer,
+                       const std::valarray<T> &lam_vac, const std::valarray<T> &weight, T th_0 = 0);
+
+    /*
+     * Objective and gradient at the given thicknesses of the variable layers.
+     */
+    auto objective(const std::valarray<T> &thickness) const -> std::pair<T, std::valarray<T>>;
+    /*
+     * Projected-gradient ascent with Barzilai-Borwein steps and backtracking within [lower, upper], run from
+     * num_starts starting points in parallel: the thicknesses of d_list and random points within the bounds.
+     * Returns the best result.
+     */
+    auto optimize(const std::valarray<T> &lower, const std::valarray<T> &upper, std::size_t num_starts = 8,
+                  std::size_t max_iter = 200, T tol = 1e-10, std::uint_fast32_t seed = 0) const -> thickness_opt_dict<T>;
+private:
+    std::vector<T> d_list;
+    std::vector<std::size_t> variable_layers;
+    std::size_t active_layer;
+    std::valarray<T> weight;
+    // [layer][wavelength]
+    std::vector<std::valarray<std::complex<T>>> kz_list;
+    // [pol][interface i -> i + 1][wavelength]
+    std::array<std::vector<std::valarray<std::complex<T>>>, 2> r_list, t_list;
+    // [pol][layer][wavelength], Poynting vector factors normalized by the incidence medium
+    std::array<std::vector<std::valarray<std::complex<T>>>, 2> poyn_factor;
+
+    auto ascend(std::valarray<T> thickness, const std::valarray<T> &lower, const std::valarray<T> &upper,
+                std::size_t max_iter, T tol) const -> thickness_opt_dict<T>;
+};
+
+#endif  // SUISAPP_THICKNESSOPTIMIZER_H
@@ -12,16 +12,48 @@
 
 #include "tmm.h"
 #include "OpticStack.h"
+#include "RatDict.h"
+#include "utils/Math.h"
 
 /*
- * R: std::valarray<T>
- * A: std::valarray<T>
- * T: std::valarray<T>
- * A_per_layer: std::valarray<std::valarray<T>> (coh) / std::vector<std::valarray<T>> (inc)
+ * Layer types of the stack for inc_tmm() from the user's coherency list ('c' or 'i' per layer).
  */
-template<typename T>
-using rat_dict = std::unordered_map<std::string, std::variant<std::valarray<T>, std::valarray<std::valarray<T>>,
-        std::vector<std::valarray<T>>>>;
+template<FloatingList U>
+std::valarray<LayerType> coherency_layers(const OpticStack<U> &stack, const bool coherent,
+                                          const std::vector<char> &coherency_list) {
+    // The rows of get_indices(): incidence, the structure, the back absorbing layer if no_back_reflection, and the
+    // substrate or, behind the absorbing layer, vacuum
+    std::valarray<LayerType> coherency_va(stack.num_mat_layers + 2 + stack.no_back_reflection);
+    if (not coherent) {
+        if (not coherency_list.empty()) {
+            if (coherency_list.size() not_eq stack.num_mat_layers) {
+                const std::string error_info = "Error: The coherency list must have as many elements " +
+                                               std::to_string(coherency_list.size()) +
+                                               " as the number of layers " + std::to_string(stack.num_mat_layers);
+                throw std::runtime_error(error_info);
+            }
+            coherency_va[0] = LayerType::Incoherent;
+#ifdef __cpp_lib_ranges_enumerate
+            for (const auto [i, layer_type] : std::views::enumerate(coherency_list)) {
+#else
+            for (auto i = 0; i < coherency_list.size(); ++i) {
+                auto layer_type = coherency_list[i];
+#endif
+                coherency_va[i + 1] = layer_type == 'c' ? LayerType::Coherent : LayerType::Incoherent;
+            }
+            coherency_va[stack.num_mat_layers + 1] = LayerType::Incoherent;
+            if (stack.no_back_reflection) {
+                coherency_va[stack.num_mat_layers + 2] = LayerType::Incoherent;
+            }
+        } else {
+            const std::string error_info = "Error: For incoherent or partly incoherent calculations you must "
+                                           "supply the coherency_list parameter with as many elements as the "
+                                           "number of layers in the structure";
+            throw std::runtime_error(error_info);
+        }
+    }
+    return coherency_va;
+}
 
 /*
  * Calculates the reflected, absorbed, and transmitted intensity of the structure
@@ -40,6 +72,10 @@ using rat_dict = std::unordered_map<std::string, std::variant<std::valarray<T>,
         layers in the structure.
     :param no_back_reflection: If reflection from the back must be suppressed.
         Default=True.
+    :param bidirectional: Also return R_rev, A_rev, T_rev and A_per_layer_rev for light coming from the back of
+        the structure, e.g., for bifacial devices, from the same coh_tmm_bidirectional() pass as the front.
+        A_per_layer_rev has the layer order of the stack. Coherent stacks only.
+        Default: false.
     :return: A dictionary with the R, A, and T at the specified wavelengths and angle.
  */
 template<typename U>
@@ -48,42 +84,39 @@ rat_dict<typename std::remove_reference_t<U>::value_type> calculate_rat(std::uni
                                                                         double angle = 0,
                                                                         char pol = 'u',
                                                                         bool coherent = true,
-                                                                        const std::vector<char> &coherency_list = {}) {
+                                                                        const std::vector<char> &coherency_list = {},
+                                                                        bool bidirectional = false) {
     using T = typename std::remove_reference_t<U>::value_type;
     constexpr double degree = std::numbers::pi_v<typename std::remove_reference_t<U>::value_type> / 180;
-    std::valarray<LayerType> coherency_va(stack->num_mat_layers + 2);
-    if (not coherent) {
-        if (not coherency_list.empty()) {
-            if (coherency_list.size() not_eq stack->num_mat_layers) {
-                const std::string error_info = "Error: The coherency list must have as many elements " +
-                                               std::to_string(coherency_list.size()) +
-                                               " as the number of layers " + std::to_string(stack->num_mat_layers);
-                throw std::runtime_error(error_info);
-            }
-            coherency_va[0] = LayerType::Incoherent;
-#ifdef __cpp_lib_ranges_enumerate
-            for (const auto [i, layer_type] : std::views::enumerate(coherency_list)) {
-#else
-            for (auto i = 0; i < coherency_list.size(); ++i) {
-                auto layer_type = coherency_list[i];
-#endif
-                coherency_va[i] = layer_type == 'c' ? LayerType::Coherent : LayerType::Incoherent;
+    const std::valarray<LayerType> coherency_va = coherency_layers(*stack, coherent, coherency_list);
+    rat_dict<T> rat_out;
+    std::valarray<T> lam_vac(wavelength.size());
+    std::ranges::copy(wavelength, std::begin(lam_vac));
+    if (bidirectional) {
+        if (not coherent) {
+            throw std::invalid_argument("Bidirectional illumination is only available for coherent stacks.");
+        }
+        const std::vector<std::valarray<std::complex<T>>> n_list = stack->template get_indices<std::vector<std::valarray<std::complex<T>>>>(std::forward<U>(wavelength));
+        const std::vector<T> d_list = stack->template get_widths<std::vector<T>>();
+        const std::vector<char> pols = pol == 's' or pol == 'p' ? std::vector<char>{pol} : std::vector<char>{'s', 'p'};
+        for (const std::string suffix : {"", "_rev"}) {
+            rat_out.emplace("R" + suffix, std::valarray<T>(0.0, lam_vac.size()));
+            rat_out.emplace("T" + suffix, std::valarray<T>(0.0, lam_vac.size()));
+            rat_out.emplace("A_per_layer" + suffix, Utils::Tensor<T, 2>({n_list.size(), lam_vac.size()}));
+        }
+        for (const char p : pols) {
+            const partial_tmm_dict<T> out = coh_tmm_bidirectional(p, n_list, d_list, std::complex<T>(angle * degree), lam_vac);
+            for (const std::string key : {"R", "T", "R_rev", "T_rev"}) {
+                std::get<std::valarray<T>>(rat_out.at(key)) += std::get<std::valarray<T>>(out.at(key)) / static_cast<T>(pols.size());
             }
-            coherency_va[stack->num_mat_layers + 1] = LayerType::Incoherent;
-            if (stack->no_back_reflection) {
-                coherency_va.resize(stack->num_mat_layers + 3);
-                coherency_va[stack->num_mat_layers + 2] = LayerType::Incoherent;
+            for (const std::string key : {"A_per_layer", "A_per_layer_rev"}) {
+                std::get<Utils::Tensor<T, 2>>(rat_out.at(key)) += std::get<Utils::Tensor<T, 2>>(out.at(key)) / static_cast<T>(pols.size());
             }
-        } else {
-            const std::string error_info = "Error: For incoherent or partly incoherent calculations you must "
-                                           "supply the coherency_list parameter with as many elements as the "
-                                           "number of layers in the structure";
-            throw std::runtime_error(error_info);
         }
+        rat_out.emplace("A", 1 - std::get<std::valarray<T>>(rat_out.at("R")) - std::get<std::valarray<T>>(rat_out.at("T")));
+        rat_out.emplace("A_rev", 1 - std::get<std::valarray<T>>(rat_out.at("R_rev")) - std::get<std::valarray<T>>(rat_out.at("T_rev")));
+        return rat_out;
     }
-    rat_dict<T> rat_out;
-    std::valarray<T> lam_vac(wavelength.size());
-    std::ranges::copy(wavelength, std::begin(lam_vac));
     if (pol == 's' or pol == 'p') {
         if (coherent) {
             // Don't want to add a template for get_widths() to deal with std::vector<T> so just use the
@@ -124,7 +157,7 @@ rat_dict<typename std::remove_reference_t<U>::value_type> calculate_rat(std::uni
             rat_out.emplace("R", (std::get<std::valarray<T>>(out_p.at("R")) + std::get<std::valarray<T>>(out_s.at("R"))) / 2);
             rat_out.emplace("T", (std::get<std::valarray<T>>(out_p.at("T")) + std::get<std::valarray<T>>(out_s.at("T"))) / 2);
             rat_out.emplace("A", 1 - std::get<std::valarray<T>>(rat_out.at("R")) - std::get<std::valarray<T>>(rat_out.at("T")));
-            rat_out.emplace("A_per_layer", (absorp_in_each_layer(out_p) + absorp_in_each_layer(out_s)) / std::valarray<T>(2));
+            rat_out.emplace("A_per_layer", (absorp_in_each_layer(out_p) + absorp_in_each_layer(out_s)) / T(2));
             // A_per_layer_s and A_per_layer_p
         } else {
             const inc_tmm_vec_dict<double> out_p = inc_tmm('p',
@@ -142,22 +175,93 @@ rat_dict<typename std::remove_reference_t<U>::value_type> calculate_rat(std::uni
             rat_out.emplace("R", (std::get<std::valarray<T>>(out_p.at("R")) + std::get<std::valarray<T>>(out_s.at("R"))) / 2);
             rat_out.emplace("T", (std::get<std::valarray<T>>(out_p.at("T")) + std::get<std::valarray<T>>(out_s.at("T"))) / 2);
             rat_out.emplace("A", 1 - std::get<std::valarray<T>>(rat_out.at("R")) - std::get<std::valarray<T>>(rat_out.at("T")));
-            std::vector<std::valarray<T>> A_per_layer;
-#ifdef __cpp_lib_ranges_zip
-            for (const auto [p, s] : std::views::zip(inc_absorp_in_each_layer(out_p), inc_absorp_in_each_layer(out_s))) {
-#else
-            auto inc_s = inc_absorp_in_each_layer(out_s);
-            auto inc_p = inc_absorp_in_each_layer(out_p);
-            for (auto i = 0; i < inc_s.size(); ++i) {
-                auto s = inc_s[i];
-                auto p = inc_p[i];
-#endif
-                A_per_layer.emplace_back((p + s) / 2);
-            }
-            rat_out.emplace("A_per_layer", A_per_layer);
+            rat_out.emplace("A_per_layer", (inc_absorp_in_each_layer(out_p) + inc_absorp_in_each_layer(out_s)) / T(2));
         }
     }
     return rat_out;
 }
 
+/*
+ * Angle-integrated (hemispherical) counterpart of calculate_rat() for diffuse illumination, e.g. the rear side of
+    bifacial modules. R, T, A and A_per_layer are averaged over the incidence angles of an isotropic radiance,
+    i.e. over theta in [0, pi / 2) weighted by cos(theta) * sin(theta), with Gauss-Legendre quadrature.
+
+    The indices are assembled once and passed to hemispherical_tmm(), which solves coherent stacks with a single
+    angle-vectorized coh_tmm() call per polarization and incoherent ones node by node.
+
+    :param num_nodes: Number of Gauss-Legendre nodes in theta. Default: 8.
+    The other parameters are those of calculate_rat().
+    :return: A dictionary with the hemispherically averaged R, A, T and A_per_layer.
+ */
+template<typename U>
+rat_dict<typename std::remove_reference_t<U>::value_type> calculate_rat_hemispherical(std::unique_ptr<OpticStack<std::remove_reference_t<U>>> stack,
+                                                                                       U &&wavelength,
+                                                                                       const std::size_t num_nodes = 8,
+                                                                                       const char pol = 'u',
+                                                                                       const bool coherent = true,
+                                                                                       const std::vector<char> &coherency_list = {}) {
+    using T = typename std::remove_reference_t<U>::value_type;
+    const std::valarray<LayerType> coherency_va = coherent ? std::valarray<LayerType>() :
+                                                  coherency_layers(*stack, false, coherency_list);
+    std::valarray<T> lam_vac(wavelength.size());
+    std::ranges::copy(wavelength, std::begin(lam_vac));
+    const std::vector<std::valarray<std::complex<T>>> n_list = stack->template get_indices<std::vector<std::valarray<std::complex<T>>>>(std::forward<U>(wavelength));
+    const std::valarray<T> d_list = stack->template get_widths<std::valarray<T>>();
+    rat_dict<T> rat_out = hemispherical_tmm(pol, n_list, d_list, coherency_va, lam_vac, num_nodes);
+    rat_out.emplace("A", 1 - std::get<std::valarray<T>>(rat_out.at("R")) - std::get<std::valarray<T>>(rat_out.at("T")));
+    return rat_out;
+}
+
+/*
+ * Calculates the absorption profile of a partly coherent stack, i.e., the absorbed energy density at each depth
+    for the wavelengths and angle defined. Coherent layers are resolved exactly by inc_position_resolved(), while
+    incoherent ones follow its Beer-Lambert approximation with the alphas of the stack's get_alphas(), which share
+    the interpolated k of get_indices() through SpectralCache.
+
+    :param dist: Depths (in m) from the front of the first layer at which to calculate the absorption.
+    :param pol: Polarization of the light: 's', 'p', or 'u'. Default: 'u' (unpolarized).
+    The other parameters are those of calculate_rat() for incoherent stacks.
+    :return: The absorbed energy density in m-1, as (depth, wavelength).
+ */
+template<typename U>
+Utils::Tensor<typename std::remove_reference_t<U>::value_type, 2> calculate_absorption_profile(std::unique_ptr<OpticStack<std::remove_reference_t<U>>> stack,
+                                                                                                U &&wavelength,
+                                                                                                const std::valarray<typename std::remove_reference_t<U>::value_type> &dist,
+                                                                                                const double angle = 0,
+                                                                                                const char pol = 'u',
+                                                                                                const std::vector<char> &coherency_list = {}) {
+    using T = typename std::remove_reference_t<U>::value_type;
+    constexpr double degree = std::numbers::pi_v<T> / 180;
+    const std::valarray<LayerType> coherency_va = coherency_layers(*stack, false, coherency_list);
+    std::valarray<T> lam_vac(wavelength.size());
+    std::ranges::copy(wavelength, std::begin(lam_vac));
+    const std::vector<std::valarray<std::complex<T>>> n_list = stack->template get_indices<std::vector<std::valarray<std::complex<T>>>>(wavelength);
+    // inc_position_resolved() passes depths in nm to beer_lambert(), so its alphas are in nm-1.
+    Utils::Tensor<T, 2> alphas = stack->get_alphas(std::forward<U>(wavelength));
+    alphas *= T(1e-9);
+    const std::valarray<T> d_list = stack->template get_widths<std::valarray<T>>();
+    const std::vector<char> pols = pol == 's' or pol == 'p' ? std::vector<char>{pol} : std::vector<char>{'s', 'p'};
+    // Layer 0 is the front medium, the depths into it are negative, as in tmm.cpp's find_in_structure_inf().
+    const std::valarray<T> starts = layer_starts(d_list);
+    std::valarray<std::size_t> layer(dist.size());
+    std::valarray<T> d_in_layer(dist.size());
+    for (std::size_t k = 0; k < dist.size(); k++) {
+        layer[k] = std::ranges::distance(std::begin(starts), std::ranges::upper_bound(starts, dist[k])) - 1;
+        d_in_layer[k] = layer[k] == 0 ? dist[k] : dist[k] - starts[layer[k]];
+    }
+    Utils::Tensor<T, 2> absorption({dist.size(), lam_vac.size()});
+    for (const char p : pols) {
+        const inc_tmm_vec_dict<T> out = inc_tmm(p, n_list, d_list, coherency_va, std::complex<T>(angle * degree), lam_vac);
+        absorption += inc_position_resolved(std::valarray<std::size_t>(layer), d_in_layer, out, coherency_va, alphas) /
+                      static_cast<T>(pols.size());
+    }
+    // The Beer-Lambert rows are in nm-1 as well.
+    for (std::size_t k = 0; k < dist.size(); k++) {
+        if (coherency_va[layer[k]] == LayerType::Incoherent) {
+            absorption[k] *= T(1e9);
+        }
+    }
+    return absorption;
+}
+
 #endif  // SUISAPP_TRANSFERMATRIX_H
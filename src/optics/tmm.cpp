@@ -113,6 +113,7 @@ auto is_forward_angle(const std::complex<T> n, const std::complex<T> theta) -> b
 }
 
 template auto is_forward_angle(const std::complex<double> n, const std::complex<double> theta) -> bool;
+template auto is_forward_angle(const std::complex<float> n, const std::complex<float> theta) -> bool;
 
 /*
  * return angle theta in layer 2 with refractive index n_2, assuming
@@ -7,6 +7,7 @@
 #include <valarray>
 #include <variant>
 #include <vector>
+#include "src/utils/Tensor.h"
 
 /*
  * r: std::complex<T>
@@ -132,6 +133,17 @@ using inc_tmm_vec_dict = std::unordered_map<std::string, std::variant<std::valar
         std::vector<coh_tmm_vecn_dict<T>>, std::vector<std::vector<T>>, std::vector<std::vector<std::size_t>>,
         std::vector<std::vector<std::valarray<std::complex<T>>>>, std::valarray<std::array<std::valarray<T>, 2>>>>;
 
+/*
+ * R: std::valarray<T>
+ * T: std::valarray<T>
+ * A_per_layer: Utils::Tensor<T, 2> (layer, wavelength)
+ * rerun: std::valarray<T> (coh_tmm_mixed() only)
+ * R_rev, T_rev: std::valarray<T> (coh_tmm_bidirectional() only)
+ * A_per_layer_rev: Utils::Tensor<T, 2> (layer, wavelength) (coh_tmm_bidirectional() only)
+ */
+template<typename T>
+using partial_tmm_dict = std::unordered_map<std::string, std::variant<std::valarray<T>, Utils::Tensor<T, 2>>>;
+
 enum class LayerType { Coherent, Incoherent };
 
 /*
@@ -220,7 +232,8 @@ public:
      * layer.
      */
     auto run(T z) const -> std::valarray<std::complex<T>>;
-    auto run(const std::valarray<T> &z) const -> std::valarray<std::valarray<std::complex<T>>>;
+    // (depth, wavelength)
+    auto run(const std::valarray<T> &z) const -> Utils::Tensor<std::complex<T>, 2>;
     /*
      * Flip the function front-to-back, to describe a(d-z) instead of a(z),
      * where d is layer thickness.
@@ -305,12 +318,28 @@ auto coh_tmm(char pol, const std::valarray<std::complex<T>> &n_list, const std::
 template<typename T, typename TH_T>
 requires std::is_same_v<TH_T, std::valarray<std::complex<T>>> || std::is_same_v<TH_T, std::complex<T>>
 auto coh_tmm(char pol, const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
-             const TH_T &th_0, const std::valarray<T> &lam_vac) -> coh_tmm_vecn_dict<T>;
+             const TH_T &th_0, const std::valarray<T> &lam_vac,
+             const std::vector<std::valarray<T>> &phase_list = {}) -> coh_tmm_vecn_dict<T>;
+
+template<std::floating_point T>
+auto coh_tmm_partial(char pol, const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+                     const std::vector<T> &coh_length, std::complex<T> th_0, const std::valarray<T> &lam_vac,
+                     std::size_t num_phases = 16) -> partial_tmm_dict<T>;
+
+template<std::floating_point T>
+auto coh_tmm_mixed(char pol, const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+                   std::complex<T> th_0, const std::valarray<T> &lam_vac, T tol = 1e-4,
+                   std::size_t sample_stride = 16) -> partial_tmm_dict<T>;
 
 template<std::floating_point T>
 auto coh_tmm_reverse(char pol, const std::valarray<std::complex<T>> &n_list, const std::valarray<T> &d_list,
                      std::complex<T> th_0, const std::valarray<T> &lam_vac) -> coh_tmm_vec_dict<T>;
 
+template<std::floating_point T>
+auto coh_tmm_bidirectional(char pol, const std::vector<std::valarray<std::complex<T>>> &n_list,
+                           const std::vector<T> &d_list, std::complex<T> th_0,
+                           const std::valarray<T> &lam_vac) -> partial_tmm_dict<T>;
+
 template<typename T>
 auto ellips(const std::valarray<std::complex<T>> &n_list, const std::valarray<T> &d_list, std::complex<T> th_0,
             T lam_vac) -> std::unordered_map<std::string, T>;
@@ -319,6 +348,11 @@ template<typename T>
 auto ellips(const std::valarray<std::complex<T>> &n_list, const std::valarray<T> &d_list, std::complex<T> th_0,
             const std::valarray<T> &lam_vac) -> std::unordered_map<std::string, std::valarray<T>>;
 
+template<std::floating_point T>
+auto ellips(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+            const std::valarray<T> &th_0,
+            const std::valarray<T> &lam_vac) -> std::unordered_map<std::string, std::vector<std::valarray<T>>>;
+
 template<typename T>
 auto unpolarized_RT(const std::valarray<std::complex<T>> &n_list, const std::valarray<T> &d_list, std::complex<T> th_0,
                     const std::valarray<T> &lam_vac) -> std::unordered_map<std::string, std::valarray<T>>;
@@ -350,11 +384,13 @@ auto layer_starts(const std::valarray<T> &d_list) -> std::valarray<T>;
 template<typename T>
 auto absorp_in_each_layer(const coh_tmm_dict<T> &coh_tmm_data) -> std::valarray<T>;
 
+// (layer, wavelength)
 template<typename T>
-auto absorp_in_each_layer(const coh_tmm_vec_dict<T> &coh_tmm_data) -> std::valarray<std::valarray<T>>;
+auto absorp_in_each_layer(const coh_tmm_vec_dict<T> &coh_tmm_data) -> Utils::Tensor<T, 2>;
 
+// (layer, wavelength)
 template<typename T>
-auto absorp_in_each_layer(const coh_tmm_vecn_dict<T> &coh_tmm_data) -> std::valarray<std::valarray<T>>;
+auto absorp_in_each_layer(const coh_tmm_vecn_dict<T> &coh_tmm_data) -> Utils::Tensor<T, 2>;
 
 template<typename T>
 auto inc_group_layers(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::valarray<T> &d_list,
@@ -372,20 +408,29 @@ auto inc_tmm(char pol, const std::vector<std::valarray<std::complex<T>>> &n_list
 template<typename T>
 auto inc_absorp_in_each_layer(const inc_tmm_dict<T> &inc_data) -> std::vector<T>;
 
+// (layer, wavelength)
 template<typename T>
-auto inc_absorp_in_each_layer(const inc_tmm_vec_dict<T> &inc_data) -> std::vector<std::valarray<T>>;
+auto inc_absorp_in_each_layer(const inc_tmm_vec_dict<T> &inc_data) -> Utils::Tensor<T, 2>;
+
+// Hemispherical (cos(theta) * sin(theta)-weighted) average over the incidence angle; an empty c_list is coherent.
+template<std::floating_point T>
+auto hemispherical_tmm(char pol, const std::vector<std::valarray<std::complex<T>>> &n_list,
+                       const std::valarray<T> &d_list, const std::valarray<LayerType> &c_list,
+                       const std::valarray<T> &lam_vac, std::size_t num_nodes = 8) -> partial_tmm_dict<T>;
 
 template<typename T>
 auto inc_find_absorp_analytic_fn(std::size_t layer, const inc_tmm_vec_dict<T> &inc_data) -> AbsorpAnalyticVecFn<T>;
 
+// (depth, wavelength)
 template<typename T>
 auto inc_position_resolved(std::valarray<std::size_t> &&layer, const std::valarray<T> &dist,
                            const inc_tmm_vec_dict<T> &inc_tmm_data, const std::valarray<LayerType> &coherency_list,
-                           const std::valarray<std::valarray<T>> &alphas,
-                           T zero_threshold = 1e-6) -> std::valarray<std::valarray<T>>;
+                           const Utils::Tensor<T, 2> &alphas,
+                           T zero_threshold = 1e-6) -> Utils::Tensor<T, 2>;
 
+// (wavelength, depth)
 template<typename T>
 auto beer_lambert(const std::valarray<T> &alphas, const std::valarray<T> &fraction, const std::valarray<T> &dist,
-                  const std::valarray<T> &A_total) -> std::valarray<std::valarray<T>>;
+                  const std::valarray<T> &A_total) -> Utils::Tensor<T, 2>;
 
 #endif // TMM_H
@@ -224,13 +224,13 @@ template<typename T>
 }
 
 template<typename T>
-[[nodiscard]] auto AbsorpAnalyticVecFn<T>::run(const std::valarray<T> &z) const -> std::valarray<std::valarray<std::complex<T>>> {
+[[nodiscard]] auto AbsorpAnalyticVecFn<T>::run(const std::valarray<T> &z) const -> Utils::Tensor<std::complex<T>, 2> {
     const std::size_t num_layers = z.size();
     const std::size_t num_wl = a1.size();
-    std::valarray<std::valarray<std::complex<T>>> result(std::valarray<std::complex<T>>(num_wl), num_layers);
+    Utils::Tensor<std::complex<T>, 2> result({num_layers, num_wl});
     for (std::size_t i = 0; i < num_layers; i++) {
-        for (std::size_t j = 0; j < num_wl; j++) {  // result[i][j] not [j][i]!
-            result[i][j] = ((A1[j] < 1e-100) ? 0 : A1[j] * std::exp(a1[j] * z[i])) + A2[j] * std::exp(-a1[j] * z[i])
+        for (std::size_t j = 0; j < num_wl; j++) {  // result(i, j) not (j, i)!
+            result(i, j) = ((A1[j] < 1e-100) ? 0 : A1[j] * std::exp(a1[j] * z[i])) + A2[j] * std::exp(-a1[j] * z[i])
                     + A3[j] * std::exp(1i * a3[j] * z[i]) + std::conj(A3[j]) * std::exp(-1i * a3[j] * z[i]);
         }
     }
@@ -633,32 +633,13 @@ auto coh_tmm(const char pol, const std::valarray<std::complex<T>> &n_list, const
     }
 #endif
     const std::valarray<std::complex<T>> kz_list = 2 * std::numbers::pi_v<T> * n_list * std::cos(th_list) / compvec_lam_vac;
-    // Do the same thing to d_list.
+    // Do the same thing to d_list, directly in the layer-major order of kz_list rather than repeating d_list and
+    // transposing it.
     std::valarray<std::complex<T>> compvec_d_list(num_elems);
-#ifdef __cpp_lib_ranges_repeat
-    std::ranges::move(std::views::repeat(d_list | std::views::transform([](const T real) -> std::complex<T> {
-        return real;
-    }), num_wl) | std::views::join, std::begin(compvec_d_list));
-#else
-    for (std::size_t i = 0; i < num_elems; ++i) {
-        compvec_d_list[i] = std::real(d_list[i % num_layers]);
+    for (std::size_t i = 0; i < num_layers; i++) {
+        compvec_d_list[std::slice(i * num_wl, num_wl, 1)] = std::complex<T>(d_list[i]);
     }
-#endif
-    // Note that if num_layers * d_list.size() greater than compvec_d_list.size(), by address sanitizer (ASAN),
-    // there will be a heap-buffer-overflow. Shadow bytes around the buggy address contain fa (Heap left redzone).
-    // Without ASAN, the problem emerges until executing the next line:
-    // (msvc) Exception 0x80000003 encountered at address 0x____________:
-    // Access violation reading location 0x00000000 at valarray::_Grow(_Count) ->
-    // _Myptr = _Allocate_for_op_delete<_Ty>(_Newsize) ->
-    // return static_cast<_Ty*>(::operator new(_Bytes));
-    // where _Count is 10, _Bytes is 100 for example.
-    // gdb SIGTRAP (Trace/breakpoint trap)
-    // valarray constructor _M_data(__valarray_get_storage<_Tp>(_M_size))
-    // return static_cast<_Tp*>(operator new(__n * sizeof(_Tp))); -> malloc -> RtlAllocateHeap -> EtwLogTraceEvent ->
-    // RtlRegisterSecureMemoryCacheCallback -> RtlAllocateHeap -> .misaligned_access -> RtlIsZeroMemory
-    // Return code -1073740940 (0xC0000374) (STATUS_HEAP_CORRUPTION)
-    // Transpose num_wl * num_layers to num_layers * num_wl
-    std::valarray<std::complex<T>> delta = kz_list * Utils::Range::rng2d_transpose(compvec_d_list, num_wl);
+    std::valarray<std::complex<T>> delta = kz_list * compvec_d_list;
     // std::slice_array does not have std::begin() or std::end().
     std::ranges::transform(std::begin(delta) + num_wl, std::begin(delta) + (num_layers - 1) * num_wl, std::begin(delta) + num_wl, [](const std::complex<T> delta_i) {
         return delta_i.imag() > 100 ? delta_i.real() + 100i : delta_i;
@@ -816,10 +797,17 @@ template auto coh_tmm(char pol, const std::valarray<std::complex<double>> &n_lis
                       const std::valarray<double> &d_list, const std::complex<double> &th_0,
                       const std::valarray<double> &lam_vac) -> coh_tmm_vec_dict<double>;
 
+/*
+ * phase_list, if not empty, holds one phase offset per layer and per element of lam_vac, which is added to the phase
+ * thickness kz * d of the layer (empty valarrays for layers without offset). Offsets change the interference in the
+ * layer but not its attenuation, so R, T, power_entering and vw_list (the amplitudes at the start of each layer) are
+ * exact; position_resolved() ignores the offsets at distance > 0.
+ */
 template<typename T, typename TH_T>
 requires std::is_same_v<TH_T, std::valarray<std::complex<T>>> || std::is_same_v<TH_T, std::complex<T>>
 auto coh_tmm(const char pol, const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
-             const TH_T &th_0, const std::valarray<T> &lam_vac) -> coh_tmm_vecn_dict<T> {
+             const TH_T &th_0, const std::valarray<T> &lam_vac,
+             const std::vector<std::valarray<T>> &phase_list) -> coh_tmm_vecn_dict<T> {
     const std::size_t num_wl = lam_vac.size();
     const std::size_t num_layers = n_list.size();
     if constexpr (std::is_same_v<TH_T, std::valarray<std::complex<T>>>) {
@@ -834,6 +822,9 @@ auto coh_tmm(const char pol, const std::vector<std::valarray<std::complex<T>>> &
     if (not std::isinf(d_list.front()) or not std::isinf(d_list.back())) {
         throw std::invalid_argument("d_list must start and end with inf!");
     }
+    if (not phase_list.empty() and phase_list.size() not_eq num_layers) {
+        throw std::invalid_argument("phase_list must be empty or have one entry per layer.");
+    }
 #if (defined __GNUC__ && __GNUC__ < 13)
     std::valarray<T> test_va(num_wl);
     for (std::size_t i = 0; i < num_wl; ++i) {
@@ -875,13 +866,18 @@ auto coh_tmm(const char pol, const std::vector<std::valarray<std::complex<T>>> &
     std::vector<std::valarray<std::complex<T>>> delta(num_layers, std::valarray<std::complex<T>>(num_wl));
     for (std::size_t i = 0; i < num_layers; i++) {
         delta.at(i) = kz_list.at(i) * comp_d_list[i];
+        if (not phase_list.empty() and phase_list.at(i).size() not_eq 0) {
+            for (std::size_t j = 0; j < num_wl; j++) {
+                delta.at(i)[j] += phase_list.at(i)[j];
+            }
+        }
     }
     for (std::size_t i : std::views::iota(1U, num_layers - 1)) {
         if (std::ranges::any_of(delta.at(i), [](const std::complex<T> delta_i) -> bool {
             return delta_i.imag() > 35;
         })) {
             std::ranges::transform(delta.at(i), std::begin(delta.at(i)), [](const std::complex<T> delta_i) {
-                return delta_i.real() + 35i;
+                return std::complex<T>(delta_i.real(), 35);
             });
             try {
                 throw std::runtime_error("Warning: Layers that are almost perfectly opaque "
@@ -900,15 +896,17 @@ auto coh_tmm(const char pol, const std::vector<std::valarray<std::complex<T>>> &
         t_list.at(i).at(i + 1) = interface_t(pol, n_list.at(i), n_list.at(i + 1), th_list.at(i), th_list.at(i + 1));
         r_list.at(i).at(i + 1) = interface_r(pol, n_list.at(i), n_list.at(i + 1), th_list.at(i), th_list.at(i + 1));
     }
+    // std::complex_literals only provide std::complex<double>, which does not mix with std::complex<float>.
+    constexpr std::complex<T> imag_unit(0, 1);
     std::valarray<boost::numeric::ublas::matrix<std::complex<T>>> M_list(boost::numeric::ublas::zero_matrix<std::complex<T>>(2, 2), num_layers * num_wl);
     for (std::size_t i = 1; i < num_layers - 1; i++) {
         std::valarray<boost::numeric::ublas::matrix<std::complex<T>>> A(boost::numeric::ublas::matrix<std::complex<T>>(2, 2), num_wl);
         std::valarray<boost::numeric::ublas::matrix<std::complex<T>>> B(boost::numeric::ublas::matrix<std::complex<T>>(2, 2), num_wl);
         for (std::size_t j = 0; j < num_wl; j++) {
-            A[j](0, 0) = std::exp(-1i * delta.at(i)[j]);
+            A[j](0, 0) = std::exp(-imag_unit * delta.at(i)[j]);
             A[j](0, 1) = 0;
             A[j](1, 0) = 0;
-            A[j](1, 1) = std::exp(1i * delta.at(i)[j]);
+            A[j](1, 1) = std::exp(imag_unit * delta.at(i)[j]);
             B[j](0, 0) = 1;
             B[j](0, 1) = r_list.at(i).at(i + 1)[j];
             B[j](1, 0) = r_list.at(i).at(i + 1)[j];
@@ -936,7 +934,7 @@ auto coh_tmm(const char pol, const std::vector<std::valarray<std::complex<T>>> &
     std::valarray<std::complex<T>> t(num_wl);
     for (std::size_t i = 0; i < num_wl; i++) {
         r[i] = Mtilde[i](1, 0) / Mtilde[i](0, 0);
-        t[i] = 1.0 / Mtilde[i](0, 0);
+        t[i] = T(1) / Mtilde[i](0, 0);
     }
     std::valarray<std::vector<std::array<std::complex<T>, 2>>> vw_list(std::vector<std::array<std::complex<T>, 2>>(num_wl), num_layers);
     std::valarray<boost::numeric::ublas::matrix<std::complex<T>>> vw(boost::numeric::ublas::zero_matrix<std::complex<T>>(2, 2), num_wl);
@@ -979,7 +977,279 @@ auto coh_tmm(const char pol, const std::vector<std::valarray<std::complex<T>>> &
 
 template auto coh_tmm(char pol, const std::vector<std::valarray<std::complex<double>>> &n_list,
                       const std::vector<double> &d_list, const std::complex<double> &th_0,
-                      const std::valarray<double> &lam_vac) -> coh_tmm_vecn_dict<double>;
+                      const std::valarray<double> &lam_vac,
+                      const std::vector<std::valarray<double>> &phase_list) -> coh_tmm_vecn_dict<double>;
+template auto coh_tmm(char pol, const std::vector<std::valarray<std::complex<double>>> &n_list,
+                      const std::vector<double> &d_list, const std::valarray<std::complex<double>> &th_0,
+                      const std::valarray<double> &lam_vac,
+                      const std::vector<std::valarray<double>> &phase_list) -> coh_tmm_vecn_dict<double>;
+template auto coh_tmm(char pol, const std::vector<std::valarray<std::complex<float>>> &n_list,
+                      const std::vector<float> &d_list, const std::complex<float> &th_0,
+                      const std::valarray<float> &lam_vac,
+                      const std::vector<std::valarray<float>> &phase_list) -> coh_tmm_vecn_dict<float>;
+
+namespace {
+    /*
+     * Generator a of the num_points-point Korobov lattice in num_dims dimensions, z = (1, a, a ^ 2, ...) mod num_points,
+     * with the smallest P_2 = -1 + 1 / N * sum_s prod_k (1 + 2 * pi ^ 2 * B_2({s * z_k / N})), where B_2 is the second
+     * Bernoulli polynomial. Only a coprime to num_points are considered, so that every coordinate is a permutation.
+     */
+    auto korobov_generator(const std::size_t num_points, const std::size_t num_dims) -> std::size_t {
+        std::size_t best = 1;
+        double best_p2 = INFINITY;
+        for (std::size_t a = 1; a < num_points; a++) {
+            if (std::gcd(a, num_points) not_eq 1) {
+                continue;
+            }
+            double p2 = -1;
+            for (std::size_t s = 0; s < num_points; s++) {
+                double prod = 1;
+                std::size_t z = 1;
+                for (std::size_t k = 0; k < num_dims; k++) {
+                    const double x = static_cast<double>(s * z % num_points) / static_cast<double>(num_points);
+                    prod *= 1 + 2 * std::numbers::pi * std::numbers::pi * (x * x - x + 1.0 / 6);
+                    z = z * a % num_points;
+                }
+                p2 += prod / static_cast<double>(num_points);
+            }
+            if (p2 < best_p2) {
+                best_p2 = p2;
+                best = a;
+            }
+        }
+        return best;
+    }
+}
+
+/*
+ * Partially coherent stack. coh_length holds the coherence length of the light in each layer, in the units of
+ * d_list: inf keeps the layer coherent, 0 makes it fully incoherent, and a finite length L_c spreads the round-trip
+ * phase of the layer uniformly over 4 * pi * Re(n * cos(th)) * d / L_c (the optical path difference of the two
+ * beams over L_c), clipped to 2 * pi. The outer media must have inf.
+
+ * R, T and the absorption in each layer are averaged over num_phases equidistant phase offsets per partially coherent
+ * layer, which converges much faster than random phases. With one or two such layers the offsets form a grid of
+ * num_phases ^ (number of layers) samples. With more, the grid would grow exponentially, so the num_phases ^ 2 samples
+ * of a rank-1 (Korobov) lattice are used instead: sample s gets the offset (s * a ^ k mod N + 1 / 2) / N in the k-th
+ * layer, so every layer still takes each of N = num_phases ^ 2 equidistant offsets once, and a is chosen to minimize
+ * the lattice's P_2 figure of merit. The round-trip phases are periodic, for which such lattices converge far faster
+ * than random (or Latin hypercube) samples. All samples are tiled along the wavelength axis and go through a single
+ * vectorized coh_tmm() call, so the cost is that of one coherent calculation on a longer wavelength list.
+ */
+template<std::floating_point T>
+auto coh_tmm_partial(const char pol, const std::vector<std::valarray<std::complex<T>>> &n_list,
+                     const std::vector<T> &d_list, const std::vector<T> &coh_length, const std::complex<T> th_0,
+                     const std::valarray<T> &lam_vac, const std::size_t num_phases) -> partial_tmm_dict<T> {
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_wl = lam_vac.size();
+    if (coh_length.size() not_eq num_layers) {
+        throw std::invalid_argument("coh_length must have one entry per layer.");
+    }
+    if (num_phases == 0) {
+        throw std::invalid_argument("num_phases must be positive.");
+    }
+    std::vector<std::size_t> partial_layers;
+    for (std::size_t i = 1; i + 1 < num_layers; i++) {
+        if (not std::isinf(coh_length.at(i))) {
+            partial_layers.emplace_back(i);
+        }
+    }
+    const bool full_grid = partial_layers.size() <= 2;
+    std::size_t num_samples = 1;
+    if (full_grid) {
+        for (std::size_t k = 0; k < partial_layers.size(); k++) {
+            num_samples *= num_phases;
+        }
+    } else {
+        num_samples = num_phases * num_phases;
+    }
+    const std::size_t num_batch = num_samples * num_wl;
+    const std::vector<std::valarray<std::complex<T>>> th_list = list_snell(n_list, th_0);
+    std::vector<std::valarray<std::complex<T>>> n_tiled(num_layers, std::valarray<std::complex<T>>(num_batch));
+    std::valarray<T> lam_tiled(num_batch);
+    for (std::size_t s = 0; s < num_samples; s++) {
+        const std::slice sample(s * num_wl, num_wl, 1);
+        lam_tiled[sample] = lam_vac;
+        for (std::size_t i = 0; i < num_layers; i++) {
+            n_tiled.at(i)[sample] = n_list.at(i);
+        }
+    }
+    std::vector<std::valarray<T>> phase_list(num_layers);
+    std::size_t stride = 1;
+    const std::size_t generator = full_grid ? 1 : korobov_generator(num_samples, partial_layers.size());
+    std::size_t multiplier = 1;
+    std::vector<std::size_t> strata(num_samples);
+    for (const std::size_t i : partial_layers) {
+        // One-way phase spread, half of the round-trip spread
+        std::valarray<T> spread(std::numbers::pi_v<T>, num_wl);
+        if (coh_length.at(i) > 0) {
+            for (std::size_t j = 0; j < num_wl; j++) {
+                spread[j] = std::min(2 * std::numbers::pi_v<T> * (n_list.at(i)[j] * std::cos(th_list.at(i)[j])).real() *
+                                     d_list.at(i) / coh_length.at(i), std::numbers::pi_v<T>);
+            }
+        }
+        phase_list.at(i).resize(num_batch);
+        if (full_grid) {
+            for (std::size_t s = 0; s < num_samples; s++) {
+                strata.at(s) = s / stride % num_phases;
+            }
+            stride *= num_phases;
+        } else {
+            for (std::size_t s = 0; s < num_samples; s++) {
+                strata.at(s) = s * multiplier % num_samples;
+            }
+            multiplier = multiplier * generator % num_samples;
+        }
+        const T num_strata = static_cast<T>(full_grid ? num_phases : num_samples);
+        for (std::size_t s = 0; s < num_samples; s++) {
+            const T offset = (static_cast<T>(strata.at(s)) + T(0.5)) / num_strata - T(0.5);
+            phase_list.at(i)[std::slice(s * num_wl, num_wl, 1)] = offset * spread;
+        }
+    }
+    const coh_tmm_vecn_dict<T> coh_tmm_data = coh_tmm(pol, n_tiled, d_list, th_0, lam_tiled, phase_list);
+    const std::valarray<T> &R_samples = std::get<std::valarray<T>>(coh_tmm_data.at("R"));
+    const std::valarray<T> &T_samples = std::get<std::valarray<T>>(coh_tmm_data.at("T"));
+    const Utils::Tensor<T, 2> A_samples = absorp_in_each_layer(coh_tmm_data);
+    std::valarray<T> R(0.0, num_wl);
+    std::valarray<T> Tr(0.0, num_wl);
+    Utils::Tensor<T, 2> A_per_layer({num_layers, num_wl});
+    for (std::size_t s = 0; s < num_samples; s++) {
+        const std::slice sample(s * num_wl, num_wl, 1);
+        R += R_samples[sample];
+        Tr += T_samples[sample];
+        A_per_layer += A_samples.slice(1, s * num_wl, num_wl);
+    }
+    const T norm = static_cast<T>(num_samples);
+    R /= norm;
+    Tr /= norm;
+    A_per_layer /= norm;
+    return {{"R", R}, {"T", Tr}, {"A_per_layer", A_per_layer}};
+}
+
+template auto coh_tmm_partial(char pol, const std::vector<std::valarray<std::complex<double>>> &n_list,
+                              const std::vector<double> &d_list, const std::vector<double> &coh_length,
+                              std::complex<double> th_0, const std::valarray<double> &lam_vac,
+                              std::size_t num_phases) -> partial_tmm_dict<double>;
+
+/*
+ * Fast mode of the vectorized coh_tmm(): the stack is solved in float and checked, and only the wavelengths that fail
+ * the checks are solved again in T.
+ * - Range: R, T and the absorption of each layer must be finite and within [-tol, 1 + tol].
+ * - Error estimate: every sample_stride'th wavelength (and the last one) is also solved in T. If R, T or the absorption
+ *   of any layer of a sample differ from the float result by more than tol, the wavelengths between its neighbouring
+ *   samples are solved in T as well. Roundoff in float grows with the optical thickness, which varies smoothly with
+ *   the wavelength, so a failing sample flags its neighbourhood.
+ * Returns R, T, A_per_layer and rerun, which is 1 for wavelengths solved in T and 0 otherwise.
+ */
+template<std::floating_point T>
+auto coh_tmm_mixed(const char pol, const std::vector<std::valarray<std::complex<T>>> &n_list,
+                   const std::vector<T> &d_list, const std::complex<T> th_0, const std::valarray<T> &lam_vac,
+                   const T tol, const std::size_t sample_stride) -> partial_tmm_dict<T> {
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_wl = lam_vac.size();
+    if (sample_stride == 0) {
+        throw std::invalid_argument("sample_stride must be positive.");
+    }
+    std::vector<std::valarray<std::complex<float>>> n_float(num_layers, std::valarray<std::complex<float>>(num_wl));
+    for (std::size_t i = 0; i < num_layers; i++) {
+        std::ranges::transform(n_list.at(i), std::begin(n_float.at(i)), [](const std::complex<T> n) -> std::complex<float> {
+            return {static_cast<float>(n.real()), static_cast<float>(n.imag())};
+        });
+    }
+    std::valarray<float> lam_float(num_wl);
+    std::ranges::transform(lam_vac, std::begin(lam_float), [](const T lam) -> float {
+        return static_cast<float>(lam);
+    });
+    const coh_tmm_vecn_dict<float> fast_data = coh_tmm(pol, n_float, std::vector<float>(d_list.begin(), d_list.end()),
+                                                       std::complex<float>(static_cast<float>(th_0.real()),
+                                                                           static_cast<float>(th_0.imag())),
+                                                       lam_float);
+    const std::valarray<float> &R_fast = std::get<std::valarray<float>>(fast_data.at("R"));
+    const std::valarray<float> &T_fast = std::get<std::valarray<float>>(fast_data.at("T"));
+    const Utils::Tensor<float, 2> A_fast = absorp_in_each_layer(fast_data);
+    std::valarray<T> R(num_wl);
+    std::valarray<T> Tr(num_wl);
+    Utils::Tensor<T, 2> A_per_layer({num_layers, num_wl});
+    std::valarray<T> rerun(0.0, num_wl);
+    const auto in_range = [tol](const T x) -> bool {
+        return std::isfinite(x) and x >= -tol and x <= 1 + tol;
+    };
+    for (std::size_t j = 0; j < num_wl; j++) {
+        R[j] = R_fast[j];
+        Tr[j] = T_fast[j];
+        bool good = in_range(R[j]) and in_range(Tr[j]);
+        for (std::size_t i = 0; i < num_layers; i++) {
+            A_per_layer(i, j) = A_fast(i, j);
+            good = good and in_range(A_per_layer(i, j));
+        }
+        if (not good) {
+            rerun[j] = 1;
+        }
+    }
+    std::vector<std::size_t> sample;
+    for (std::size_t j = 0; j < num_wl; j += sample_stride) {
+        sample.emplace_back(j);
+    }
+    if (num_wl > 0 and sample.back() not_eq num_wl - 1) {
+        sample.emplace_back(num_wl - 1);
+    }
+    // Solves the selected wavelengths in T, stores them and returns whether each agreed with the float result.
+    const auto refine = [&](const std::vector<std::size_t> &wl_index) -> std::vector<bool> {
+        const std::size_t num_refine = wl_index.size();
+        std::vector<bool> agree(num_refine);
+        if (wl_index.empty()) {
+            return agree;
+        }
+        std::vector<std::valarray<std::complex<T>>> n_sub(num_layers, std::valarray<std::complex<T>>(num_refine));
+        std::valarray<T> lam_sub(num_refine);
+        for (std::size_t k = 0; k < num_refine; k++) {
+            lam_sub[k] = lam_vac[wl_index.at(k)];
+            for (std::size_t i = 0; i < num_layers; i++) {
+                n_sub.at(i)[k] = n_list.at(i)[wl_index.at(k)];
+            }
+        }
+        const coh_tmm_vecn_dict<T> data = coh_tmm(pol, n_sub, d_list, th_0, lam_sub);
+        const std::valarray<T> &R_sub = std::get<std::valarray<T>>(data.at("R"));
+        const std::valarray<T> &T_sub = std::get<std::valarray<T>>(data.at("T"));
+        const Utils::Tensor<T, 2> A_sub = absorp_in_each_layer(data);
+        for (std::size_t k = 0; k < num_refine; k++) {
+            const std::size_t j = wl_index.at(k);
+            // NaN compares false, so a non-finite float result disagrees as well.
+            bool good = std::abs(R[j] - R_sub[k]) <= tol and std::abs(Tr[j] - T_sub[k]) <= tol;
+            R[j] = R_sub[k];
+            Tr[j] = T_sub[k];
+            for (std::size_t i = 0; i < num_layers; i++) {
+                good = good and std::abs(A_per_layer(i, j) - A_sub(i, k)) <= tol;
+                A_per_layer(i, j) = A_sub(i, k);
+            }
+            agree.at(k) = good;
+            rerun[j] = 1;
+        }
+        return agree;
+    };
+    const std::vector<bool> sample_agree = refine(sample);
+    for (std::size_t k = 0; k < sample.size(); k++) {
+        if (not sample_agree.at(k)) {
+            const std::size_t first = k == 0 ? 0 : sample.at(k - 1);
+            const std::size_t last = k + 1 == sample.size() ? num_wl - 1 : sample.at(k + 1);
+            rerun[std::slice(first, last - first + 1, 1)] = 1;
+        }
+    }
+    std::vector<std::size_t> failed;
+    for (std::size_t j = 0; j < num_wl; j++) {
+        // Samples have been solved in T already.
+        if (rerun[j] == 1 and not std::ranges::binary_search(sample, j)) {
+            failed.emplace_back(j);
+        }
+    }
+    refine(failed);
+    return {{"R", R}, {"T", Tr}, {"A_per_layer", A_per_layer}, {"rerun", rerun}};
+}
+
+template auto coh_tmm_mixed(char pol, const std::vector<std::valarray<std::complex<double>>> &n_list,
+                            const std::vector<double> &d_list, std::complex<double> th_0,
+                            const std::valarray<double> &lam_vac, double tol,
+                            std::size_t sample_stride) -> partial_tmm_dict<double>;
 
 template<std::floating_point T>
 auto coh_tmm_reverse(const char pol, const std::valarray<std::complex<T>> &n_list, const std::valarray<T> &d_list,
@@ -1058,6 +1328,93 @@ template auto ellips(const std::valarray<std::complex<double>> &n_list, const st
                      const std::complex<double> th_0,
                      const std::valarray<double> &lam_vac) -> std::unordered_map<std::string, std::valarray<double>>;
 
+/*
+ * This function is vectorized over both angles and wavelengths.
+ * Calculates ellipsometric parameters, in radians, for every angle of incidence in th_0 (variable-angle spectroscopic
+ * ellipsometry). psi[a][j] and Delta[a][j] belong to th_0[a] and lam_vac[j].
+ * The Snell angles, cosines and phase thicknesses of one angle are computed once and shared by s and p.
+ * Only r = M(1, 0) / M(0, 0) is needed, so the 1 / t factors of the transfer matrices are dropped, and each layer
+ * matrix diag(exp(-1j * delta), exp(1j * delta)) is divided by exp(-1j * delta), which leaves the ratio unchanged and
+ * keeps the products bounded for opaque layers without clipping delta.
+ */
+template<std::floating_point T>
+auto ellips(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::vector<T> &d_list,
+            const std::valarray<T> &th_0,
+            const std::valarray<T> &lam_vac) -> std::unordered_map<std::string, std::vector<std::valarray<T>>> {
+    const std::size_t num_wl = lam_vac.size();
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_angles = th_0.size();
+    if (num_layers not_eq d_list.size()) {
+        throw std::invalid_argument("n_list and d_list must have same length");
+    }
+    if (not std::isinf(d_list.front()) or not std::isinf(d_list.back())) {
+        throw std::invalid_argument("d_list must start and end with inf!");
+    }
+    if (std::ranges::any_of(n_list, [num_wl](const std::valarray<std::complex<T>> &n) -> bool {
+        return n.size() not_eq num_wl;
+    })) {
+        throw std::invalid_argument("n_list elements' size mismatches lam_vac's size.");
+    }
+    // 2 * pi * n / lambda does not depend on the angle of incidence.
+    std::vector<std::valarray<std::complex<T>>> k_list(num_layers, std::valarray<std::complex<T>>(num_wl));
+    for (std::size_t i = 0; i < num_layers; i++) {
+        for (std::size_t j = 0; j < num_wl; j++) {
+            k_list.at(i)[j] = 2 * std::numbers::pi_v<T> * n_list.at(i)[j] / lam_vac[j];
+        }
+    }
+    std::vector<std::valarray<T>> psi(num_angles, std::valarray<T>(num_wl));
+    std::vector<std::valarray<T>> Delta(num_angles, std::valarray<T>(num_wl));
+    std::vector<std::valarray<std::complex<T>>> cos_list(num_layers, std::valarray<std::complex<T>>(num_wl));
+    for (std::size_t a = 0; a < num_angles; a++) {
+        const std::complex<T> th_a = th_0[a];
+        for (std::size_t j = 0; j < num_wl; j++) {
+            if (std::abs(std::imag(n_list.front()[j] * std::sin(th_a))) > Utils::Math::TOL * Utils::Math::EPSILON<T>) {
+                throw std::invalid_argument("Error in n0 or th0!");
+            }
+        }
+        const std::vector<std::valarray<std::complex<T>>> th_list = list_snell(n_list, th_a);
+        for (std::size_t i = 0; i < num_layers; i++) {
+            cos_list.at(i) = std::cos(th_list.at(i));
+        }
+        for (std::size_t j = 0; j < num_wl; j++) {
+            // Row-major 2x2 matrices {M00, M01, M10, M11}, starting from the 0 -> 1 interface.
+            const std::complex<T> ni_ci = n_list.front()[j] * cos_list.front()[j];
+            const std::complex<T> nf_cf = n_list.at(1)[j] * cos_list.at(1)[j];
+            const std::complex<T> nf_ci = n_list.at(1)[j] * cos_list.front()[j];
+            const std::complex<T> ni_cf = n_list.front()[j] * cos_list.at(1)[j];
+            const std::complex<T> rs_01 = (ni_ci - nf_cf) / (ni_ci + nf_cf);
+            const std::complex<T> rp_01 = (nf_ci - ni_cf) / (nf_ci + ni_cf);
+            std::array<std::complex<T>, 4> Ms = {1, rs_01, rs_01, 1};
+            std::array<std::complex<T>, 4> Mp = {1, rp_01, rp_01, 1};
+            for (std::size_t i = 1; i < num_layers - 1; i++) {
+                const std::complex<T> phase = std::exp(2i * k_list.at(i)[j] * cos_list.at(i)[j] * d_list.at(i));
+                const std::complex<T> n_i = n_list.at(i)[j];
+                const std::complex<T> n_f = n_list.at(i + 1)[j];
+                const std::complex<T> c_i = cos_list.at(i)[j];
+                const std::complex<T> c_f = cos_list.at(i + 1)[j];
+                const std::complex<T> rs = (n_i * c_i - n_f * c_f) / (n_i * c_i + n_f * c_f);
+                const std::complex<T> rp = (n_f * c_i - n_i * c_f) / (n_f * c_i + n_i * c_f);
+                // M = M * [[1, r], [phase * r, phase]]
+                const auto step = [phase](std::array<std::complex<T>, 4> &M, const std::complex<T> r) -> void {
+                    const std::complex<T> m01 = M[1] * phase;
+                    const std::complex<T> m11 = M[3] * phase;
+                    M = {M[0] + m01 * r, M[0] * r + m01, M[2] + m11 * r, M[2] * r + m11};
+                };
+                step(Ms, rs);
+                step(Mp, rp);
+            }
+            const std::complex<T> rho = (Mp[2] / Mp[0]) / (Ms[2] / Ms[0]);
+            psi.at(a)[j] = std::atan(std::abs(rho));
+            Delta.at(a)[j] = std::arg(-rho);
+        }
+    }
+    return {{"psi", psi}, {"Delta", Delta}};
+}
+
+template auto ellips(const std::vector<std::valarray<std::complex<double>>> &n_list, const std::vector<double> &d_list,
+                     const std::valarray<double> &th_0,
+                     const std::valarray<double> &lam_vac) -> std::unordered_map<std::string, std::vector<std::valarray<double>>>;
+
 /*
  * This function is vectorized.
  * Calculates reflected and transmitted power for unpolarized light.
@@ -1180,17 +1537,11 @@ auto position_resolved(const std::valarray<std::size_t> &layer, const std::valar
     if (pos not_eq std::end(cond)) {
         throw std::runtime_error("Position cannot be resolved at layer " + std::to_string(std::ranges::distance(std::begin(cond), pos)));
     }
+    // Layer-major like v, w and kz
     std::valarray<std::complex<T>> comp_dist(num_layers * num_wl);
-#ifdef __cpp_lib_ranges_repeat
-    std::ranges::move(std::views::repeat(distance | std::views::transform([](const T real) -> std::complex<T> {
-        return real;
-    }), num_wl) | std::views::join, std::begin(comp_dist));
-#else
-    for (std::size_t i = 0; i < num_layers * num_wl; ++i) {
-        comp_dist[i] = std::real(distance[i % num_layers]);
+    for (std::size_t i = 0; i < num_layers; i++) {
+        comp_dist[std::slice(i * num_wl, num_wl, 1)] = std::complex<T>(distance[i]);
     }
-#endif
-    comp_dist = Utils::Range::rng2d_transpose(comp_dist, num_wl);
     const std::valarray<std::complex<T>> Ef = v * std::exp(1i * kz * comp_dist);
     const std::valarray<std::complex<T>> Eb = w * std::exp(-1i * kz * comp_dist);
     std::valarray<T> poyn(num_layers * num_wl);
@@ -1316,35 +1667,40 @@ auto position_resolved(const std::size_t layer, const T distance,
     const std::valarray<std::complex<T>> th = std::get<std::vector<std::valarray<std::complex<T>>>>(coh_tmm_data.at("th_list")).at(layer);
     const std::valarray<std::complex<T>> n = std::get<std::vector<std::valarray<std::complex<T>>>>(coh_tmm_data.at("n_list")).at(layer);
     const std::valarray<std::complex<T>> n_0 = std::get<std::vector<std::valarray<std::complex<T>>>>(coh_tmm_data.at("n_list")).front();
-    const std::complex<T> th_0 = std::get<std::complex<T>>(coh_tmm_data.at("th_0"));
+    // th_0 is one angle, or one angle per wavelength (coh_tmm_reverse and angle-batched calls).
+    const auto &th_0 = coh_tmm_data.at("th_0");
+    const std::valarray<std::complex<T>> cos_th_0 = std::holds_alternative<std::complex<T>>(th_0) ?
+            std::valarray<std::complex<T>>(std::cos(std::get<std::complex<T>>(th_0)), num_wl) :
+            std::valarray<std::complex<T>>(std::cos(std::get<std::valarray<std::complex<T>>>(th_0)));
     const char pol = std::get<char>(coh_tmm_data.at("pol"));
-    if ((layer < 1 or 0 > distance or distance > std::get<std::valarray<T>>(coh_tmm_data.at("d_list"))[layer]) and (layer not_eq 0 or distance > 0)) {
+    if ((layer < 1 or 0 > distance or distance > std::get<std::vector<T>>(coh_tmm_data.at("d_list")).at(layer)) and (layer not_eq 0 or distance > 0)) {
         throw std::runtime_error("Position cannot be resolved at layer " + std::to_string(layer));
     }
-    const std::valarray<std::complex<T>> Ef = v * std::exp(1i * kz * distance);
-    const std::valarray<std::complex<T>> Eb = w * std::exp(-1i * kz * distance);
+    constexpr std::complex<T> imag_unit(0, 1);
+    const std::valarray<std::complex<T>> Ef = v * std::exp(imag_unit * kz * distance);
+    const std::valarray<std::complex<T>> Eb = w * std::exp(-imag_unit * kz * distance);
     std::valarray<T> poyn(num_wl);
     if (pol == 's') {
         for (std::size_t i = 0; i < num_wl; i++) {
             poyn[i] = (n[i] * std::cos(th[i]) * std::conj(Ef[i] + Eb[i]) * (Ef[i] - Eb[i])).real() /
-                      (n_0[i] * std::cos(th_0)).real();
+                      (n_0[i] * cos_th_0[i]).real();
         }
     } else if (pol == 'p') {
         for (std::size_t i = 0; i < num_wl; i++) {
             poyn[i] = (n[i] * std::conj(std::cos(th[i])) * (Ef[i] + Eb[i]) * std::conj(Ef[i] - Eb[i])).real() /
-                      (n_0[i] * std::conj(std::cos(th_0))).real();
+                      (n_0[i] * std::conj(cos_th_0[i])).real();
         }
     }
     std::valarray<T> absor(num_wl);
     if (pol == 's') {
         for (std::size_t i = 0; i < num_wl; i++) {
             absor[i] = (n[i] * std::cos(th[i]) * kz[i] * std::norm(Ef[i] + Eb[i])).imag() /
-                       (n_0[i] * std::cos(th_0)).real();
+                       (n_0[i] * cos_th_0[i]).real();
         }
     } else if (pol == 'p') {
         for (std::size_t i = 0; i < num_wl; i++) {
             absor[i] = (n[i] * std::conj(std::cos(th[i])) * (kz[i] * std::norm(Ef[i] - Eb[i]) - std::conj(kz[i]) * std::norm(Ef[i] + Eb[i]))).imag() /
-                       (n_0[i] * std::conj(std::cos(th_0))).real();
+                       (n_0[i] * std::conj(cos_th_0[i])).real();
         }
     }
     const std::valarray<std::complex<T>> Ex = pol == 's' ? std::valarray<std::complex<T>>{0} : (Ef - Eb) * std::cos(th);
@@ -1504,57 +1860,181 @@ auto layer_starts(const std::valarray<T> &d_list) -> std::valarray<T> {
 
 template auto layer_starts(const std::valarray<double> &d_list) -> std::valarray<double>;
 
+/*
+ * Absorption of each layer from the power entering each layer, both (layer, wavelength) and row-major. The rows are
+ * contiguous, so the differences of adjacent layers are a single valarray operation.
+ */
+template<typename T>
+auto absorp_from_power_entering(const std::valarray<T> &power_entering_each_layer, const std::size_t num_layers,
+                                const std::size_t num_lam_vac) -> Utils::Tensor<T, 2> {
+    const std::size_t num_inner = (num_layers - 1) * num_lam_vac;
+    std::valarray<T> final_answer(num_layers * num_lam_vac);
+    final_answer[std::slice(0, num_inner, 1)] = std::valarray<T>(power_entering_each_layer[std::slice(0, num_inner, 1)]) -
+            std::valarray<T>(power_entering_each_layer[std::slice(num_lam_vac, num_inner, 1)]);
+    final_answer[std::slice(num_inner, num_lam_vac, 1)] = power_entering_each_layer[std::slice(num_inner, num_lam_vac, 1)];
+    final_answer[final_answer < T(0)] = 0;
+    return {{num_layers, num_lam_vac}, std::move(final_answer)};
+}
+
 template<typename T>
-auto absorp_in_each_layer(const coh_tmm_vec_dict<T> &coh_tmm_data) -> std::valarray<std::valarray<T>> {  // public
+auto absorp_in_each_layer(const coh_tmm_vec_dict<T> &coh_tmm_data) -> Utils::Tensor<T, 2> {  // public
     const std::size_t num_layers = std::get<std::valarray<T>>(coh_tmm_data.at("d_list")).size();
     const std::size_t num_lam_vac = std::get<std::valarray<T>>(coh_tmm_data.at("lam_vac")).size();
-    std::valarray<std::valarray<T>> power_entering_each_layer(std::valarray<T>(num_lam_vac), num_layers);
-    power_entering_each_layer[0] = 1;
-    power_entering_each_layer[1] = std::get<std::valarray<T>>(coh_tmm_data.at("power_entering"));
-    power_entering_each_layer[num_layers - 1] = std::get<std::valarray<T>>(coh_tmm_data.at("T"));
+    std::valarray<T> power_entering_each_layer(T(1), num_layers * num_lam_vac);
+    power_entering_each_layer[std::slice(num_lam_vac, num_lam_vac, 1)] = std::get<std::valarray<T>>(coh_tmm_data.at("power_entering"));
+    power_entering_each_layer[std::slice((num_layers - 1) * num_lam_vac, num_lam_vac, 1)] = std::get<std::valarray<T>>(coh_tmm_data.at("T"));
     for (std::size_t i = 2; i < num_layers - 1; i++) {
-        power_entering_each_layer[i] = std::get<std::valarray<T>>(position_resolved(i, 0.0, coh_tmm_data).at("poyn"));
+        power_entering_each_layer[std::slice(i * num_lam_vac, num_lam_vac, 1)] = std::get<std::valarray<T>>(position_resolved(i, T(0), coh_tmm_data).at("poyn"));
     }
-    std::valarray<std::valarray<T>> final_answer(std::valarray<T>(num_lam_vac), num_layers);
-    std::adjacent_difference(std::next(std::begin(power_entering_each_layer)), std::end(power_entering_each_layer),
-                             std::begin(final_answer), [](const std::valarray<T> &x, const std::valarray<T> &y) {
-                return y - x;
-            });
-    final_answer[0] = power_entering_each_layer[0] - power_entering_each_layer[1];
-    final_answer[num_layers - 1] = power_entering_each_layer[num_layers - 1];
-    for (std::size_t i = 0; i < num_layers; i++) {
-        final_answer[i][final_answer[i] < std::valarray<T>(0.0, num_lam_vac)] = 0;
-    }
-    return final_answer;
+    return absorp_from_power_entering(power_entering_each_layer, num_layers, num_lam_vac);
 }
 
-template auto absorp_in_each_layer(const coh_tmm_vec_dict<double> &coh_tmm_data) -> std::valarray<std::valarray<double>>;
+template auto absorp_in_each_layer(const coh_tmm_vec_dict<double> &coh_tmm_data) -> Utils::Tensor<double, 2>;
 
 template<typename T>
-auto absorp_in_each_layer(const coh_tmm_vecn_dict<T> &coh_tmm_data) -> std::valarray<std::valarray<T>> {  // private
+auto absorp_in_each_layer(const coh_tmm_vecn_dict<T> &coh_tmm_data) -> Utils::Tensor<T, 2> {  // private
     const std::size_t num_layers = std::get<std::vector<T>>(coh_tmm_data.at("d_list")).size();
     const std::size_t num_lam_vac = std::get<std::valarray<T>>(coh_tmm_data.at("lam_vac")).size();
-    std::valarray<std::valarray<T>> power_entering_each_layer(std::valarray<T>(num_lam_vac), num_layers);
-    power_entering_each_layer[0] = 1;
-    power_entering_each_layer[1] = std::get<std::valarray<T>>(coh_tmm_data.at("power_entering"));
-    power_entering_each_layer[num_layers - 1] = std::get<std::valarray<T>>(coh_tmm_data.at("T"));
+    std::valarray<T> power_entering_each_layer(T(1), num_layers * num_lam_vac);
+    power_entering_each_layer[std::slice(num_lam_vac, num_lam_vac, 1)] = std::get<std::valarray<T>>(coh_tmm_data.at("power_entering"));
+    power_entering_each_layer[std::slice((num_layers - 1) * num_lam_vac, num_lam_vac, 1)] = std::get<std::valarray<T>>(coh_tmm_data.at("T"));
     for (std::size_t i = 2; i < num_layers - 1; i++) {
-        power_entering_each_layer[i] = std::get<std::valarray<T>>(position_resolved(i, 0.0, coh_tmm_data).at("poyn"));
+        power_entering_each_layer[std::slice(i * num_lam_vac, num_lam_vac, 1)] = std::get<std::valarray<T>>(position_resolved(i, T(0), coh_tmm_data).at("poyn"));
+    }
+    return absorp_from_power_entering(power_entering_each_layer, num_layers, num_lam_vac);
+}
+
+template auto absorp_in_each_layer(const coh_tmm_vecn_dict<double> &coh_tmm_data) -> Utils::Tensor<double, 2>;
+template auto absorp_in_each_layer(const coh_tmm_vecn_dict<float> &coh_tmm_data) -> Utils::Tensor<float, 2>;
+
+/*
+ * Front and rear illumination of a coherent stack in one pass. Both share the same kx, so the rear beam comes in
+ * through the last medium at the forward transmission angle, and the transfer matrix M of the forward stack already
+ * describes it: with [v_0, w_0] = M [v_N, w_N], front incidence has r = M10 / M00 and t = 1 / M00, and rear incidence
+ * (v_0 = 0, w_N = 1) has r_rev = -M01 / M00 and t_rev = det(M) / M00. The amplitudes of both cases are propagated
+ * back through the layers together, and the absorption of each layer follows from the Poynting flux at the layer
+ * starts as in absorp_in_each_layer(). This replaces a second coh_tmm() on the reversed lists (coh_tmm_reverse()).
+
+ * Returns R, T and A_per_layer for front incidence and R_rev, T_rev and A_per_layer_rev for rear incidence.
+ * A_per_layer_rev keeps the layer order of n_list, so its first row is T_rev and its last row is R_rev.
+ */
+template<std::floating_point T>
+auto coh_tmm_bidirectional(const char pol, const std::vector<std::valarray<std::complex<T>>> &n_list,
+                           const std::vector<T> &d_list, const std::complex<T> th_0,
+                           const std::valarray<T> &lam_vac) -> partial_tmm_dict<T> {
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_wl = lam_vac.size();
+    if (num_layers not_eq d_list.size()) {
+        throw std::invalid_argument("n_list and d_list must have same length");
+    }
+    if (not std::isinf(d_list.front()) or not std::isinf(d_list.back())) {
+        throw std::invalid_argument("d_list must start and end with inf!");
+    }
+    for (std::size_t j = 0; j < num_wl; j++) {
+        if (std::abs(std::imag(n_list.front()[j] * std::sin(th_0))) > Utils::Math::TOL * Utils::Math::EPSILON<T>) {
+            throw std::invalid_argument("Error in n0 or th0!");
+        }
+    }
+    constexpr std::complex<T> imag_unit(0, 1);
+    const std::vector<std::valarray<std::complex<T>>> th_list = list_snell(n_list, th_0);
+    std::valarray<std::complex<T>> comp_lam_vac(num_wl);
+    std::ranges::copy(lam_vac, std::begin(comp_lam_vac));
+    // Layer i: propagation through layer i and the interface to layer i + 1, as M_list in coh_tmm()
+    std::vector<std::array<std::valarray<std::complex<T>>, 4>> M_list(num_layers - 1);
+    for (std::size_t i = 0; i < num_layers - 1; i++) {
+        const std::valarray<std::complex<T>> r = interface_r(pol, n_list.at(i), n_list.at(i + 1), th_list.at(i), th_list.at(i + 1));
+        const std::valarray<std::complex<T>> t = interface_t(pol, n_list.at(i), n_list.at(i + 1), th_list.at(i), th_list.at(i + 1));
+        std::valarray<std::complex<T>> ef(T(1), num_wl);
+        std::valarray<std::complex<T>> eb(T(1), num_wl);
+        if (i > 0) {
+            std::valarray<std::complex<T>> delta = 2 * std::numbers::pi_v<T> * n_list.at(i) * std::cos(th_list.at(i)) /
+                    comp_lam_vac * std::complex<T>(d_list.at(i));
+            // Almost opaque layers pass 1 photon in 10^30, as in coh_tmm().
+            for (std::complex<T> &delta_j : delta) {
+                if (delta_j.imag() > 35) {
+                    delta_j.imag(35);
+                }
+            }
+            ef = std::exp(-imag_unit * delta);
+            eb = std::exp(imag_unit * delta);
+        }
+        M_list.at(i) = {ef / t, ef * r / t, eb * r / t, eb / t};
     }
-    std::valarray<std::valarray<T>> final_answer(std::valarray<T>(num_lam_vac), num_layers);
-    std::adjacent_difference(std::next(std::begin(power_entering_each_layer)), std::end(power_entering_each_layer),
-                             std::begin(final_answer), [](const std::valarray<T> &x, const std::valarray<T> &y) {
-                return y - x;
+    std::array<std::valarray<std::complex<T>>, 4> Mtilde = M_list.front();
+    for (std::size_t i = 1; i < num_layers - 1; i++) {
+        const std::array<std::valarray<std::complex<T>>, 4> &M = M_list.at(i);
+        Mtilde = {Mtilde[0] * M[0] + Mtilde[1] * M[2], Mtilde[0] * M[1] + Mtilde[1] * M[3],
+                  Mtilde[2] * M[0] + Mtilde[3] * M[2], Mtilde[2] * M[1] + Mtilde[3] * M[3]};
+    }
+    const std::valarray<std::complex<T>> r = Mtilde[2] / Mtilde[0];
+    const std::valarray<std::complex<T>> t = T(1) / Mtilde[0];
+    const std::valarray<std::complex<T>> r_rev = -Mtilde[1] / Mtilde[0];
+    const std::valarray<std::complex<T>> t_rev = (Mtilde[0] * Mtilde[3] - Mtilde[1] * Mtilde[2]) / Mtilde[0];
+    const std::valarray<std::complex<T>> &n_f = n_list.back();
+    const std::valarray<std::complex<T>> &th_f = th_list.back();
+    const std::valarray<T> R = R_from_r(r);
+    const std::valarray<T> Tr = T_from_t(pol, t, n_list.front(), n_f, th_0, th_f);
+    const std::valarray<T> R_rev = R_from_r(r_rev);
+    const std::valarray<T> T_rev = T_from_t(pol, t_rev, n_f, n_list.front(), th_f, th_list.front());
+    // Power entering each layer, in the order the light meets the layers
+    std::valarray<T> power_entering(T(1), num_layers * num_wl);
+    std::valarray<T> power_entering_rev(T(1), num_layers * num_wl);
+    power_entering[std::slice(num_wl, num_wl, 1)] = power_entering_from_r(pol, r, n_list.front(), th_0);
+    power_entering[std::slice((num_layers - 1) * num_wl, num_wl, 1)] = Tr;
+    power_entering_rev[std::slice(num_wl, num_wl, 1)] = power_entering_from_r(pol, r_rev, n_f, th_f);
+    power_entering_rev[std::slice((num_layers - 1) * num_wl, num_wl, 1)] = T_rev;
+    // Denominator of the Poynting flux, n * cos(th) for s and n * conj(cos(th)) for p
+    const auto n_cos = [pol](const std::valarray<std::complex<T>> &n, std::valarray<std::complex<T>> cos_th) -> std::valarray<std::complex<T>> {
+        if (pol == 'p') {
+            std::ranges::transform(cos_th, std::begin(cos_th), [](const std::complex<T> c) -> std::complex<T> {
+                return std::conj(c);
             });
-    final_answer[0] = power_entering_each_layer[0] - power_entering_each_layer[1];
-    final_answer[num_layers - 1] = power_entering_each_layer[num_layers - 1];
+        }
+        return n * cos_th;
+    };
+    const std::valarray<std::complex<T>> norm_fwd = n_cos(n_list.front(), std::valarray<std::complex<T>>(std::cos(th_0), num_wl));
+    const std::valarray<std::complex<T>> norm_rev = n_cos(n_f, std::cos(th_f));
+    // Amplitudes in the last layer, (t, 0) for front and (r_rev, 1) for rear incidence, taken back to the start of each
+    // inner layer i. Rear light enters layer i there from layer i + 1 and flows backwards, i.e., the reversed stack has
+    // it as its layer num_layers - 1 - i and the flux is the power entering its layer num_layers - i.
+    std::valarray<std::complex<T>> v = t;
+    std::valarray<std::complex<T>> w(num_wl);
+    std::valarray<std::complex<T>> v_rev = r_rev;
+    std::valarray<std::complex<T>> w_rev(T(1), num_wl);
+    for (std::size_t i = num_layers - 2; i > 1; i--) {
+        const std::array<std::valarray<std::complex<T>>, 4> &M = M_list.at(i);
+        std::valarray<std::complex<T>> v_next = M[0] * v + M[1] * w;
+        w = M[2] * v + M[3] * w;
+        v = std::move(v_next);
+        v_next = M[0] * v_rev + M[1] * w_rev;
+        w_rev = M[2] * v_rev + M[3] * w_rev;
+        v_rev = std::move(v_next);
+        const std::valarray<std::complex<T>> n_cos_i = n_cos(n_list.at(i), std::cos(th_list.at(i)));
+        for (std::size_t j = 0; j < num_wl; j++) {
+            const auto flux = [pol, n_cos_j = n_cos_i[j]](const std::complex<T> v_j, const std::complex<T> w_j) -> T {
+                return pol == 's' ? (n_cos_j * std::conj(v_j + w_j) * (v_j - w_j)).real() :
+                        (n_cos_j * (v_j + w_j) * std::conj(v_j - w_j)).real();
+            };
+            power_entering[i * num_wl + j] = flux(v[j], w[j]) / norm_fwd[j].real();
+            power_entering_rev[(num_layers - i) * num_wl + j] = -flux(v_rev[j], w_rev[j]) / norm_rev[j].real();
+        }
+    }
+    const std::valarray<T> A_rev_reversed = absorp_from_power_entering(power_entering_rev, num_layers, num_wl).flat();
+    std::valarray<T> A_rev(num_layers * num_wl);
     for (std::size_t i = 0; i < num_layers; i++) {
-        final_answer[i][final_answer[i] < std::valarray<T>(0.0, num_lam_vac)] = 0;
+        A_rev[std::slice(i * num_wl, num_wl, 1)] = A_rev_reversed[std::slice((num_layers - 1 - i) * num_wl, num_wl, 1)];
     }
-    return final_answer;
+    return {{"R", R},
+            {"T", Tr},
+            {"A_per_layer", absorp_from_power_entering(power_entering, num_layers, num_wl)},
+            {"R_rev", R_rev},
+            {"T_rev", T_rev},
+            {"A_per_layer_rev", Utils::Tensor<T, 2>({num_layers, num_wl}, std::move(A_rev))}};
 }
 
-template auto absorp_in_each_layer(const coh_tmm_vecn_dict<double> &coh_tmm_data) -> std::valarray<std::valarray<double>>;
+template auto coh_tmm_bidirectional(char pol, const std::vector<std::valarray<std::complex<double>>> &n_list,
+                                    const std::vector<double> &d_list, std::complex<double> th_0,
+                                    const std::valarray<double> &lam_vac) -> partial_tmm_dict<double>;
 
 template<typename T>
 auto inc_group_layers(const std::vector<std::valarray<std::complex<T>>> &n_list, const std::valarray<T> &d_list,
@@ -1887,7 +2367,7 @@ template auto inc_tmm(char pol, const std::vector<std::valarray<std::complex<dou
                       const std::valarray<double> &lam_vac) -> inc_tmm_vec_dict<double>;
 
 template<typename T>
-auto inc_absorp_in_each_layer(const inc_tmm_vec_dict<T> &inc_data) -> std::vector<std::valarray<T>> {
+auto inc_absorp_in_each_layer(const inc_tmm_vec_dict<T> &inc_data) -> Utils::Tensor<T, 2> {
     const std::vector<std::ptrdiff_t> stack_from_inc = std::get<std::vector<std::ptrdiff_t>>(inc_data.at("stack_from_inc"));
     const std::vector<std::valarray<T>> power_entering_list = std::get<std::vector<std::valarray<T>>>(inc_data.at("power_entering_list"));
     const std::valarray<std::array<std::valarray<T>, 2>> stackFB_list = std::get<std::valarray<std::array<std::valarray<T>, 2>>>(inc_data.at("stackFB_list"));
@@ -1902,25 +2382,98 @@ auto inc_absorp_in_each_layer(const inc_tmm_vec_dict<T> &inc_data) -> std::vecto
             const coh_tmm_vecn_dict<T> coh_tmm_bdata = std::get<std::vector<coh_tmm_vecn_dict<T>>>(inc_data.at("coh_tmm_bdata_list")).at(j);
             const std::valarray<T> power_exiting = stackFB_list[j].front() * std::get<std::valarray<T>>(coh_tmm_data.at("power_entering")) - stackFB_list[j].back() * std::get<std::valarray<T>>(coh_tmm_bdata.at("T"));
             absorp_list.emplace_back(power_entering_list.at(i) - power_exiting);
-            const std::valarray<std::valarray<T>> fcoh_absorp = stackFB_list[j].front() * absorp_in_each_layer(coh_tmm_data);
-            const std::valarray<std::valarray<T>> bcoh_absorp = stackFB_list[j].back() * absorp_in_each_layer(coh_tmm_bdata);
-            const std::size_t num_layers = fcoh_absorp.size();  // == d_list.size()
-            const std::valarray<std::valarray<T>> stack_absorp = fcoh_absorp[std::slice(1, num_layers - 2, 1)] + bcoh_absorp[std::slice(num_layers - 2, num_layers - 2, -1)];
-#ifdef __cpp_lib_containers_ranges
-            absorp_list.append_range(stack_absorp);
-#else
-            absorp_list.insert(absorp_list.end(), std::cbegin(stack_absorp), std::cend(stack_absorp));
-#endif
+            const Utils::Tensor<T, 2> fcoh_absorp = absorp_in_each_layer(coh_tmm_data);
+            const Utils::Tensor<T, 2> bcoh_absorp = absorp_in_each_layer(coh_tmm_bdata);
+            const std::size_t num_layers = fcoh_absorp.shape(0);  // == d_list.size()
+            // The backward stack runs in the opposite direction.
+            for (std::size_t k = 1; k < num_layers - 1; k++) {
+                absorp_list.emplace_back(stackFB_list[j].front() * fcoh_absorp[k].flat() +
+                                         stackFB_list[j].back() * bcoh_absorp[num_layers - 1 - k].flat());
+            }
         }
     }
     absorp_list.push_back(std::get<std::valarray<T>>(inc_data.at("T")));
-    for (std::valarray<T> &absorp : absorp_list) {
-        absorp[absorp < 0] = 0;
+    std::valarray<T> absorp(absorp_list.size() * num_wl);
+    for (std::size_t i = 0; i < absorp_list.size(); i++) {
+        absorp[std::slice(i * num_wl, num_wl, 1)] = absorp_list.at(i);
     }
-    return absorp_list;
+    absorp[absorp < T(0)] = 0;
+    return {{absorp_list.size(), num_wl}, std::move(absorp)};
 }
 
-template auto inc_absorp_in_each_layer(const inc_tmm_vec_dict<double> &inc_data) -> std::vector<std::valarray<double>>;
+template auto inc_absorp_in_each_layer(const inc_tmm_vec_dict<double> &inc_data) -> Utils::Tensor<double, 2>;
+
+/*
+ * R, T and A_per_layer averaged over the incidence angles of an isotropic radiance, i.e. over theta in [0, pi / 2)
+ * weighted by cos(theta) * sin(theta), with num_nodes-point Gauss-Legendre quadrature. pol 'u' averages 's' and 'p'.
+ * An empty c_list solves the stack coherently: n_list is tiled over the nodes so that all nodes go through a single
+ * angle-vectorized coh_tmm() call per polarization. Otherwise, inc_tmm() takes one angle at a time and the nodes
+ * are solved one by one.
+ */
+template<std::floating_point T>
+auto hemispherical_tmm(const char pol, const std::vector<std::valarray<std::complex<T>>> &n_list,
+                       const std::valarray<T> &d_list, const std::valarray<LayerType> &c_list,
+                       const std::valarray<T> &lam_vac, const std::size_t num_nodes) -> partial_tmm_dict<T> {
+    const std::size_t num_layers = n_list.size();
+    const std::size_t num_wl = lam_vac.size();
+    const auto [x, w] = Utils::Math::gauss_legendre<T>(num_nodes);
+    const std::valarray<T> theta = std::numbers::pi_v<T> / 4 * (x + T(1));
+    // dtheta = pi / 4 * dx, and the weight is normalised by int_0^(pi / 2) cos(theta) * sin(theta) dtheta = 1 / 2.
+    const std::valarray<T> weight = std::numbers::pi_v<T> / 2 * w * std::cos(theta) * std::sin(theta);
+    const std::vector<char> pols = pol == 's' or pol == 'p' ? std::vector<char>{pol} : std::vector<char>{'s', 'p'};
+    std::valarray<T> R(T(0), num_wl);
+    std::valarray<T> Tr(T(0), num_wl);
+    Utils::Tensor<T, 2> A_per_layer;
+    if (c_list.size() == 0) {
+        // Node-major tiling: element a * num_wl + j belongs to node a and wavelength j.
+        const std::size_t num_batch = num_nodes * num_wl;
+        std::vector<std::valarray<std::complex<T>>> n_tiled(num_layers, std::valarray<std::complex<T>>(num_batch));
+        std::valarray<T> lam_tiled(num_batch);
+        std::valarray<std::complex<T>> th_tiled(num_batch);
+        for (std::size_t a = 0; a < num_nodes; a++) {
+            const std::slice node(a * num_wl, num_wl, 1);
+            lam_tiled[node] = lam_vac;
+            th_tiled[node] = theta[a];
+            for (std::size_t i = 0; i < num_layers; i++) {
+                n_tiled.at(i)[node] = n_list.at(i);
+            }
+        }
+        const std::vector<T> d_vec(std::begin(d_list), std::end(d_list));
+        A_per_layer = Utils::Tensor<T, 2>({num_layers, num_wl});
+        for (const char p : pols) {
+            const coh_tmm_vecn_dict<T> out = coh_tmm(p, n_tiled, d_vec, th_tiled, lam_tiled);
+            const std::valarray<T> &R_nodes = std::get<std::valarray<T>>(out.at("R"));
+            const std::valarray<T> &T_nodes = std::get<std::valarray<T>>(out.at("T"));
+            const Utils::Tensor<T, 2> A_nodes = absorp_in_each_layer(out);
+            for (std::size_t a = 0; a < num_nodes; a++) {
+                const std::slice node(a * num_wl, num_wl, 1);
+                const T w_a = weight[a] / static_cast<T>(pols.size());
+                R += w_a * std::valarray<T>(R_nodes[node]);
+                Tr += w_a * std::valarray<T>(T_nodes[node]);
+                A_per_layer += w_a * A_nodes.slice(1, a * num_wl, num_wl);
+            }
+        }
+    } else {
+        for (std::size_t a = 0; a < num_nodes; a++) {
+            const T w_a = weight[a] / static_cast<T>(pols.size());
+            for (const char p : pols) {
+                const inc_tmm_vec_dict<T> out = inc_tmm(p, n_list, d_list, c_list, std::complex<T>(theta[a]), lam_vac);
+                R += w_a * std::get<std::valarray<T>>(out.at("R"));
+                Tr += w_a * std::get<std::valarray<T>>(out.at("T"));
+                const Utils::Tensor<T, 2> A_node = inc_absorp_in_each_layer(out);
+                if (A_per_layer.size() == 0) {
+                    A_per_layer = Utils::Tensor<T, 2>(A_node.shape());
+                }
+                A_per_layer += w_a * A_node;
+            }
+        }
+    }
+    return {{"R", R}, {"T", Tr}, {"A_per_layer", A_per_layer}};
+}
+
+template auto hemispherical_tmm(char pol, const std::vector<std::valarray<std::complex<double>>> &n_list,
+                                const std::valarray<double> &d_list, const std::valarray<LayerType> &c_list,
+                                const std::valarray<double> &lam_vac, std::size_t num_nodes) -> partial_tmm_dict<double>;
 
 template<typename T>
 auto inc_find_absorp_analytic_fn(const std::size_t layer, const inc_tmm_vec_dict<T> &inc_data) -> AbsorpAnalyticVecFn<T> {
@@ -1943,10 +2496,6 @@ auto inc_find_absorp_analytic_fn(const std::size_t layer, const inc_tmm_vec_dict
 
 template auto inc_find_absorp_analytic_fn(std::size_t layer, const inc_tmm_vec_dict<double> &inc_data) -> AbsorpAnalyticVecFn<double>;
 
-// helper type for the visitor
-template<class... Ts>
-struct overloads : Ts... { using Ts::operator()...; };
-
 /*
  * This function is vectorized. Analogous to position_resolved, but
  * for layers (incoherent or coherent) in (partly) incoherent stacks.
@@ -1962,26 +2511,35 @@ struct overloads : Ts... { using Ts::operator()...; };
 template<typename T>
 auto inc_position_resolved(std::valarray<std::size_t> &&layer, const std::valarray<T> &dist,
                            const inc_tmm_vec_dict<T> &inc_tmm_data, const std::valarray<LayerType> &coherency_list,
-                           const std::valarray<std::valarray<T>> &alphas,
-                           const T zero_threshold) -> std::valarray<std::valarray<T>> {
+                           const Utils::Tensor<T, 2> &alphas,
+                           const T zero_threshold) -> Utils::Tensor<T, 2> {
     // If duplicate elements exist, after unique, the last elements will be indeterminate!
-    const std::vector<std::valarray<T>> A_per_layer = inc_absorp_in_each_layer(inc_tmm_data);
-    const std::size_t num_layers = A_per_layer.size();
-    const std::size_t num_wl = A_per_layer.front().size();  // == alphas[0].size()
+    const Utils::Tensor<T, 2> A_per_layer = inc_absorp_in_each_layer(inc_tmm_data);
+    const std::size_t num_layers = A_per_layer.shape(0);
+    const std::size_t num_wl = A_per_layer.shape(1);  // == alphas.shape(1)
     std::vector<std::valarray<T>> fraction_reaching(num_layers, std::valarray<T>(num_wl));
-    fraction_reaching.front() = 1 - A_per_layer.front();
-    std::variant<std::valarray<std::valarray<T>>, std::valarray<std::valarray<std::complex<T>>>> A_layer;
-    // Cumulative sum but cannot use std::accumulate
-    std::valarray<std::valarray<T>> A_local(std::valarray<T>(num_wl), dist.size());  // Note the order of dims
+    // Cumulative sum over the layers
+    std::valarray<T> cumsum_axis0 = A_per_layer[0].flat();
+    fraction_reaching.front() = 1 - cumsum_axis0;
     for (std::size_t i : std::views::iota(1U, num_layers)) {
-        for (std::size_t j : std::views::iota(0U, num_wl)) {
-            T cumsum_axis0 = A_per_layer.front()[j];
-            for (std::size_t k : std::views::iota(1U, i + 1)) {
-                cumsum_axis0 += A_per_layer.at(k)[j];
+        cumsum_axis0 += A_per_layer[i].flat();
+        fraction_reaching.at(i) = 1 - cumsum_axis0;
+    }
+    Utils::Tensor<T, 2> A_local({dist.size(), num_wl});
+    // Copies the rows of A_layer (one per depth in layer l) to the depths in layer l, zeroing the wavelengths that
+    // hardly reach the layer.
+    const auto fill_layer = [&](const std::size_t i, const std::size_t l, const auto &A_layer) -> void {
+        std::size_t row = 0;
+        for (std::size_t k = 0; k < dist.size(); k++) {
+            if (layer[k] not_eq l) {
+                continue;
+            }
+            for (std::size_t j = 0; j < num_wl; j++) {
+                A_local(k, j) = fraction_reaching.at(i)[j] < zero_threshold ? T(0) : std::real(A_layer(row, j));
             }
-            fraction_reaching.at(i)[j] = 1 - cumsum_axis0;
+            row++;
         }
-    }
+    };
     // const std::ranges::subrange<std::size_t*, std::size_t*, (std::ranges::subrange_kind)1> layers = std::ranges::unique(layer);
     // Do not directly use the return value of std::ranges::unique() without erasing!
     std::vector<std::size_t> layers;
@@ -1994,43 +2552,17 @@ auto inc_position_resolved(std::valarray<std::size_t> &&layer, const std::valarr
 #endif
         if (coherency_list[l] == LayerType::Coherent) {
             AbsorpAnalyticVecFn<T> fn = inc_find_absorp_analytic_fn(l, inc_tmm_data);
-            A_layer = fn.run(dist[layer == l]);
+            fill_layer(i, l, fn.run(dist[layer == l]));
         } else {
+            // beer_lambert() is (wavelength, depth); its transpose is a view, not a copy.
 #ifdef _MSC_VER
-            A_layer = beer_lambert(alphas[l], fraction_reaching[i], dist[layer == l] * 1e9, A_per_layer[l]);
+            fill_layer(i, l, beer_lambert(alphas[l].flat(), fraction_reaching[i], dist[layer == l] * 1e9,
+                                          A_per_layer[l].flat()).transposed());
 #else
-            A_layer = beer_lambert(alphas[l], fraction_reaching[i],
-                                   std::valarray<T>(dist[layer == l] * 1e9), A_per_layer[l]);
+            fill_layer(i, l, beer_lambert(alphas[l].flat(), fraction_reaching[i],
+                                          std::valarray<T>(dist[layer == l] * 1e9), A_per_layer[l].flat()).transposed());
 #endif
         }
-        // vaT (beer_lambert) is num_wl * num_llayers while vaCT (fn.run) is num_llayers * num_wl
-        auto use_vaT = [i, zero_threshold, &fraction_reaching, num_wl](std::valarray<std::valarray<T>> &vaT) -> std::valarray<std::valarray<T>> {
-            // std::mask_array<std::valarray<T>> vaT_cond = vaT[fraction_reaching[i] < zero_threshold];
-            // Unfortunately, we cannot write vaT[fraction_reaching[i] < zero_threshold] = std::valarray<T>(0.0, vaT[0].size());
-            vaT = Utils::Range::rng2l_transpose(vaT);
-            // Now vaT is num_llayers * num_wl
-            for (std::size_t j : std::views::iota(0U, vaT.size())) {
-                vaT[j][fraction_reaching.at(i) < zero_threshold] = 0;
-            }
-            return vaT;
-        };
-        auto use_vaCT = [i, zero_threshold, &fraction_reaching, num_wl](std::valarray<std::valarray<std::complex<T>>> &vaCT) -> std::valarray<std::valarray<T>> {
-            vaCT[fraction_reaching[i] < zero_threshold] = std::valarray<std::complex<T>>(0.0, vaCT[0].size());
-            const std::size_t num_llayers = vaCT.size();
-            std::valarray<std::valarray<T>> Areal_layer(std::valarray<T>(num_wl), num_llayers);
-            for (std::size_t j : std::views::iota(0U, num_llayers)) {
-                for (std::size_t k : std::views::iota(0U, num_wl)) {
-                    Areal_layer[j][k] = (fraction_reaching.at(i)[k] < zero_threshold) ? 0 : vaCT[j][k].real();
-                }
-            }
-            return Areal_layer;
-        };
-#if (__cpp_lib_variant >= 202306L)
-        std::valarray<std::valarray<T>> Areal_layer = A_layer.std::visit(overloads{use_vaT, use_vaCT});
-#else
-        std::valarray<std::valarray<T>> Areal_layer = std::visit(overloads{use_vaT, use_vaCT}, A_layer);
-#endif
-        A_local[layer == l] = Areal_layer;
     }
     return A_local;
 }
@@ -2038,34 +2570,30 @@ auto inc_position_resolved(std::valarray<std::size_t> &&layer, const std::valarr
 template auto inc_position_resolved(std::valarray<std::size_t> &&layer, const std::valarray<double> &dist,
                                     const inc_tmm_vec_dict<double> &inc_tmm_data,
                                     const std::valarray<LayerType> &coherency_list,
-                                    const std::valarray<std::valarray<double>> &alphas,
-                                    double zero_threshold) -> std::valarray<std::valarray<double>>;
+                                    const Utils::Tensor<double, 2> &alphas,
+                                    double zero_threshold) -> Utils::Tensor<double, 2>;
 
 template<typename T>
 auto beer_lambert(const std::valarray<T> &alphas, const std::valarray<T> &fraction, const std::valarray<T> &dist,
-                  const std::valarray<T> &A_total) -> std::valarray<std::valarray<T>> {
+                  const std::valarray<T> &A_total) -> Utils::Tensor<T, 2> {
     const std::size_t sz_d = dist.size();
     const std::size_t sz_alpha = alphas.size();
-    std::valarray<std::valarray<T>> expn(std::valarray<T>(sz_d), sz_alpha);
-    // We are doing outer products here, similar to AbsorpAnalyticVecFn<T>::run()
-    for (std::size_t i = 0; i < sz_alpha; i++) {
-        for (std::size_t j = 0; j < sz_d; j++) {
-            expn[i][j] = std::exp(-alphas[i] * dist[j]);
-        }
-    }
     const std::valarray<T> A_integrated = fraction * (1 - std::exp(-alphas * std::ranges::max(dist)));
     // Check std::ranges::contains(A_integrated, 0))
     std::valarray<T> scale = A_total / A_integrated;
     std::ranges::replace_if(scale, [](const T sc) -> bool {
         return std::isnan(sc) or std::isinf(sc);  // 0/0 is nan; otherwise /0 is inf.
     }, 0);
-    std::valarray<std::valarray<T>> output(std::valarray<T>(sz_d), sz_alpha);
+    // We are doing outer products here, similar to AbsorpAnalyticVecFn<T>::run()
+    Utils::Tensor<T, 2> output({sz_alpha, sz_d});
     for (std::size_t i = 0; i < sz_alpha; i++) {
-        output[i] = scale[i] * fraction[i] * alphas[i] * expn[i];  // Not dividing 1e9 here
+        for (std::size_t j = 0; j < sz_d; j++) {
+            output(i, j) = scale[i] * fraction[i] * alphas[i] * std::exp(-alphas[i] * dist[j]);  // Not dividing 1e9 here
+        }
     }
     return output;
 }
 
 template auto beer_lambert(const std::valarray<double> &alphas, const std::valarray<double> &fraction,
                            const std::valarray<double> &dist,
-                           const std::valarray<double> &A_total) -> std::valarray<std::valarray<double>>;
+                           const std::valarray<double> &A_total) -> Utils::Tensor<double, 2>;
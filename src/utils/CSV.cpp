@@ -11,10 +11,15 @@
 // Function to read a CSV file into a 2D vector of strings
 std::vector<std::vector<std::string>> Utils::CSV::readCSV(const std::string &filename) {
     std::ifstream file(filename);
+    return readCSV(file);
+}
+
+// Same for any input stream, e.g., a resource read into memory
+std::vector<std::vector<std::string>> Utils::CSV::readCSV(std::istream &stream) {
     std::vector<std::vector<std::string>> data;
     std::string line, cell;
 
-    while (std::getline(file, line)) {
+    while (std::getline(stream, line)) {
         std::vector<std::string> row;
         std::stringstream lineStream(line);
         while (std::getline(lineStream, cell, ',')) {
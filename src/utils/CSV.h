@@ -5,6 +5,7 @@
 #ifndef CSV_H
 #define CSV_H
 
+#include <istream>
 #include <string>
 #include <vector>
 
@@ -12,6 +13,7 @@ namespace Utils {
     class CSV {
     public:
         static std::vector<std::vector<std::string>> readCSV(const std::string &filename);
+        static std::vector<std::vector<std::string>> readCSV(std::istream &stream);
         static void writeCSV(const std::string &filename, const std::vector<std::vector<std::string>> &data);
         static void modifyCell(std::vector<std::vector<std::string>> &data, size_t row, size_t col, const double newNum);
     };
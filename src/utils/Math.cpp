@@ -4,7 +4,10 @@
 
 #include "Math.h"
 #include <algorithm>
+#include <cmath>
+#include <numbers>
 #include <ranges>
+#include <stdexcept>
 
 /* numpy.real_if_close(a, tol=100)
  * If input is complex with all imaginary parts close to zero, return real parts.
@@ -141,3 +144,92 @@ auto Utils::Math::linspace(const T start, const T stop, const T step) -> std::ve
 }
 
 template auto Utils::Math::linspace(double start, double stop, double step) -> std::vector<double>;
+
+/*
+ * Newton iteration on the Legendre polynomial P_num from the Tricomi initial guesses; the nodes are symmetric, so only
+ * half of them are computed.
+ */
+template<std::floating_point T>
+auto Utils::Math::gauss_legendre(const std::size_t num) -> std::pair<std::valarray<T>, std::valarray<T>> {
+    if (num == 0) {
+        throw std::invalid_argument("Gauss-Legendre quadrature needs at least one node.");
+    }
+    std::valarray<T> nodes(num);
+    std::valarray<T> weights(num);
+    const T n = static_cast<T>(num);
+    for (std::size_t i = 0; i < (num + 1) / 2; i++) {
+        T x = std::cos(std::numbers::pi_v<T> * (static_cast<T>(i) + T(0.75)) / (n + T(0.5)));
+        T dp = 0;
+        for (int iter = 0; iter < 100; iter++) {
+            T p0 = 1;
+            T p1 = x;
+            for (std::size_t k = 2; k <= num; k++) {
+                const T p2 = ((2 * static_cast<T>(k) - 1) * x * p1 - (static_cast<T>(k) - 1) * p0) / static_cast<T>(k);
+                p0 = p1;
+                p1 = p2;
+            }
+            // p1 = P_num(x), p0 = P_{num - 1}(x)
+            dp = n * (x * p1 - p0) / (x * x - 1);
+            const T dx = p1 / dp;
+            x -= dx;
+            if (std::abs(dx) <= EPSILON<T>) {
+                break;
+            }
+        }
+        nodes[i] = -x;
+        nodes[num - 1 - i] = x;
+        weights[i] = weights[num - 1 - i] = 2 / ((1 - x * x) * dp * dp);
+    }
+    return {nodes, weights};
+}
+
+template auto Utils::Math::gauss_legendre(std::size_t num) -> std::pair<std::valarray<double>, std::valarray<double>>;
+
+template<std::floating_point T>
+auto Utils::Math::trapezoid_weights(const std::valarray<T> &x) -> std::valarray<T> {
+    const std::size_t num = x.size();
+    std::valarray<T> weights(T(0), num);
+    if (num < 2) {
+        return weights;
+    }
+    const std::valarray<T> h = std::valarray<T>(x[std::slice(1, num - 1, 1)]) - std::valarray<T>(x[std::slice(0, num - 1, 1)]);
+    weights[std::slice(0, num - 1, 1)] += h / T(2);
+    weights[std::slice(1, num - 1, 1)] += h / T(2);
+    return weights;
+}
+
+template auto Utils::Math::trapezoid_weights(const std::valarray<double> &x) -> std::valarray<double>;
+
+/*
+ * Each pair of intervals (h0, h1) integrates the parabola through its three points. With an odd number of
+ * intervals, the last interval integrates the parabola through the last three points (Cartwright's correction, as
+ * scipy.integrate.simpson since SciPy 1.11). Two points fall back to the trapezoidal rule.
+ */
+template<std::floating_point T>
+auto Utils::Math::simpson_weights(const std::valarray<T> &x) -> std::valarray<T> {
+    const std::size_t num = x.size();
+    if (num < 3) {
+        return trapezoid_weights(x);
+    }
+    std::valarray<T> weights(T(0), num);
+    const std::size_t num_pairs = (num - 1) / 2;
+    for (std::size_t k = 0; k < num_pairs; k++) {
+        const std::size_t i = 2 * k;
+        const T h0 = x[i + 1] - x[i];
+        const T h1 = x[i + 2] - x[i + 1];
+        const T h = h0 + h1;
+        weights[i] += h / 6 * (2 - h1 / h0);
+        weights[i + 1] += h / 6 * h * h / (h0 * h1);
+        weights[i + 2] += h / 6 * (2 - h0 / h1);
+    }
+    if ((num - 1) % 2 == 1) {
+        const T h0 = x[num - 2] - x[num - 3];
+        const T h1 = x[num - 1] - x[num - 2];
+        weights[num - 1] += (2 * h1 * h1 + 3 * h0 * h1) / (6 * (h0 + h1));
+        weights[num - 2] += (h1 * h1 + 3 * h1 * h0) / (6 * h0);
+        weights[num - 3] -= h1 * h1 * h1 / (6 * h0 * (h0 + h1));
+    }
+    return weights;
+}
+
+template auto Utils::Math::simpson_weights(const std::valarray<double> &x) -> std::valarray<double>;
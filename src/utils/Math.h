@@ -5,9 +5,11 @@
 #ifndef UTILS_MATH_H
 #define UTILS_MATH_H
 
+#include <algorithm>
 #include <complex>
 #include <limits>
 #include <ranges>
+#include <stdexcept>
 #include <valarray>
 #include <variant>
 #include <vector>
@@ -40,17 +42,33 @@ namespace Utils::Math {
     template<typename T>
     auto linspace(T start, T stop, T step) -> std::vector<T>;
 
+    // Gauss-Legendre nodes and weights of order num on [-1, 1]
+    template<std::floating_point T>
+    auto gauss_legendre(std::size_t num) -> std::pair<std::valarray<T>, std::valarray<T>>;
+
+    // Weights w of the composite trapezoidal rule on the (not necessarily uniform) grid x, i.e. (w * y).sum()
+    // integrates y(x)
+    template<std::floating_point T>
+    auto trapezoid_weights(const std::valarray<T> &x) -> std::valarray<T>;
+
+    // Weights of the composite Simpson's rule on the (not necessarily uniform) grid x, as scipy.integrate.simpson
+    template<std::floating_point T>
+    auto simpson_weights(const std::valarray<T> &x) -> std::valarray<T>;
+
     // If you do not want to import a heap of headers of instances list QList, put the definition here.
     // Note that the parameter order is different from numpy.interp!
-    template<FloatingList U, FloatingList V>
-    auto interp1_linear(U &&x, U &&y, V &&xi) -> std::remove_reference_t<U> {
+    // y may be stored in a narrower type than x, e.g. float n, k on a double wavelength grid; yi is computed and
+    // returned in the type of x.
+    template<FloatingList U, FloatingList W, FloatingList V>
+    auto interp1_linear(U &&x, W &&y, V &&xi) -> std::remove_cvref_t<U> {
+        using R = typename std::remove_cvref_t<U>::value_type;
         if (x.size() not_eq y.size()) {
             throw std::invalid_argument("x and y must have the same length");
         }
         if (x.size() < 2) {
             throw std::invalid_argument("x and y must have at least two elements");
         }
-        std::remove_reference_t<U> yi(static_cast<typename std::remove_reference_t<U>::value_type>(xi.size()));
+        std::remove_cvref_t<U> yi(static_cast<R>(xi.size()));
         // const typename std::remove_reference_t<V>::value_type xi_val
 #ifdef __cpp_lib_ranges_enumerate
         for (const auto [i, xi_val] : std::views::enumerate(xi)) {
@@ -65,7 +83,7 @@ namespace Utils::Math {
             } else {
                 for (size_t j = 0; j < x.size() - 1; ++j) {
                     if (xi_val >= x[j] && xi_val <= x[j + 1]) {
-                        yi[i] = std::lerp(y[j], y[j + 1], (xi_val - x[j]) / (x[j + 1] - x[j]));
+                        yi[i] = std::lerp(static_cast<R>(y[j]), static_cast<R>(y[j + 1]), (xi_val - x[j]) / (x[j + 1] - x[j]));
                         break;
                     }
                 }
@@ -73,6 +91,138 @@ namespace Utils::Math {
         }
         return yi;
     }
+
+    // Linear-interpolation stencil of points xi on an ascending grid x, to be applied to any y on x:
+    // y(xi[i]) = (1 - weight[i]) * y[lower[i]] + weight[i] * y[upper[i]].
+    // Points outside x are clamped to its ends, as in interp1_linear.
+    template<std::floating_point R>
+    struct LinearStencil {
+        std::vector<std::size_t> lower;
+        std::vector<std::size_t> upper;
+        std::vector<R> weight;
+    };
+
+    template<std::floating_point R, typename U, typename V>
+    auto linear_stencil(const U &x, const V &xi) -> LinearStencil<R> {
+        if (x.size() == 0) {
+            throw std::invalid_argument("x must not be empty");
+        }
+        const std::size_t last = x.size() - 1;
+        LinearStencil<R> stencil{std::vector<std::size_t>(xi.size()), std::vector<std::size_t>(xi.size()),
+                                 std::vector<R>(xi.size())};
+        for (std::size_t i = 0; i < xi.size(); i++) {
+            const auto xi_val = xi[i];
+            if (xi_val <= x[0]) {
+                stencil.lower[i] = stencil.upper[i] = 0;
+            } else if (xi_val >= x[last]) {
+                stencil.lower[i] = stencil.upper[i] = last;
+            } else {
+                // Binary search; x[upper - 1] < xi_val <= x[upper]
+                const std::size_t upper = std::distance(std::begin(x), std::lower_bound(std::begin(x), std::end(x), xi_val));
+                stencil.lower[i] = upper - 1;
+                stencil.upper[i] = upper;
+                stencil.weight[i] = static_cast<R>((xi_val - x[upper - 1]) / (x[upper] - x[upper - 1]));
+            }
+        }
+        return stencil;
+    }
+
+    /*
+     * Monotone piecewise cubic Hermite interpolant (PCHIP, as scipy.interpolate.PchipInterpolator) of y on an
+     * strictly ascending grid x. Unlike a spline, it does not overshoot the data, e.g. k does not turn negative at an absorption
+     * edge, while it follows curved spectra much closer than linear interpolation on the same grid. The polynomial
+     * coefficients of every interval are computed once, so evaluating is a binary search and a Horner step per point.
+     * Points outside x are clamped to its ends, as in interp1_linear.
+     */
+    template<std::floating_point R>
+    class Pchip {
+    public:
+        template<typename U, typename W>
+        Pchip(const U &x, const W &y) : x(std::begin(x), std::end(x)), c0(std::begin(y), std::end(y)) {
+            const std::size_t num = this->x.size();
+            if (num not_eq c0.size()) {
+                throw std::invalid_argument("x and y must have the same length");
+            }
+            if (num < 2) {
+                throw std::invalid_argument("x and y must have at least two elements");
+            }
+            std::vector<R> h(num - 1);
+            std::vector<R> delta(num - 1);
+            for (std::size_t i = 0; i < num - 1; i++) {
+                h[i] = this->x[i + 1] - this->x[i];
+                // Also rejects NaN
+                if (not (h[i] > 0)) {
+                    throw std::invalid_argument("x must be strictly ascending");
+                }
+                delta[i] = (c0[i + 1] - c0[i]) / h[i];
+            }
+            // Fritsch-Carlson derivatives: weighted harmonic means of the neighbouring slopes, 0 at extrema
+            std::vector<R> d(num);
+            if (num == 2) {
+                d[0] = d[1] = delta[0];
+            } else {
+                for (std::size_t i = 1; i < num - 1; i++) {
+                    if (delta[i - 1] * delta[i] > 0) {
+                        const R w1 = 2 * h[i] + h[i - 1];
+                        const R w2 = h[i] + 2 * h[i - 1];
+                        d[i] = (w1 + w2) / (w1 / delta[i - 1] + w2 / delta[i]);
+                    }
+                }
+                d[0] = edge_derivative(h[0], h[1], delta[0], delta[1]);
+                d[num - 1] = edge_derivative(h[num - 2], h[num - 3], delta[num - 2], delta[num - 3]);
+            }
+            c1.assign(d.cbegin(), d.cend() - 1);
+            c2.resize(num - 1);
+            c3.resize(num - 1);
+            for (std::size_t i = 0; i < num - 1; i++) {
+                c2[i] = (3 * delta[i] - 2 * d[i] - d[i + 1]) / h[i];
+                c3[i] = (d[i] + d[i + 1] - 2 * delta[i]) / (h[i] * h[i]);
+            }
+        }
+
+        template<typename Out, typename V>
+        [[nodiscard]] auto evaluate(const V &xi) const -> Out {
+            Out yi(xi.size());
+            for (std::size_t j = 0; j < static_cast<std::size_t>(xi.size()); j++) {
+                const R xi_val = static_cast<R>(xi[j]);
+                if (xi_val <= x.front()) {
+                    yi[j] = c0.front();
+                } else if (xi_val >= x.back()) {
+                    yi[j] = c0.back();
+                } else {
+                    const std::size_t i = std::distance(x.cbegin(), std::upper_bound(x.cbegin(), x.cend(), xi_val)) - 1;
+                    const R t = xi_val - x[i];
+                    yi[j] = c0[i] + t * (c1[i] + t * (c2[i] + t * c3[i]));
+                }
+            }
+            return yi;
+        }
+
+        // Bytes of the grid and the coefficients
+        [[nodiscard]] std::size_t memory_usage() const {
+            return (x.size() + c0.size() + c1.size() + c2.size() + c3.size()) * sizeof(R);
+        }
+
+    private:
+        std::vector<R> x;
+        // y on [x[i], x[i + 1]] is c0[i] + t * (c1[i] + t * (c2[i] + t * c3[i])) with t = x - x[i]; c0 is y.
+        std::vector<R> c0;
+        std::vector<R> c1;
+        std::vector<R> c2;
+        std::vector<R> c3;
+
+        // One-sided three-point derivative at an end, limited to keep the interpolant monotone
+        static R edge_derivative(const R h0, const R h1, const R delta0, const R delta1) {
+            const R d = ((2 * h0 + h1) * delta0 - h0 * delta1) / (h0 + h1);
+            if (d * delta0 <= 0) {
+                return 0;
+            }
+            if (delta0 * delta1 < 0 and std::abs(d) > std::abs(3 * delta0)) {
+                return 3 * delta0;
+            }
+            return d;
+        }
+    };
 }
 
 #endif  // UTILS_MATH_H
@@ -0,0 +1,166 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <utility>
+
+#include "NumericParser.h"
+
+namespace {
+    constexpr std::string_view whitespace = " \t\r\f\v";
+
+    auto trim(const std::string_view field) -> std::string_view {
+        const std::size_t first = field.find_first_not_of(whitespace);
+        if (first == std::string_view::npos) {
+            return field.substr(field.size());
+        }
+        return field.substr(first, field.find_last_not_of(whitespace) - first + 1);
+    }
+}
+
+Utils::NumericParser::NumericParser(const std::string_view text, std::string source) : text(text),
+                                                                                      source(std::move(source)) {}
+
+auto Utils::NumericParser::at_end() const -> bool {
+    return pos >= text.size();
+}
+
+auto Utils::NumericParser::line_number() const -> std::size_t {
+    return line_no;
+}
+
+auto Utils::NumericParser::read_line() -> std::string_view {
+    if (at_end()) {
+        fail(nullptr, "unexpected end of file");
+    }
+    std::size_t end = text.find('\n', pos);
+    if (end == std::string_view::npos) {
+        end = text.size();
+    }
+    line = text.substr(pos, end - pos);
+    if (line.ends_with('\r')) {
+        line.remove_suffix(1);
+    }
+    pos = end + 1;
+    line_no++;
+    return line;
+}
+
+void Utils::NumericParser::skip_lines(const std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        read_line();
+    }
+}
+
+auto Utils::NumericParser::read_fields(const char separator) -> std::vector<std::string_view> {
+    std::string_view rest = read_line();
+    std::vector<std::string_view> fields;
+    for (std::string_view field = next_field(rest, separator); not field.empty(); field = next_field(rest, separator)) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+template<typename T>
+auto Utils::NumericParser::parse(const std::string_view field) const -> T {
+    const char *first = field.data();
+    const char *last = field.data() + field.size();
+    if (first not_eq last and *first == '+') {
+        ++first;
+    }
+    T value{};
+    const auto [ptr, ec] = std::from_chars(first, last, value);
+    if (ec == std::errc::result_out_of_range) {
+        fail(field.data(), "number out of range '" + std::string(field) + "'");
+    }
+    if (ec not_eq std::errc() or ptr not_eq last) {
+        fail(field.data(), "invalid number '" + std::string(field) + "'");
+    }
+    return value;
+}
+
+auto Utils::NumericParser::read_columns(const std::vector<std::size_t> &columns, const std::size_t num_fields,
+                                        const char separator, const std::size_t max_rows) -> std::vector<std::vector<double>> {
+    if (columns.empty()) {
+        throw std::invalid_argument("No columns to read.");
+    }
+    const std::size_t min_fields = std::ranges::max(columns) + 1;
+    if (num_fields not_eq 0 and num_fields < min_fields) {
+        throw std::invalid_argument("A requested column exceeds the number of fields.");
+    }
+    // Output container of each field, or columns.size() if the field is not read
+    std::vector<std::size_t> slots(min_fields, columns.size());
+    for (std::size_t c = 0; c < columns.size(); c++) {
+        slots.at(columns.at(c)) = c;
+    }
+    const std::size_t num_lines = std::ranges::count(text.substr(std::min(pos, text.size())), '\n') + 1;
+    std::vector<std::vector<double>> data(columns.size());
+    for (std::vector<double> &column : data) {
+        column.reserve(std::min(num_lines, max_rows));
+    }
+    std::size_t num_rows = 0;
+    while (num_rows < max_rows and not at_end()) {
+        std::string_view rest = read_line();
+        if (rest.find_first_not_of(whitespace) == std::string_view::npos) {
+            continue;
+        }
+        std::size_t count = 0;
+        for (std::string_view field = next_field(rest, separator); not field.empty(); field = next_field(rest, separator)) {
+            if (count < min_fields and slots[count] < columns.size()) {
+                data[slots[count]].push_back(parse<double>(field));
+            } else if (num_fields == 0 and count >= min_fields) {
+                break;
+            } else if (num_fields not_eq 0 and count >= num_fields) {
+                fail(field.data(), "expected " + std::to_string(num_fields) + " fields, found more");
+            }
+            count++;
+        }
+        if (count < min_fields or (num_fields not_eq 0 and count not_eq num_fields)) {
+            fail(line.data() + line.size(), "expected " + std::to_string(num_fields == 0 ? min_fields : num_fields) +
+                 " fields, found " + std::to_string(count));
+        }
+        num_rows++;
+    }
+    if (max_rows not_eq std::numeric_limits<std::size_t>::max() and num_rows < max_rows) {
+        fail(nullptr, "expected " + std::to_string(max_rows) + " rows, found " + std::to_string(num_rows));
+    }
+    return data;
+}
+
+void Utils::NumericParser::fail(const char *at, const std::string &message) const {
+    std::string position = source + ':' + std::to_string(line_no);
+    if (at not_eq nullptr) {
+        position += ':' + std::to_string(at - line.data() + 1);
+    }
+    throw std::runtime_error(position + ": " + message);
+}
+
+auto Utils::NumericParser::next_field(std::string_view &rest, const char separator) const -> std::string_view {
+    if (separator == ' ') {
+        const std::size_t first = rest.find_first_not_of(whitespace);
+        if (first == std::string_view::npos) {
+            rest.remove_prefix(rest.size());
+            return rest;
+        }
+        const std::size_t last = std::min(rest.find_first_of(whitespace, first), rest.size());
+        const std::string_view field = rest.substr(first, last - first);
+        rest.remove_prefix(last);
+        return field;
+    }
+    while (not rest.empty()) {
+        const std::size_t last = std::min(rest.find(separator), rest.size());
+        const std::string_view field = trim(rest.substr(0, last));
+        rest.remove_prefix(std::min(last + 1, rest.size()));
+        if (not field.empty()) {
+            return field;
+        }
+    }
+    return rest;
+}
+
+template auto Utils::NumericParser::parse<double>(std::string_view field) const -> double;
+template auto Utils::NumericParser::parse<float>(std::string_view field) const -> float;
+template auto Utils::NumericParser::parse<std::size_t>(std::string_view field) const -> std::size_t;
@@ -0,0 +1,62 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef UTILS_NUMERICPARSER_H
+#define UTILS_NUMERICPARSER_H
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Utils {
+    /*
+     * Line-oriented parser of numeric text tables (Solcore n/k files, Sopra .MAT files, etc.) over a buffer holding
+     * the whole file, e.g. from QFile::readAll(). Fields are views into the buffer and numbers are converted with
+     * std::from_chars, so nothing is allocated per line or per number. The buffer must outlive the parser.
+
+     * separator ' ' splits at runs of whitespace; any other separator splits at that character, and fields are
+     * trimmed of whitespace, empty fields being skipped as with Qt::SkipEmptyParts. Both "\n" and "\r\n" end lines.
+     * Errors are thrown as std::runtime_error with the position "source:line:column: ".
+     */
+    class NumericParser {
+    public:
+        NumericParser(std::string_view text, std::string source);
+
+        [[nodiscard]] auto at_end() const -> bool;
+        // 1-based number of the last line read
+        [[nodiscard]] auto line_number() const -> std::size_t;
+        auto read_line() -> std::string_view;
+        void skip_lines(std::size_t count);
+        // Fields of the next line, for headers such as "POINTS*  100*"
+        auto read_fields(char separator = ' ') -> std::vector<std::string_view>;
+
+        /*
+         * Converts a whole field of the last line read, a leading '+' allowed. T: double, float or std::size_t.
+         */
+        template<typename T>
+        auto parse(std::string_view field) const -> T;
+
+        /*
+         * Reads up to max_rows rows (blank lines are skipped) and returns the given columns (0-based field indices),
+         * each as one contiguous vector. A row must have exactly num_fields fields if num_fields is not zero,
+         * otherwise at least as many as the largest requested column needs.
+         */
+        auto read_columns(const std::vector<std::size_t> &columns, std::size_t num_fields = 0, char separator = ' ',
+                          std::size_t max_rows = std::numeric_limits<std::size_t>::max()) -> std::vector<std::vector<double>>;
+
+    private:
+        std::string_view text;
+        std::string source;
+        std::size_t pos = 0;
+        std::size_t line_no = 0;
+        std::string_view line;
+
+        [[noreturn]] void fail(const char *at, const std::string &message) const;
+        auto next_field(std::string_view &rest, char separator) const -> std::string_view;
+    };
+}
+
+#endif  // UTILS_NUMERICPARSER_H
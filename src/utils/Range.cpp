@@ -5,18 +5,90 @@
 // GCC/Clang has already forwarded <algorithm> from <valarray>, but it is not the case for MSVC.
 #include <algorithm>
 #include <complex>
+#include <stdexcept>
 #include "Range.h"
 
+/*
+ * Edge of the square tiles: the largest power of 2 for which a source and a destination tile of T fit in 16 KiB, half
+ * of a typical L1 data cache, e.g., 32 for double and 16 for std::complex<double>.
+ */
+template<typename T>
+consteval auto transpose_tile() -> std::size_t {
+    std::size_t tile = 1;
+    while (2 * (2 * tile) * (2 * tile) * sizeof(T) <= 16384) {
+        tile *= 2;
+    }
+    return tile;
+}
+
 template<std::ranges::sized_range U>
 auto Utils::Range::rng2d_transpose(const U &old_rng, const std::size_t num_rows) -> U {
     U new_rng(old_rng.size());
+    rng2d_transpose(old_rng, num_rows, new_rng);
+    return new_rng;
+}
+
+template<std::ranges::sized_range U>
+void Utils::Range::rng2d_transpose(const U &old_rng, const std::size_t num_rows, U &new_rng) {
+    if (new_rng.size() not_eq old_rng.size()) {
+        throw std::invalid_argument("The destination of the transpose must have the size of the source.");
+    }
+    if (num_rows == 0) {
+        return;
+    }
+    constexpr std::size_t tile = transpose_tile<std::ranges::range_value_t<U>>();
     const std::size_t num_cols = old_rng.size() / num_rows;
-    for (std::size_t i = 0; i < num_rows; i++) {
-        for (std::size_t j = 0; j < num_cols; j++) {
-            new_rng[j * num_rows + i] = old_rng[i * num_cols + j];
+    for (std::size_t i_tile = 0; i_tile < num_rows; i_tile += tile) {
+        const std::size_t i_end = std::min(i_tile + tile, num_rows);
+        for (std::size_t j_tile = 0; j_tile < num_cols; j_tile += tile) {
+            const std::size_t j_end = std::min(j_tile + tile, num_cols);
+            for (std::size_t i = i_tile; i < i_end; i++) {
+                for (std::size_t j = j_tile; j < j_end; j++) {
+                    new_rng[j * num_rows + i] = old_rng[i * num_cols + j];
+                }
+            }
         }
     }
-    return new_rng;
+}
+
+template<std::ranges::sized_range U>
+void Utils::Range::rng2d_transpose_inplace(U &rng, const std::size_t num_rows) {
+    const std::size_t size = rng.size();
+    if (num_rows == 0 or size < 3) {
+        return;
+    }
+    const std::size_t num_cols = size / num_rows;
+    if (num_rows == num_cols) {
+        constexpr std::size_t tile = transpose_tile<std::ranges::range_value_t<U>>();
+        for (std::size_t i_tile = 0; i_tile < num_rows; i_tile += tile) {
+            const std::size_t i_end = std::min(i_tile + tile, num_rows);
+            // Tiles above the diagonal swap with their mirror images; the diagonal tiles with themselves.
+            for (std::size_t j_tile = i_tile; j_tile < num_cols; j_tile += tile) {
+                const std::size_t j_end = std::min(j_tile + tile, num_cols);
+                for (std::size_t i = i_tile; i < i_end; i++) {
+                    for (std::size_t j = std::max(j_tile, i + 1); j < j_end; j++) {
+                        std::swap(rng[i * num_cols + j], rng[j * num_rows + i]);
+                    }
+                }
+            }
+        }
+        return;
+    }
+    // Element k = i * num_cols + j goes to j * num_rows + i = k * num_rows mod (size - 1); the first and last elements
+    // stay in place.
+    std::vector<bool> moved(size, false);
+    for (std::size_t start = 1; start < size - 1; start++) {
+        if (moved.at(start)) {
+            continue;
+        }
+        std::ranges::range_value_t<U> carried = rng[start];
+        std::size_t k = start;
+        do {
+            k = k * num_rows % (size - 1);
+            std::swap(carried, rng[k]);
+            moved.at(k) = true;
+        } while (k not_eq start);
+    }
 }
 
 template auto Utils::Range::rng2d_transpose(const std::valarray<std::complex<double>> &old_va,
@@ -27,6 +99,13 @@ template auto Utils::Range::rng2d_transpose(const std::valarray<std::size_t> &ol
                               std::size_t num_rows) -> std::valarray<std::size_t>;
 template auto Utils::Range::rng2d_transpose(const std::vector<double> &old_vec,
                               std::size_t num_rows) -> std::vector<double>;
+template void Utils::Range::rng2d_transpose(const std::valarray<std::complex<double>> &old_va, std::size_t num_rows,
+                                            std::valarray<std::complex<double>> &new_va);
+template void Utils::Range::rng2d_transpose(const std::valarray<double> &old_va, std::size_t num_rows,
+                                            std::valarray<double> &new_va);
+template void Utils::Range::rng2d_transpose_inplace(std::valarray<std::complex<double>> &va, std::size_t num_rows);
+template void Utils::Range::rng2d_transpose_inplace(std::valarray<double> &va, std::size_t num_rows);
+template void Utils::Range::rng2d_transpose_inplace(std::vector<double> &vec, std::size_t num_rows);
 
 template<std::ranges::sized_range U>
 requires std::ranges::sized_range<std::ranges::range_value_t<U>> and (not std::ranges::range<typename std::ranges::range_value_t<U>::value_type>)
@@ -37,9 +116,16 @@ auto Utils::Range::rng2l_transpose(const U &old_rng) -> U {
     for (std::size_t i = 0; i < num_cols; i++) {
         new_rng[i] = typename U::value_type(num_rows);
     }
-    for (std::size_t i = 0; i < num_rows; i++) {
-        for (std::size_t j = 0; j < num_cols; j++) {
-            new_rng[j][i] = old_rng[i][j];
+    constexpr std::size_t tile = transpose_tile<typename std::ranges::range_value_t<U>::value_type>();
+    for (std::size_t i_tile = 0; i_tile < num_rows; i_tile += tile) {
+        const std::size_t i_end = std::min(i_tile + tile, num_rows);
+        for (std::size_t j_tile = 0; j_tile < num_cols; j_tile += tile) {
+            const std::size_t j_end = std::min(j_tile + tile, num_cols);
+            for (std::size_t i = i_tile; i < i_end; i++) {
+                for (std::size_t j = j_tile; j < j_end; j++) {
+                    new_rng[j][i] = old_rng[i][j];
+                }
+            }
         }
     }
     return new_rng;
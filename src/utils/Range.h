@@ -18,9 +18,40 @@
 // using std::size_t;
 
 namespace Utils::Range {
+    /*
+     * Transposes the row-major num_rows x (size / num_rows) matrix in old_va. The copies go tile by tile, with tiles
+     * small enough for the source and destination tiles to stay in L1 together, so that neither side is read or
+     * written with a large stride for long.
+     */
     template<std::ranges::sized_range U>
     auto rng2d_transpose(const U &old_va, std::size_t num_rows) -> U;
 
+    /*
+     * As above, into new_va, which must have the same size as old_va and must not overlap with it.
+     */
+    template<std::ranges::sized_range U>
+    void rng2d_transpose(const U &old_va, std::size_t num_rows, U &new_va);
+
+    /*
+     * In-place transpose. Square matrices swap mirrored tiles; the others follow the cycles of the permutation
+     * k -> k * num_rows mod (size - 1), with one bit of extra storage per element.
+     */
+    template<std::ranges::sized_range U>
+    void rng2d_transpose_inplace(U &va, std::size_t num_rows);
+
+    /*
+     * Lazy transpose: a random-access view of the transposed matrix that reads old_va on demand, for callers that
+     * only walk the transpose once, e.g., to copy it into another layout. old_va must outlive the view.
+     */
+    template<std::ranges::random_access_range U>
+    auto rng2d_transposed_view(const U &old_va, const std::size_t num_rows) {
+        const std::size_t num_cols = std::ranges::size(old_va) / num_rows;
+        return std::views::iota(std::size_t(0), std::ranges::size(old_va)) |
+               std::views::transform([&old_va, num_rows, num_cols](const std::size_t k) {
+                   return old_va[k % num_rows * num_cols + k / num_rows];
+               });
+    }
+
     template<std::ranges::sized_range U>
     requires std::ranges::sized_range<std::ranges::range_value_t<U>> and (not std::ranges::range<typename std::ranges::range_value_t<U>::value_type>)
     auto rng2l_transpose(const U &old_rng) -> U;
@@ -0,0 +1,231 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <complex>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include "Tensor.h"
+
+template<typename T, std::size_t N>
+Utils::Tensor<T, N>::Tensor(const std::array<std::size_t, N> &shape, const T value) :
+        Tensor(shape, std::valarray<T>(value, std::reduce(shape.cbegin(), shape.cend(), std::size_t(1),
+                                                          std::multiplies<>()))) {}
+
+template<typename T, std::size_t N>
+Utils::Tensor<T, N>::Tensor(const std::array<std::size_t, N> &shape, std::valarray<T> values) : dims(shape) {
+    std::size_t step = 1;
+    for (std::size_t k = N; k-- > 0;) {
+        steps.at(k) = step;
+        step *= dims.at(k);
+    }
+    if (values.size() not_eq step) {
+        throw std::invalid_argument("The number of values does not match the shape.");
+    }
+    buffer = std::make_shared<std::valarray<T>>(std::move(values));
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::shape() const -> const std::array<std::size_t, N> & {
+    return dims;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::shape(const std::size_t axis) const -> std::size_t {
+    return dims.at(axis);
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::size() const -> std::size_t {
+    return std::reduce(dims.cbegin(), dims.cend(), std::size_t(1), std::multiplies<>());
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::is_contiguous() const -> bool {
+    std::size_t step = 1;
+    for (std::size_t k = N; k-- > 0;) {
+        if (dims.at(k) not_eq 1 and steps.at(k) not_eq step) {
+            return false;
+        }
+        step *= dims.at(k);
+    }
+    return true;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator[](const std::size_t i) const -> Tensor<T, N - 1> requires (N > 1) {
+    if (i >= dims.front()) {
+        throw std::out_of_range("Tensor index out of range.");
+    }
+    Tensor<T, N - 1> sub;
+    sub.buffer = buffer;
+    std::copy(std::next(dims.cbegin()), dims.cend(), sub.dims.begin());
+    std::copy(std::next(steps.cbegin()), steps.cend(), sub.steps.begin());
+    sub.start = start + i * steps.front();
+    return sub;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::transposed(const std::size_t axis0, const std::size_t axis1) const -> Tensor {
+    Tensor view = *this;
+    std::swap(view.dims.at(axis0), view.dims.at(axis1));
+    std::swap(view.steps.at(axis0), view.steps.at(axis1));
+    return view;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::slice(const std::size_t axis, const std::size_t first,
+                                const std::size_t length) const -> Tensor {
+    if (first + length > dims.at(axis)) {
+        throw std::out_of_range("Tensor slice out of range.");
+    }
+    Tensor view = *this;
+    view.dims.at(axis) = length;
+    view.start += first * steps.at(axis);
+    return view;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::flat() const -> std::valarray<T> {
+    if (not buffer) {
+        return {};
+    }
+    if (is_contiguous()) {
+        return (*buffer)[std::slice(start, size(), 1)];
+    }
+    return (*buffer)[elements()];
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::clone() const -> Tensor {
+    return {dims, flat()};
+}
+
+template<typename T, std::size_t N>
+void Utils::Tensor<T, N>::assign(const std::valarray<T> &values) {
+    if (values.size() not_eq size()) {
+        throw std::invalid_argument("The number of values does not match the shape.");
+    }
+    storage()[elements()] = values;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator+=(const std::valarray<T> &values) -> Tensor & {
+    storage()[elements()] += values;
+    return *this;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator-=(const std::valarray<T> &values) -> Tensor & {
+    storage()[elements()] -= values;
+    return *this;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator*=(const std::valarray<T> &values) -> Tensor & {
+    storage()[elements()] *= values;
+    return *this;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator/=(const std::valarray<T> &values) -> Tensor & {
+    storage()[elements()] /= values;
+    return *this;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator+=(const Tensor &other) -> Tensor & {
+    check_shape(other);
+    return *this += other.flat();
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator-=(const Tensor &other) -> Tensor & {
+    check_shape(other);
+    return *this -= other.flat();
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator*=(const T factor) -> Tensor & {
+    return *this *= std::valarray<T>(factor, size());
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::operator/=(const T factor) -> Tensor & {
+    return *this /= std::valarray<T>(factor, size());
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::storage() const -> std::valarray<T> & {
+    // A default-constructed tensor has no buffer to write to.
+    if (not buffer) {
+        throw std::logic_error("Tensor has no buffer; construct it with a shape first.");
+    }
+    return *buffer;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::offset(const std::array<std::size_t, N> &index) const -> std::size_t {
+    std::size_t pos = start;
+    for (std::size_t k = 0; k < N; k++) {
+        pos += index.at(k) * steps.at(k);
+    }
+    return pos;
+}
+
+template<typename T, std::size_t N>
+auto Utils::Tensor<T, N>::elements() const -> std::gslice {
+    // std::gslice enumerates the indices with the last length varying fastest, i.e., in row-major order.
+    return {start, std::valarray<std::size_t>(dims.data(), N), std::valarray<std::size_t>(steps.data(), N)};
+}
+
+template<typename T, std::size_t N>
+void Utils::Tensor<T, N>::check_shape(const Tensor &other) const {
+    if (other.dims not_eq dims) {
+        throw std::invalid_argument("Tensor shapes do not match.");
+    }
+}
+
+template<typename T, std::size_t N>
+auto Utils::operator+(const Tensor<T, N> &a, const Tensor<T, N> &b) -> Tensor<T, N> {
+    Tensor<T, N> sum = a.clone();
+    sum += b;
+    return sum;
+}
+
+template<typename T, std::size_t N>
+auto Utils::operator-(const Tensor<T, N> &a, const Tensor<T, N> &b) -> Tensor<T, N> {
+    Tensor<T, N> difference = a.clone();
+    difference -= b;
+    return difference;
+}
+
+template<typename T, std::size_t N>
+auto Utils::operator*(const Tensor<T, N> &a, const T factor) -> Tensor<T, N> {
+    return {a.shape(), a.flat() * factor};
+}
+
+template<typename T, std::size_t N>
+auto Utils::operator*(const T factor, const Tensor<T, N> &a) -> Tensor<T, N> {
+    return {a.shape(), factor * a.flat()};
+}
+
+template<typename T, std::size_t N>
+auto Utils::operator/(const Tensor<T, N> &a, const T factor) -> Tensor<T, N> {
+    return {a.shape(), a.flat() / factor};
+}
+
+template class Utils::Tensor<double, 1>;
+template class Utils::Tensor<double, 2>;
+template class Utils::Tensor<double, 3>;
+template class Utils::Tensor<float, 1>;
+template class Utils::Tensor<float, 2>;
+template class Utils::Tensor<std::complex<double>, 1>;
+template class Utils::Tensor<std::complex<double>, 2>;
+template auto Utils::operator+(const Tensor<double, 2> &a, const Tensor<double, 2> &b) -> Tensor<double, 2>;
+template auto Utils::operator-(const Tensor<double, 2> &a, const Tensor<double, 2> &b) -> Tensor<double, 2>;
+template auto Utils::operator*(const Tensor<double, 2> &a, double factor) -> Tensor<double, 2>;
+template auto Utils::operator*(double factor, const Tensor<double, 2> &a) -> Tensor<double, 2>;
+template auto Utils::operator/(const Tensor<double, 2> &a, double factor) -> Tensor<double, 2>;
@@ -0,0 +1,106 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#ifndef UTILS_TENSOR_H
+#define UTILS_TENSOR_H
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <valarray>
+
+namespace Utils {
+    /*
+     * N-dimensional strided array over a single contiguous buffer, for optics results indexed by (layer, wavelength),
+     * (depth, wavelength), etc. Element (i_0, ..., i_{N-1}) is buffer[start + sum_k i_k * steps[k]], so transposing,
+     * taking the sub-array at an index of the first axis or a range along an axis only changes dims, steps and start:
+     * the result is a view of the same buffer, and writing through it writes to the original. Copies are views as
+     * well; clone() makes an independent copy. New tensors are row-major, i.e., the last axis is contiguous, and
+     * flat() gathers the elements of any view in row-major order with a std::gslice.
+     */
+    template<typename T, std::size_t N>
+    class Tensor {
+    public:
+        Tensor() = default;
+        explicit Tensor(const std::array<std::size_t, N> &shape, T value = T());
+        // values in row-major order
+        Tensor(const std::array<std::size_t, N> &shape, std::valarray<T> values);
+
+        [[nodiscard]] auto shape() const -> const std::array<std::size_t, N> &;
+        [[nodiscard]] auto shape(std::size_t axis) const -> std::size_t;
+        [[nodiscard]] auto size() const -> std::size_t;
+        [[nodiscard]] auto is_contiguous() const -> bool;
+
+        template<std::convertible_to<std::size_t>... I>
+        requires (sizeof...(I) == N)
+        auto operator()(I... index) -> T & {
+            return (*buffer)[offset({static_cast<std::size_t>(index)...})];
+        }
+
+        template<std::convertible_to<std::size_t>... I>
+        requires (sizeof...(I) == N)
+        auto operator()(I... index) const -> const T & {
+            return (*buffer)[offset({static_cast<std::size_t>(index)...})];
+        }
+
+        /*
+         * View of the sub-array at index i of the first axis, e.g., the spectrum of one layer.
+         */
+        auto operator[](std::size_t i) const -> Tensor<T, N - 1> requires (N > 1);
+        /*
+         * View with axis0 and axis1 swapped; the default reverses a 2D tensor.
+         */
+        [[nodiscard]] auto transposed(std::size_t axis0 = 0, std::size_t axis1 = N - 1) const -> Tensor;
+        /*
+         * View of the indices [first, first + length) of the given axis.
+         */
+        [[nodiscard]] auto slice(std::size_t axis, std::size_t first, std::size_t length) const -> Tensor;
+        [[nodiscard]] auto flat() const -> std::valarray<T>;
+        [[nodiscard]] auto clone() const -> Tensor;
+        /*
+         * Writes values, in row-major order, to the elements of this view.
+         */
+        void assign(const std::valarray<T> &values);
+
+        auto operator+=(const std::valarray<T> &values) -> Tensor &;
+        auto operator-=(const std::valarray<T> &values) -> Tensor &;
+        auto operator*=(const std::valarray<T> &values) -> Tensor &;
+        auto operator/=(const std::valarray<T> &values) -> Tensor &;
+        auto operator+=(const Tensor &other) -> Tensor &;
+        auto operator-=(const Tensor &other) -> Tensor &;
+        auto operator*=(T factor) -> Tensor &;
+        auto operator/=(T factor) -> Tensor &;
+
+        template<typename, std::size_t>
+        friend class Tensor;
+    private:
+        std::shared_ptr<std::valarray<T>> buffer;
+        std::array<std::size_t, N> dims{};
+        std::array<std::size_t, N> steps{};
+        std::size_t start = 0;
+
+        [[nodiscard]] auto storage() const -> std::valarray<T> &;
+        [[nodiscard]] auto offset(const std::array<std::size_t, N> &index) const -> std::size_t;
+        [[nodiscard]] auto elements() const -> std::gslice;
+        void check_shape(const Tensor &other) const;
+    };
+
+    template<typename T, std::size_t N>
+    auto operator+(const Tensor<T, N> &a, const Tensor<T, N> &b) -> Tensor<T, N>;
+
+    template<typename T, std::size_t N>
+    auto operator-(const Tensor<T, N> &a, const Tensor<T, N> &b) -> Tensor<T, N>;
+
+    template<typename T, std::size_t N>
+    auto operator*(const Tensor<T, N> &a, T factor) -> Tensor<T, N>;
+
+    template<typename T, std::size_t N>
+    auto operator*(T factor, const Tensor<T, N> &a) -> Tensor<T, N>;
+
+    template<typename T, std::size_t N>
+    auto operator/(const Tensor<T, N> &a, T factor) -> Tensor<T, N>;
+}
+
+#endif  // UTILS_TENSOR_H
@@ -0,0 +1,533 @@
+//
+// Created by Yihua Liu on 2026-10-18.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <valarray>
+#include <vector>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QTemporaryDir>
+#include "../../src/Profile.h"
+#include "../../src/material/DielectricModel.h"
+#include "../../src/material/FileIndex.h"
+#include "../../src/material/GridRegistry.h"
+#include "../../src/material/MaterialCache.h"
+#include "../../src/material/OpticMaterial.h"
+#include "../../src/material/ParameterSystem.h"
+#include "../../src/material/SpectralCache.h"
+#include "../../src/optics/TransferMatrix.h"
+#include "../../src/utils/NumericParser.h"
+
+/*
+ * Message of the std::runtime_error thrown by f, or an empty string.
+ */
+template<typename F>
+auto error_of(F &&f) -> std::string {
+    try {
+        f();
+    } catch (const std::runtime_error &e) {
+        return e.what();
+    }
+    return {};
+}
+
+/*
+ * The same complex refractive index at every wavelength. index can be changed behind the back of the materials using
+ * the model.
+ */
+class ConstantIndex : public DielectricModel<double> {
+public:
+    explicit ConstantIndex(const std::complex<double> index) : index(index) {}
+
+    auto epsilon(const std::valarray<double> &energy) const -> std::valarray<std::complex<double>> override {
+        return std::valarray<std::complex<double>>(index * index, energy.size());
+    }
+
+    std::complex<double> index;
+};
+
+void test_numeric_parser() {
+    // "\r\n" and "\n" line ends, a leading '+', blank lines and a header read as fields
+    Utils::NumericParser parser("POINTS*  3*\r\n1.5 +2 3\r\n\r\n  4e-1\t-5 6 \n7 8 +9e2", "nk.txt");
+    const std::vector<std::string_view> header = parser.read_fields('*');
+    assert(header.size() == 2 and header.at(0) == "POINTS" and header.at(1) == "3");
+    assert(parser.parse<std::size_t>(header.at(1)) == 3);
+    const std::vector<std::vector<double>> columns = parser.read_columns({2, 0}, 3);
+    assert((columns.at(0) == std::vector<double>{3, 6, 900}));
+    assert((columns.at(1) == std::vector<double>{1.5, 0.4, 7}));
+    assert(parser.at_end() and parser.line_number() == 5);
+    // Any other separator splits at that character and trims the fields.
+    Utils::NumericParser csv("1, 2 ,3\n4,5,6\n", "table.csv");
+    const std::vector<std::vector<double>> csv_columns = csv.read_columns({1}, 3, ',');
+    assert((csv_columns.at(0) == std::vector<double>{2, 5}));
+    // Errors carry source:line:column of the offending field, or of the end of a short line.
+    Utils::NumericParser invalid("1 2\n3 x4\n", "bad.txt");
+    assert(error_of([&invalid] { invalid.read_columns({0, 1}); }) == "bad.txt:2:3: invalid number 'x4'");
+    Utils::NumericParser too_many("1 2\n3 4 5\n", "many.txt");
+    assert(error_of([&too_many] { too_many.read_columns({0, 1}, 2); }) == "many.txt:2:5: expected 2 fields, found more");
+    Utils::NumericParser too_few("1 2\r\n3\r\n", "few.txt");
+    assert(error_of([&too_few] { too_few.read_columns({0, 1}); }) == "few.txt:2:2: expected 2 fields, found 1");
+    Utils::NumericParser too_short("1 2\n3 4\n", "short.txt");
+    assert(error_of([&too_short] { too_short.read_columns({0}, 2, ' ', 3); }) == "short.txt:2: expected 3 rows, found 2");
+    Utils::NumericParser empty("", "empty.txt");
+    assert(error_of([&empty] { empty.read_line(); }) == "empty.txt:0: unexpected end of file");
+    // Only a whole field is a number, and only one leading '+' is allowed.
+    Utils::NumericParser fields("x", "fields.txt");
+    fields.read_line();
+    assert(error_of([&fields] { fields.parse<double>("1.5e"); }).ends_with("invalid number '1.5e'"));
+    assert(error_of([&fields] { fields.parse<double>("++1"); }).ends_with("invalid number '++1'"));
+    assert(error_of([&fields] { fields.parse<float>("1e60"); }).ends_with("number out of range '1e60'"));
+}
+
+/*
+ * Creates an empty file, and its directory if needed.
+ */
+void touch(const QString &path) {
+    const bool made_dir = QDir().mkpath(QFileInfo(path).absolutePath());
+    assert(made_dir);
+    QFile file(path);
+    const bool opened = file.open(QIODevice::WriteOnly);
+    assert(opened);
+}
+
+/*
+ * Creates or overwrites a file with contents.
+ */
+void write(const QString &path, const QByteArray &contents) {
+    QFile file(path);
+    const bool opened = file.open(QIODevice::WriteOnly);
+    assert(opened);
+    file.write(contents);
+}
+
+void test_file_index() {
+    const QTemporaryDir tmp;
+    assert(tmp.isValid());
+    Profile::initInstance(tmp.filePath("profile").toStdString(), u"test");
+    const QDir db(tmp.filePath("db"));
+    // Duplicates resolve to the shortest path relative to the root, then to the lexicographically smallest one.
+    touch(db.filePath("deep/er/A.MAT"));
+    touch(db.filePath("A.MAT"));
+    touch(db.filePath("b/B.MAT"));
+    touch(db.filePath("a/B.MAT"));
+    touch(db.filePath("b/c/C.MAT"));
+    touch(db.filePath("ab/C.MAT"));
+    touch(db.filePath("a/notes.txt"));
+    const std::shared_ptr<const FileIndex> index = FileIndex::load(db.path(), {"*.MAT"});
+    assert(index->size() == 3);
+    assert(index->find("A.MAT") == db.absoluteFilePath("A.MAT"));
+    assert(index->find("B.MAT") == db.absoluteFilePath("a/B.MAT"));
+    assert(index->find("C.MAT") == db.absoluteFilePath("ab/C.MAT"));
+    assert(not index->find("notes.txt"));
+    // The index has been persisted in the profile cache, and reloading it gives the same result.
+    const QDir cache_dir(specialFolderLocation(SpecialFolder::Cache) / "file-index");
+    assert(cache_dir.entryList({"*.idx"}, QDir::Files).size() == 1);
+    const std::shared_ptr<const FileIndex> cached = FileIndex::load(db.path(), {"*.MAT"});
+    assert(cached->size() == 3);
+    assert(cached->find("B.MAT") == db.absoluteFilePath("a/B.MAT"));
+    // Adding or removing a file changes the modification time of its directory, so the persisted index is stale.
+    // Wait past the millisecond resolution of the stored times first.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    touch(db.filePath("b/c/D.MAT"));
+    const bool removed = QFile::remove(db.filePath("a/B.MAT"));
+    assert(removed);
+    const std::shared_ptr<const FileIndex> rebuilt = FileIndex::load(db.path(), {"*.MAT"});
+    assert(rebuilt->size() == 4);
+    assert(rebuilt->find("D.MAT") == db.absoluteFilePath("b/c/D.MAT"));
+    assert(rebuilt->find("B.MAT") == db.absoluteFilePath("b/B.MAT"));
+    Profile::freeInstance();
+}
+
+void test_grid_registry() {
+    GridRegistry<QList<double>> registry;
+    // Equal grids share one array.
+    QList<double> grid = registry.intern(QList<double>{400, 500, 600});
+    QList<double> same = registry.intern(QList<double>{400, 500, 600});
+    QList<double> other = registry.intern(QList<double>{400, 500});
+    assert(registry.size() == 2);
+    assert(grid.isSharedWith(same) and not grid.isSharedWith(other));
+    // A grid is unregistered once the last holder has released it; an equal but unshared list is only cleared.
+    QList<double> equal{400, 500, 600};
+    registry.release(equal);
+    assert(equal.isEmpty() and registry.size() == 2);
+    registry.release(grid);
+    assert(grid.isEmpty() and registry.size() == 2);
+    registry.release(same);
+    assert(registry.size() == 1);
+    QList<double> again = registry.intern(QList<double>{400, 500, 600});
+    assert(registry.size() == 2 and not again.isSharedWith(other));
+    registry.release(again);
+    registry.release(other);
+    assert(registry.size() == 0);
+    // With every grid in one bucket, grids are still told apart by value, and release() drops the right one.
+    GridRegistry<QList<double>> colliding([](const QList<double> &) -> std::size_t {
+        return 0;
+    });
+    QList<double> a = colliding.intern({1, 2, 3});
+    QList<double> b = colliding.intern({1, 2});
+    QList<double> c = colliding.intern({1, 2, 4});
+    const QList<double> a_again = colliding.intern({1, 2, 3});
+    assert(colliding.size() == 3);
+    assert(a.isSharedWith(a_again) and not a.isSharedWith(b) and not a.isSharedWith(c));
+    colliding.release(b);
+    assert(colliding.size() == 2);
+    const QList<double> c_again = colliding.intern({1, 2, 4});
+    assert(c.isSharedWith(c_again));
+    colliding.release(c);
+    assert(colliding.size() == 2);
+    colliding.release(a);
+    assert(colliding.size() == 2 and a_again.size() == 3);
+}
+
+void test_parameter_system() {
+    const QTemporaryDir tmp;
+    assert(tmp.isValid());
+    write(tmp.filePath("params.ini"), R"ini(
+[GaAs]
+Eg0_Gamma = 1.519 eV
+alpha_Gamma = 0.0005405 eV/K
+beta_Gamma = 204 K
+Eg0_X = 1.981 eV
+alpha_X = 0.00046 eV/K
+beta_X = 204 K
+
+[AlAs]
+Eg0_Gamma = 3.099 eV
+alpha_Gamma = 0.000885 eV/K
+beta_Gamma = 530 K
+Eg0_X = 2.24 eV
+alpha_X = 0.0007 eV/K
+beta_X = 530 K
+
+[AlGaAs]
+x = Al
+parent0 = GaAs
+parent1 = AlAs
+Eg0_X = 0.055 eV
+
+[Tabulated]
+precedence = 42
+)ini");
+    write(tmp.filePath("calculables.ini"), R"ini(
+[Calculables]
+precedence = 1 + 2 * 3 ^ 2
+parentheses = (1 + 2) * 3
+left_assoc = 8 / 4 / 2 - 1
+right_assoc = 2 ^ 3 ^ 2
+negate_power = -2 ^ 2
+power_negate = 2 ^ -1
+double_negate = 3 - -2
+functions = max(min(1, 5), sqrt(16)) + exp(0) + log(1)
+temperature = T / 100
+min_one = min(1)
+min_three = min(1, 2, 3)
+trailing = 1 +
+unbalanced = (1 + 2
+unopened = 1 + 2)
+juxtaposed = 2 3
+unknown = foo(1)
+symbol = 1 $ 2
+Eg_Gamma = Eg0_Gamma - alpha_Gamma * T ^ 2 / (T + beta_Gamma)
+Eg_X = Eg0_X - alpha_X * T ^ 2 / (T + beta_X)
+band_gap = min(Eg_Gamma, Eg_X)
+)ini");
+    const ParameterSystem parameters({{"Materials", "SOLCORE_ROOT/params.ini"},
+                                      {"calculables", "SOLCORE_ROOT/calculables.ini"}}, tmp.path());
+    const auto value = [&parameters](const QString &material, const QString &key, const double T = 300) -> double {
+        return parameters.evaluate(*parameters.materialIndex(material), *parameters.keyIndex(key), {}, T)[0];
+    };
+    // Precedence and associativity: ^ binds tighter than a leading -, and is right-associative.
+    assert(value("GaAs", "precedence") == 19);
+    assert(value("Tabulated", "precedence") == 42);
+    assert(value("GaAs", "parentheses") == 9);
+    assert(value("GaAs", "left_assoc") == 0);
+    assert(value("GaAs", "right_assoc") == 512);
+    assert(value("GaAs", "negate_power") == -4);
+    assert(value("GaAs", "power_negate") == 0.5);
+    assert(value("GaAs", "double_negate") == 5);
+    assert(value("GaAs", "functions") == 5);
+    assert(value("GaAs", "temperature", 250) == 2.5);
+    // Formulas that do not compile are ignored, so their keys are undefined (the key may not even be interned).
+    for (const QString key : {"min_one", "min_three", "trailing", "unbalanced", "unopened", "juxtaposed", "unknown",
+                              "symbol"}) {
+        const std::optional<qsizetype> index = parameters.keyIndex(key);
+        assert(not index or std::isnan(parameters.evaluate(*parameters.materialIndex("GaAs"), *index, {})[0]));
+    }
+    // An alloy evaluates band_gap from its own, interpolated, inputs; across the crossover from the direct (Gamma)
+    // to the indirect (X) gap, min() of the interpolated gaps is well above the interpolated min() of the parents.
+    const double T = 300;
+    const std::valarray<double> x = {0, 0.2, 0.4, 0.5, 0.8, 1};
+    const auto lerp = [&x](const double a, const double b, const double bowing = 0) -> std::valarray<double> {
+        return (1. - x) * a + x * b - x * (1. - x) * bowing;
+    };
+    const std::valarray<double> gamma = lerp(1.519, 3.099) - lerp(0.0005405, 0.000885) * (T * T) / (T + lerp(204, 530));
+    const std::valarray<double> indirect = lerp(1.981, 2.24, 0.055) - lerp(0.00046, 0.0007) * (T * T) /
+                                           (T + lerp(204, 530));
+    const std::valarray<double> band_gap = parameters.evaluate(*parameters.materialIndex("AlGaAs"),
+                                                               *parameters.keyIndex("band_gap"), {{"Al", x}}, T);
+    assert(band_gap.size() == x.size());
+    for (std::size_t i = 0; i < x.size(); i++) {
+        assert(std::abs(band_gap[i] - std::fmin(gamma[i], indirect[i])) < 1e-12);
+    }
+    assert(gamma[1] < indirect[1] and indirect[3] < gamma[3]);
+    assert(std::abs(band_gap[0] - value("GaAs", "band_gap")) < 1e-12);
+    assert(std::abs(band_gap[5] - value("AlAs", "band_gap")) < 1e-12);
+    assert(band_gap[3] - (band_gap[0] + band_gap[5]) / 2 > 0.1);
+    // Tabulated alloy numbers are bowing parameters of the parents' values.
+    const std::valarray<double> Eg0_X = parameters.evaluate(*parameters.materialIndex("AlGaAs"),
+                                                            *parameters.keyIndex("Eg0_X"), {{"Al", x}}, T);
+    assert(std::abs(Eg0_X[3] - (1.981 + 2.24) / 2 + 0.055 / 4) < 1e-12);
+}
+
+void test_nk_composition() {
+    // Bilinear functions of composition and wavelength are reproduced exactly by bilinear interpolation. The fractions
+    // are given out of order, and fraction 1 has a coarser grid than the others.
+    const auto n_exact = [](const double fraction, const double wavelength) -> double {
+        return 2 + fraction * wavelength / 1000;
+    };
+    const auto k_exact = [](const double fraction, const double wavelength) -> double {
+        return fraction / 10 + wavelength / 10000;
+    };
+    QList<std::pair<double, QList<double>>> grids;
+    QList<std::pair<double, QList<double>>> n_data;
+    QList<std::pair<double, QList<double>>> k_data;
+    for (const double fraction : {1., 0., 0.5}) {
+        const QList<double> grid = fraction == 1 ? QList<double>{400, 600} : QList<double>{400, 500, 600};
+        QList<double> n;
+        QList<double> k;
+        for (const double wavelength : grid) {
+            n.append(n_exact(fraction, wavelength));
+            k.append(k_exact(fraction, wavelength));
+        }
+        grids.emplace_back(fraction, grid);
+        n_data.emplace_back(fraction, n);
+        k_data.emplace_back(fraction, k);
+    }
+    OpticMaterial<QList<double>> alloy("AlGaAs", grids, n_data, grids, k_data);
+    // At and between the tabulated fractions and wavelengths, and clamped outside both ranges
+    const std::valarray<double> fractions = {-0.2, 0, 0.25, 0.5, 0.8, 1, 1.3};
+    const QList<double> wavelengths{350, 400, 450, 525, 600, 650};
+    const auto [n, k] = alloy.nk_composition(fractions, wavelengths);
+    assert(n.size() == fractions.size() and k.size() == fractions.size());
+    for (std::size_t s = 0; s < fractions.size(); s++) {
+        const double fraction = std::clamp(fractions[s], 0., 1.);
+        assert(n.at(s).size() == wavelengths.size());
+        for (qsizetype j = 0; j < wavelengths.size(); j++) {
+            const double wavelength = std::clamp(wavelengths.at(j), 400., 600.);
+            assert(std::abs(n.at(s).at(j) - n_exact(fraction, wavelength)) < 1e-12);
+            assert(std::abs(k.at(s).at(j) - k_exact(fraction, wavelength)) < 1e-12);
+        }
+    }
+    const auto [n_single, k_single] = alloy.nk_composition(0.25, wavelengths);
+    assert(n_single == n.at(2) and k_single == k.at(2));
+    const std::vector<std::valarray<std::complex<double>>> nk = alloy.nk_graded(fractions, wavelengths);
+    assert(nk.size() == fractions.size());
+    assert(nk.at(4)[3] == std::complex<double>(n.at(4).at(3), k.at(4).at(3)));
+}
+
+void test_replace() {
+    // A re-import updates the listed material in place, so pointers held e.g. by devices see the new data.
+    const QList<std::pair<double, QList<double>>> grid{{1, {400, 600}}};
+    OpticMaterial<QList<double>> listed("GaAs", grid, {{1, {3.5, 3.7}}}, grid, {{1, {0.1, 0}}});
+    OpticMaterial<QList<double>> imported("GaAs", grid, {{1, {3.6, 3.8}}}, grid, {{1, {0.2, 0}}});
+    const QList<double> wavelengths{500};
+    const QList<double> n_before = listed.n_interpolated(wavelengths);
+    assert(std::abs(n_before.front() - 3.6) < 1e-12);
+    listed.replace(std::move(imported));
+    const QList<double> n_after = listed.n_interpolated(wavelengths);
+    const QList<double> k_after = listed.k_interpolated(wavelengths);
+    assert(std::abs(n_after.front() - 3.7) < 1e-12 and std::abs(k_after.front() - 0.1) < 1e-12);
+    assert(imported.memory_usage() == 0);
+}
+
+void test_spectral_cache() {
+    SpectralCache<QList<double>> &cache = SpectralCache<QList<double>>::instance();
+    const QList<std::pair<double, QList<double>>> grid{{1, {400e-9, 600e-9}}};
+    OpticMaterial<QList<double>> tabulated("GaAs", grid, {{1, {3.5, 3.7}}}, grid, {{1, {0.2, 0}}});
+    const std::valarray<double> wavelength = {400e-9, 500e-9};
+    const SpectralData<double> data = cache.query({&tabulated, nullptr}, wavelength);
+    assert(std::abs(data.n(0, 1) - 3.6) < 1e-12 and std::abs(data.k(0, 1) - 0.1) < 1e-12);
+    const double alpha = 4 * std::numbers::pi * 0.2 / 400e-9;
+    assert(std::abs(data.alpha(0, 0) - alpha) < 1e-6 * alpha);
+    // Rows of null materials are those of vacuum.
+    for (std::size_t j = 0; j < wavelength.size(); j++) {
+        assert(data.n(1, j) == 1 and data.k(1, j) == 0 and data.alpha(1, j) == 0);
+    }
+
+    // A changed model is only seen once the material drops its rows: a hit returns the old rows.
+    const auto model = std::make_shared<ConstantIndex>(2);
+    OpticMaterial<QList<double>> modelled("Glass", model);
+    const auto n_of = [&cache, &modelled, &wavelength]() -> double {
+        return cache.query({&modelled}, wavelength).n(0, 0);
+    };
+    assert(std::abs(n_of() - 2) < 1e-12);
+    model->index = 3;
+    assert(std::abs(n_of() - 2) < 1e-12);
+    modelled.set_model(model, Mixing<double>{500e-9, 10e-9});
+    assert(std::abs(n_of() - 3) < 1e-12);
+    model->index = 4;
+    modelled.set_single_precision(true);
+    assert(std::abs(n_of() - 4) < 1e-12);
+    model->index = 5;
+    assert(std::abs(n_of() - 4) < 1e-12);
+    cache.remove(&modelled);
+    assert(std::abs(n_of() - 5) < 1e-12);
+}
+
+void test_nk_invalidation() {
+    // New n, k data replace everything interpolated from the old ones: the PCHIP coefficients and the cached spectra.
+    // n + 1 and 2 k have the PCHIP interpolants n + 1 and 2 k, so stale coefficients or spectra would show.
+    SpectralCache<QList<double>> &cache = SpectralCache<QList<double>>::instance();
+    const std::valarray<double> wavelength = {450, 550, 650};
+    const QList<std::pair<double, QList<double>>> grid{{1, {400, 500, 600, 700}}};
+    OpticMaterial<QList<double>> solcore("GaAs", grid, {{1, {3, 3.2, 3.6, 3.7}}}, grid, {{1, {0.3, 0.2, 0.1, 0}}});
+    solcore.set_interpolation(Interpolation::PCHIP);
+    const SpectralData<double> old_data = cache.query({&solcore}, wavelength);
+    constexpr std::size_t data_bytes = 8 * sizeof(double);
+    assert(solcore.memory_usage() > data_bytes);
+    solcore.set_nk(grid, {{1, {4, 4.2, 4.6, 4.7}}}, grid, {{1, {0.6, 0.4, 0.2, 0}}});
+    assert(solcore.memory_usage() == data_bytes);
+    const SpectralData<double> new_data = cache.query({&solcore}, wavelength);
+    for (std::size_t j = 0; j < wavelength.size(); j++) {
+        assert(std::abs(new_data.n(0, j) - old_data.n(0, j) - 1) < 1e-12);
+        assert(std::abs(new_data.k(0, j) - 2 * old_data.k(0, j)) < 1e-12);
+    }
+
+    // A database file changed on disk is read again.
+    const QTemporaryDir tmp;
+    assert(tmp.isValid());
+    const QString path = tmp.filePath("GAAS.MAT");
+    const auto write_sopra = [&path](const double n_offset, const double k_scale) -> void {
+        QByteArray contents = "VERSION*1\nFORMAT*1\nPOINTS*4*\n";
+        const QList<double> n{3, 3.2, 3.6, 3.7};
+        const QList<double> k{0.3, 0.2, 0.1, 0};
+        for (qsizetype i = 0; i < n.size(); i++) {
+            contents += "DATA1*NM*" + QByteArray::number(400 + 100 * i) + "*" + QByteArray::number(n.at(i) + n_offset) +
+                        "*" + QByteArray::number(k.at(i) * k_scale) + "*\n";
+        }
+        write(path, contents);
+    };
+    write_sopra(0, 1);
+    OpticMaterial<QList<double>> sopra("GAAS", DbType::SOPRA, path);
+    sopra.set_interpolation(Interpolation::PCHIP);
+    const SpectralData<double> loaded = cache.query({&sopra}, wavelength);
+    assert(sopra.memory_usage() > data_bytes);
+    write_sopra(1, 2);
+    sopra.reload_nk();
+    assert(sopra.memory_usage() == 0);
+    const SpectralData<double> reloaded = cache.query({&sopra}, wavelength);
+    for (std::size_t j = 0; j < wavelength.size(); j++) {
+        assert(std::abs(reloaded.n(0, j) - loaded.n(0, j) - 1) < 1e-12);
+        assert(std::abs(reloaded.k(0, j) - 2 * loaded.k(0, j)) < 1e-12);
+    }
+}
+
+void test_data_access() {
+    // nData(), kData() and wl(), which the material list shows, load an unloaded material and report the access to
+    // MaterialCache as n_interpolated() does, so that its data count against the budget.
+    MaterialCache<QList<double>> &cache = MaterialCache<QList<double>>::instance();
+    const QTemporaryDir tmp;
+    assert(tmp.isValid());
+    const QString path = tmp.filePath("GAAS.MAT");
+    write(path, "VERSION*1\nFORMAT*1\nPOINTS*2*\nDATA1*NM*400*3.5*0.3*\nDATA1*NM*600*3.7*0.1*\n");
+    OpticMaterial<QList<double>> first("GAAS", DbType::SOPRA, path);
+    OpticMaterial<QList<double>> second("GAAS", DbType::SOPRA, path);
+    assert(first.memory_usage() == 0);
+    const std::size_t usage = cache.usage();
+    assert((first.nData() == QList<double>{3.5, 3.7}));
+    assert((first.wl() == QList<double>{400, 600}));
+    assert(first.memory_usage() > 0 and cache.usage() == usage + first.memory_usage());
+    // With room for one material, reading the data of the second evicts the first.
+    const std::size_t budget = cache.budget();
+    cache.setBudget(first.memory_usage());
+    assert((second.kData() == QList<double>{0.3, 0.1}));
+    assert(first.memory_usage() == 0 and second.memory_usage() > 0);
+    cache.setBudget(budget);
+}
+
+void test_absorption_profile() {
+    // A film on its own, e.g. a thick wafer, absorbs as exp(-alpha * z) in the incoherent approximation, and the
+    // profile integrates to its absorption.
+    OpticMaterial<QList<double>> film("Film", std::make_shared<const ConstantIndex>(std::complex<double>(2, 0.01)));
+    constexpr double width = 1e-6;
+    QList<double> wavelength{500e-9, 800e-9};
+    const std::valarray<double> dist = Utils::Math::linspace_va(0.0, width * 0.999, 1000);
+    const Utils::Tensor<double, 2> profile = calculate_absorption_profile(
+            std::make_unique<OpticStack<QList<double>>>(std::vector<std::pair<OpticMaterial<QList<double>> *, double>>{{&film, width}}),
+            wavelength, dist, 0, 'u', {'i'});
+    const rat_dict<double> rat = calculate_rat(
+            std::make_unique<OpticStack<QList<double>>>(std::vector<std::pair<OpticMaterial<QList<double>> *, double>>{{&film, width}}),
+            wavelength, 0, 'u', false, {'i'});
+    const Utils::Tensor<double, 2> &A_per_layer = std::get<Utils::Tensor<double, 2>>(rat.at("A_per_layer"));
+    const double step = dist[1] - dist[0];
+    for (qsizetype j = 0; j < wavelength.size(); j++) {
+        const double alpha = 4 * std::numbers::pi * 0.01 / wavelength.at(j);
+        const double decay = profile(dist.size() - 1, j) / profile(0, j);
+        assert(std::abs(decay - std::exp(-alpha * dist[dist.size() - 1])) < 1e-9);
+        double absorbed = 0;
+        for (std::size_t k = 1; k < dist.size(); k++) {
+            absorbed += (profile(k - 1, j) + profile(k, j)) / 2 * step;
+        }
+        assert(std::abs(absorbed - A_per_layer(1, j)) < 1e-6);
+    }
+}
+
+void test_no_back_reflection() {
+    // The back absorbing layer and the medium behind it are incoherent, and so is the film if the coherency list says
+    // so: the result is that of inc_tmm() with every row of the stack incoherent.
+    OpticMaterial<QList<double>> film("Film", std::make_shared<const ConstantIndex>(std::complex<double>(2, 0.01)));
+    QList<double> wavelength{500e-9, 800e-9};
+    const auto make_stack = [&film]() -> std::unique_ptr<OpticStack<QList<double>>> {
+        return std::make_unique<OpticStack<QList<double>>>(std::vector<std::pair<OpticMaterial<QList<double>> *, double>>{{&film, 1e-6}}, true);
+    };
+    const std::vector<std::valarray<std::complex<double>>> n_list = make_stack()->get_indices<std::vector<std::valarray<std::complex<double>>>>(wavelength);
+    const std::valarray<double> d_list = make_stack()->get_widths<std::valarray<double>>();
+    assert(n_list.size() == 4 and d_list.size() == 4);
+    const std::valarray<double> lam_vac = {500e-9, 800e-9};
+    const std::valarray<double> R_expected = std::get<std::valarray<double>>(inc_tmm('s', n_list, d_list, std::valarray<LayerType>(LayerType::Incoherent, 4), std::complex<double>(0), lam_vac).at("R"));
+    const rat_dict<double> rat = calculate_rat(make_stack(), wavelength, 0, 's', false, {'i'});
+    const std::valarray<double> &R = std::get<std::valarray<double>>(rat.at("R"));
+    const Utils::Tensor<double, 2> &A_per_layer = std::get<Utils::Tensor<double, 2>>(rat.at("A_per_layer"));
+    // The absorbing layer is index-matched to the film, so only the front surface reflects, and the film absorbs
+    // what enters it in a single pass.
+    const std::complex<double> n_film(2, 0.01);
+    const double R_front = std::norm((n_film - 1.) / (n_film + 1.));
+    for (std::size_t j = 0; j < lam_vac.size(); j++) {
+        assert(std::abs(R[j] - R_expected[j]) < 1e-12);
+        assert(std::abs(R[j] - R_front) < 1e-12);
+        const double single_pass = 1 - std::exp(-4 * std::numbers::pi * 0.01 * 1e-6 / lam_vac[j]);
+        assert(std::abs(A_per_layer(1, j) - (1 - R_front) * single_pass) < 1e-9);
+    }
+}
+
+void runall() {
+    test_numeric_parser();
+    test_file_index();
+    test_grid_registry();
+    test_parameter_system();
+    test_nk_composition();
+    test_replace();
+    test_spectral_cache();
+    test_nk_invalidation();
+    test_data_access();
+    test_absorption_profile();
+    test_no_back_reflection();
+}
+
+auto main() -> int {
+    runall();
+}
@@ -7,6 +7,14 @@
 #include <cassert>
 #include <numbers>
 #include <functional>
+#include "../../src/material/DielectricModel.h"
+#include "../../src/optics/AdaptiveGrid.h"
+#include "../../src/optics/DetailedBalance.h"
+#include "../../src/optics/EllipsFit.h"
+#include "../../src/optics/GuidedModes.h"
+#include "../../src/optics/Spectrum.h"
+#include "../../src/optics/TexturedStack.h"
+#include "../../src/optics/ThicknessOptimizer.h"
 #include "../../src/optics/tmm.h"
 #include "../../src/utils/Approx.h"
 #include "../../src/utils/Math.h"
@@ -404,6 +412,385 @@ void test_ellips_Delta() {
     assert(Delta_result.at("psi") == Delta_approx);
 }
 
+void test_ellips_angles() {
+    const std::vector<std::valarray<std::complex<double>>> n_list = {{1.5, 1.3}, {1.0 + 0.4i, 1.2 + 0.2i},
+                                                                     {2.0 + 3i, 1.5 + 0.3i}, {5, 4}, {4.0 + 1i, 3.0 + 0.1i}};
+    const std::vector<double> d_list = {INFINITY, 200, 187.3, 1973.5, INFINITY};
+    const std::valarray<double> th_0 = {0.3, 0.9, 1.2};
+    const std::valarray<double> lam_vac = {400, 1770};
+    const std::unordered_map<std::string, std::vector<std::valarray<double>>> ellips_result = ellips(n_list, d_list, th_0, lam_vac);
+    const ApproxNestedRange<std::vector<std::valarray<double>>, double> psi_approx = approx<std::vector<std::valarray<double>>, double>(std::vector<std::valarray<double>>{{0.64939282, 0.73516374},
+                                                                                                                                                                           {0.56505696, 0.44198973},
+                                                                                                                                                                           {0.69469201, 0.46542739}});
+    const ApproxNestedRange<std::vector<std::valarray<double>>, double> Delta_approx = approx<std::vector<std::valarray<double>>, double>(std::vector<std::valarray<double>>{{0.09560384, 0.10886363},
+                                                                                                                                                                             {2.00975214, 1.15427632},
+                                                                                                                                                                             {2.53392836, 2.32667294}});
+    assert(ellips_result.at("psi") == psi_approx);
+    assert(ellips_result.at("Delta") == Delta_approx);
+}
+
+// Kramers-Kronig transform of eps2 at an energy E below the absorption edge Eg, where the integrand is regular
+template<typename F>
+double kramers_kronig_below_edge(const F &eps2, const double E, const double Eg) {
+    // Geometric grid in xi - Eg from 1e-6 to 1e4 eV, integrated by the midpoint rule
+    constexpr std::size_t num_nodes = 400000;
+    const double ratio = std::pow(1e10, 1.0 / num_nodes);
+    std::valarray<double> xi(num_nodes);
+    std::valarray<double> width(num_nodes);
+    double left = 1e-6;
+    for (std::size_t k = 0; k < num_nodes; k++) {
+        xi[k] = Eg + left * std::sqrt(ratio);
+        width[k] = left * (ratio - 1);
+        left *= ratio;
+    }
+    return 2 / std::numbers::pi * (width * xi * eps2(xi) / (xi * xi - E * E)).sum();
+}
+
+void test_dielectric_models() {
+    const std::valarray<double> wl = {500e-9};
+    // n = 1.5 + 0.004 / 0.25 + 1e-4 / 0.0625 at 0.5 um
+    const Cauchy<double> cauchy(1.5, 0.004, 1e-4);
+    const ApproxScalar<std::complex<double>, double> cauchy_approx = approx<std::complex<double>, double>(1.5176);
+    assert(cauchy.nk(wl)[0] == cauchy_approx);
+    // Fused silica (Malitson 1965): n_d = 1.4585 at 587.6 nm
+    const Sellmeier<double> silica(1, {0.6961663, 0.4079426, 0.8974794},
+                                   {0.0684043 * 0.0684043, 0.1162414 * 0.1162414, 9.896161 * 9.896161});
+    const ApproxScalar<std::complex<double>, double> silica_approx = approx<std::complex<double>, double>(1.45846, 1e-5);
+    assert(silica.nk({587.56e-9})[0] == silica_approx);
+    // Tauc-Lorentz a-Si (Jellison and Modine 1996): the closed-form eps1 matches the transform of eps2.
+    const TaucLorentz<double> tauc_lorentz(122, 3.45, 2.54, 1.2, 1.15);
+    const std::valarray<double> E_below = {0.5, 1.0};
+    const std::valarray<std::complex<double>> tl_eps = tauc_lorentz.epsilon(E_below);
+    for (std::size_t j = 0; j < E_below.size(); j++) {
+        const double kk = 1.15 + kramers_kronig_below_edge([&tauc_lorentz](const std::valarray<double> &E) {
+            const std::valarray<std::complex<double>> eps = tauc_lorentz.epsilon(E);
+            std::valarray<double> eps2(E.size());
+            std::ranges::transform(eps, std::begin(eps2), [](const std::complex<double> e) { return e.imag(); });
+            return eps2;
+        }, E_below[j], 1.2);
+        const ApproxScalar<double, double> kk_approx = approx<double, double>(kk, 1e-5);
+        assert(tl_eps[j].real() == kk_approx);
+        assert(tl_eps[j].imag() == 0);
+    }
+    // eps1 is continuous down to E = 0, where the 1 / E term takes its limit.
+    const std::valarray<std::complex<double>> tl_eps_0 = tauc_lorentz.epsilon({0, 1e-4});
+    const ApproxScalar<double, double> tl_eps_0_approx = approx<double, double>(tl_eps_0[1].real(), 1e-7);
+    assert(tl_eps_0[0].real() == tl_eps_0_approx);
+    // n + ik is the principal square root of eps.
+    const std::valarray<std::complex<double>> tl_nk = tauc_lorentz.nk({400e-9});
+    const std::complex<double> tl_eps_400 = tauc_lorentz.epsilon(DielectricModel<double>::energy_from_wl({400e-9}))[0];
+    assert(tl_nk[0].imag() > 0);
+    const ApproxScalar<std::complex<double>, double> tl_eps_approx = approx<std::complex<double>, double>(tl_eps_400);
+    assert(tl_nk[0] * tl_nk[0] == tl_eps_approx);
+    // Cody-Lorentz: eps2 is continuous at Et, and without the Urbach tail (Et = Eg) the numerical eps1 matches the
+    // transform of eps2 below the edge.
+    const CodyLorentz<double> cody_lorentz(100, 3.6, 2.4, 1.6, 1.2, 1.8, 0.05, 1.1);
+    const std::valarray<double> eps2_at_Et = cody_lorentz.epsilon2({1.8 * (1 - 1e-9), 1.8 * (1 + 1e-9)});
+    const ApproxScalar<double, double> eps2_Et_approx = approx<double, double>(eps2_at_Et[1], 1e-7);
+    assert(eps2_at_Et[0] == eps2_Et_approx);
+    assert(cody_lorentz.epsilon2({1.0})[0] > 0);
+    const CodyLorentz<double> cody_no_tail(100, 3.6, 2.4, 1.6, 1.2, 1.6, 0.05, 1.1);
+    const std::valarray<std::complex<double>> cl_eps = cody_no_tail.epsilon(E_below);
+    for (std::size_t j = 0; j < E_below.size(); j++) {
+        const double kk = 1.1 + kramers_kronig_below_edge([&cody_no_tail](const std::valarray<double> &E) {
+            return cody_no_tail.epsilon2(E);
+        }, E_below[j], 1.6);
+        const ApproxScalar<double, double> kk_approx = approx<double, double>(kk, 1e-3);
+        assert(cl_eps[j].real() == kk_approx);
+    }
+    // The model weight is 1 / 2 at the mixing point and the decreasing weight complements the increasing one.
+    const Mixing<double> increasing{600e-9, 20e-9};
+    const Mixing<double> decreasing{600e-9, 20e-9, true};
+    const std::valarray<double> mix_wl = {500e-9, 600e-9, 700e-9};
+    const std::valarray<double> w_inc = increasing.weight(mix_wl);
+    const ApproxScalar<double, double> half_approx = approx<double, double>(0.5);
+    assert(w_inc[1] == half_approx);
+    assert(w_inc[0] < 0.01 and w_inc[2] > 0.99);
+    const ApproxSequenceLike<std::valarray<double>, double> w_dec_approx = approx<std::valarray<double>, double>(1.0 - w_inc);
+    assert(decreasing.weight(mix_wl) == w_dec_approx);
+}
+
+void test_ellips_fit() {
+    // Air | film | substrate; the film thickness and (real) index are fitted.
+    const std::valarray<double> th_0 = {1.1, 1.2, 1.3};
+    const std::valarray<double> lam_vac = {400, 450, 500, 550, 600, 650, 700, 750, 800};
+    const EllipsFit<double>::StackModel model = [&lam_vac](const std::valarray<double> &params) {
+        const std::size_t num_wl = lam_vac.size();
+        const std::vector<std::valarray<std::complex<double>>> n_list = {std::valarray<std::complex<double>>(1, num_wl),
+                                                                         std::valarray<std::complex<double>>(params[1], num_wl),
+                                                                         std::valarray<std::complex<double>>(3.9 + 0.02i, num_wl)};
+        return std::make_pair(n_list, std::vector<double>{INFINITY, params[0], INFINITY});
+    };
+    const std::valarray<double> truth = {120, 1.8};
+    const auto [n_list, d_list] = model(truth);
+    const std::unordered_map<std::string, std::vector<std::valarray<double>>> measured = ellips(n_list, d_list, th_0, lam_vac);
+    const EllipsFit<double> fitter(model, th_0, lam_vac, measured.at("psi"), measured.at("Delta"));
+    const ApproxSequenceLike<std::valarray<double>, double> truth_approx = approx<std::valarray<double>, double>(truth, 1e-6);
+    const ellips_fit_dict<double> result = fitter.fit({100, 1.6}, {50, 1.3}, {200, 2.5});
+    assert(std::get<std::valarray<double>>(result.at("params")) == truth_approx);
+    assert(std::get<double>(result.at("chi2")) < 1e-16);
+    // Starting on the upper bound of n, which the true index sits on, needs a backward difference.
+    const ellips_fit_dict<double> bound_result = fitter.fit({100, 1.8}, {50, 1.3}, {200, 1.8});
+    assert(std::get<std::valarray<double>>(bound_result.at("params")) == truth_approx);
+    // A fixed parameter (lower == upper) stays where it is.
+    const ellips_fit_dict<double> fixed_result = fitter.fit({100, 1.8}, {50, 1.8}, {200, 1.8});
+    assert(std::get<std::valarray<double>>(fixed_result.at("params")) == truth_approx);
+}
+
+void test_textured_stack() {
+    // Bare wafer, n = 3.5, strongly absorbing at 1000 nm and weakly absorbing at 1100 nm
+    const std::valarray<double> lam_vac = {1000, 1100};
+    const std::vector<std::valarray<std::complex<double>>> front_n = {{1, 1}, {3.5 + 0.01i, 3.5 + 1e-5i}};
+    const std::vector<std::valarray<std::complex<double>>> rear_n = {{3.5 + 0.01i, 3.5 + 1e-5i}, {1, 1}};
+    const std::vector<double> d_list = {INFINITY, INFINITY};
+    // The interface table reproduces Fresnel at normal incidence, interpolates linearly and ends with R = 1 at grazing
+    // incidence.
+    const InterfaceTable<double> table(front_n, d_list, lam_vac, 90);
+    constexpr double fresnel = 2.5 * 2.5 / (4.5 * 4.5);
+    const ApproxScalar<double, double> fresnel_approx = approx<double, double>(fresnel, 1e-4);
+    assert(table.at(0).first[0] == fresnel_approx);
+    const double step = std::numbers::pi / 180;
+    const ApproxScalar<double, double> mid_approx = approx<double, double>((table.at(10 * step).first[0] + table.at(11 * step).first[0]) / 2);
+    assert(table.at(10.5 * step).first[0] == mid_approx);
+    const ApproxScalar<double, double> grazing_R_approx = approx<double, double>(1);
+    const ApproxScalar<double, double> grazing_T_approx = approx<double, double>(0);
+    assert(table.at(std::numbers::pi / 2).first[0] == grazing_R_approx);
+    assert(table.at(std::numbers::pi / 2).second[0] == grazing_T_approx);
+    const TexturedStack<double> stack(front_n, d_list, lam_vac);
+    const std::unordered_map<std::string, std::valarray<double>> rat = stack.calculate_rat(2e5, 0, rear_n, d_list);
+    // Energy is conserved.
+    const ApproxSequenceLike<std::valarray<double>, double> one_approx = approx<std::valarray<double>, double>({1, 1});
+    assert(std::valarray<double>(rat.at("R") + rat.at("T") + rat.at("A_front") + rat.at("A_bulk") + rat.at("A_rear")) == one_approx);
+    // Nothing comes back from a thick absorbing wafer, so R is that of the front texture, where most rays hit two facets.
+    assert(rat.at("R")[0] < 0.5 * fresnel);
+    // Light trapping: the weakly absorbing wafer absorbs far more than in a planar double pass.
+    const double alpha = 4 * std::numbers::pi * 1e-5 / lam_vac[1];
+    assert(rat.at("A_bulk")[1] > 4 * (1 - std::exp(-2 * alpha * 2e5)));
+}
+
+void test_thickness_optimizer() {
+    // Glass | ARC | transport layer | absorber | back contact | metal
+    const std::valarray<double> lam_vac = {400, 500, 600, 700, 800};
+    const std::vector<std::valarray<std::complex<double>>> n_list = {{1.5, 1.5, 1.5, 1.5, 1.5},
+                                                                     {2.0 + 0.01i, 1.95, 1.9, 1.9, 1.9},
+                                                                     {2.4 + 0.05i, 2.3 + 0.01i, 2.2, 2.2, 2.2},
+                                                                     {2.6 + 1.2i, 2.7 + 0.8i, 2.6 + 0.4i, 2.5 + 0.1i, 2.5 + 0.01i},
+                                                                     {1.8, 1.8, 1.8, 1.8, 1.8},
+                                                                     {0.2 + 2.0i, 0.15 + 3.0i, 0.15 + 3.8i, 0.2 + 4.5i, 0.25 + 5.2i}};
+    const std::vector<double> d_list = {INFINITY, 90, 40, 300, 60, INFINITY};
+    const std::valarray<double> weight = {0.5, 1.0, 1.2, 1.1, 0.8};
+    const std::vector<std::size_t> variable_layers = {1, 2, 4};
+    const ThicknessOptimizer<double> optimizer(n_list, d_list, variable_layers, 3, lam_vac, weight);
+    const auto absorbed = [&](const std::valarray<double> &thickness) -> double {
+        std::vector<double> d = d_list;
+        for (std::size_t v = 0; v < variable_layers.size(); v++) {
+            d.at(variable_layers.at(v)) = thickness[v];
+        }
+        double sum = 0;
+        for (const char pol : {'s', 'p'}) {
+            const Utils::Tensor<double, 2> A = absorp_in_each_layer(coh_tmm(pol, n_list, d, std::complex<double>(0), lam_vac));
+            sum += (weight * A[3].flat()).sum() / 2;
+        }
+        return sum;
+    };
+    const std::valarray<double> thickness = {90, 40, 60};
+    const auto [J, grad] = optimizer.objective(thickness);
+    // The objective matches absorp_in_each_layer(), and the analytic gradient central differences.
+    const ApproxScalar<double, double> J_approx = approx<double, double>(absorbed(thickness), 1e-9);
+    assert(J == J_approx);
+    std::valarray<double> fd_grad(thickness.size());
+    for (std::size_t v = 0; v < thickness.size(); v++) {
+        std::valarray<double> plus = thickness;
+        std::valarray<double> minus = thickness;
+        plus[v] += 1e-3;
+        minus[v] -= 1e-3;
+        fd_grad[v] = (absorbed(plus) - absorbed(minus)) / 2e-3;
+    }
+    const ApproxSequenceLike<std::valarray<double>, double> grad_approx = approx<std::valarray<double>, double>(fd_grad, 1e-6, 1e-10);
+    assert(grad == grad_approx);
+    // The optimum beats the starting point and stays within the bounds, where the gradient vanishes in the interior.
+    const std::valarray<double> lower = {0, 0, 0};
+    const std::valarray<double> upper = {200, 100, 150};
+    const thickness_opt_dict<double> result = optimizer.optimize(lower, upper);
+    const std::valarray<double> best = std::get<std::valarray<double>>(result.at("thickness"));
+    const ApproxScalar<double, double> best_approx = approx<double, double>(absorbed(best), 1e-9);
+    assert(std::get<double>(result.at("objective")) == best_approx);
+    assert(std::get<double>(result.at("objective")) >= J);
+    const std::valarray<double> best_grad = optimizer.objective(best).second;
+    for (std::size_t v = 0; v < best.size(); v++) {
+        assert(best[v] >= lower[v] and best[v] <= upper[v]);
+        if (best[v] > lower[v] and best[v] < upper[v]) {
+            assert(std::abs(best_grad[v]) < 1e-6);
+        }
+    }
+}
+
+void test_guided_modes() {
+    // Symmetric slab: the fundamental TE and TM modes solve tan(k0 * d * kappa / 2) = c * gamma / kappa with
+    // kappa = sqrt(n_1^2 - n_eff^2), gamma = sqrt(n_eff^2 - n_2^2), and c = 1 (TE) or n_1^2 / n_2^2 (TM).
+    const double n_1 = 3.5;
+    const double n_2 = 1.45;
+    const double d = 220;
+    const double k0 = 2 * std::numbers::pi / 1550;
+    const auto slab_mode = [&](const double c) -> double {
+        // The left side minus the right side increases from the cladding to the core index on the first branch.
+        const auto g = [&](const double n_eff) -> double {
+            const double kappa = std::sqrt(n_1 * n_1 - n_eff * n_eff);
+            const double gamma = std::sqrt(n_eff * n_eff - n_2 * n_2);
+            return std::atan(c * gamma / kappa) - k0 * d * kappa / 2;
+        };
+        double lo = n_2;
+        double hi = n_1;
+        for (std::size_t iter = 0; iter < 100; iter++) {
+            const double mid = (lo + hi) / 2;
+            (g(mid) < 0 ? lo : hi) = mid;
+        }
+        return (lo + hi) / 2;
+    };
+    const std::vector<std::valarray<std::complex<double>>> slab_n = {{n_2}, {n_1}, {n_2}};
+    const std::vector<double> slab_d = {INFINITY, d, INFINITY};
+    const guided_mode_dict<double> slab = find_guided_modes(slab_n, slab_d, std::valarray<double>{1550},
+                                                            std::complex<double>(1.46, -0.01),
+                                                            std::complex<double>(3.49, 0.01));
+    const std::valarray<std::complex<double>> &slab_s = std::get<0>(slab.at("n_eff_s")).at(0);
+    const std::valarray<std::complex<double>> &slab_p = std::get<0>(slab.at("n_eff_p")).at(0);
+    assert(slab_s.size() == 1 and slab_p.size() == 1);
+    const ApproxScalar<double, double> te_approx = approx<double, double>(slab_mode(1), 1e-9);
+    const ApproxScalar<double, double> tm_approx = approx<double, double>(slab_mode(n_1 * n_1 / (n_2 * n_2)), 1e-9);
+    assert(slab_s[0].real() == te_approx);
+    assert(slab_p[0].real() == tm_approx);
+    // Asymmetric stack with two inner layers, whose mode condition is not even in the kz of a single inner layer.
+    const std::vector<std::valarray<std::complex<double>>> n_list = {{1}, {2.5}, {1.5}, {1.45}};
+    const std::vector<double> d_list = {INFINITY, 300, 50, INFINITY};
+    const std::valarray<double> lam_vac = {600};
+    const guided_mode_dict<double> upper = find_guided_modes(n_list, d_list, lam_vac, std::complex<double>(2.3, -0.01),
+                                                             std::complex<double>(2.45, 0.01));
+    const std::valarray<std::complex<double>> &upper_s = std::get<0>(upper.at("n_eff_s")).at(0);
+    assert(upper_s.size() == 1);
+    const ApproxScalar<double, double> upper_approx = approx<double, double>(2.3795785, 1e-7);
+    assert(upper_s[0].real() == upper_approx);
+    const guided_mode_dict<double> lower = find_guided_modes(n_list, d_list, lam_vac, std::complex<double>(2.0, -0.01),
+                                                             std::complex<double>(2.3, 0.01));
+    assert(std::get<0>(lower.at("n_eff_s")).at(0).size() == 0);
+}
+
+void test_coh_tmm_partial() {
+    const std::vector<std::valarray<std::complex<double>>> n_list = {{1, 1}, {1.5 + 1e-4i, 1.5 + 2e-5i},
+                                                                     {2.0 + 0.1i, 3.0 + 0.05i}, {1, 1}};
+    const std::vector<double> d_list = {INFINITY, 5000, 80, INFINITY};
+    constexpr std::complex<double> th_0 = 0.3;
+    const std::valarray<double> lam_vac = {400, 600};
+    // A zero coherence length reproduces an incoherent layer: R, T and the absorption in every layer match inc_tmm().
+    const partial_tmm_dict<double> inc_result = coh_tmm_partial('s', n_list, d_list, {INFINITY, 0, INFINITY, INFINITY},
+                                                                th_0, lam_vac, 32);
+    const ApproxSequenceLike<std::valarray<double>, double> R_approx = approx<std::valarray<double>, double>({0.12202647, 0.29496636});
+    const ApproxSequenceLike<std::valarray<double>, double> T_approx = approx<std::valarray<double>, double>({0.65308701, 0.62385739});
+    assert(std::get<std::valarray<double>>(inc_result.at("R")) == R_approx);
+    assert(std::get<std::valarray<double>>(inc_result.at("T")) == T_approx);
+    const inc_tmm_vec_dict<double> inc_tmm_data = inc_tmm('s', n_list, std::valarray<double>(d_list.data(), d_list.size()),
+                                                          {LayerType::Incoherent, LayerType::Incoherent,
+                                                           LayerType::Coherent, LayerType::Incoherent}, th_0, lam_vac);
+    const ApproxSequenceLike<std::valarray<double>, double> A_approx = approx<std::valarray<double>, double>(inc_absorp_in_each_layer(inc_tmm_data).flat());
+    const Utils::Tensor<double, 2> A_per_layer = std::get<Utils::Tensor<double, 2>>(inc_result.at("A_per_layer"));
+    assert(A_per_layer.flat() == A_approx);
+    // Four incoherent layers are sampled on a lattice instead of a grid of 16 ^ 4 samples.
+    const std::vector<std::valarray<std::complex<double>>> n_thick = {{1, 1}, {1.5 + 1e-4i, 1.5 + 2e-5i},
+                                                                      {2.0 + 1e-3i, 1.8}, {1.4, 1.45 + 1e-4i},
+                                                                      {2.2 + 1e-3i, 2.1}, {3.5 + 0.01i, 3.4}};
+    const std::vector<double> d_thick = {INFINITY, 5000, 4000, 6000, 3000, INFINITY};
+    const partial_tmm_dict<double> lattice_result = coh_tmm_partial('s', n_thick, d_thick,
+                                                                    {INFINITY, 0, 0, 0, 0, INFINITY}, th_0, lam_vac);
+    const inc_tmm_vec_dict<double> inc_thick = inc_tmm('s', n_thick, std::valarray<double>(d_thick.data(), d_thick.size()),
+                                                       std::valarray<LayerType>(LayerType::Incoherent, n_thick.size()),
+                                                       th_0, lam_vac);
+    const ApproxSequenceLike<std::valarray<double>, double> R_thick_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(inc_thick.at("R")), NAN, 2e-3);
+    const ApproxSequenceLike<std::valarray<double>, double> A_thick_approx = approx<std::valarray<double>, double>(inc_absorp_in_each_layer(inc_thick).flat(), NAN, 2e-3);
+    assert(std::get<std::valarray<double>>(lattice_result.at("R")) == R_thick_approx);
+    const Utils::Tensor<double, 2> A_lattice = std::get<Utils::Tensor<double, 2>>(lattice_result.at("A_per_layer"));
+    assert(A_lattice.flat() == A_thick_approx);
+    // An infinite coherence length reproduces coh_tmm().
+    const partial_tmm_dict<double> coh_result = coh_tmm_partial('s', n_list, d_list, {INFINITY, INFINITY, INFINITY, INFINITY},
+                                                                th_0, lam_vac);
+    const coh_tmm_vecn_dict<double> coh_tmm_data = coh_tmm('s', n_list, d_list, th_0, lam_vac);
+    const ApproxSequenceLike<std::valarray<double>, double> coh_R_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(coh_tmm_data.at("R")));
+    assert(std::get<std::valarray<double>>(coh_result.at("R")) == coh_R_approx);
+}
+
+void test_coh_tmm_mixed() {
+    const std::vector<std::valarray<std::complex<double>>> n_list = {{1.5, 1.3}, {1.0 + 0.4i, 1.2 + 0.2i},
+                                                                     {2.0 + 3i, 1.5 + 0.3i}, {5, 4}, {4.0 + 1i, 3.0 + 0.1i}};
+    const std::vector<double> d_list = {INFINITY, 200, 187.3, 1973.5, INFINITY};
+    constexpr std::complex<double> th_0 = 0.3;
+    const std::valarray<double> lam_vac = {400, 1770};
+    const partial_tmm_dict<double> mixed_result = coh_tmm_mixed('s', n_list, d_list, th_0, lam_vac);
+    const coh_tmm_vecn_dict<double> coh_tmm_data = coh_tmm('s', n_list, d_list, th_0, lam_vac);
+    const ApproxSequenceLike<std::valarray<double>, double> R_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(coh_tmm_data.at("R")), 1e-4);
+    const ApproxSequenceLike<std::valarray<double>, double> T_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(coh_tmm_data.at("T")), 1e-4);
+    assert(std::get<std::valarray<double>>(mixed_result.at("R")) == R_approx);
+    assert(std::get<std::valarray<double>>(mixed_result.at("T")) == T_approx);
+    // Over many wavelengths, only the 51 samples are solved in double, and the float results stay within tol.
+    constexpr std::size_t num_wl = 801;
+    std::valarray<double> lam_many(num_wl);
+    std::vector<std::valarray<std::complex<double>>> n_many(n_list.size(), std::valarray<std::complex<double>>(num_wl));
+    for (std::size_t j = 0; j < num_wl; j++) {
+        const double x = static_cast<double>(j) / (num_wl - 1);
+        lam_many[j] = 400 + static_cast<double>(j);
+        for (std::size_t i = 0; i < n_list.size(); i++) {
+            n_many.at(i)[j] = (1 - x) * n_list.at(i)[0] + x * n_list.at(i)[1];
+        }
+    }
+    const partial_tmm_dict<double> many_result = coh_tmm_mixed('s', n_many, d_list, th_0, lam_many);
+    const coh_tmm_vecn_dict<double> many_data = coh_tmm('s', n_many, d_list, th_0, lam_many);
+    const std::valarray<double> &rerun = std::get<std::valarray<double>>(many_result.at("rerun"));
+    assert(rerun.sum() == 51);
+    const ApproxSequenceLike<std::valarray<double>, double> R_many_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(many_data.at("R")), 0, 1e-4);
+    const ApproxSequenceLike<std::valarray<double>, double> A_many_approx = approx<std::valarray<double>, double>(absorp_in_each_layer(many_data).flat(), 0, 1e-4);
+    assert(std::get<std::valarray<double>>(many_result.at("R")) == R_many_approx);
+    const Utils::Tensor<double, 2> A_many = std::get<Utils::Tensor<double, 2>>(many_result.at("A_per_layer"));
+    assert(A_many.flat() == A_many_approx);
+    // With tol = 0, every sample disagrees with the float result, which flags all wavelengths between the samples.
+    const partial_tmm_dict<double> strict_result = coh_tmm_mixed('s', n_many, d_list, th_0, lam_many, 0.0);
+    assert(std::get<std::valarray<double>>(strict_result.at("rerun")).sum() == num_wl);
+    const ApproxSequenceLike<std::valarray<double>, double> R_strict_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(many_data.at("R")), 1e-12);
+    assert(std::get<std::valarray<double>>(strict_result.at("R")) == R_strict_approx);
+}
+
+void test_coh_tmm_bidirectional() {
+    const std::vector<std::valarray<std::complex<double>>> n_list = {{1.5, 1.3}, {1.0 + 0.4i, 1.2 + 0.2i},
+                                                                     {2.0 + 3i, 1.5 + 0.3i}, {5, 4}, {4.0 + 1i, 3}};
+    const std::vector<double> d_list = {INFINITY, 200, 187.3, 1973.5, INFINITY};
+    constexpr std::complex<double> th_0 = 0.3;
+    const std::valarray<double> lam_vac = {400, 1770};
+    const partial_tmm_dict<double> result = coh_tmm_bidirectional('s', n_list, d_list, th_0, lam_vac);
+    const coh_tmm_vecn_dict<double> coh_tmm_data = coh_tmm('s', n_list, d_list, th_0, lam_vac);
+    const ApproxSequenceLike<std::valarray<double>, double> R_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(coh_tmm_data.at("R")));
+    const ApproxSequenceLike<std::valarray<double>, double> T_approx = approx<std::valarray<double>, double>(std::get<std::valarray<double>>(coh_tmm_data.at("T")));
+    const ApproxSequenceLike<std::valarray<double>, double> A_approx = approx<std::valarray<double>, double>(absorp_in_each_layer(coh_tmm_data).flat());
+    assert(std::get<std::valarray<double>>(result.at("R")) == R_approx);
+    assert(std::get<std::valarray<double>>(result.at("T")) == T_approx);
+    const Utils::Tensor<double, 2> A_per_layer = std::get<Utils::Tensor<double, 2>>(result.at("A_per_layer"));
+    assert(A_per_layer.flat() == A_approx);
+    // Same as test_coh_tmm_reverse()
+    const ApproxSequenceLike<std::valarray<double>, double> R_rev_approx = approx<std::valarray<double>, double>({0.20458758, 0.15908784});
+    const ApproxSequenceLike<std::valarray<double>, double> T_rev_approx = approx<std::valarray<double>, double>({1.22605928e-09, 4.19050975e-01});
+    assert(std::get<std::valarray<double>>(result.at("R_rev")) == R_rev_approx);
+    assert(std::get<std::valarray<double>>(result.at("T_rev")) == T_rev_approx);
+    std::valarray<std::complex<double>> th_f(lam_vac.size());
+    for (std::size_t j = 0; j < lam_vac.size(); j++) {
+        th_f[j] = snell(n_list.front()[j], n_list.back()[j], th_0);
+    }
+    const std::vector<std::valarray<std::complex<double>>> reversed_n_list(n_list.crbegin(), n_list.crend());
+    const std::vector<double> reversed_d_list(d_list.crbegin(), d_list.crend());
+    const Utils::Tensor<double, 2> A_reversed = absorp_in_each_layer(coh_tmm('s', reversed_n_list, reversed_d_list, th_f, lam_vac));
+    std::valarray<double> A_rev_expected(A_reversed.size());
+    for (std::size_t i = 0; i < n_list.size(); i++) {
+        A_rev_expected[std::slice(i * lam_vac.size(), lam_vac.size(), 1)] = A_reversed[n_list.size() - 1 - i].flat();
+    }
+    const ApproxSequenceLike<std::valarray<double>, double> A_rev_approx = approx<std::valarray<double>, double>(A_rev_expected);
+    const Utils::Tensor<double, 2> A_per_layer_rev = std::get<Utils::Tensor<double, 2>>(result.at("A_per_layer_rev"));
+    assert(A_per_layer_rev.flat() == A_rev_approx);
+}
+
 void test_unpolarized_RT_R() {
     std::valarray<std::complex<double>> n_list = {1.5, 1.0 + 0.4i, 2.0 + 3i, 5, 4.0 + 1i,
                                                   1.3, 1.2 + 0.2i, 1.5 + 0.3i, 4, 3.0 + 0.1i};
@@ -973,7 +1360,8 @@ void test_run_array() {
         0.01179895 + 0.i, 0.00772895 + 0.i, 0.00570666 + 0.i, 0.0043161 + 0.i, 0.00277534 + 0.i, 0.00118025 + 0.i, 0.00016438 + 0.i,
         0.00206809 + 0.i, 0.00196401 + 0.i, 0.00182646 + 0.i, 0.00166052 + 0.i, 0.00147356 + 0.i, 0.00127472 + 0.i, 0.00107422 + 0.i
     }, 1e-4);
-    const std::vector<std::complex<double>> run_result = Utils::Range::vv_flatten<std::valarray<std::valarray<std::complex<double>>>, std::complex<double>>(a.run(Utils::Math::linspace_va<double>(0, 200, 7)));
+    const std::valarray<std::complex<double>> run_flat = a.run(Utils::Math::linspace_va<double>(0, 200, 7)).transposed().flat();
+    const std::vector<std::complex<double>> run_result(std::begin(run_flat), std::end(run_flat));
     assert(run_result == run_approx);
 }
 
@@ -1118,7 +1506,8 @@ void test_absorp_in_each_layer() {
             {"th_0", 0.3},
             {"lam_vac", std::valarray<double>{400, 1770}}
     };
-    const std::vector<double> ab_result = Utils::Range::vv_flatten<std::valarray<std::valarray<double>>, double>(absorp_in_each_layer(coh_tmm_data));
+    const std::valarray<double> ab_flat = absorp_in_each_layer(coh_tmm_data).flat();
+    const std::vector<double> ab_result(std::begin(ab_flat), std::end(ab_flat));
     const ApproxSequenceLike<std::vector<double>, double> ab_approx = approx<std::vector<double>, double>({
             6.51396300e-02, 6.12213100e-02,
             9.08895166e-01, 3.25991032e-01,
@@ -1344,12 +1733,12 @@ void test_inc_absorp_in_each_layer() {
             {"num_inc_layers", 4U},
             {"num_layers", 5U}
     };
-    const ApproxNestedRange<std::vector<std::valarray<double>>, double> absorp_approx = approx<std::vector<std::valarray<double>>, double>(std::vector<std::valarray<double>>{{6.91010944e-02, 9.34006064e-02},
-                                                                                                                                                                              {8.80953397e-01, 2.49822147e-01},
-                                                                                                                                                                              {4.98234308e-02, 2.68195587e-01},
-                                                                                                                                                                              {0, 0},
-                                                                                                                                                                              {1.22080402e-04, 3.88581656e-01}});
-    assert(inc_absorp_in_each_layer(inc_data) == absorp_approx);
+    const ApproxSequenceLike<std::valarray<double>, double> absorp_approx = approx<std::valarray<double>, double>({6.91010944e-02, 9.34006064e-02,
+                                                                                                                    8.80953397e-01, 2.49822147e-01,
+                                                                                                                    4.98234308e-02, 2.68195587e-01,
+                                                                                                                    0, 0,
+                                                                                                                    1.22080402e-04, 3.88581656e-01});
+    assert(inc_absorp_in_each_layer(inc_data).flat() == absorp_approx);
 }
 
 void test_inc_find_absorp_analytic_fn_exception() {
@@ -1409,21 +1798,22 @@ void test_inc_position_resolved() {
     const std::valarray<double> dist = Utils::Math::linspace_va(0.0, 1100.0, 12.0);
     // layer is going to be uniqued later
     auto [layer, d_in_layer] = find_in_structure_inf(d_list, dist);
-    std::valarray<std::valarray<double>> alphas(std::valarray<double>(2), 4);
+    Utils::Tensor<double, 2> alphas({4, 2});
     for (std::size_t i : std::views::iota(0U, 4U)) {
         for (std::size_t j : std::views::iota(0U, 2U)) {
-            alphas[i][j] = 4 * std::numbers::pi * n_list[i][j].imag() / lam_vac[j];
+            alphas(i, j) = 4 * std::numbers::pi * n_list[i][j].imag() / lam_vac[j];
         }
     }
-    const ApproxNestedRange<std::valarray<std::valarray<double>>, double> incpr_approx = approx<std::valarray<std::valarray<double>>, double>(
-            Utils::Range::rng2l_transpose(std::valarray<std::valarray<double>>{
-        {0, 5.41619013e-02, 1.11248375e-04, 7.66705892e-03,
-         4.38516795e+00, 2.50714861e+03, 1.43341858e+06, 8.19532120e+08,
-         4.68553223e+11, 2.67887148e+14, 1.53159813e+17, 0},
-        {0, 0, 0, 0,
-         0, 0, 0, 0,
-         0, 0, 0, 1.74764534e-13}}));
-    assert(inc_position_resolved(std::forward<std::valarray<std::size_t>>(layer), d_in_layer, inc_tmm_data, c_list, alphas) == incpr_approx);
+    // (wavelength, depth)
+    const Utils::Tensor<double, 2> incpr_expected({2, 12}, {
+        0, 5.41619013e-02, 1.11248375e-04, 7.66705892e-03,
+        4.38516795e+00, 2.50714861e+03, 1.43341858e+06, 8.19532120e+08,
+        4.68553223e+11, 2.67887148e+14, 1.53159813e+17, 0,
+        0, 0, 0, 0,
+        0, 0, 0, 0,
+        0, 0, 0, 1.74764534e-13});
+    const ApproxSequenceLike<std::valarray<double>, double> incpr_approx = approx<std::valarray<double>, double>(incpr_expected.transposed().flat());
+    assert(inc_position_resolved(std::forward<std::valarray<std::size_t>>(layer), d_in_layer, inc_tmm_data, c_list, alphas).flat() == incpr_approx);
 }
 
 void test_beer_lambert() {
@@ -1431,12 +1821,348 @@ void test_beer_lambert() {
     const std::valarray<double> fraction = Utils::Math::linspace_va(0.2, 1.0, 5.0);
     const std::valarray<double> A_total = {0, 9.99999989e-09, 2.99999992e-08, 5.99999978e-08, 9.99999950e-08};
     const std::valarray<double> dist = Utils::Math::linspace_va(0.0, 100e-9, 4.0);
-    const ApproxNestedRange<std::valarray<std::valarray<double>>, double> bl_approx = approx<std::valarray<std::valarray<double>>, double>(std::valarray<std::valarray<double>>{{0, 0, 0, 0},
-                                                                                                                                                                                {0.1, 0.1, 0.1, 0.1},
-                                                                                                                                                                                {0.3, 0.3, 0.29999999, 0.29999999},
-                                                                                                                                                                                {0.6, 0.59999999, 0.59999997, 0.59999996},
-                                                                                                                                                                                {1, 0.99999997, 0.99999993, 0.9999999}});
-    assert(beer_lambert(alphas, fraction, dist, A_total) == bl_approx);
+    const ApproxSequenceLike<std::valarray<double>, double> bl_approx = approx<std::valarray<double>, double>({0, 0, 0, 0,
+                                                                                                                0.1, 0.1, 0.1, 0.1,
+                                                                                                                0.3, 0.3, 0.29999999, 0.29999999,
+                                                                                                                0.6, 0.59999999, 0.59999997, 0.59999996,
+                                                                                                                1, 0.99999997, 0.99999993, 0.9999999});
+    assert(beer_lambert(alphas, fraction, dist, A_total).flat() == bl_approx);
+}
+
+void test_hemispherical_tmm() {
+    const std::valarray<double> lam_vac = {400e-9, 550e-9, 800e-9};
+    const std::size_t num_wl = lam_vac.size();
+    const std::valarray<double> theta = Utils::Math::linspace_va(0.0, std::numbers::pi / 2, 4001);
+    const std::valarray<double> sweep_weights = 2 * Utils::Math::simpson_weights(theta) * std::cos(theta) * std::sin(theta);
+    // Air on glass: the hemispherical reflectance of n = 1.5 is about 9.2 %.
+    const std::vector<std::valarray<std::complex<double>>> n_glass = {std::valarray<std::complex<double>>(1, num_wl),
+                                                                      std::valarray<std::complex<double>>(1.5, num_wl)};
+    double R_fresnel = 0;
+    for (std::size_t a = 0; a < theta.size(); a++) {
+        const std::complex<double> th_1 = snell(std::complex<double>(1), std::complex<double>(1.5), std::complex<double>(theta[a]));
+        R_fresnel += sweep_weights[a] * (interface_R('s', std::complex<double>(1), std::complex<double>(1.5), std::complex<double>(theta[a]), th_1) +
+                                         interface_R('p', std::complex<double>(1), std::complex<double>(1.5), std::complex<double>(theta[a]), th_1)) / 2;
+    }
+    const partial_tmm_dict<double> glass = hemispherical_tmm('u', n_glass, {INFINITY, INFINITY}, {}, lam_vac, 16);
+    const ApproxSequenceLike<std::valarray<double>, double> R_fresnel_approx = approx<std::valarray<double>, double>(std::valarray<double>(R_fresnel, num_wl), 1e-6);
+    assert(std::get<std::valarray<double>>(glass.at("R")) == R_fresnel_approx);
+    const ApproxScalar<double, double> R_glass_approx = approx<double, double>(0.092, 0.01);
+    assert(R_fresnel == R_glass_approx);
+    // A thin absorbing film and a thick absorber on glass against a dense angle sweep of coh_tmm()
+    const std::vector<std::valarray<std::complex<double>>> n_list = {std::valarray<std::complex<double>>(1, num_wl),
+                                                                     std::valarray<std::complex<double>>(2.0 + 0.1i, num_wl),
+                                                                     std::valarray<std::complex<double>>(3.5 + 0.02i, num_wl),
+                                                                     std::valarray<std::complex<double>>(1.5, num_wl)};
+    const std::valarray<double> d_list = {INFINITY, 1e-7, 5e-7, INFINITY};
+    const std::vector<double> d_vec(std::begin(d_list), std::end(d_list));
+    std::valarray<double> R_sweep(0.0, num_wl);
+    std::valarray<double> T_sweep(0.0, num_wl);
+    for (std::size_t a = 0; a < theta.size(); a++) {
+        for (const char pol : {'s', 'p'}) {
+            const coh_tmm_vecn_dict<double> out = coh_tmm(pol, n_list, d_vec, std::complex<double>(theta[a]), lam_vac);
+            R_sweep += sweep_weights[a] / 2 * std::get<std::valarray<double>>(out.at("R"));
+            T_sweep += sweep_weights[a] / 2 * std::get<std::valarray<double>>(out.at("T"));
+        }
+    }
+    const partial_tmm_dict<double> coh = hemispherical_tmm('u', n_list, d_list, {}, lam_vac, 16);
+    const std::valarray<double> &R_coh = std::get<std::valarray<double>>(coh.at("R"));
+    const std::valarray<double> &T_coh = std::get<std::valarray<double>>(coh.at("T"));
+    const ApproxSequenceLike<std::valarray<double>, double> R_sweep_approx = approx<std::valarray<double>, double>(R_sweep, 1e-5);
+    const ApproxSequenceLike<std::valarray<double>, double> T_sweep_approx = approx<std::valarray<double>, double>(T_sweep, 1e-5);
+    assert(R_coh == R_sweep_approx);
+    assert(T_coh == T_sweep_approx);
+    // An all-coherent c_list goes through inc_tmm() node by node and must agree with the coherent branch.
+    const std::valarray<LayerType> all_coherent = {LayerType::Incoherent, LayerType::Coherent, LayerType::Coherent,
+                                                   LayerType::Incoherent};
+    const partial_tmm_dict<double> inc_coh = hemispherical_tmm('u', n_list, d_list, all_coherent, lam_vac, 16);
+    const ApproxSequenceLike<std::valarray<double>, double> R_coh_approx = approx<std::valarray<double>, double>(R_coh, 1e-10);
+    assert(std::get<std::valarray<double>>(inc_coh.at("R")) == R_coh_approx);
+    // Energy conservation of both branches: the first and last rows of A_per_layer are R and T.
+    const std::valarray<LayerType> thick_incoherent = {LayerType::Incoherent, LayerType::Coherent,
+                                                       LayerType::Incoherent, LayerType::Incoherent};
+    const partial_tmm_dict<double> inc = hemispherical_tmm('u', n_list, d_list, thick_incoherent, lam_vac, 16);
+    // inc_tmm() takes one angle at a time, so its sweep is coarser.
+    const std::valarray<double> theta_inc = Utils::Math::linspace_va(0.0, std::numbers::pi / 2, 801);
+    const std::valarray<double> inc_weights = Utils::Math::simpson_weights(theta_inc) * std::cos(theta_inc) * std::sin(theta_inc);
+    std::valarray<double> R_inc_sweep(0.0, num_wl);
+    for (std::size_t a = 0; a < theta_inc.size(); a++) {
+        for (const char pol : {'s', 'p'}) {
+            const inc_tmm_vec_dict<double> out = inc_tmm(pol, n_list, d_list, thick_incoherent, std::complex<double>(theta_inc[a]), lam_vac);
+            R_inc_sweep += inc_weights[a] * std::get<std::valarray<double>>(out.at("R"));
+        }
+    }
+    const ApproxSequenceLike<std::valarray<double>, double> R_inc_approx = approx<std::valarray<double>, double>(R_inc_sweep, 1e-5);
+    assert(std::get<std::valarray<double>>(inc.at("R")) == R_inc_approx);
+    for (const partial_tmm_dict<double> &rat : {coh, inc}) {
+        const std::valarray<double> &R = std::get<std::valarray<double>>(rat.at("R"));
+        const std::valarray<double> &Tr = std::get<std::valarray<double>>(rat.at("T"));
+        const Utils::Tensor<double, 2> &A_per_layer = std::get<Utils::Tensor<double, 2>>(rat.at("A_per_layer"));
+        assert(A_per_layer.shape(0) == n_list.size() and A_per_layer.shape(1) == num_wl);
+        const ApproxSequenceLike<std::valarray<double>, double> R_approx = approx<std::valarray<double>, double>(R, 1e-12);
+        const ApproxSequenceLike<std::valarray<double>, double> T_approx = approx<std::valarray<double>, double>(Tr, 1e-12);
+        assert(A_per_layer[0].flat() == R_approx);
+        assert(A_per_layer[n_list.size() - 1].flat() == T_approx);
+        const ApproxSequenceLike<std::valarray<double>, double> one_approx = approx<std::valarray<double>, double>(std::valarray<double>(1, num_wl), 1e-12);
+        const std::valarray<double> total = R + Tr + A_per_layer[1].flat() + A_per_layer[2].flat();
+        assert(total == one_approx);
+    }
+}
+
+void test_tensor() {
+    Utils::Tensor<double, 2> A({2, 3}, std::valarray<double>{0, 1, 2, 3, 4, 5});
+    // Views write through to the original: a row, the transpose and a slice.
+    Utils::Tensor<double, 1> row = A[1];
+    row(2) = 15;
+    assert(A(1, 2) == 15);
+    Utils::Tensor<double, 2> At = A.transposed();
+    assert(At.shape(0) == 3 and At.shape(1) == 2 and not At.is_contiguous());
+    At(2, 0) = 12;
+    assert(A(0, 2) == 12);
+    Utils::Tensor<double, 2> middle = A.slice(1, 1, 2);
+    middle.assign({21, 22, 23, 24});
+    assert(A(0, 1) == 21 and A(0, 2) == 22 and A(1, 1) == 23 and A(1, 2) == 24);
+    middle *= 2.0;
+    assert(A(1, 2) == 48);
+    // flat() gathers non-contiguous views in row-major order.
+    assert((At.flat() == std::valarray<double>{0, 3, 42, 46, 44, 48}).min());
+    assert((A.slice(1, 1, 2).transposed().flat() == std::valarray<double>{42, 46, 44, 48}).min());
+    // A clone is independent of the original.
+    Utils::Tensor<double, 2> copy = At.clone();
+    assert(copy.is_contiguous());
+    copy(0, 0) = -1;
+    assert(A(0, 0) == 0);
+    A(1, 0) = -3;
+    assert(copy(0, 1) == 3);
+    // A default-constructed tensor has nothing to write to.
+    Utils::Tensor<double, 2> empty;
+    assert(empty.size() == 0 and empty.flat().size() == 0);
+    bool thrown = false;
+    try {
+        empty += std::valarray<double>();
+    } catch (const std::logic_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+void test_rng2d_transpose() {
+    // Element (i, j) of the num_rows x num_cols matrix holds i * 100 + j, which the transpose holds at (j, i).
+    // 3 x 5 follows the permutation cycles, 33 x 40 crosses the boundary of the 32 x 32 tiles of double, and 40 x 40
+    // swaps mirrored tiles.
+    for (const auto &[num_rows, num_cols] : {std::pair<std::size_t, std::size_t>{3, 5}, {33, 40}, {40, 40}}) {
+        std::valarray<double> va(num_rows * num_cols);
+        std::valarray<double> expected(num_rows * num_cols);
+        for (std::size_t i = 0; i < num_rows; i++) {
+            for (std::size_t j = 0; j < num_cols; j++) {
+                va[i * num_cols + j] = expected[j * num_rows + i] = static_cast<double>(i * 100 + j);
+            }
+        }
+        assert((Utils::Range::rng2d_transpose(va, num_rows) == expected).min());
+        std::valarray<double> out(va.size());
+        Utils::Range::rng2d_transpose(va, num_rows, out);
+        assert((out == expected).min());
+        std::valarray<double> in_place = va;
+        Utils::Range::rng2d_transpose_inplace(in_place, num_rows);
+        assert((in_place == expected).min());
+        const auto view = Utils::Range::rng2d_transposed_view(va, num_rows);
+        assert(std::ranges::size(view) == va.size());
+        assert(std::ranges::equal(view, expected));
+        assert(view[num_rows * (num_cols - 1)] == static_cast<double>(num_cols - 1));
+    }
+}
+
+void test_pchip() {
+    // Reference values of scipy.interpolate.PchipInterpolator on a non-uniform grid with a flat interval and extrema
+    const std::valarray<double> x = {0, 1, 2.5, 3, 5, 6};
+    const std::valarray<double> y = {0, 1, 1, 3, 2, 2.5};
+    const Utils::Math::Pchip<double> pchip(x, y);
+    const std::valarray<double> xi = {0.5, 1.7, 2.75, 3.2, 4, 5.5, 6};
+    const ApproxSequenceLike<std::valarray<double>, double> scipy_approx = approx<std::valarray<double>, double>(
+            {0.675, 1, 2, 2.972, 2.5, 2.145833333333333, 2.5}, 1e-12);
+    assert(pchip.evaluate<std::valarray<double>>(xi) == scipy_approx);
+    // Clamped outside the grid
+    const std::valarray<double> outside = pchip.evaluate<std::valarray<double>>(std::valarray<double>{-1, 7});
+    assert(outside[0] == 0 and outside[1] == 2.5);
+    // Monotone data give a monotone interpolant that stays within the data, where a cubic spline would overshoot.
+    const std::valarray<double> step_x = {0, 1, 2, 3, 4, 5};
+    const std::valarray<double> step_y = {0, 0, 0.1, 0.9, 1, 1};
+    const std::valarray<double> fine = Utils::Math::linspace_va(0.0, 5.0, 501);
+    const std::valarray<double> step = Utils::Math::Pchip<double>(step_x, step_y).evaluate<std::valarray<double>>(fine);
+    for (std::size_t j = 1; j < fine.size(); j++) {
+        assert(step[j] >= step[j - 1] and step[j] >= 0 and step[j] <= 1);
+    }
+    // Two points give the line through them.
+    const Utils::Math::Pchip<double> line(std::valarray<double>{1, 3}, std::valarray<double>{2, -2});
+    const ApproxSequenceLike<std::valarray<double>, double> line_approx = approx<std::valarray<double>, double>({1, -1}, 1e-12);
+    assert(line.evaluate<std::valarray<double>>(std::valarray<double>{1.5, 2.5}) == line_approx);
+    // Repeated or descending grid points would divide by zero.
+    for (const std::valarray<double> &bad_x : {std::valarray<double>{0, 1, 1, 2}, std::valarray<double>{0, 2, 1, 3}}) {
+        bool thrown = false;
+        try {
+            const Utils::Math::Pchip<double> bad(bad_x, std::valarray<double>{0, 1, 2, 3});
+        } catch (const std::invalid_argument &) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    // Integrated over wavelength, a smooth band tabulated at 17 points is more accurate with PCHIP than at 65 points
+    // with linear interpolation.
+    const auto band = [](const std::valarray<double> &wl) -> std::valarray<double> {
+        return 3.5 + 0.5 * std::exp(-(wl - 550.0) * (wl - 550.0) / (2.0 * 80 * 80));
+    };
+    const std::valarray<double> wl_fine = Utils::Math::linspace_va(400.0, 800.0, 4001);
+    const std::valarray<double> weights = Utils::Math::trapezoid_weights(wl_fine);
+    const double exact = (weights * band(wl_fine)).sum();
+    const std::valarray<double> wl_coarse = Utils::Math::linspace_va(400.0, 800.0, 17);
+    const double pchip_error = std::abs((weights * Utils::Math::Pchip<double>(wl_coarse, band(wl_coarse)).evaluate<std::valarray<double>>(wl_fine)).sum() - exact);
+    const std::valarray<double> wl_grid = Utils::Math::linspace_va(400.0, 800.0, 65);
+    const std::valarray<double> band_grid = band(wl_grid);
+    const std::vector<double> wl_linear(std::begin(wl_grid), std::end(wl_grid));
+    const std::vector<double> band_linear(std::begin(band_grid), std::end(band_grid));
+    const std::vector<double> wl_fine_vec(std::begin(wl_fine), std::end(wl_fine));
+    const std::vector<double> linear = Utils::Math::interp1_linear(wl_linear, band_linear, wl_fine_vec);
+    const double linear_error = std::abs((weights * std::valarray<double>(linear.data(), linear.size())).sum() - exact);
+    assert(pchip_error < linear_error);
+}
+
+void test_spectrum() {
+    constexpr double h = 6.62607015e-34;
+    constexpr double c = 299792458;
+    constexpr double k_B = 1.380649e-23;
+    constexpr double q = 1.602176634e-19;
+    // On non-uniform grids, trapezoid weights integrate lines and Simpson weights parabolas exactly, for an even and an
+    // odd number of intervals.
+    for (const std::valarray<double> &x : {std::valarray<double>{0, 0.1, 0.35, 0.5, 0.9, 1.2, 1.7, 2},
+                                           std::valarray<double>{0, 0.3, 0.4, 0.9, 1.25, 1.6, 2}}) {
+        const ApproxScalar<double, double> line_approx = approx<double, double>(8, 1e-12);
+        const ApproxScalar<double, double> parabola_approx = approx<double, double>(8.0 / 3, 1e-12);
+        assert((Utils::Math::trapezoid_weights(x) * (3 * x + 1)).sum() == line_approx);
+        assert((Utils::Math::simpson_weights(x) * x * x).sum() == parabola_approx);
+    }
+    // The photon flux of a black body into a hemisphere is 4 * zeta(3) * pi * (k * T)^3 / (h^3 * c^2).
+    constexpr double temperature = 5778;
+    std::valarray<double> lam_bb(20001);
+    for (std::size_t j = 0; j < lam_bb.size(); j++) {
+        lam_bb[j] = 5e-8 * std::pow(1e4, static_cast<double>(j) / (lam_bb.size() - 1));
+    }
+    const double kT = k_B * temperature;
+    // Beyond 0.5 mm, the Rayleigh-Jeans tail 2 * pi * k * T / (h * lambda^3) adds pi * k * T / (h * lambda^2).
+    const double bb_total = (Utils::Math::trapezoid_weights(lam_bb) * blackbody_photon_flux(lam_bb, temperature)).sum() +
+            std::numbers::pi * kT / (h * 25e-8);
+    const ApproxScalar<double, double> bb_approx = approx<double, double>(4 * 1.2020569031595942 * std::numbers::pi * kT * kT * kT / (h * h * h * c * c), 1e-6);
+    assert(bb_total == bb_approx);
+    // A step absorber under a flat spectrum of 1 W m-2 nm-1 from 300 nm collects
+    // q * 1e9 / (h * c) * (800 nm^2 - 300 nm^2) / 2; the R and T rows are not layers.
+    SpectrumLibrary<double> spectra;
+    spectra.add_table("flat", {300e-9, 1200e-9}, {1e9, 1e9});
+    std::valarray<double> lam_vac(901);
+    std::valarray<double> A_step(lam_vac.size());
+    for (std::size_t j = 0; j < lam_vac.size(); j++) {
+        lam_vac[j] = (300 + static_cast<double>(j)) * 1e-9;
+        A_step[j] = j < 500 ? 1 : j == 500 ? 0.5 : 0;
+    }
+    Utils::Tensor<double, 2> A_per_layer({3, lam_vac.size()});
+    A_per_layer[1].assign(A_step);
+    A_per_layer[2].assign(1 - A_step);
+    LightSource<double> flat;
+    flat.name = "flat";
+    const std::valarray<double> Jsc = photocurrent(A_per_layer, spectra.weights(flat, lam_vac));
+    assert(Jsc.size() == 1);
+    const ApproxScalar<double, double> Jsc_approx = approx<double, double>(q * 1e9 / (h * c) * (64e-14 - 9e-14) / 2, 1e-6);
+    assert(Jsc[0] == Jsc_approx);
+    // A laser is absorbed at its wavelength whatever the grid.
+    LightSource<double> laser;
+    laser.name = "laser";
+    laser.wavelength = 532.4e-9;
+    laser.power = 100;
+    const std::valarray<double> Jsc_laser = photocurrent(A_per_layer, spectra.weights(laser, lam_vac));
+    const ApproxScalar<double, double> laser_approx = approx<double, double>(q * 100 * 532.4e-9 / (h * c), 1e-12);
+    assert(Jsc_laser[0] == laser_approx);
+}
+
+void test_adaptive_wavelength_grid() {
+    // 100 nm of a transparent conductor on 2 um of an absorber whose k decays from 0.3 at 400 nm, on glass
+    const auto evaluate = [](const std::valarray<double> &lam_vac) -> rat_dict<double> {
+        const std::size_t num_wl = lam_vac.size();
+        std::vector<std::valarray<std::complex<double>>> n_list = {std::valarray<std::complex<double>>(1, num_wl),
+                                                                   std::valarray<std::complex<double>>(1.9 + 0.01i, num_wl),
+                                                                   std::valarray<std::complex<double>>(num_wl),
+                                                                   std::valarray<std::complex<double>>(1.5, num_wl)};
+        for (std::size_t j = 0; j < num_wl; j++) {
+            n_list.at(2)[j] = {2.5, 0.3 * std::exp(-(lam_vac[j] - 400e-9) / 80e-9)};
+        }
+        const partial_tmm_dict<double> out = coh_tmm_bidirectional('s', n_list, {INFINITY, 1e-7, 2e-6, INFINITY}, std::complex<double>(0), lam_vac);
+        return {{"R", std::get<std::valarray<double>>(out.at("R"))}, {"A_per_layer", std::get<Utils::Tensor<double, 2>>(out.at("A_per_layer"))}};
+    };
+    const std::valarray<double> lam_fine = Utils::Math::linspace_va(400e-9, 1100e-9, 14001);
+    const Utils::Tensor<double, 2> A_fine = std::get<Utils::Tensor<double, 2>>(evaluate(lam_fine).at("A_per_layer"));
+    const double absorbed = (Utils::Math::trapezoid_weights(lam_fine) * A_fine[2].flat()).sum();
+    // 246 points in 4 rounds instead of the 701 of a 1 nm grid give the absorption in the absorber within 4e-5.
+    const rat_dict<double> grid = adaptive_wavelength_grid<double>(evaluate, 400e-9, 1100e-9, 65, 1e-3);
+    const std::valarray<double> &lam_vac = std::get<std::valarray<double>>(grid.at("lam_vac"));
+    assert(lam_vac.size() == 246);
+    assert(std::get<std::valarray<double>>(grid.at("num_rounds"))[0] == 4);
+    const ApproxScalar<double, double> last_approx = approx<double, double>(1100e-9, 1e-12);
+    assert(std::ranges::is_sorted(lam_vac) and lam_vac[0] == 400e-9 and lam_vac[lam_vac.size() - 1] == last_approx);
+    const Utils::Tensor<double, 2> A_per_layer = std::get<Utils::Tensor<double, 2>>(grid.at("A_per_layer"));
+    assert(A_per_layer.shape(1) == lam_vac.size());
+    // The results are sorted along with the grid.
+    const ApproxSequenceLike<std::valarray<double>, double> A_approx = approx<std::valarray<double>, double>(std::get<Utils::Tensor<double, 2>>(evaluate(lam_vac).at("A_per_layer")).flat(), 1e-12);
+    assert(A_per_layer.flat() == A_approx);
+    const std::valarray<double> &weights = std::get<std::valarray<double>>(grid.at("weights"));
+    const ApproxScalar<double, double> absorbed_approx = approx<double, double>(absorbed, 4e-5);
+    assert((weights * A_per_layer[2].flat()).sum() == absorbed_approx);
+}
+
+void test_detailed_balance() {
+    constexpr double h = 6.62607015e-34;
+    constexpr double c = 299792458;
+    constexpr double q = 1.602176634e-19;
+    std::valarray<double> lam_vac(40001);
+    for (std::size_t j = 0; j < lam_vac.size(); j++) {
+        lam_vac[j] = 1e-7 * std::pow(1e3, static_cast<double>(j) / (lam_vac.size() - 1));
+    }
+    // Shockley and Queisser's sun: a 6000 K black body under the solid angle of the sun, on a cell at 300 K
+    SpectrumLibrary<double> spectra;
+    LightSource<double> sun;
+    sun.name = "blackbody";
+    sun.temperature = 6000;
+    const DetailedBalance<double> detailed_balance(lam_vac, spectra.weights(sun, lam_vac), 300);
+    const auto step = [&lam_vac](const double E_g) -> std::valarray<double> {
+        std::valarray<double> absorptance(lam_vac.size());
+        for (std::size_t j = 0; j < lam_vac.size(); j++) {
+            absorptance[j] = lam_vac[j] <= h * c / (E_g * q) ? 1 : 0;
+        }
+        return absorptance;
+    };
+    // About 30 % at 1.1 eV as in their paper, and the maximum of about 31 % near 1.34 eV
+    const std::vector<detailed_balance_dict<double>> results = detailed_balance(std::vector<std::valarray<double>>{step(1.1), step(1.34)});
+    assert(results.at(0).at("PCE") > 0.295 and results.at(0).at("PCE") < 0.305);
+    assert(results.at(1).at("PCE") > 0.305 and results.at(1).at("PCE") < 0.315);
+    // The Lambert W maximum power point against a brute-force scan of J(V) = Jsc - J0 * (exp(V / V_T) - 1)
+    const detailed_balance_dict<double> &result = results.at(1);
+    const double V_T = 1.380649e-23 * 300 / q;
+    const double Jsc = result.at("Jsc");
+    const double J0 = result.at("J0");
+    const ApproxScalar<double, double> Voc_approx = approx<double, double>(V_T * std::log(Jsc / J0 + 1), 1e-12);
+    assert(result.at("Voc") == Voc_approx);
+    double P_max = 0;
+    double V_max = 0;
+    constexpr std::size_t num_steps = 1000000;
+    for (std::size_t k = 0; k <= num_steps; k++) {
+        const double V = result.at("Voc") * static_cast<double>(k) / num_steps;
+        const double P = V * (Jsc - J0 * std::expm1(V / V_T));
+        if (P > P_max) {
+            P_max = P;
+            V_max = V;
+        }
+    }
+    const ApproxScalar<double, double> Vmp_approx = approx<double, double>(V_max, 0, 2 * result.at("Voc") / num_steps);
+    const ApproxScalar<double, double> Pmp_approx = approx<double, double>(P_max, 1e-10);
+    assert(result.at("Vmp") == Vmp_approx);
+    assert(result.at("Vmp") * result.at("Jmp") == Pmp_approx);
+    const ApproxScalar<double, double> FF_approx = approx<double, double>(P_max / (result.at("Voc") * Jsc), 1e-10);
+    assert(result.at("FF") == FF_approx);
 }
 
 void runall() {
@@ -1463,6 +2189,15 @@ void runall() {
     test_coh_tmm_reverse();
     test_ellips_psi();
     test_ellips_Delta();
+    test_ellips_angles();
+    test_ellips_fit();
+    test_dielectric_models();
+    test_coh_tmm_partial();
+    test_textured_stack();
+    test_thickness_optimizer();
+    test_guided_modes();
+    test_coh_tmm_mixed();
+    test_coh_tmm_bidirectional();
     test_unpolarized_RT_R();
     test_find_in_structure();
     test_find_in_structure_inf();
@@ -1485,6 +2220,13 @@ void runall() {
     test_inc_find_absorp_analytic_fn();
     test_inc_position_resolved();
     test_beer_lambert();
+    test_hemispherical_tmm();
+    test_tensor();
+    test_rng2d_transpose();
+    test_pchip();
+    test_spectrum();
+    test_adaptive_wavelength_grid();
+    test_detailed_balance();
 }
 
 void run_all_except() {